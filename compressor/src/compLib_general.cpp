@@ -0,0 +1,43 @@
+/*********************************************************************\
+	compLib_general.cpp
+ 	Copyright (c) Thomas Weber. All rights reserved.
+	Licensed under the MIT License.
+	https://github.com/madweasel/weaselLibrary
+\*********************************************************************/
+
+#include "compLib_general.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------------------
+// Name: generalLib()
+// Desc: generalLib class constructor
+//-----------------------------------------------------------------------------
+compressor::generalLib::generalLib()
+{
+	// init default values
+	osPrint		= &wcout;
+	verbosity	= 3;
+}
+
+//-----------------------------------------------------------------------------
+// Name: ~generalLib()
+// Desc: generalLib class destructor
+//-----------------------------------------------------------------------------
+compressor::generalLib::~generalLib()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Name: print()
+// Desc: 
+//-----------------------------------------------------------------------------
+bool compressor::generalLib::print(wstringstream &ss, int level)
+{
+	if (verbosity > level) {
+		*osPrint << ss.str();
+		return true;
+	} else {
+		return false;
+	}
+}
@@ -0,0 +1,47 @@
+/*********************************************************************\
+	compLib_general.h
+ 	Copyright (c) Thomas Weber. All rights reserved.
+	Licensed under the MIT License.
+	https://github.com/madweasel/weaselLibrary
+\*********************************************************************/
+#pragma once
+
+// standard library only, so that the portable libraries do not depend on the win32 api
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <memory>
+
+/*** Classes *********************************************************/
+
+namespace compressor
+{
+	// base class for all compression libraries, providing a common interface
+	class generalLib
+	{
+	public:
+		enum class libId { undefined, uncompressed, winCompApi, bzip2, skvRans, plyInfoDelta };					// list of all available compression libraries
+
+	protected:
+		// Variables
+		std::wostream						*osPrint;										// stream for output. default is cout
+		int									verbosity;										// output detail level. default is 2
+		std::wstring						name;											// name of the compression library
+		libId								id;												// id of the compression library
+
+											// Constructor
+											generalLib();
+
+	public:
+		virtual								~generalLib();
+		bool								print							(std::wstringstream &ss, int level);
+		bool								setVerbosity					(int newVerbosity) { verbosity = newVerbosity; return true; };
+		std::wstring const&					getName							() { return name; };
+		libId const&						getLibId						() { return id; };
+		virtual bool						compress						(void *compressedData, void *sourceData, unsigned int nBytesToCompress, unsigned int &nBytesCompressed) { return false; };
+		virtual bool						decompress						(void *destData, void *compressedData, unsigned int nBytesCompressed, unsigned int &nBytesDecompressed) { return false; };
+		virtual long long					estimateMaxSizeOfCompressedData	(long long amountUncompressedData) { return 0; };
+		virtual void						setMaxUncompressedSize			(long long maxUncompressedSize) { estimateMaxSizeOfCompressedData(maxUncompressedSize); };	// capacity of the destination buffers passed to decompress()
+		virtual std::unique_ptr<generalLib>	clone							() const { return nullptr; };	// independent instance for another thread, nullptr if not supported
+	};
+} // namespace compressor
@@ -0,0 +1,279 @@
+/*********************************************************************\
+	compLib_plyInfoDelta.cpp
+ 	Copyright (c) Thomas Weber. All rights reserved.
+	Licensed under the MIT License.
+	https://github.com/madweasel/weaselLibrary
+\*********************************************************************/
+
+#include "compLib_plyInfoDelta.h"
+#include <cstring>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__SSE2__)
+	#include <emmintrin.h>
+	#define PLYINFO_DELTA_SSE2
+#endif
+
+//-----------------------------------------------------------------------------
+// Name: plyInfoDelta()
+// Desc: class constructor. Only the first MAX_NUM_SPECIAL_VALUES special values are used.
+//-----------------------------------------------------------------------------
+compressor::plyInfoDelta::plyInfoDelta(std::vector<unsigned short> const& specialValues)
+	: specialValues(specialValues.begin(), specialValues.begin() + std::min<size_t>(specialValues.size(), MAX_NUM_SPECIAL_VALUES))
+{
+	name	= L"plyInfoDelta";
+	id		= libId::plyInfoDelta;
+}
+
+//-----------------------------------------------------------------------------
+// Name: getBitWidth()
+// Desc: Returns the number of bits needed for the largest of the passed residuals.
+//-----------------------------------------------------------------------------
+unsigned int compressor::plyInfoDelta::getBitWidth(const unsigned short* pResiduals, unsigned int numResiduals)
+{
+	unsigned int allBits	= 0;
+	unsigned int bitWidth	= 0;
+
+	for (unsigned int residualNo = 0; residualNo < numResiduals; residualNo++) {
+		allBits |= pResiduals[residualNo];
+	}
+	while (allBits >> bitWidth) bitWidth++;
+	return bitWidth;
+}
+
+//-----------------------------------------------------------------------------
+// Name: decodeResiduals()
+// Desc: Replaces the zigzag coded differences by the values, which are the prefix sum of the differences starting at 'prevValue'.
+//		 'prevValue' is set to the last value afterwards.
+//-----------------------------------------------------------------------------
+void compressor::plyInfoDelta::decodeResiduals(unsigned short* pValues, unsigned int numValues, unsigned short& prevValue)
+{
+	unsigned int valueNo = 0;
+
+#ifdef PLYINFO_DELTA_SSE2
+	// eight values at once: zigzag decoding, prefix sum within the register and the carry of the previous register
+	const __m128i	one		= _mm_set1_epi16(1);
+	__m128i			carry	= _mm_set1_epi16((short) prevValue);
+	for (; valueNo + 8 <= numValues; valueNo += 8) {
+		__m128i zigzag	= _mm_loadu_si128((const __m128i*) &pValues[valueNo]);
+		__m128i delta	= _mm_xor_si128(_mm_srli_epi16(zigzag, 1), _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(zigzag, one)));
+		delta			= _mm_add_epi16(delta, _mm_slli_si128(delta, 2));
+		delta			= _mm_add_epi16(delta, _mm_slli_si128(delta, 4));
+		delta			= _mm_add_epi16(delta, _mm_slli_si128(delta, 8));
+		delta			= _mm_add_epi16(delta, carry);
+		_mm_storeu_si128((__m128i*) &pValues[valueNo], delta);
+		carry			= _mm_shufflehi_epi16(delta, 0xff);
+		carry			= _mm_unpackhi_epi64(carry, carry);
+	}
+	if (valueNo) prevValue = pValues[valueNo - 1];
+#endif
+
+	// remaining values
+	for (; valueNo < numValues; valueNo++) {
+		unsigned short zigzag	= pValues[valueNo];
+		prevValue				= (unsigned short) (prevValue + ((zigzag >> 1) ^ (0 - (zigzag & 1))));
+		pValues[valueNo]		= prevValue;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name: compress()
+// Desc: Compresses the block. If the compressed data would be larger than the source, then the block is stored uncompressed.
+//-----------------------------------------------------------------------------
+bool compressor::plyInfoDelta::compress(void *compressedData, void *sourceData, unsigned int nBytesToCompress, unsigned int &nBytesCompressed)
+{
+	// locals
+	unsigned char*	pOut			= (unsigned char*) compressedData;
+	unsigned char*	pSource			= (unsigned char*) sourceData;
+	unsigned int	numValues		= nBytesToCompress / 2;
+	unsigned int	numSpecials		= (unsigned int) specialValues.size();
+	bool			hasSpecials		= false;
+	bool			hasOddByte		= (nBytesToCompress % 2) != 0;
+	unsigned short	firstValue		= 0;
+	unsigned short	prevValue		= 0;
+	bool			isFirstValue	= true;
+	size_t			compressedSize	= 1 + 4 + 1 + 2 * numSpecials + 2 + 1;
+
+	// split into bitmap and zigzag coded differences of the regular values
+	residuals.clear();
+	bitmap.assign((numValues + 3) / 4, 0);
+	for (unsigned int valueNo = 0; valueNo < numValues; valueNo++) {
+		unsigned short value;
+		memcpy(&value, &pSource[2 * valueNo], 2);
+		unsigned int code = 0;
+		while (code < numSpecials && specialValues[code] != value) code++;
+		if (code < numSpecials) {
+			bitmap[valueNo / 4] |= (unsigned char) ((code + 1) << (2 * (valueNo % 4)));
+			hasSpecials = true;
+			continue;
+		}
+		if (isFirstValue) {
+			firstValue		= value;
+			prevValue		= value;
+			isFirstValue	= false;
+		}
+		short delta = (short) (unsigned short) (value - prevValue);
+		residuals.push_back((unsigned short) ((delta << 1) ^ (delta >> 15)));
+		prevValue = value;
+	}
+
+	// size
+	if (hasSpecials) compressedSize += bitmap.size();
+	if (hasOddByte)  compressedSize += 1;
+	for (size_t first = 0; first < residuals.size(); first += MINIBLOCK_SIZE) {
+		unsigned int numInBlock = (unsigned int) std::min<size_t>(MINIBLOCK_SIZE, residuals.size() - first);
+		compressedSize += 1 + (getBitWidth(&residuals[first], numInBlock) * numInBlock + 7) / 8;
+	}
+
+	// store uncompressed if the coding does not pay off
+	if (compressedSize >= (size_t) nBytesToCompress + 1) {
+		pOut[0]				= METHOD_STORED;
+		memcpy(&pOut[1], pSource, nBytesToCompress);
+		nBytesCompressed	= nBytesToCompress + 1;
+		return true;
+	}
+
+	// header
+	*pOut++ = METHOD_DELTA;
+	memcpy(pOut, &numValues, 4);	pOut += 4;
+	*pOut++ = (unsigned char) numSpecials;
+	for (unsigned short specialValue : specialValues) {
+		memcpy(pOut, &specialValue, 2);	pOut += 2;
+	}
+	memcpy(pOut, &firstValue, 2);	pOut += 2;
+	*pOut++ = (hasSpecials ? FLAG_BITMAP : 0) | (hasOddByte ? FLAG_ODD_BYTE : 0);
+	if (hasSpecials) {
+		memcpy(pOut, bitmap.data(), bitmap.size());
+		pOut += bitmap.size();
+	}
+
+	// bit-packed miniblocks
+	for (size_t first = 0; first < residuals.size(); first += MINIBLOCK_SIZE) {
+		unsigned int		numInBlock	= (unsigned int) std::min<size_t>(MINIBLOCK_SIZE, residuals.size() - first);
+		unsigned int		bitWidth	= getBitWidth(&residuals[first], numInBlock);
+		unsigned long long	bitBuffer	= 0;
+		unsigned int		numBits		= 0;
+		*pOut++ = (unsigned char) bitWidth;
+		for (unsigned int residualNo = 0; residualNo < numInBlock; residualNo++) {
+			bitBuffer	|= (unsigned long long) residuals[first + residualNo] << numBits;
+			numBits		+= bitWidth;
+			for (; numBits >= 8; numBits -= 8, bitBuffer >>= 8) {
+				*pOut++ = (unsigned char) bitBuffer;
+			}
+		}
+		if (numBits) *pOut++ = (unsigned char) bitBuffer;
+	}
+
+	if (hasOddByte) *pOut++ = pSource[nBytesToCompress - 1];
+	nBytesCompressed = (unsigned int) (pOut - (unsigned char*) compressedData);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: decompress()
+// Desc: Decompresses a block. The destination must hold the number of bytes passed to estimateMaxSizeOfCompressedData().
+//-----------------------------------------------------------------------------
+bool compressor::plyInfoDelta::decompress(void *destData, void *compressedData, unsigned int nBytesCompressed, unsigned int &nBytesDecompressed)
+{
+	// locals
+	const unsigned char*	pIn				= (const unsigned char*) compressedData;
+	const unsigned char*	pInEnd			= pIn + nBytesCompressed;
+	unsigned char*			pOut			= (unsigned char*) destData;
+	unsigned int			numValues		= 0;
+	unsigned int			numSpecials		= 0;
+	unsigned short			specials		[MAX_NUM_SPECIAL_VALUES + 1] = {};
+	unsigned int			numRegular		= 0;
+	unsigned char			flags			= 0;
+	const unsigned char*	pBitmap			= nullptr;
+	unsigned short			prevValue		= 0;
+
+	if (nBytesCompressed == 0) return false;
+
+	// stored block
+	if (pIn[0] == METHOD_STORED) {
+		if (nBytesCompressed - 1 > maxUncompressedSize) return false;
+		memcpy(pOut, &pIn[1], nBytesCompressed - 1);
+		nBytesDecompressed = nBytesCompressed - 1;
+		return true;
+	}
+	if (pIn[0] != METHOD_DELTA || nBytesCompressed < 1 + 4 + 1 + 1) return false;
+	pIn++;
+
+	// header
+	memcpy(&numValues, pIn, 4);		pIn += 4;
+	numSpecials = *pIn++;
+	if (numSpecials > MAX_NUM_SPECIAL_VALUES || pIn + 2 * numSpecials + 2 + 1 > pInEnd) return false;
+	for (unsigned int specialNo = 0; specialNo < numSpecials; specialNo++) {
+		memcpy(&specials[specialNo + 1], pIn, 2);	pIn += 2;
+	}
+	memcpy(&prevValue, pIn, 2);		pIn += 2;
+	flags = *pIn++;
+	if (flags & ~(FLAG_BITMAP | FLAG_ODD_BYTE)) return false;
+	nBytesDecompressed = 2 * numValues + ((flags & FLAG_ODD_BYTE) ? 1 : 0);
+	if (numValues > maxUncompressedSize / 2 || nBytesDecompressed > maxUncompressedSize) return false;
+
+	// bitmap
+	numRegular = numValues;
+	if (flags & FLAG_BITMAP) {
+		size_t bitmapSize = ((size_t) numValues + 3) / 4;
+		if ((size_t) (pInEnd - pIn) < bitmapSize) return false;
+		pBitmap	 = pIn;
+		pIn		+= bitmapSize;
+		for (unsigned int valueNo = 0; valueNo < numValues; valueNo++) {
+			unsigned int code = (pBitmap[valueNo / 4] >> (2 * (valueNo % 4))) & 3;
+			if (code > numSpecials) return false;
+			if (code) numRegular--;
+		}
+	}
+
+	// unpack the miniblocks
+	regularValues.resize(numRegular);
+	for (unsigned int first = 0; first < numRegular; first += MINIBLOCK_SIZE) {
+		unsigned int		numInBlock	= std::min<unsigned int>(MINIBLOCK_SIZE, numRegular - first);
+		if (pIn >= pInEnd) return false;
+		unsigned int		bitWidth	= *pIn++;
+		if (bitWidth > 16 || (size_t) (pInEnd - pIn) < (bitWidth * numInBlock + 7) / 8) return false;
+		unsigned long long	bitBuffer	= 0;
+		unsigned int		numBits		= 0;
+		unsigned int		mask		= (1u << bitWidth) - 1;
+		for (unsigned int residualNo = 0; residualNo < numInBlock; residualNo++) {
+			for (; numBits < bitWidth; numBits += 8) {
+				bitBuffer |= (unsigned long long) *pIn++ << numBits;
+			}
+			regularValues[first + residualNo]	 = (unsigned short) (bitBuffer & mask);
+			bitBuffer							>>= bitWidth;
+			numBits								-= bitWidth;
+		}
+	}
+	decodeResiduals(regularValues.data(), numRegular, prevValue);
+
+	// merge regular and special values
+	if (pBitmap) {
+		const unsigned short* pRegular = regularValues.data();
+		for (unsigned int valueNo = 0; valueNo < numValues; valueNo++) {
+			unsigned int	code	= (pBitmap[valueNo / 4] >> (2 * (valueNo % 4))) & 3;
+			unsigned short	value	= code ? specials[code] : *pRegular++;
+			memcpy(&pOut[2 * valueNo], &value, 2);
+		}
+	} else if (numValues) {
+		memcpy(pOut, regularValues.data(), 2 * (size_t) numValues);
+	}
+
+	// trailing odd byte
+	if (flags & FLAG_ODD_BYTE) {
+		if (pIn >= pInEnd) return false;
+		pOut[2 * numValues] = *pIn++;
+	}
+	return pIn == pInEnd;
+}
+
+//-----------------------------------------------------------------------------
+// Name: estimateMaxSizeOfCompressedData()
+// Desc: Blocks, which cannot be compressed, are stored with one additional byte.
+//		 The passed size is also the capacity of the destination buffers passed to decompress().
+//-----------------------------------------------------------------------------
+long long compressor::plyInfoDelta::estimateMaxSizeOfCompressedData(long long amountUncompressedData)
+{
+	maxUncompressedSize = amountUncompressedData;
+	return amountUncompressedData + 1;
+}
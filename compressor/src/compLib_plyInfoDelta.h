@@ -0,0 +1,62 @@
+/*********************************************************************\
+	compLib_plyInfoDelta.h
+ 	Copyright (c) Thomas Weber. All rights reserved.
+	Licensed under the MIT License.
+	https://github.com/madweasel/weaselLibrary
+\*********************************************************************/
+#pragma once
+
+#include "compLib_general.h"
+#include <vector>
+
+/*** Classes *********************************************************/
+
+namespace compressor
+{
+	// Codec for arrays of 16-bit values, where neighbouring values are similar, like the ply infos of the miniMax database.
+	// Up to three special values (e.g. drawn, invalid, uncalculated) are marked in a bitmap with two bits per value.
+	// The differences between the remaining values are zigzag coded and bit-packed in miniblocks of 128 values,
+	// each using the bit width of its largest residual. Decoding of the differences uses SSE2.
+	// Compressed block format:
+	//	1 byte				method (0: stored uncompressed, 1: delta coded)
+	//	method 0:			the uncompressed bytes
+	//	method 1:			4 bytes number of values
+	//						1 byte number of special values, followed by the special values with 2 bytes each
+	//						2 bytes first regular value, from which the differences start
+	//						1 byte flags (bit 0: bitmap present, bit 1: trailing odd byte present)
+	//						bitmap with 2 bits per value (0: regular value, i: special value i - 1)
+	//						for each miniblock: 1 byte bit width, packed residuals
+	//						trailing odd byte
+	// An instance must not be used by several threads at once. Use clone() to get one instance per thread.
+	class plyInfoDelta : public generalLib
+	{
+	public:
+		static constexpr unsigned int	MAX_NUM_SPECIAL_VALUES	= 3;
+
+							plyInfoDelta					(std::vector<unsigned short> const& specialValues = {});
+		bool				compress						(void *compressedData, void *sourceData, unsigned int nBytesToCompress, unsigned int &nBytesCompressed) override;
+		bool				decompress						(void *destData, void *compressedData, unsigned int nBytesCompressed, unsigned int &nBytesDecompressed) override;
+		long long			estimateMaxSizeOfCompressedData	(long long amountUncompressedData) override;
+		void				setMaxUncompressedSize			(long long maxUncompressedSize) override { this->maxUncompressedSize = maxUncompressedSize; };
+		std::unique_ptr<generalLib> clone					() const override { return std::make_unique<plyInfoDelta>(specialValues); };
+
+	private:
+		// Constants
+		static constexpr unsigned int	MINIBLOCK_SIZE			= 128;							// number of residuals sharing one bit width
+		static constexpr unsigned char	METHOD_STORED			= 0;
+		static constexpr unsigned char	METHOD_DELTA			= 1;
+		static constexpr unsigned char	FLAG_BITMAP				= 1;
+		static constexpr unsigned char	FLAG_ODD_BYTE			= 2;
+
+		// Variables
+		std::vector<unsigned short>	specialValues;											// values marked in the bitmap instead of being delta coded
+		long long					maxUncompressedSize		= 0;							// capacity of the destination buffer passed to decompress()
+		std::vector<unsigned short>	residuals;												// zigzag coded differences of the regular values
+		std::vector<unsigned char>	bitmap;													// 2 bits per value
+		std::vector<unsigned short>	regularValues;											// decoded regular values, before they are merged with the special values
+
+		// Functions
+		static unsigned int	getBitWidth						(const unsigned short* pResiduals, unsigned int numResiduals);
+		static void			decodeResiduals					(unsigned short* pValues, unsigned int numValues, unsigned short& prevValue);
+	};
+} // namespace compressor
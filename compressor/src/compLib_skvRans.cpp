@@ -0,0 +1,309 @@
+/*********************************************************************\
+	compLib_skvRans.cpp
+ 	Copyright (c) Thomas Weber. All rights reserved.
+	Licensed under the MIT License.
+	https://github.com/madweasel/weaselLibrary
+\*********************************************************************/
+
+#include "compLib_skvRans.h"
+#include <cstring>
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+// Name: skvRans()
+// Desc: class constructor
+//-----------------------------------------------------------------------------
+compressor::skvRans::skvRans()
+{
+	name	= L"skvRans";
+	id		= libId::skvRans;
+	slots.resize(PROB_SCALE);
+}
+
+//-----------------------------------------------------------------------------
+// Name: tokenize()
+// Desc: Run-length codes the 2-bit symbols of the passed bytes into 'tokens'.
+//-----------------------------------------------------------------------------
+void compressor::skvRans::tokenize(const unsigned char* pData, unsigned int numBytes)
+{
+	// locals
+	unsigned int	curSymbol	= pData[0] & 3;
+	unsigned int	runLength	= 0;
+
+	tokens.clear();
+	for (unsigned int curByte = 0; curByte < numBytes; curByte++) {
+
+		// whole byte continues the run
+		if (pData[curByte] == curSymbol * 0x55 && runLength + 4 <= MAX_RUN_LENGTH) {
+			runLength += 4;
+			continue;
+		}
+
+		// symbol by symbol
+		for (unsigned int symbolNo = 0; symbolNo < 4; symbolNo++) {
+			unsigned int symbol = (pData[curByte] >> (2 * symbolNo)) & 3;
+			if (symbol == curSymbol && runLength < MAX_RUN_LENGTH) {
+				runLength++;
+			} else {
+				tokens.push_back((unsigned char) ((curSymbol << 6) | (runLength - 1)));
+				curSymbol = symbol;
+				runLength = 1;
+			}
+		}
+	}
+	tokens.push_back((unsigned char) ((curSymbol << 6) | (runLength - 1)));
+}
+
+//-----------------------------------------------------------------------------
+// Name: normalizeFrequencies()
+// Desc: Scales the token counts to frequencies summing up to PROB_SCALE. Each used token gets at least frequency 1.
+//-----------------------------------------------------------------------------
+void compressor::skvRans::normalizeFrequencies(const unsigned int* counts, size_t numTokens)
+{
+	// locals
+	unsigned int	sum			= 0;
+	unsigned int	largest		= 0;
+
+	// scale
+	for (unsigned int token = 0; token < NUM_TOKENS; token++) {
+		freqs[token] = counts[token] ? std::max<unsigned int>(1, (unsigned int) ((unsigned long long) counts[token] * PROB_SCALE / numTokens)) : 0;
+		sum += freqs[token];
+		if (freqs[token] > freqs[largest]) largest = token;
+	}
+
+	// the rounding error is given to the most frequent token
+	if (sum <= PROB_SCALE || freqs[largest] > sum - PROB_SCALE) {
+		freqs[largest] += PROB_SCALE;
+		freqs[largest] -= sum;
+	} else {
+		while (sum > PROB_SCALE) {
+			for (unsigned int token = 0; token < NUM_TOKENS; token++) {
+				if (freqs[token] > freqs[largest]) largest = token;
+			}
+			freqs[largest]--;
+			sum--;
+		}
+	}
+
+	// cumulative frequencies
+	for (unsigned int token = 0, start = 0; token < NUM_TOKENS; token++) {
+		starts[token]	 = start;
+		start			+= freqs[token];
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name: compress()
+// Desc: Compresses the block. If the compressed data would be larger than the source, then the block is stored uncompressed.
+//-----------------------------------------------------------------------------
+bool compressor::skvRans::compress(void *compressedData, void *sourceData, unsigned int nBytesToCompress, unsigned int &nBytesCompressed)
+{
+	// locals
+	unsigned char*	pOut		= (unsigned char*) compressedData;
+	unsigned char*	pSource		= (unsigned char*) sourceData;
+	unsigned int	counts		[NUM_TOKENS] = {};
+	unsigned int	numUsed		= 0;
+	size_t			headerSize	= 1 + 4 + 2;
+
+	if (nBytesToCompress == 0) {
+		pOut[0]				= METHOD_STORED;
+		nBytesCompressed	= 1;
+		return true;
+	}
+
+	// run-length coding and token statistics
+	tokenize(pSource, nBytesToCompress);
+	for (unsigned char token : tokens) {
+		counts[token]++;
+	}
+	normalizeFrequencies(counts, tokens.size());
+	for (unsigned int token = 0; token < NUM_TOKENS; token++) {
+		if (!freqs[token]) continue;
+		numUsed++;
+		headerSize += (freqs[token] - 1 < 128) ? 2 : 3;
+	}
+
+	// rANS encoding with two interleaved states, backwards, so that the decoder reads forwards
+	ransBuffer.resize(2 * tokens.size() + 8);
+	unsigned char*	pEnd		= ransBuffer.data() + ransBuffer.size();
+	unsigned char*	pRans		= pEnd;
+	unsigned int	states[2]	= { RANS_L, RANS_L };
+	for (size_t tokenNo = tokens.size(); tokenNo-- > 0; ) {
+		unsigned int& state		= states[tokenNo & 1];
+		unsigned int freq		= freqs[tokens[tokenNo]];
+		unsigned int stateMax	= ((RANS_L >> PROB_BITS) << 8) * freq;
+		while (state >= stateMax) {
+			*--pRans	= (unsigned char) (state & 0xff);
+			state	  >>= 8;
+		}
+		state = ((state / freq) << PROB_BITS) + (state % freq) + starts[tokens[tokenNo]];
+	}
+	for (int stateNo = 1; stateNo >= 0; stateNo--) {
+		for (int byteNo = 0; byteNo < 4; byteNo++) {
+			*--pRans = (unsigned char) (states[stateNo] >> (8 * byteNo));
+		}
+	}
+
+	// store uncompressed if the coding does not pay off
+	size_t ransSize = pEnd - pRans;
+	if (headerSize + ransSize >= (size_t) nBytesToCompress + 1) {
+		pOut[0]				= METHOD_STORED;
+		memcpy(&pOut[1], pSource, nBytesToCompress);
+		nBytesCompressed	= nBytesToCompress + 1;
+		return true;
+	}
+
+	// header
+	unsigned int numTokens = (unsigned int) tokens.size();
+	*pOut++ = METHOD_RANS;
+	memcpy(pOut, &numTokens, 4);	pOut += 4;
+	*pOut++ = (unsigned char) (numUsed & 0xff);
+	*pOut++ = (unsigned char) (numUsed >> 8);
+	for (unsigned int token = 0; token < NUM_TOKENS; token++) {
+		if (!freqs[token]) continue;
+		unsigned int value = freqs[token] - 1;
+		*pOut++ = (unsigned char) token;
+		if (value < 128) {
+			*pOut++ = (unsigned char) value;
+		} else {
+			*pOut++ = (unsigned char) (0x80 | (value & 0x7f));
+			*pOut++ = (unsigned char) (value >> 7);
+		}
+	}
+
+	// rANS stream
+	memcpy(pOut, pRans, ransSize);
+	nBytesCompressed = (unsigned int) (headerSize + ransSize);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: decompress()
+// Desc: Decompresses a block. The destination must hold the number of bytes passed to estimateMaxSizeOfCompressedData().
+//-----------------------------------------------------------------------------
+bool compressor::skvRans::decompress(void *destData, void *compressedData, unsigned int nBytesCompressed, unsigned int &nBytesDecompressed)
+{
+	// locals
+	const unsigned char*	pIn			= (const unsigned char*) compressedData;
+	const unsigned char*	pInEnd		= pIn + nBytesCompressed;
+	unsigned char*			pOut		= (unsigned char*) destData;
+	unsigned char*			pOutEnd		= pOut + maxUncompressedSize;
+	unsigned int			numTokens	= 0;
+	unsigned int			numUsed		= 0;
+	unsigned int			sum			= 0;
+	unsigned int			states[2]	= { 0, 0 };			// two interleaved rANS states, used alternately
+	const unsigned int*		pSlots		= slots.data();
+	unsigned long long		bitBuffer	= 0;				// decoded symbols, which are not written yet
+	unsigned int			numBits		= 0;				// number of used bits in bitBuffer, always below 32 between two tokens
+
+	if (nBytesCompressed == 0) return false;
+
+	// stored block
+	if (pIn[0] == METHOD_STORED) {
+		if (nBytesCompressed - 1 > maxUncompressedSize) return false;
+		memcpy(pOut, &pIn[1], nBytesCompressed - 1);
+		nBytesDecompressed = nBytesCompressed - 1;
+		return true;
+	}
+	if (pIn[0] != METHOD_RANS || nBytesCompressed < 1 + 4 + 2 + 8) return false;
+	pIn++;
+
+	// frequency table
+	memcpy(&numTokens, pIn, 4);		pIn += 4;
+	numUsed = pIn[0] | (pIn[1] << 8);
+	pIn += 2;
+	if (numUsed == 0 || numUsed > NUM_TOKENS) return false;
+	for (unsigned int usedNo = 0; usedNo < numUsed; usedNo++) {
+		if (pIn + 2 > pInEnd) return false;
+		unsigned int token = *pIn++;
+		unsigned int value = *pIn++;
+		if (value & 0x80) {
+			if (pIn >= pInEnd) return false;
+			value = (value & 0x7f) | (*pIn++ << 7);
+		}
+		if (value + 1 > PROB_SCALE - sum) return false;
+		std::fill(&slots[sum], &slots[sum + value + 1], value | (sum << 12) | (token << 24));
+		sum += value + 1;
+	}
+	if (sum != PROB_SCALE) return false;
+
+	// initial states
+	if (pIn + 8 > pInEnd) return false;
+	for (int byteNo = 0; byteNo < 8; byteNo++) {
+		states[byteNo / 4] = (states[byteNo / 4] << 8) | *pIn++;
+	}
+
+	// decodes the next token with one of the states. the state needs at most two bytes for renormalization.
+	auto decodeToken = [&](unsigned int& state) {
+		unsigned int		slot		= state & (PROB_SCALE - 1);
+		unsigned int		info		= pSlots[slot];
+		state = ((info & 0xfff) + 1) * (state >> PROB_BITS) + slot - ((info >> 12) & 0xfff);
+		if (pInEnd - pIn >= 2) {
+			unsigned int needsByte;
+			needsByte = state < RANS_L;		state = needsByte ? (state << 8) | pIn[0] : state;		pIn += needsByte;
+			needsByte = state < RANS_L;		state = needsByte ? (state << 8) | pIn[0] : state;		pIn += needsByte;
+		} else {
+			while (state < RANS_L && pIn < pInEnd) {
+				state = (state << 8) | *pIn++;
+			}
+		}
+		return info >> 24;
+	};
+
+	// appends the run of a token to the bit buffer. runs of 16 symbols fill exactly one word.
+	auto appendRun = [&](unsigned int token) {
+		unsigned long long	pattern		= (token >> 6) * 0x55555555ull;
+		unsigned int		runLength	= (token & 0x3f) + 1;
+		for (; runLength >= 16; runLength -= 16) {
+			if (pOut + 4 > pOutEnd) return false;
+			bitBuffer |= pattern << numBits;
+			unsigned int word = (unsigned int) bitBuffer;
+			memcpy(pOut, &word, 4);
+			pOut		+= 4;
+			bitBuffer  >>= 32;
+		}
+		bitBuffer	|= (pattern & ((1ull << (2 * runLength)) - 1)) << numBits;
+		numBits		+= 2 * runLength;
+		if (numBits >= 32) {
+			if (pOut + 4 > pOutEnd) return false;
+			unsigned int word = (unsigned int) bitBuffer;
+			memcpy(pOut, &word, 4);
+			pOut		+= 4;
+			bitBuffer  >>= 32;
+			numBits		-= 32;
+		}
+		return true;
+	};
+
+	// decode tokens pairwise, so that the two states are processed in parallel by the cpu
+	unsigned int tokenNo = 0;
+	for (; tokenNo + 1 < numTokens; tokenNo += 2) {
+		unsigned int token0 = decodeToken(states[0]);
+		unsigned int token1 = decodeToken(states[1]);
+		if (!appendRun(token0)) return false;
+		if (!appendRun(token1)) return false;
+	}
+	if (tokenNo < numTokens) {
+		if (!appendRun(decodeToken(states[0]))) return false;
+	}
+
+	// remaining bytes, which must be complete
+	if (numBits % 8) return false;
+	for (; numBits; numBits -= 8, bitBuffer >>= 8) {
+		if (pOut >= pOutEnd) return false;
+		*pOut++ = (unsigned char) bitBuffer;
+	}
+	nBytesDecompressed = (unsigned int) (pOut - (unsigned char*) destData);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: estimateMaxSizeOfCompressedData()
+// Desc: Blocks, which cannot be compressed, are stored with one additional byte.
+//		 The passed size is also the capacity of the destination buffers passed to decompress().
+//-----------------------------------------------------------------------------
+long long compressor::skvRans::estimateMaxSizeOfCompressedData(long long amountUncompressedData)
+{
+	maxUncompressedSize = amountUncompressedData;
+	return amountUncompressedData + 1;
+}
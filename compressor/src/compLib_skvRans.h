@@ -0,0 +1,59 @@
+/*********************************************************************\
+	compLib_skvRans.h
+ 	Copyright (c) Thomas Weber. All rights reserved.
+	Licensed under the MIT License.
+	https://github.com/madweasel/weaselLibrary
+\*********************************************************************/
+#pragma once
+
+#include "compLib_general.h"
+#include <vector>
+
+/*** Classes *********************************************************/
+
+namespace compressor
+{
+	// Portable codec for arrays of 2-bit values, like the short knot values of the miniMax database.
+	// Each byte holds four symbols, starting with the lowest two bits. The symbols are run-length coded into tokens
+	// of one byte (symbol in the upper two bits, run length - 1 in the lower six bits), which are entropy coded by rANS.
+	// Compressed block format:
+	//	1 byte				method (0: stored uncompressed, 1: run-length + rANS)
+	//	method 0:			the uncompressed bytes
+	//	method 1:			4 bytes number of tokens
+	//						2 bytes number of used tokens
+	//						for each used token: 1 byte token, varint (frequency - 1)
+	//						8 bytes initial states of the two interleaved rANS decoders, followed by the rANS stream
+	// An instance must not be used by several threads at once. Use clone() to get one instance per thread.
+	class skvRans : public generalLib
+	{
+	public:
+							skvRans							();
+		bool				compress						(void *compressedData, void *sourceData, unsigned int nBytesToCompress, unsigned int &nBytesCompressed) override;
+		bool				decompress						(void *destData, void *compressedData, unsigned int nBytesCompressed, unsigned int &nBytesDecompressed) override;
+		long long			estimateMaxSizeOfCompressedData	(long long amountUncompressedData) override;
+		void				setMaxUncompressedSize			(long long maxUncompressedSize) override { this->maxUncompressedSize = maxUncompressedSize; };
+		std::unique_ptr<generalLib> clone					() const override { return std::make_unique<skvRans>(); };
+
+	private:
+		// Constants
+		static const unsigned int	PROB_BITS				= 12;							// probabilities are scaled to a sum of 1 << PROB_BITS
+		static const unsigned int	PROB_SCALE				= 1 << PROB_BITS;
+		static const unsigned int	RANS_L					= 1u << 23;						// lower bound of the rANS state
+		static const unsigned int	NUM_TOKENS				= 256;							// a token is one byte
+		static const unsigned int	MAX_RUN_LENGTH			= 64;							// longer runs are split into several tokens
+		static const unsigned char	METHOD_STORED			= 0;
+		static const unsigned char	METHOD_RANS				= 1;
+
+		// Variables
+		long long					maxUncompressedSize		= 0;							// capacity of the destination buffer passed to decompress()
+		std::vector<unsigned char>	tokens;													// run-length coded symbols of the current block
+		std::vector<unsigned char>	ransBuffer;												// rANS stream, written backwards
+		std::vector<unsigned int>	slots;													// [slot] lookup table for decoding: frequency - 1, cumulative frequency << 12, token << 24
+		unsigned int				freqs					[NUM_TOKENS];					// [token] normalized frequency
+		unsigned int				starts					[NUM_TOKENS];					// [token] cumulative frequency
+
+		// Functions
+		void				tokenize						(const unsigned char* pData, unsigned int numBytes);
+		void				normalizeFrequencies			(const unsigned int* counts, size_t numTokens);
+	};
+} // namespace compressor
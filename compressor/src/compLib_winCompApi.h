@@ -21,6 +21,8 @@ namespace compressor
 		bool				compress						(void *compressedData, void *sourceData, unsigned int nBytesToCompress, unsigned int &nBytesCompressed) override;
 		bool				decompress						(void *destData, void *compressedData, unsigned int nBytesCompressed, unsigned int &nBytesDecompressed) override;
 		long long			estimateMaxSizeOfCompressedData	(long long amountUncompressedData) override;
+		void				setMaxUncompressedSize			(long long maxUncompressedSize) override { DecompressedBufferSize = static_cast<SIZE_T>(maxUncompressedSize); };
+		std::unique_ptr<generalLib> clone					() const override { return std::make_unique<winCompApi>(); };
 
 	private:
 		COMPRESSOR_HANDLE	Compressor						= NULL;
@@ -8,44 +8,14 @@
 
 #include "compressor.h"
 #include <thread>
-#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <barrier>
 
 using namespace std;
 
-#pragma region generalLib
-//-----------------------------------------------------------------------------
-// Name: generalLib()
-// Desc: generalLib class constructor
-//-----------------------------------------------------------------------------
-compressor::generalLib::generalLib()
-{
-	// init default values
-	osPrint		= &wcout;
-	verbosity	= 3;
-}
-
-//-----------------------------------------------------------------------------
-// Name: ~generalLib()
-// Desc: generalLib class destructor
-//-----------------------------------------------------------------------------
-compressor::generalLib::~generalLib()
-{
-}
-
-//-----------------------------------------------------------------------------
-// Name: print()
-// Desc: 
-//-----------------------------------------------------------------------------
-bool compressor::generalLib::print(wstringstream &ss, int level)
-{
-	if (verbosity > level) {
-		*osPrint << ss.str();
-		return true;
-	} else {
-		return false;
-	}
-}
-
+#pragma region uncompressed
 //-----------------------------------------------------------------------------
 // Name: compress()
 // Desc: 
@@ -87,6 +57,7 @@ compressor::file::file(generalLib & comp)
 	: comp{&comp}
 {
 	footer.usedLib = comp.getLibId();
+	libs[comp.getLibId()] = &comp;
 }
 
 //-----------------------------------------------------------------------------
@@ -100,6 +71,7 @@ compressor::file::~file()
 	}
 	tmpFiles.clear();
 	if (fs.is_open()) fs.close();
+	if (hReadFile != INVALID_HANDLE_VALUE) CloseHandle(hReadFile);
 }
 
 //-----------------------------------------------------------------------------
@@ -143,6 +115,18 @@ bool compressor::file::open(wstring const & filePath, bool onlyRead)
 		footer.read(fs, comp->getLibId());
 	}
 
+	// second handle for positional reads, so that several threads can read at once
+	hReadFile = CreateFile(filePathStr.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+	if (hReadFile == INVALID_HANDLE_VALUE) {
+		fs.close();
+		footer.clear();
+		return false;
+	}
+	readers.resize(2 * std::max<unsigned int>(1, std::thread::hardware_concurrency()));
+	for (auto& reader : readers) {
+		reader = make_unique<readerContext>();
+	}
+
 	readOnlyMode = onlyRead;
 	return true;
 }
@@ -156,9 +140,13 @@ bool compressor::file::close()
 {
 	if (!fs.good())		return false;
 	if (!fs.is_open())	return false;
+	if (stream.isOpen)	endSection();
 	flush();
 	footer.clear();
 	fs.close();
+	readers.clear();
+	if (hReadFile != INVALID_HANDLE_VALUE) CloseHandle(hReadFile);
+	hReadFile = INVALID_HANDLE_VALUE;
 	return true;
 }
 
@@ -180,6 +168,7 @@ std::vector<std::wstring> compressor::file::getKeys()
 	vector<wstring> keys;
 	if (!fs.good()) return keys;
 	if (!fs.is_open()) return keys;
+	std::shared_lock<std::shared_mutex> lock(footerMutex);
 	for (auto& curSection : footer.sections) {					// get all keys from the footer, which are already written to the compressed file
 		keys.push_back(curSection.keyName);
 	}
@@ -199,7 +188,8 @@ bool compressor::file::doesKeyExist(wstring const & key)
 {
 	if (!fs.good()) return false;
 	if (!fs.is_open()) return false;
-	return footer.doesKeyExist(key) || tmpFile::doesExist(key);
+	std::shared_lock<std::shared_mutex> lock(footerMutex);
+	return footer.doesKeyExist(key) || findTmpFile(key) != nullptr;
 }
 
 //-----------------------------------------------------------------------------
@@ -215,9 +205,12 @@ bool compressor::file::read(wstring const & key, long long position, long long n
 	if (!fs.good()) return false;					// a file must be open
 	if (!fs.is_open()) return false;				// a file must be open
 
+	// the sections must not change while they are read
+	std::shared_lock<std::shared_mutex> lock(footerMutex);
+
 	// if there is already a temporary file for the section, then read from it
-	if (tmpFile::doesExist(key)) {
-		return getTmpFile(key).read(position, numBytes, pBytes);
+	if (tmpFile* curTmpFile = findTmpFile(key)) {
+		return curTmpFile->read(position, numBytes, pBytes);
 	} else {
 		if (!footer.doesKeyExist(key)) return false;	// key must exist
 		return readFromCompressed(key, position, numBytes, pBytes);
@@ -233,14 +226,52 @@ bool compressor::file::read(wstring const & key, long long position, long long n
 compressor::file::tmpFile& compressor::file::getTmpFile(wstring const & key)
 {
 	// check if the temporary file already exists
+	if (tmpFile* curTmpFile = findTmpFile(key)) {
+		return *curTmpFile;
+	}
+	// create a new temporary file
+	tmpFiles.push_back(new tmpFile(key, tmpDirectory, maxStagingSizeInMemory));
+	return *tmpFiles.back();
+}
+
+//-----------------------------------------------------------------------------
+// Name: limitStagingInMemory()
+// Desc: Moves the largest sections staged in memory to temporary files, until all staged sections fit into maxTotalStagingSizeInMemory.
+//-----------------------------------------------------------------------------
+bool compressor::file::limitStagingInMemory()
+{
+	// locals
+	long long	totalSizeInMemory	= 0;
+	tmpFile*	largestTmpFile		= nullptr;
+
+	for (auto& curTmpFile : tmpFiles) {
+		if (curTmpFile->isInMemory()) totalSizeInMemory += curTmpFile->getSize();
+	}
+	while (totalSizeInMemory > maxTotalStagingSizeInMemory) {
+		largestTmpFile = nullptr;
+		for (auto& curTmpFile : tmpFiles) {
+			if (curTmpFile->isInMemory() && (!largestTmpFile || curTmpFile->getSize() > largestTmpFile->getSize())) {
+				largestTmpFile = curTmpFile;
+			}
+		}
+		totalSizeInMemory -= largestTmpFile->getSize();
+		if (!largestTmpFile->moveToFile()) return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: findTmpFile()
+// Desc: Returns the temporary file of a section, or nullptr if the section was not written since the last flush.
+//-----------------------------------------------------------------------------
+compressor::file::tmpFile* compressor::file::findTmpFile(wstring const & key)
+{
 	for (auto& curTmpFile : tmpFiles) {
 		if (curTmpFile->getKeyName() == key) {
-			return *curTmpFile;
+			return curTmpFile;
 		}
 	}
-	// create a new temporary file
-	tmpFiles.push_back(new tmpFile(key));
-	return *tmpFiles.back();
+	return nullptr;
 }
 
 //-----------------------------------------------------------------------------
@@ -257,7 +288,97 @@ bool compressor::file::readFromCompressed(wstring const & key, long long positio
 	
 	// locals
 	if (!footer.doesKeyExist(key)) return false;
-	return footer.getSection(key).readData(fs, footer, *comp, pBytes, numBytes, position);
+	sectionInfo&				curSection		= footer.getSection(key);
+	generalLib::libId			sectionLibId	= curSection.usedLib == generalLib::libId::undefined ? footer.usedLib : curSection.usedLib;
+	auto						sectionLib		= libs.find(sectionLibId);
+	unique_ptr<readerContext>	tmpReader;
+	readerContext*				reader			= nullptr;
+	bool						success			= false;
+
+	// the library of the section must be registered by addLib() or setSectionLib()
+	if (sectionLib == libs.end()) return false;
+
+	// if all readers are busy, then a temporary one is used
+	reader = acquireReader();
+	if (!reader) {
+		tmpReader	= make_unique<readerContext>();
+		reader		= tmpReader.get();
+	}
+
+	// each reader uses its own clone of the library. libraries, which cannot be cloned, are used by one thread at a time.
+	vector<decompressionContext>& contexts = reader->contexts[sectionLibId];
+	if (contexts.empty()) {
+		contexts.emplace_back();
+		contexts.back().comp = sectionLib->second->clone();
+	}
+	if (contexts.front().comp) {
+		success = curSection.readData(hReadFile, reader->hEvent, footer, *sectionLib->second, pBytes, numBytes, position, &contexts);
+	} else {
+		lock_guard<mutex> lock(nonCloneableLibMutex);
+		success = curSection.readData(hReadFile, reader->hEvent, footer, *sectionLib->second, pBytes, numBytes, position, &contexts);
+	}
+
+	if (!tmpReader) reader->inUse.store(false, memory_order_release);
+	return success;
+}
+
+//-----------------------------------------------------------------------------
+// Name: acquireReader()
+// Desc: Returns an unused reader context, which must be released by setting inUse to false. Returns nullptr if all are in use.
+//		 The search starts at a position depending on the thread, so that threads rarely compete for the same context.
+//-----------------------------------------------------------------------------
+compressor::file::readerContext* compressor::file::acquireReader()
+{
+	if (readers.empty()) return nullptr;
+	size_t firstReaderNo = std::hash<std::thread::id>{}(std::this_thread::get_id()) % readers.size();
+	for (size_t readerNo = 0; readerNo < readers.size(); readerNo++) {
+		readerContext& reader = *readers[(firstReaderNo + readerNo) % readers.size()];
+		if (!reader.inUse.load(memory_order_relaxed) && !reader.inUse.exchange(true, memory_order_acquire)) {
+			return &reader;
+		}
+	}
+	return nullptr;
+}
+
+//-----------------------------------------------------------------------------
+// Name: readAt()
+// Desc: Reads from the passed position of a file opened with FILE_FLAG_OVERLAPPED. The file pointer is not used,
+//		 so that several threads can read from the same handle at once. Each thread must pass its own event.
+//-----------------------------------------------------------------------------
+bool compressor::file::readAt(HANDLE hFile, HANDLE hEvent, long long offset, long long numBytes, void* pBytes)
+{
+	// locals
+	OVERLAPPED	overlapped		= {};
+	DWORD		numBytesRead	= 0;
+
+	if (hFile == INVALID_HANDLE_VALUE || hEvent == NULL) return false;
+	if (numBytes < 0 || numBytes > 0xffffffff) return false;
+
+	overlapped.Offset		= (DWORD) (offset & 0xffffffff);
+	overlapped.OffsetHigh	= (DWORD) (offset >> 32);
+	overlapped.hEvent		= hEvent;
+	if (!ReadFile(hFile, pBytes, (DWORD) numBytes, NULL, &overlapped) && GetLastError() != ERROR_IO_PENDING) return false;
+	if (!GetOverlappedResult(hFile, &overlapped, &numBytesRead, TRUE)) return false;
+	return numBytesRead == numBytes;
+}
+
+//-----------------------------------------------------------------------------
+// Name: getLibForKey()
+// Desc: Returns the library for writing a section. That is the library of the longest matching key prefix passed to setSectionLib(),
+//		 or the library passed to the constructor.
+//-----------------------------------------------------------------------------
+compressor::generalLib& compressor::file::getLibForKey(wstring const & key)
+{
+	generalLib*	lib				= comp;
+	size_t		prefixLength	= 0;
+
+	for (auto& curSectionLib : sectionLibs) {
+		if (curSectionLib.first.length() < prefixLength) continue;
+		if (key.compare(0, curSectionLib.first.length(), curSectionLib.first) != 0) continue;
+		lib				= curSectionLib.second;
+		prefixLength	= curSectionLib.first.length();
+	}
+	return *lib;
 }
 
 //-----------------------------------------------------------------------------
@@ -277,6 +398,9 @@ bool compressor::file::write(wstring const& key, long long position, long long n
 	if (!fs.good()) return false;													// a file must be open
 	if (!fs.is_open()) return false;												// a file must be open
 
+	// readers must wait, while the staged sections change
+	std::unique_lock<std::shared_mutex> lock(footerMutex);
+
 	// create or open a temporary file for the section
 	tmpFile& curTmpFile = getTmpFile(key);
 
@@ -299,7 +423,8 @@ bool compressor::file::write(wstring const& key, long long position, long long n
 	}
 
 	// write user data to temporary file
-	return curTmpFile.write(position, numBytes, pBytes);
+	if (!curTmpFile.write(position, numBytes, pBytes)) return false;
+	return limitStagingInMemory();
 }
 
 //-----------------------------------------------------------------------------
@@ -313,8 +438,12 @@ bool compressor::file::flush()
 	if (!comp)		return false;				// a compressor must be available
 	if (!fs.good()) return false;				// a file must be open
 	if (!fs.is_open()) return false;			// a file must be open
+	if (stream.isOpen) return false;			// the streamed section is written at the end of the file
 	if (tmpFiles.size() == 0) return false;		// no data to write
 
+	// readers must wait, while the footer changes
+	std::unique_lock<std::shared_mutex> lock(footerMutex);
+
 	// locals
 	vector<filesystem::path> 	tmpFilePaths;
 
@@ -329,11 +458,12 @@ bool compressor::file::flush()
 		// get key from file name and numBytes from file size
 		wstring 	key 		= curTmpFile->getKeyName();
 		long long	numBytes 	= curTmpFile->getSize();
+		generalLib&	sectionComp	= getLibForKey(key);
 		sectionInfo curSection;
 
 		// print info
 		wstringstream ss;
-		ss << L"Flushing section \"" << key << L"\" with " << numBytes << L" bytes." << endl;
+		ss << L"Flushing section \"" << key << L"\" with " << numBytes << L" bytes using " << sectionComp.getName() << L"." << endl;
 		comp->print(ss, 2);
 
 		// does the section already exist?
@@ -345,29 +475,25 @@ bool compressor::file::flush()
 		curSection.offsetInFile		= footer.fileInfoOffsetInFile;
 		curSection.uncompressedSize	= numBytes;
 		curSection.compressedSize	= 0;
-		curSection.numBlocks		= (unsigned int) numBytes / footer.blockSizeInBytes + 1;
+		curSection.blockSizeInBytes	= chooseBlockSize(sectionComp, *curTmpFile, numBytes);
+		curSection.numBlocks		= (unsigned int) (numBytes / curSection.getBlockSize(footer)) + 1;
 		curSection.keyLengthInBytes	= key.length() * sizeof(wchar_t);
 		curSection.keyName			= key;
 		curSection.sectionId		= footer.sections.size();
+		curSection.usedLib			= sectionComp.getLibId();
 		curSection.blocks.resize(curSection.numBlocks);
 	
-		// read data from temporary file in chucks of footer.blockSizeInBytes, compress and write to the compressed file
-		if (!curSection.writeData(fs, footer, *comp, *curTmpFile)) {
+		// read data from temporary file in chucks of the block size, compress and write to the compressed file
+		if (!curSection.writeData(fs, footer, sectionComp, *curTmpFile)) {
 			return false;
 		}
 
-		// update file info
-		footer.dictionary[key]				= curSection.sectionId;
-		footer.sections.push_back(curSection);
-
-		// update footer info
-		footer.numSections++;
-		footer.fileInfoOffsetInFile += curSection.compressedSize + curSection.numBlocks * sizeof(sectionInfo::blockInfo);
-		footer.footerOffsetInFile	+= curSection.compressedSize + curSection.numBlocks * sizeof(sectionInfo::blockInfo);
+		addSectionToFooter(curSection);
 	}
 
 	// write footer
 	footer.write(fs);
+	fs.flush();
 	   
 	// delete all temporary files
 	for (auto& curTmpFile : tmpFiles) {
@@ -378,6 +504,155 @@ bool compressor::file::flush()
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// Name: addSectionToFooter()
+// Desc: Adds a section, which was completely written behind the previous sections, to the footer.
+//-----------------------------------------------------------------------------
+void compressor::file::addSectionToFooter(sectionInfo& curSection)
+{
+	// update file info
+	footer.dictionary[curSection.keyName]	= curSection.sectionId;
+	footer.sections.push_back(curSection);
+
+	// update footer info
+	footer.numSections++;
+	footer.fileInfoOffsetInFile += curSection.compressedSize + curSection.numBlocks * sizeof(sectionInfo::blockInfo);
+	footer.footerOffsetInFile	+= curSection.compressedSize + curSection.numBlocks * sizeof(sectionInfo::blockInfo);
+}
+
+//-----------------------------------------------------------------------------
+// Name: beginSection()
+// Desc: Starts writing a section as a stream, without staging it in a temporary file. The data passed to append()
+//		 is compressed whenever a block is full, so only a few blocks are kept in memory. The section is readable after endSection().
+//		 Only one section can be streamed at once. Sections staged by write() are written by the next flush() after endSection().
+//-----------------------------------------------------------------------------
+bool compressor::file::beginSection(wstring const& key)
+{
+	// check preconditions
+	if (readOnlyMode) return false;													// no appending when in read only mode
+	if (key.length() > maxKeyLength) return false;									// limit key length
+	if (!comp)		return false;													// a compressor must be available
+	if (!fs.good()) return false;													// a file must be open
+	if (!fs.is_open()) return false;												// a file must be open
+	if (stream.isOpen) return false;												// only one section can be streamed
+
+	// readers must wait, while the stream takes the place behind the last section
+	std::unique_lock<std::shared_mutex> lock(footerMutex);
+	if (findTmpFile(key)) return false;												// the section is already staged
+
+	// the section is written behind all other sections, like flush() does
+	stream								= sectionStream{};
+	stream.comp							= &getLibForKey(key);
+	stream.section.offsetInFile			= footer.fileInfoOffsetInFile;
+	stream.section.keyName				= key;
+	stream.section.keyLengthInBytes		= key.length() * sizeof(wchar_t);
+	stream.section.usedLib				= stream.comp->getLibId();
+
+	// the first bytes are kept until the block size is chosen
+	stream.uncompressedData.resize(blockSizeCandidates.empty() ? footer.blockSizeInBytes : std::max<unsigned int>(footer.blockSizeInBytes, blockSizeCandidates.back()));
+	stream.isBlockSizeChosen	= blockSizeCandidates.empty();
+	stream.isOpen				= true;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: append()
+// Desc: Appends data to the section started by beginSection(). If it fails, the section is discarded.
+//-----------------------------------------------------------------------------
+bool compressor::file::append(long long numBytes, const void* pBytes)
+{
+	if (!stream.isOpen) return false;
+	if (!pBytes)	return false;
+	if (numBytes <= 0) return false;
+
+	const char* pSource = (const char*) pBytes;
+	while (numBytes) {
+		size_t numBytesToCopy = (size_t) std::min<long long>(numBytes, stream.uncompressedData.size() - stream.numBytesInBuffer);
+		memcpy(&stream.uncompressedData[stream.numBytesInBuffer], pSource, numBytesToCopy);
+		stream.numBytesInBuffer			+= numBytesToCopy;
+		stream.section.uncompressedSize	+= numBytesToCopy;
+		pSource							+= numBytesToCopy;
+		numBytes						-= numBytesToCopy;
+		if (stream.numBytesInBuffer == stream.uncompressedData.size() && !compressStreamBuffer(false)) {
+			stream.isOpen = false;
+			return false;
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: endSection()
+// Desc: Compresses the remaining data of the streamed section, writes its block infos and adds it to the footer.
+//		 The footer is written right away, since the streamed blocks overwrote the previous one.
+//-----------------------------------------------------------------------------
+bool compressor::file::endSection()
+{
+	if (!stream.isOpen) return false;
+	stream.isOpen = false;
+	if (!compressStreamBuffer(true)) return false;
+
+	// the number of blocks is calculated like in flush(), so that the section is identical to a staged one
+	sectionInfo& curSection		= stream.section;
+	curSection.numBlocks		= (unsigned int) (curSection.uncompressedSize / curSection.getBlockSize(footer)) + 1;
+	curSection.sectionId		= footer.sections.size();
+	curSection.blocks.resize(curSection.numBlocks);
+
+	// write all block infos to file
+	fs.seekp(curSection.offsetInFile + curSection.compressedSize, ios_base::beg);
+	for (auto& curBlock : curSection.blocks) {
+		fs.write((char*) &curBlock, sizeof(curBlock));
+	}
+	if (!fs.good()) return false;
+
+	fs.flush();
+
+	// readers must wait, while the footer changes
+	std::unique_lock<std::shared_mutex> lock(footerMutex);
+	addSectionToFooter(curSection);
+	stream = sectionStream{};
+	if (!footer.write(fs)) return false;
+	fs.flush();
+	return fs.good();
+}
+
+//-----------------------------------------------------------------------------
+// Name: compressStreamBuffer()
+// Desc: Compresses and writes all complete blocks in the buffer of the streamed section, and the incomplete one if it is the last call.
+//		 On the first call the block size is chosen, using the buffer as sample.
+//-----------------------------------------------------------------------------
+bool compressor::file::compressStreamBuffer(bool isLastCall)
+{
+	// locals
+	sectionInfo&	curSection			= stream.section;
+	size_t			offsetInBuffer		= 0;
+	unsigned int	nBytesCompressed	= 0;
+
+	if (!stream.isBlockSizeChosen) {
+		curSection.blockSizeInBytes	= chooseBlockSize(*stream.comp, stream.uncompressedData.data(), 1, stream.numBytesInBuffer);
+		stream.isBlockSizeChosen	= true;
+	}
+
+	// compress and write the blocks
+	unsigned int blockSize = curSection.getBlockSize(footer);
+	stream.compressedData.resize(stream.comp->estimateMaxSizeOfCompressedData(blockSize));
+	fs.seekp(curSection.offsetInFile + curSection.compressedSize, ios_base::beg);
+	while (stream.numBytesInBuffer - offsetInBuffer >= blockSize || (isLastCall && offsetInBuffer < stream.numBytesInBuffer)) {
+		unsigned int numBytesToCompress = (unsigned int) std::min<size_t>(blockSize, stream.numBytesInBuffer - offsetInBuffer);
+		if (!stream.comp->compress(&stream.compressedData[0], &stream.uncompressedData[offsetInBuffer], numBytesToCompress, nBytesCompressed)) return false;
+		fs.write(&stream.compressedData[0], nBytesCompressed);
+		curSection.blocks.push_back({(unsigned int) curSection.compressedSize, nBytesCompressed});
+		curSection.compressedSize	+= nBytesCompressed;
+		offsetInBuffer				+= numBytesToCompress;
+	}
+	if (!fs.good()) return false;
+
+	// keep the incomplete block
+	memmove(&stream.uncompressedData[0], &stream.uncompressedData[offsetInBuffer], stream.numBytesInBuffer - offsetInBuffer);
+	stream.numBytesInBuffer -= offsetInBuffer;
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // Name: setBlockSize()
 // Desc: By default the block size is 1000 bytes. This function allows to change the block size, but only before flushing.
@@ -389,14 +664,174 @@ bool compressor::file::setBlockSize(unsigned int newSizeInBytes)
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// Name: setBlockSizeCandidates()
+// Desc: Lets flush() choose the block size of each section from the passed candidates. Large blocks compress better,
+//		 while small blocks are faster for random access. 'allowedSizeIncrease' weights between both: with 0 the block size
+//		 giving the smallest file is chosen, with e.g. 0.1 the smallest block size, which increases the section by at most 10 %.
+//		 An empty list of candidates restores the fixed block size passed to setBlockSize().
+//-----------------------------------------------------------------------------
+bool compressor::file::setBlockSizeCandidates(std::vector<unsigned int> const& candidates, double allowedSizeIncrease)
+{
+	if (allowedSizeIncrease < 0) return false;
+	if (std::find(candidates.begin(), candidates.end(), 0u) != candidates.end()) return false;
+	blockSizeCandidates			= candidates;
+	this->allowedSizeIncrease	= allowedSizeIncrease;
+	sort(blockSizeCandidates.begin(), blockSizeCandidates.end());
+	blockSizeCandidates.erase(unique(blockSizeCandidates.begin(), blockSizeCandidates.end()), blockSizeCandidates.end());
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: setTmpDirectory()
+// Desc: Sets the directory of the temporary files, e.g. a fast local disk. Only possible while no section is staged.
+//-----------------------------------------------------------------------------
+bool compressor::file::setTmpDirectory(wstring const& directory)
+{
+	if (tmpFiles.size()) return false;
+	if (directory.empty()) return false;
+	tmpDirectory = directory;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: setMaxStagingSizeInMemory()
+// Desc: Sections are staged in memory until they grow beyond this size. Then they are moved to a temporary file.
+//		 With 0 each section is staged in a temporary file. Sections already staged keep their limit.
+//-----------------------------------------------------------------------------
+bool compressor::file::setMaxStagingSizeInMemory(long long maxSizeInBytes)
+{
+	if (maxSizeInBytes < 0) return false;
+	maxStagingSizeInMemory = maxSizeInBytes;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: setMaxTotalStagingSizeInMemory()
+// Desc: Limits the memory of all sections staged in memory together. When a write exceeds it, the largest ones are moved to temporary files.
+//-----------------------------------------------------------------------------
+bool compressor::file::setMaxTotalStagingSizeInMemory(long long maxSizeInBytes)
+{
+	if (maxSizeInBytes < 0) return false;
+	std::unique_lock<std::shared_mutex> lock(footerMutex);
+	maxTotalStagingSizeInMemory = maxSizeInBytes;
+	return limitStagingInMemory();
+}
+
+//-----------------------------------------------------------------------------
+// Name: chooseBlockSize()
+// Desc: Compresses a few samples of the staged section with each candidate block size and returns the chosen one.
+//		 Returns 0 to use the block size of the footer.
+//-----------------------------------------------------------------------------
+unsigned int compressor::file::chooseBlockSize(generalLib& sectionComp, tmpFile& curTmpFile, long long numBytes)
+{
+	if (blockSizeCandidates.empty() || numBytes <= 0) return 0;
+
+	// locals
+	long long				sampleSize			= std::min<long long>(blockSizeCandidates.back(), numBytes);
+	unsigned int			numSamples			= (unsigned int) std::min<long long>(numBlockSizeSamples, numBytes / sampleSize);
+	vector<char>			samples				((size_t) (numSamples * sampleSize));
+
+	// samples evenly distributed over the section
+	for (unsigned int sampleNo = 0; sampleNo < numSamples; sampleNo++) {
+		long long position = numSamples > 1 ? (numBytes - sampleSize) * sampleNo / (numSamples - 1) : 0;
+		if (!curTmpFile.read(position, sampleSize, &samples[sampleNo * sampleSize])) return 0;
+	}
+	return chooseBlockSize(sectionComp, samples.data(), numSamples, sampleSize);
+}
+
+//-----------------------------------------------------------------------------
+// Name: chooseBlockSize()
+// Desc: Compresses the passed samples with each candidate block size and returns the chosen one.
+//		 The block infos stored for each block are part of the compressed size. Returns 0 to use the block size of the footer.
+//-----------------------------------------------------------------------------
+unsigned int compressor::file::chooseBlockSize(generalLib& sectionComp, char* pSamples, unsigned int numSamples, long long sampleSize)
+{
+	if (blockSizeCandidates.empty() || numSamples == 0 || sampleSize <= 0) return 0;
+
+	// locals
+	vector<char>			compressedData;
+	vector<long long>		compressedSizes		(blockSizeCandidates.size(), -1);
+	long long				bestSize			= -1;
+
+	// compressed size of the samples for each candidate
+	for (size_t candidateNo = 0; candidateNo < blockSizeCandidates.size(); candidateNo++) {
+		unsigned int	blockSize		= blockSizeCandidates[candidateNo];
+		long long		compressedSize	= 0;
+		bool			success			= true;
+		compressedData.resize(sectionComp.estimateMaxSizeOfCompressedData(blockSize));
+		for (unsigned int sampleNo = 0; sampleNo < numSamples && success; sampleNo++) {
+			for (long long offset = 0; offset < sampleSize && success; offset += blockSize) {
+				unsigned int numBytesToCompress	= (unsigned int) std::min<long long>(blockSize, sampleSize - offset);
+				unsigned int nBytesCompressed	= 0;
+				success			 = sectionComp.compress(&compressedData[0], &pSamples[sampleNo * sampleSize + offset], numBytesToCompress, nBytesCompressed);
+				compressedSize	+= nBytesCompressed + sizeof(sectionInfo::blockInfo);
+			}
+		}
+		if (!success) continue;
+		compressedSizes[candidateNo] = compressedSize;
+		if (bestSize < 0 || compressedSize < bestSize) bestSize = compressedSize;
+	}
+
+	// smallest candidate, which is close enough to the best one
+	for (size_t candidateNo = 0; candidateNo < blockSizeCandidates.size(); candidateNo++) {
+		if (compressedSizes[candidateNo] < 0) continue;
+		if (compressedSizes[candidateNo] <= bestSize * (1 + allowedSizeIncrease)) return blockSizeCandidates[candidateNo];
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name: getBlockSizeOfSection()
+// Desc: Returns the block size of a section, but only after flushing.
+//-----------------------------------------------------------------------------
+unsigned int compressor::file::getBlockSizeOfSection(wstring const & key)
+{
+	std::shared_lock<std::shared_mutex> lock(footerMutex);
+	if (!footer.doesKeyExist(key)) return 0;
+	return footer.getSection(key).getBlockSize(footer);
+}
+
+//-----------------------------------------------------------------------------
+// Name: addLib()
+// Desc: Makes a further library available for reading sections, which were compressed with it.
+//		 The library must live as long as the file object. Only one library per libId can be added.
+//-----------------------------------------------------------------------------
+bool compressor::file::addLib(generalLib& lib)
+{
+	auto existingLib = libs.find(lib.getLibId());
+	if (existingLib != libs.end()) return existingLib->second == &lib;
+	libs[lib.getLibId()] = &lib;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: setSectionLib()
+// Desc: Sections with a key starting with 'keyPrefix' are written with the passed library instead of the one passed to the constructor.
+//		 The library is also added for reading. Sections written before keep their library.
+//-----------------------------------------------------------------------------
+bool compressor::file::setSectionLib(wstring const& keyPrefix, generalLib& lib)
+{
+	if (!addLib(lib)) return false;
+	for (auto& curSectionLib : sectionLibs) {
+		if (curSectionLib.first == keyPrefix) {
+			curSectionLib.second = &lib;
+			return true;
+		}
+	}
+	sectionLibs.push_back({keyPrefix, &lib});
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // Name: getSizeOfUncompressedSection()
 // Desc: Returns the size of the uncompressed section, but only after flushing.
 //-----------------------------------------------------------------------------
 long long compressor::file::getSizeOfUncompressedSection(wstring const & key)
 {
-	if (tmpFile::doesExist(key)) {
-		return getTmpFile(key).getSize();
+	std::shared_lock<std::shared_mutex> lock(footerMutex);
+	if (tmpFile* curTmpFile = findTmpFile(key)) {
+		return curTmpFile->getSize();
 	}
 	if (!footer.doesKeyExist(key)) return 0;
 	return footer.getSection(key).uncompressedSize;
@@ -408,6 +843,7 @@ long long compressor::file::getSizeOfUncompressedSection(wstring const & key)
 //-----------------------------------------------------------------------------
 long long compressor::file::getSizeOfCompressedSection(wstring const & key)
 {
+	std::shared_lock<std::shared_mutex> lock(footerMutex);
 	if (!footer.doesKeyExist(key)) return 0;
 	return footer.getSection(key).compressedSize;
 }
@@ -525,11 +961,42 @@ bool compressor::file::footerStruct::read(std::fstream & fs, generalLib::libId l
 		if (!curSectionInfo.read(fs, *this)) return false;
 		dictionary[curSectionInfo.keyName] = curSectionInfo.sectionId;
 	}
+
+	// block infos of all sections, so that reading does not modify the footer
+	for (auto& curSectionInfo : sections) {
+		if (!curSectionInfo.readBlockInfos(fs)) return false;
+	}
 	return true;
 }
 #pragma endregion
 
 #pragma region sectionInfo
+//-----------------------------------------------------------------------------
+// Name: sectionInfo::readBlockInfos()
+// Desc: Reads the block infos stored behind the compressed data of the section. They are the index for the random access.
+//-----------------------------------------------------------------------------
+bool compressor::file::sectionInfo::readBlockInfos(std::fstream& fs)
+{
+	if (!fs.good()) return false;
+	if (!fs.is_open()) return false;
+
+	fs.seekg(offsetInFile + compressedSize, ios_base::beg);
+	blocks.resize(numBlocks);
+	if (numBlocks) {
+		fs.read((char*) blocks.data(), numBlocks * sizeof(blockInfo));
+	}
+	return fs.good();
+}
+
+//-----------------------------------------------------------------------------
+// Name: sectionInfo::getBlockSize()
+// Desc: Returns the size of the blocks of this section. Files written before the block size was stored per section use the one of the footer.
+//-----------------------------------------------------------------------------
+unsigned int compressor::file::sectionInfo::getBlockSize(footerStruct const& footer) const
+{
+	return blockSizeInBytes ? blockSizeInBytes : footer.blockSizeInBytes;
+}
+
 //-----------------------------------------------------------------------------
 // Name: sectionInfo::write()
 // Desc: Writes the section info to the file, at the current file pointer position.
@@ -542,14 +1009,14 @@ bool compressor::file::sectionInfo::write(std::fstream& fs, footerStruct& footer
 	if (numBlocks == 0) return false;
 
 	// write section info
-	unsigned int dummy_unit32 = 0;
+	unsigned int libId_uint32 = (unsigned int) usedLib;
 	fs.write((char*) &offsetInFile,		sizeof(offsetInFile		));
 	fs.write((char*) &uncompressedSize,	sizeof(uncompressedSize	));
 	fs.write((char*) &compressedSize,	sizeof(compressedSize	));
 	fs.write((char*) &numBlocks,		sizeof(numBlocks		));
-	fs.write((char*) &dummy_unit32,		sizeof(dummy_unit32		));		// 4 bytes were formerly used for padding
+	fs.write((char*) &libId_uint32,		sizeof(libId_uint32		));		// 4 bytes were formerly used for padding, so older files contain zero here
 	fs.write((char*) &sectionId,		sizeof(sectionId		));
-	fs.write((char*) &dummy_unit32,		sizeof(dummy_unit32		));		// 4 bytes were formerly used for padding
+	fs.write((char*) &blockSizeInBytes,	sizeof(blockSizeInBytes	));		// 4 bytes were formerly used for padding, so older files contain zero here
 	fs.write((char*) &keyLengthInBytes,	sizeof(keyLengthInBytes	));
 	fs.write((char*) keyName.c_str(), keyLengthInBytes);
 
@@ -570,17 +1037,18 @@ bool compressor::file::sectionInfo::read(std::fstream & fs, footerStruct& footer
 
 	// locals
 	vector<wchar_t> keyNameTmp(maxKeyLength, L'\0');
-	unsigned int dummy_unit32;
+	unsigned int libId_uint32 = 0;
 
 	// read section info
 	fs.read((char*) &offsetInFile,		sizeof(offsetInFile		));
 	fs.read((char*) &uncompressedSize,	sizeof(uncompressedSize	));
 	fs.read((char*) &compressedSize,	sizeof(compressedSize	));
 	fs.read((char*) &numBlocks,			sizeof(numBlocks		));
-	fs.read((char*) &dummy_unit32,		sizeof(dummy_unit32		));		// 4 bytes were formerly used for padding
+	fs.read((char*) &libId_uint32,		sizeof(libId_uint32		));		// 4 bytes were formerly used for padding, so older files contain zero here
 	fs.read((char*) &sectionId,			sizeof(sectionId		));
-	fs.read((char*) &dummy_unit32,		sizeof(dummy_unit32		));		// 4 bytes were formerly used for padding
+	fs.read((char*) &blockSizeInBytes,	sizeof(blockSizeInBytes	));		// 4 bytes were formerly used for padding, so older files contain zero here
 	fs.read((char*) &keyLengthInBytes,	sizeof(keyLengthInBytes	));
+	usedLib = (generalLib::libId) libId_uint32;
 
 	// keys
 	if (keyLengthInBytes > maxKeyLength) {
@@ -597,33 +1065,55 @@ bool compressor::file::sectionInfo::read(std::fstream & fs, footerStruct& footer
 //-----------------------------------------------------------------------------
 // Name: sectionInfo::writeData()
 // Desc: Writes the data from tmpFile to the compressed file. IMPORTANT: The whole section must be written at once.
+//		 Large sections are compressed by several threads, each using its own clone of the compression library.
+//		 The output is identical to the single threaded compression.
 //-----------------------------------------------------------------------------
 bool compressor::file::sectionInfo::writeData(std::fstream& fs, footerStruct& footer, generalLib& comp, tmpFile& curTmpFile, bool forceSingleThreading)
 {
 	// set file pointer
 	fs.seekp(offsetInFile, ios_base::beg);
 
-	// BUG: Multithreading does not work
-	forceSingleThreading = true;
+	// locals
+	unsigned int	numThreads			= std::max<unsigned int>(1, std::thread::hardware_concurrency());
+	long long		numBytesTotal		= curTmpFile.getSize();
+	size_t			totalBlocks			= (size_t) ((numBytesTotal + getBlockSize(footer) - 1) / getBlockSize(footer));
+
+	// checks
+	if (numBytesTotal < 0) return false;
+	if (blocks.size() < totalBlocks) return false;
+
+	// each thread needs its own instance of the compression library. if it cannot be cloned only one thread is used.
+	vector<unique_ptr<generalLib>> threadComps;
+	numThreads = (unsigned int) std::min<size_t>(numThreads, totalBlocks);
+	if (!forceSingleThreading && numBytesTotal >= minSizeForMultiThreading && numThreads > 1) {
+		for (unsigned int threadNo = 0; threadNo < numThreads; threadNo++) {
+			unique_ptr<generalLib> threadComp = comp.clone();
+			if (!threadComp) {
+				threadComps.clear();
+				break;
+			}
+			threadComps.push_back(std::move(threadComp));
+		}
+	}
 
 	// single thread compression
-	if (forceSingleThreading || curTmpFile.getSize() < 1000000) {
+	if (threadComps.empty()) {
 
 		vector<char> 	uncompressedData;
 		vector<char>	compressedData;
-		long long		numBytesResting		= curTmpFile.getSize();
+		long long		numBytesResting		= numBytesTotal;
 		unsigned int	nBytesCompressed	= 0;
 		unsigned int	curOffsetInSection	= 0;
 		unsigned int 	curOffsetInTmpFile	= 0;
 		size_t			blockId				= 0;
 		
-		compressedData.resize(comp.estimateMaxSizeOfCompressedData(footer.blockSizeInBytes));
-		uncompressedData.resize(footer.blockSizeInBytes);
+		compressedData.resize(comp.estimateMaxSizeOfCompressedData(getBlockSize(footer)));
+		uncompressedData.resize(getBlockSize(footer));
 
 		while (numBytesResting) {
 			
 			// locals
-			unsigned int numBytesToCompress = (unsigned int) std::min((long long) footer.blockSizeInBytes, numBytesResting);
+			unsigned int numBytesToCompress = (unsigned int) std::min<long long>(getBlockSize(footer), numBytesResting);
 			curTmpFile.read(curOffsetInTmpFile, numBytesToCompress, &uncompressedData[0]);
 
 			// compress data
@@ -641,66 +1131,121 @@ bool compressor::file::sectionInfo::writeData(std::fstream& fs, footerStruct& fo
 			blockId++;
 		}
 
-	// use multi-threading and a buffered file for compression
+	// pipeline: this thread reads the blocks, the worker threads compress them, and this thread writes them in order
 	} else {
-		// Multi-threaded compression with buffered file
-		const size_t numThreads = std::thread::hardware_concurrency();
-		size_t totalBlocks = (size_t)((curTmpFile.getSize() + footer.blockSizeInBytes - 1) / footer.blockSizeInBytes);
 
-		vector<char> 	uncompressedData;
-		vector<char>	compressedData;
+		// a block between reading and writing
+		struct blockJob
+		{
+			size_t				blockId			= 0;
+			vector<char>		data;																	// uncompressed data, replaced by the compressed data
+			unsigned int		numBytes		= 0;													// size of 'data' in bytes
+		};
+
+		// locals
+		mutex					mtx;
+		condition_variable		cvJobs;																	// signaled when a block was read or when the workers shall stop
+		condition_variable		cvDone;																	// signaled when a block was compressed
+		list<blockJob>			jobs;																	// blocks read but not yet compressed
+		map<size_t, blockJob>	reorderBuffer;															// compressed blocks, which are not written yet
+		vector<vector<char>>	freeBuffers;															// buffers of written blocks, which are reused
+		bool					stop				= false;
+		bool					failed				= false;
+		size_t					maxBlocksInFlight	= (size_t) numThreads * numBlocksInFlightPerThread;
+		size_t					nextBlockToRead		= 0;
+		size_t					nextBlockToWrite	= 0;
+		unsigned int			curOffsetInSection	= 0;
+		vector<thread>			workers;
+
+		// start worker threads
+		for (unsigned int threadNo = 0; threadNo < numThreads; threadNo++) {
+			workers.emplace_back([&, threadNo]() {
+				generalLib&		threadComp		= *threadComps[threadNo];
+				vector<char>	compressedData(threadComp.estimateMaxSizeOfCompressedData(getBlockSize(footer)));
+				unique_lock<mutex> lock(mtx);
+				while (true) {
+					cvJobs.wait(lock, [&]() { return stop || !jobs.empty(); });
+					if (stop) return;
+					blockJob job = std::move(jobs.front());
+					jobs.pop_front();
+					lock.unlock();
+
+					// compress block
+					unsigned int nBytesCompressed	= 0;
+					bool		 success			= threadComp.compress(&compressedData[0], &job.data[0], job.numBytes, nBytesCompressed);
+					if (success) {
+						job.data.resize(std::max<size_t>(job.data.size(), nBytesCompressed));
+						memcpy(&job.data[0], &compressedData[0], nBytesCompressed);
+						job.numBytes = nBytesCompressed;
+					}
+
+					lock.lock();
+					if (!success) failed = true;
+					reorderBuffer[job.blockId] = std::move(job);
+					cvDone.notify_all();
+				}
+			});
+		}
 
-		compressedData.resize(comp.estimateMaxSizeOfCompressedData(footer.blockSizeInBytes));
-		uncompressedData.resize(footer.blockSizeInBytes);
-
-		std::vector<std::future<std::pair<std::vector<char>, unsigned int>>> futures;
-		std::vector<std::vector<char>> compressedBlocks(totalBlocks);
-		std::vector<unsigned int> compressedSizes(totalBlocks, 0);
-
-		for (size_t blockId = 0; blockId < totalBlocks; ++blockId) {
-			futures.push_back(std::async(std::launch::async, [&, blockId]() {
-				std::vector<char> blockUncompressed(footer.blockSizeInBytes);
-				std::vector<char> blockCompressed(comp.estimateMaxSizeOfCompressedData(footer.blockSizeInBytes));
-				unsigned int nBytesCompressed = 0;
-				long long offset = blockId * footer.blockSizeInBytes;
-				unsigned int numBytesToCompress = (unsigned int)std::min((long long)footer.blockSizeInBytes, curTmpFile.getSize() - offset);
-				curTmpFile.read(offset, numBytesToCompress, &blockUncompressed[0]);
-				if (!comp.compress(&blockCompressed[0], &blockUncompressed[0], numBytesToCompress, nBytesCompressed)) {
-					throw std::runtime_error("Compression failed in thread");
+		// read, hand over and write the blocks
+		while (nextBlockToWrite < totalBlocks) {
+
+			// read blocks as long as the limit of blocks in memory is not reached
+			while (nextBlockToRead < totalBlocks && nextBlockToRead - nextBlockToWrite < maxBlocksInFlight) {
+				blockJob job;
+				job.blockId		= nextBlockToRead;
+				job.numBytes	= (unsigned int) std::min<long long>(getBlockSize(footer), numBytesTotal - (long long) nextBlockToRead * getBlockSize(footer));
+				{
+					lock_guard<mutex> lock(mtx);
+					if (!freeBuffers.empty()) {
+						job.data = std::move(freeBuffers.back());
+						freeBuffers.pop_back();
+					}
 				}
-				blockCompressed.resize(nBytesCompressed);
-				return std::make_pair(std::move(blockCompressed), nBytesCompressed);
-			}));
-			// Limit number of concurrent threads
-			if (futures.size() >= numThreads) {
-				for (auto& fut : futures) {
-					auto result = fut.get();
-					size_t idx = &fut - &futures[0] + blockId - futures.size() + 1;
-					compressedBlocks[idx] = std::move(result.first);
-					compressedSizes[idx] = result.second;
+				job.data.resize(getBlockSize(footer));
+				if (!curTmpFile.read((long long) nextBlockToRead * getBlockSize(footer), job.numBytes, &job.data[0])) {
+					lock_guard<mutex> lock(mtx);
+					failed = true;
+					break;
 				}
-				futures.clear();
+				lock_guard<mutex> lock(mtx);
+				jobs.push_back(std::move(job));
+				cvJobs.notify_one();
+				nextBlockToRead++;
+			}
+
+			// wait for the next block in order
+			blockJob job;
+			{
+				unique_lock<mutex> lock(mtx);
+				cvDone.wait(lock, [&]() { return failed || reorderBuffer.count(nextBlockToWrite); });
+				if (failed) break;
+				job = std::move(reorderBuffer[nextBlockToWrite]);
+				reorderBuffer.erase(nextBlockToWrite);
 			}
-		}
 
-		// Collect remaining futures
-		size_t startIdx = totalBlocks - futures.size();
-		for (size_t i = 0; i < futures.size(); ++i) {
-			auto result = futures[i].get();
-			compressedBlocks[startIdx + i] = std::move(result.first);
-			compressedSizes[startIdx + i] = result.second;
+			// write to file
+			fs.write(&job.data[0], job.numBytes);
+			compressedSize								+= job.numBytes;
+			blocks[nextBlockToWrite].compressedSize		= job.numBytes;
+			blocks[nextBlockToWrite].offsetInSection	= curOffsetInSection;
+			curOffsetInSection							+= job.numBytes;
+			nextBlockToWrite++;
+
+			lock_guard<mutex> lock(mtx);
+			freeBuffers.push_back(std::move(job.data));
 		}
 
-		// Write all compressed blocks to file and update block info
-		unsigned int curOffsetInSection = 0;
-		compressedSize = 0;
-		for (size_t blockId = 0; blockId < totalBlocks; ++blockId) {
-			fs.write(compressedBlocks[blockId].data(), compressedSizes[blockId]);
-			blocks[blockId].compressedSize = compressedSizes[blockId];
-			blocks[blockId].offsetInSection = curOffsetInSection;
-			curOffsetInSection += compressedSizes[blockId];
-			compressedSize += compressedSizes[blockId];
+		// stop worker threads
+		{
+			lock_guard<mutex> lock(mtx);
+			stop = true;
+			cvJobs.notify_all();
+		}
+		for (auto& worker : workers) {
+			worker.join();
 		}
+		if (failed) return false;
 	}
 
 	// write all block infos to file
@@ -714,74 +1259,146 @@ bool compressor::file::sectionInfo::writeData(std::fstream& fs, footerStruct& fo
 //-----------------------------------------------------------------------------
 // Name: sectionInfo::readData()
 // Desc: Reads the data from the file. This may happen as random access.
+//		 The blocks touched by the range are decompressed directly into pBytes, only partially needed blocks are copied.
+//		 If contexts are passed, then their buffers are reused and large ranges are decompressed by several threads.
+//		 Concurrent reads share the additional threads, so that in total not more threads than cores decompress.
 //-----------------------------------------------------------------------------
-bool compressor::file::sectionInfo::readData(std::fstream& fs, footerStruct& footer, generalLib& comp, void* pBytes, long long numBytes, long long position)
+bool compressor::file::sectionInfo::readData(HANDLE hFile, HANDLE hEvent, footerStruct& footer, generalLib& comp, void* pBytes, long long numBytes, long long position, std::vector<decompressionContext>* contexts)
 {
 	// check preconditions
-	if (fs.good() == false) return false;
-	if (fs.is_open() == false) return false;
+	if (hFile == INVALID_HANDLE_VALUE) return false;
 	if (pBytes == nullptr) return false;
 	if (numBytes <= 0) return false;
 	if (position < 0) return false;
 	if (position >= uncompressedSize) return false;
-	if (position > numBlocks * footer.blockSizeInBytes) return false;
+	if (position + numBytes > uncompressedSize) return false;
+	if (position > numBlocks * getBlockSize(footer)) return false;
 
 	// locals
-	long long			blockId				= position / footer.blockSizeInBytes;			// block index
-	long long			offsetInsideBlock	= position %  footer.blockSizeInBytes;			// offset inside block
-	long long			numBytesResting		= numBytes;										// number of bytes still to read and to copy to pBytes
-	char*				pBlock				= (char*) pBytes;								// moving pointer to the current position in pBytes during the copy process
-	vector<char>		compressedData;														// buffer for compressed data
-	vector<char>		uncompressedData;													// buffer for uncompressed data
-	long long			numRestingCompBytes	= compressedSize;								// number of bytes still available in the compressed section
-	unsigned int		nBytesDecompressed	= 0;											// number of bytes decompressed in the current block
+	long long							firstBlockId		= position / getBlockSize(footer);					// first block touched by the range
+	long long							lastBlockId			= (position + numBytes - 1) / getBlockSize(footer);	// last block touched by the range
+	long long							numBlocksInRange	= lastBlockId - firstBlockId + 1;
+	unsigned int						numThreads			= 1;
+	unsigned int						maxNumThreads		= std::max<unsigned int>(1, std::thread::hardware_concurrency());
+	unsigned int						numFreeThreads;
+	vector<decompressionContext>		localContexts;															// used if the caller does not pass any contexts
 	
-	// is block id valid?
-	if (blockId >= numBlocks) return false;
-
-	// seek to beginning of section
-	compressedData	.resize(comp.estimateMaxSizeOfCompressedData(footer.blockSizeInBytes));	
-	uncompressedData.resize(footer.blockSizeInBytes);
-
-	// if blockInfo not loaded yet than do it now
-	if (blocks.size() == 0) {
-		fs.seekg(offsetInFile + compressedSize, ios_base::beg);
-		blocks.resize(numBlocks);
-		for (auto& curBlock : blocks) {
-			fs.read((char*) &curBlock, sizeof(curBlock));
+	// is block id valid? the block infos are loaded when the footer is read.
+	if (lastBlockId >= numBlocks) return false;
+	if (blocks.size() != numBlocks) return false;
+
+	// one context per thread, the first one uses the passed library unless it has its own clone
+	if (!contexts) {
+		contexts = &localContexts;
+	}
+	if (contexts->empty()) {
+		contexts->emplace_back();
+	}
+	generalLib& firstComp = contexts->front().comp ? *contexts->front().comp : comp;
+	if (numBlocksInRange >= minBlocksForMultiThreading) {
+		numThreads = (unsigned int) std::min<long long>(maxNumThreads, numBlocksInRange);
+		while (contexts->size() < numThreads) {
+			unique_ptr<generalLib> threadComp = comp.clone();
+			if (!threadComp) break;
+			contexts->emplace_back();
+			contexts->back().comp = std::move(threadComp);
 		}
+		numThreads = (unsigned int) std::min<size_t>(numThreads, contexts->size());
+
+		// reserve the additional threads, but only as many as are not used by other reads
+		unsigned int numUsedThreads = numDecodeThreads.load(memory_order_relaxed);
+		do {
+			numFreeThreads = maxNumThreads - 1 - std::min<unsigned int>(maxNumThreads - 1, numUsedThreads);
+		} while (numFreeThreads && !numDecodeThreads.compare_exchange_weak(numUsedThreads, numUsedThreads + std::min<unsigned int>(numThreads - 1, numFreeThreads), memory_order_relaxed));
+		numThreads = 1 + std::min<unsigned int>(numThreads - 1, numFreeThreads);
 	}
 
-	// seekg to relevant block
-	fs.seekg(offsetInFile, ios_base::beg);
-	fs.seekg(blocks[blockId].offsetInSection, ios_base::cur);
-	numRestingCompBytes -= blocks[blockId].offsetInSection;									// update numRestingCompBytes, because we have seeked to the block
-
-	// loop through all remaining blocks
-	// only single threading here
-	while (numBytesResting) {
+	// process the range in chunks, so that the compressed data in memory is limited.
+	// the threads are created once and synchronized by a barrier, while thread zero reads the compressed blocks of each chunk.
+	vector<char>&		compressedData		= contexts->front().compressedData;
+	long long			chunkFirstBlockId	= firstBlockId;
+	long long			chunkLastBlockId	= firstBlockId;
+	long long			chunkOffset			= 0;
+	bool				allChunksDone		= false;
+	atomic<long long>	nextBlockId			= firstBlockId;
+	atomic<bool>		failed				= false;
+	std::barrier<>		chunkBarrier		(numThreads);
+	auto processChunks = [&](unsigned int threadNo) {
+		decompressionContext&	context		= (*contexts)[threadNo];
+		generalLib&				threadComp	= context.comp ? *context.comp : firstComp;
+		threadComp.setMaxUncompressedSize(getBlockSize(footer));
+		while (true) {
+
+			// read the compressed blocks of the chunk at once, since they are stored consecutively
+			if (threadNo == 0) {
+				if (failed || chunkFirstBlockId > lastBlockId) {
+					allChunksDone = true;
+				} else {
+					chunkLastBlockId	= std::min<long long>(lastBlockId, chunkFirstBlockId + (long long) numThreads * numBlocksPerThreadAndChunk - 1);
+					chunkOffset			= blocks[chunkFirstBlockId].offsetInSection;
+					long long chunkSize	= (long long) blocks[chunkLastBlockId].offsetInSection + blocks[chunkLastBlockId].compressedSize - chunkOffset;
+					if ((long long) compressedData.size() < chunkSize) compressedData.resize(std::max<long long>(chunkSize, 0));
+					if (chunkSize < 0 || chunkOffset + chunkSize > compressedSize || !readAt(hFile, hEvent, offsetInFile + chunkOffset, chunkSize, compressedData.data())) {
+						failed			= true;
+						allChunksDone	= true;
+					}
+					nextBlockId = chunkFirstBlockId;
+				}
+			}
+			chunkBarrier.arrive_and_wait();
+			if (allChunksDone) break;
 
-		// is block id valid?
-		if (blockId >= numBlocks) return false;
+			// decompress the blocks of the chunk
+			for (long long blockId = nextBlockId++; blockId <= chunkLastBlockId && !failed; blockId = nextBlockId++) {
+				if (!decompressBlock(footer, threadComp, context, &compressedData[blocks[blockId].offsetInSection - chunkOffset], blockId, (char*) pBytes, numBytes, position)) failed = true;
+			}
 
-		// read current block from compresed file
-		fs.read(&compressedData[0], blocks[blockId].compressedSize);
-		
-		// decompress data
-		if (!comp.decompress(&uncompressedData[0], &compressedData[0], blocks[blockId].compressedSize, nBytesDecompressed)) return false;
+			// the buffer is overwritten by the next chunk
+			chunkBarrier.arrive_and_wait();
+			if (threadNo == 0) chunkFirstBlockId = chunkLastBlockId + 1;
+		}
+	};
+	vector<thread> workers;
+	for (unsigned int threadNo = 1; threadNo < numThreads; threadNo++) {
+		workers.emplace_back(processChunks, threadNo);
+	}
+	processChunks(0);
+	for (auto& worker : workers) {
+		worker.join();
+	}
 
-		// copy data to passed pointer from caller
-		long long numBytesToCopy = std::min({(long long) nBytesDecompressed, numBytesResting, (long long) footer.blockSizeInBytes - offsetInsideBlock});
-		memcpy(pBlock, &uncompressedData[offsetInsideBlock], numBytesToCopy);
+	// release the additional threads
+	numDecodeThreads.fetch_sub(numThreads - 1, memory_order_relaxed);
+	return !failed;
+}
 
-		// goto next block
-		numBytesResting		-= numBytesToCopy;
-		numRestingCompBytes -= std::min((long long) blocks[blockId].compressedSize, numRestingCompBytes);
-		pBlock				+= numBytesToCopy;
-		offsetInsideBlock	 = 0;
-		blockId++;
+//-----------------------------------------------------------------------------
+// Name: sectionInfo::decompressBlock()
+// Desc: Decompresses one block and copies the part within the range [position, position + numBytes) to pBytes.
+//		 A block lying completely within the range is decompressed directly into pBytes.
+//-----------------------------------------------------------------------------
+bool compressor::file::sectionInfo::decompressBlock(footerStruct& footer, generalLib& comp, decompressionContext& context, const char* pCompressed, long long blockId, char* pBytes, long long numBytes, long long position)
+{
+	// locals
+	long long		blockStart			= blockId * getBlockSize(footer);								// position of the block in the section
+	long long		blockSize			= std::min<long long>(getBlockSize(footer), uncompressedSize - blockStart);
+	long long		copyStart			= std::max<long long>(position, blockStart);						// part of the block within the range
+	long long		copyEnd				= std::min<long long>(position + numBytes, blockStart + blockSize);
+	unsigned int	nBytesDecompressed	= 0;
+
+	// block completely inside the range
+	if (copyStart == blockStart && copyEnd == blockStart + blockSize) {
+		if (!comp.decompress(&pBytes[blockStart - position], (void*) pCompressed, blocks[blockId].compressedSize, nBytesDecompressed)) return false;
+		return nBytesDecompressed == blockSize;
 	}
 
+	// only a part of the block is needed
+	if (context.uncompressedData.size() < getBlockSize(footer)) {
+		context.uncompressedData.resize(getBlockSize(footer));
+	}
+	if (!comp.decompress(context.uncompressedData.data(), (void*) pCompressed, blocks[blockId].compressedSize, nBytesDecompressed)) return false;
+	if (nBytesDecompressed < copyEnd - blockStart) return false;
+	memcpy(&pBytes[copyStart - position], &context.uncompressedData[copyStart - blockStart], copyEnd - copyStart);
 	return true;
 }
 #pragma endregion
@@ -789,19 +1406,13 @@ bool compressor::file::sectionInfo::readData(std::fstream& fs, footerStruct& foo
 #pragma region tmpFile
 //-----------------------------------------------------------------------------
 // Name: tmpFile()
-// Desc: Constructor
+// Desc: Constructor. The temporary file is only created, when the section grows beyond maxSizeInMemory.
 //-----------------------------------------------------------------------------
-compressor::file::tmpFile::tmpFile(wstring const & keyName) : 
-	keyName{keyName}
+compressor::file::tmpFile::tmpFile(wstring const & keyName, wstring const & directory, long long maxSizeInMemory) : 
+	keyName{keyName},
+	maxSizeInMemory{maxSizeInMemory}
 {
-	filePath = (filesystem::temp_directory_path() / L"compressor" / (keyName + L".dat")).c_str();
-	std::filesystem::path filePathStr = filePath;
-	std::filesystem::create_directories(filePathStr.parent_path());
-	fsTmp.open(filePathStr, ios::in | ios::out | ios::binary | ios::trunc);
-	if (!fsTmp.good() || !fsTmp.is_open()) {
-		throw std::runtime_error("Could not create temporary file for section.");
-	}
-	fsTmp.close();
+	filePath = (filesystem::path(directory) / (keyName + L".dat")).wstring();
 }
 
 //-----------------------------------------------------------------------------
@@ -811,17 +1422,43 @@ compressor::file::tmpFile::tmpFile(wstring const & keyName) :
 compressor::file::tmpFile::~tmpFile()
 {
 	if (fsTmp.is_open()) fsTmp.close();
-	filesystem::remove(filePath);
+	if (!inMemory) filesystem::remove(filePath);
 }
 
 //-----------------------------------------------------------------------------
-// Name: doesExist()
-// Desc: Returns true if a temporary file exists for a section.
+// Name: getDefaultDirectory()
+// Desc: Returns the default directory of the temporary files.
 //-----------------------------------------------------------------------------
-bool compressor::file::tmpFile::doesExist(wstring const & keyName)
+std::wstring compressor::file::tmpFile::getDefaultDirectory()
 {
-	std::filesystem::path tmpFilePath = (std::filesystem::temp_directory_path() / L"compressor" / (keyName + L".dat")).c_str();
-	return std::filesystem::exists(tmpFilePath);
+	return (filesystem::temp_directory_path() / L"compressor").wstring();
+}
+
+//-----------------------------------------------------------------------------
+// Name: moveToFile()
+// Desc: Creates the temporary file and moves the data kept in memory so far into it.
+//-----------------------------------------------------------------------------
+bool compressor::file::tmpFile::moveToFile()
+{
+	std::filesystem::path filePathStr = filePath;
+	std::error_code errorCode;
+	std::filesystem::create_directories(filePathStr.parent_path(), errorCode);
+	fsTmp.open(filePathStr, ios::in | ios::out | ios::binary | ios::trunc);
+	if (!fsTmp.good() || !fsTmp.is_open()) {
+		return false;
+	}
+	if (memoryData.size()) {
+		fsTmp.write(memoryData.data(), memoryData.size());
+	}
+	bool success = fsTmp.good();
+	fsTmp.close();
+	if (!success) {
+		filesystem::remove(filePath);
+		return false;
+	}
+	inMemory = false;
+	vector<char>().swap(memoryData);
+	return true;
 }
 
 //-----------------------------------------------------------------------------
@@ -842,7 +1479,7 @@ bool compressor::file::tmpFile::openIfNotOpen()
 
 //-----------------------------------------------------------------------------
 // Name: read()
-// Desc: Reads data from the temporary file.
+// Desc: Reads data from the temporary file. Several threads may read at once, while write() is only called exclusively.
 //-----------------------------------------------------------------------------
 bool compressor::file::tmpFile::read(long long position, long long numBytes, void* pBytes)
 {
@@ -850,6 +1487,11 @@ bool compressor::file::tmpFile::read(long long position, long long numBytes, voi
 	if (position < 0) return false;
 	if (numBytes <= 0) return false;
 	if (position + numBytes > getSize()) return false;
+	if (inMemory) {
+		memcpy(pBytes, &memoryData[position], numBytes);
+		return true;
+	}
+	std::lock_guard<std::mutex> lock(fsTmpMutex);
 	if (!openIfNotOpen()) return false;
 	fsTmp.seekg(position, ios_base::beg);
 	fsTmp.read((char*) pBytes, numBytes);
@@ -859,13 +1501,21 @@ bool compressor::file::tmpFile::read(long long position, long long numBytes, voi
 
 //-----------------------------------------------------------------------------
 // Name: write()
-// Desc: Writes data to the temporary file.
+// Desc: Writes data to the temporary file. Gaps before the position are filled with zeros.
 //-----------------------------------------------------------------------------
 bool compressor::file::tmpFile::write(long long position, long long numBytes, const void* pBytes)
 {
 	if (!pBytes) return false;
 	if (position < 0) return false;
 	if (numBytes <= 0) return false;
+	if (inMemory && position + numBytes > maxSizeInMemory) {
+		if (!moveToFile()) return false;
+	}
+	if (inMemory) {
+		if ((long long) memoryData.size() < position + numBytes) memoryData.resize(position + numBytes, 0);
+		memcpy(&memoryData[position], pBytes, numBytes);
+		return true;
+	}
 	if (!openIfNotOpen()) return false;
 	fsTmp.seekp(position, ios_base::beg);
 	fsTmp.write((char*) pBytes, numBytes);
@@ -879,6 +1529,8 @@ bool compressor::file::tmpFile::write(long long position, long long numBytes, co
 //-----------------------------------------------------------------------------
 long long compressor::file::tmpFile::getSize()
 {
+	if (inMemory) return (long long) memoryData.size();
+	std::lock_guard<std::mutex> lock(fsTmpMutex);
 	if (!openIfNotOpen()) return -1;
 	fsTmp.seekg(0, ios_base::end);
 	long long size = fsTmp.tellg();
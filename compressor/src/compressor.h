@@ -25,36 +25,15 @@
 #include <algorithm>
 #include <map>
 #include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+
+#include "compLib_general.h"
 
 namespace compressor
 {
-	// base class for all compression libraries, providing a common interface
-	class generalLib
-	{
-	public:
-		enum class libId { undefined, uncompressed, winCompApi, bzip2 };					// list of all available compression libraries
-
-	protected:
-		// Variables
-		std::wostream						*osPrint;										// stream for output. default is cout
-		int									verbosity;										// output detail level. default is 2
-		std::wstring						name;											// name of the compression library
-		libId								id;												// id of the compression library
-
-											// Constructor / destructor
-											generalLib();
-											~generalLib();
-
-	public:
-		bool								print							(std::wstringstream &ss, int level);
-		bool								setVerbosity					(int newVerbosity) { verbosity = newVerbosity; return true; };
-		std::wstring const&					getName							() { return name; };
-		libId const&						getLibId						() { return id; };
-		virtual bool						compress						(void *compressedData, void *sourceData, unsigned int nBytesToCompress, unsigned int &nBytesCompressed) { return false; };
-		virtual bool						decompress						(void *destData, void *compressedData, unsigned int nBytesCompressed, unsigned int &nBytesDecompressed) { return false; };
-		virtual long long					estimateMaxSizeOfCompressedData	(long long amountUncompressedData) { return 0; };
-	};
-
 	// class for uncompressed data
 	class uncompressed : public generalLib
 	{
@@ -63,6 +42,7 @@ namespace compressor
 		bool								compress						(void *compressedData, void *sourceData, unsigned int nBytesToCompress, unsigned int &nBytesCompressed);
 		bool								decompress						(void *destData, void *compressedData, unsigned int nBytesCompressed, unsigned int &nBytesDecompressed);
 		long long							estimateMaxSizeOfCompressedData	(long long amountUncompressedData);
+		std::unique_ptr<generalLib>			clone							() const override { return std::make_unique<uncompressed>(); };
 	};
 
 	// Class providing read/write functions for a compressed file.
@@ -71,6 +51,8 @@ namespace compressor
 	// The access to the file is done in named sections, addressed by a string key.
 	// The actual file is written in the destructor during the flush() function. 
 	// Before, the sections are written to temporary files.
+	// read() is thread-safe without locks, as long as no other thread writes, flushes, opens or closes the file.
+	// A section can be streamed by beginSection(), append() and endSection() while other threads read the sections already in the file.
 	class file
 	{
 	public:
@@ -84,7 +66,17 @@ namespace compressor
 		bool								read							(std::wstring const& key, long long position, long long numBytes,       void* pBytes);
 		bool								write							(std::wstring const& key, long long position, long long numBytes, const void* pBytes);
 		bool								flush							();
+		bool								beginSection					(std::wstring const& key);
+		bool								append							(long long numBytes, const void* pBytes);
+		bool								endSection						();
 		bool								setBlockSize					(unsigned int newSizeInBytes);
+		bool								addLib							(generalLib& lib);
+		bool								setSectionLib					(std::wstring const& keyPrefix, generalLib& lib);
+		bool								setBlockSizeCandidates			(std::vector<unsigned int> const& candidates, double allowedSizeIncrease);
+		bool								setTmpDirectory					(std::wstring const& directory);
+		bool								setMaxStagingSizeInMemory		(long long maxSizeInBytes);
+		bool								setMaxTotalStagingSizeInMemory	(long long maxSizeInBytes);
+		unsigned int						getBlockSizeOfSection			(std::wstring const& key);
 		long long							getSizeOfUncompressedSection	(std::wstring const& key);
 		long long							getSizeOfCompressedSection		(std::wstring const& key);
 		std::vector<std::wstring>			getKeys							();
@@ -110,7 +102,9 @@ namespace compressor
 		// 											8						uncompressedSize
 		// 											8						compressedSize
 		// 											4						numBlocks
-		// 											8						sectionId
+		// 											4						usedLib (0: usedLib of the footer)
+		// 											4						sectionId
+		// 											4						blockSizeInBytes (0: blockSizeInBytes of the footer)
 		// 											8						keyLengthInBytes
 		// 											keyLengthInBytes			keyName[keyLengthInBytes]
 		// 											0					sections[1]
@@ -127,6 +121,14 @@ namespace compressor
 		class footerStruct;
 		class tmpFile;
 
+		// buffers and library instance of a thread, reused for each decompressed block
+		struct decompressionContext
+		{
+			std::unique_ptr<generalLib>		comp;																// clone of the compression library, nullptr to use the library of the file
+			std::vector<char>				compressedData;														// compressed blocks read from the file
+			std::vector<char>				uncompressedData;													// blocks, which are only partially copied to the caller
+		};
+
 		// section of the file, containing the data
 		struct sectionInfo	
 		{	
@@ -144,16 +146,30 @@ namespace compressor
 			unsigned int					numBlocks						= 0;								// number of blocks in the section
 			unsigned int					sectionId						= 0;								// index of the section in the file
 			unsigned int					keyLengthInBytes				= 0;								// length of the key in bytes
+			generalLib::libId				usedLib							= generalLib::libId::undefined;		// id of the library used for this section, undefined means the library of the footer
+			unsigned int					blockSizeInBytes				= 0;								// size of the blocks of this section, 0 means the block size of the footer
+
+			// constants
+			static const long long			minSizeForMultiThreading		= 1000000;							// smaller sections are compressed by a single thread
+			static const unsigned int		numBlocksInFlightPerThread		= 4;								// limits the memory used by the reorder buffer during compression
+			static const unsigned int		minBlocksForMultiThreading		= 16;								// reads of less blocks are decompressed by a single thread
+			static const unsigned int		numBlocksPerThreadAndChunk		= 16;								// limits the memory for compressed data while reading a large range
+			static inline std::atomic<unsigned int>	numDecodeThreads		= 0;								// additional threads decompressing blocks at the moment, of all files together
 
 			// abstract data (cannot be written directly to file)
 			std::wstring					keyName;															// key of the section, by which the section is addressed in the file
 			std::vector<blockInfo>			blocks;																// data
 
 			// functions
+			unsigned int					getBlockSize					(footerStruct const& footer) const;
 			bool							write							(std::fstream& fs, footerStruct& footer);
 			bool							read							(std::fstream& fs, footerStruct& footer);
 			bool							writeData						(std::fstream& fs, footerStruct& footer, generalLib& comp, tmpFile& tmpFile, bool forceSingleThreading = false);
-			bool							readData						(std::fstream& fs, footerStruct& footer, generalLib& comp, void* pBytes, long long numBytes, long long position);
+			bool							readData						(HANDLE hFile, HANDLE hEvent, footerStruct& footer, generalLib& comp, void* pBytes, long long numBytes, long long position, std::vector<decompressionContext>* contexts = nullptr);
+			bool							readBlockInfos					(std::fstream& fs);
+
+		private:
+			bool							decompressBlock					(footerStruct& footer, generalLib& comp, decompressionContext& context, const char* pCompressed, long long blockId, char* pBytes, long long numBytes, long long position);
 		};
 
 		// footer of the file, containing infos about the sections
@@ -183,38 +199,92 @@ namespace compressor
 
 		// uncompressed temporary file for writing the sections, used before it is written to the actual compressed file
 		// this allows fast reading and writing of the sections, even if the file is very large
+		// small sections are kept in memory, and only written to the disk when they grow beyond maxSizeInMemory, or when all sections in memory exceed the budget of the file
 		class tmpFile
 		{
 		public:
-											tmpFile							(std::wstring const& keyName);
+											tmpFile							(std::wstring const& keyName, std::wstring const& directory = getDefaultDirectory(), long long maxSizeInMemory = 0);
 											~tmpFile						();
 
 			std::wstring const&				getKeyName						() { return keyName; };
 			std::wstring const&				getFilePath						() { return filePath; };
+			bool							isInMemory						() { return inMemory; };
 			long long 						getSize							();
 			bool							write							(long long position, long long numBytes, const void* pBytes);
 			bool							read							(long long position, long long numBytes, void* pBytes);
+			bool							moveToFile						();
 
-			static bool  					doesExist						(std::wstring const& keyName);
+			static std::wstring				getDefaultDirectory				();
 
 		private:
 			std::wstring					keyName;															// key of the section	
 			std::wstring					filePath;															// path to the temporary file
 			std::fstream					fsTmp;																// file stream for reading/writing the temporary file
+			std::mutex						fsTmpMutex;															// concurrent readers of the section share fsTmp
+			std::vector<char>				memoryData;															// data of the section, as long as it is kept in memory
+			long long						maxSizeInMemory					= 0;								// larger sections are moved to the temporary file
+			bool							inMemory						= true;								// true until the data was moved to the temporary file
 
 			bool 							openIfNotOpen					();
 		};
 
 	private:
+		// buffers and library instances of one reading thread
+		struct readerContext
+		{
+			std::atomic<bool>				inUse							= false;							// true while a thread reads with this context
+			HANDLE							hEvent							= NULL;								// completion event of the positional reads
+			std::map<generalLib::libId, std::vector<decompressionContext>>	contexts;							// [libId][threadNo] buffers and library clones for reading compressed sections
+
+											readerContext					() { hEvent = CreateEvent(NULL, TRUE, FALSE, NULL); };
+											~readerContext					() { if (hEvent != NULL) CloseHandle(hEvent); };
+		};
+
+		// section, which is written by beginSection(), append() and endSection()
+		struct sectionStream
+		{
+			sectionInfo						section;															// section info, completed by endSection()
+			generalLib*						comp							= nullptr;							// library used for the section
+			std::vector<char>				uncompressedData;													// appended data, which is not compressed yet
+			std::vector<char>				compressedData;														// buffer for one compressed block
+			size_t							numBytesInBuffer				= 0;								// number of used bytes in 'uncompressedData'
+			bool							isBlockSizeChosen				= false;							// false until the first bytes were sampled
+			bool							isOpen							= false;							// true between beginSection() and endSection()
+		};
+
 		static const size_t 				maxKeyLength 					= 240;								// each section in the file is identified by a string key. this is the maximum length of the key.
+		static const unsigned int			numBlockSizeSamples				= 4;								// number of samples taken from a section to choose its block size
+		static const long long				defaultMaxStagingSizeInMemory	= 67108864;							// sections up to this size are staged in memory instead of a temporary file
+		static const long long				defaultMaxTotalStagingSizeInMemory = 268435456;						// all sections staged in memory together do not exceed this size
 
 		footerStruct						footer;																// footer of the file, containing infos about the sections
 		std::fstream						fs;																	// file stream for readiong/writing the actual file on the disk
 		generalLib*							comp							= nullptr;							// pointer to the compression library
 		bool								readOnlyMode					= false;							// if true, no writing is allowed
 		std::vector<tmpFile*>				tmpFiles;															// temporary files for writing the sections
+		std::wstring						tmpDirectory					= tmpFile::getDefaultDirectory();	// directory of the temporary files
+		long long							maxStagingSizeInMemory			= defaultMaxStagingSizeInMemory;	// larger sections are staged in temporary files
+		long long							maxTotalStagingSizeInMemory		= defaultMaxTotalStagingSizeInMemory;	// beyond this size the largest sections staged in memory are moved to temporary files
+		sectionStream						stream;																// section being streamed
+		std::map<generalLib::libId, generalLib*>							libs;								// libraries available for reading sections, including 'comp'
+		std::vector<std::pair<std::wstring, generalLib*>>					sectionLibs;						// [key prefix] library used for writing sections with a matching key
+		HANDLE								hReadFile						= INVALID_HANDLE_VALUE;				// handle of the file for positional reads, which are independent of the file pointer of 'fs'
+		std::vector<std::unique_ptr<readerContext>>	readers;													// [readerNo] contexts of concurrently reading threads, created by open()
+		std::mutex							nonCloneableLibMutex;												// serializes the reads of sections, whose library cannot be cloned
+		std::shared_mutex					footerMutex;														// shared by readers, exclusive while the footer or the staged sections change
+		std::vector<unsigned int>			blockSizeCandidates;												// ascending block sizes, from which the block size of each section is chosen. empty to use the block size of the footer.
+		double								allowedSizeIncrease				= 0;								// the smallest candidate is chosen, whose compressed size exceeds the best one by at most this fraction
 
 		tmpFile&							getTmpFile						(std::wstring const& key);				
+		tmpFile*							findTmpFile						(std::wstring const& key);
+		bool								limitStagingInMemory			();
+		generalLib&							getLibForKey					(std::wstring const& key);
+		unsigned int						chooseBlockSize					(generalLib& sectionComp, tmpFile& curTmpFile, long long numBytes);
+		unsigned int						chooseBlockSize					(generalLib& sectionComp, char* pSamples, unsigned int numSamples, long long sampleSize);
+		void								addSectionToFooter				(sectionInfo& curSection);
+		readerContext*						acquireReader					();
+		static bool							readAt							(HANDLE hFile, HANDLE hEvent, long long offset, long long numBytes, void* pBytes);
+		bool								compressStreamBuffer			(bool isLastCall);
 		bool 								readFromCompressed				(std::wstring const& key, long long position, long long numBytes, void* pBytes);
 	};
 
@@ -230,5 +300,7 @@ namespace compressor
 // #include "compLib_snappy.h"
 // #include "compLib_ucl.h"
 #include "compLib_winCompApi.h"
+#include "compLib_skvRans.h"
+#include "compLib_plyInfoDelta.h"
 
 #endif // COMPRESSOR_H
@@ -9,8 +9,15 @@
 #include "gtest/gtest.h"
 #include <vector>
 #include <string>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <atomic>
 
 #include "compLib_winCompApi.h"
+#include "compLib_skvRans.h"
+#include "compLib_plyInfoDelta.h"
 
 class CompressorTest : public ::testing::Test {
 public:
@@ -302,4 +309,726 @@ TEST(sectionInfoTests, WriteData)
 	fsMultiThread .close();
 	remove(std::filesystem::temp_directory_path() / "singleThread.dat");
 	remove(std::filesystem::temp_directory_path() / "multiThread.dat");
-}
\ No newline at end of file
+}
+
+// Compresses sections of various sizes with and without multi-threading and compares the written files byte by byte
+TEST(sectionInfoTests, ParallelWriteDataStress)
+{
+	compressor::winCompApi	 			comp;
+	const std::filesystem::path			pathSingleThread	= std::filesystem::temp_directory_path() / "singleThread.dat";
+	const std::filesystem::path			pathMultiThread		= std::filesystem::temp_directory_path() / "multiThread.dat";
+	const std::vector<size_t>			dataSizes			= { 1000000, 1000001, 2345678, 4000000 };
+	const std::vector<unsigned int>		blockSizes			= { 1000, 4096, 100000 };
+
+	srand(0);
+	for (size_t dataSize : dataSizes) {
+		for (unsigned int blockSize : blockSizes) {
+
+			// data with runs of equal bytes, so that the compressed blocks differ in size
+			std::vector<char> data(dataSize, 0);
+			for (size_t i = 0; i < dataSize; ) {
+				size_t runLength = 1 + rand() % 20;
+				char   value     = (char) (rand() % 4);
+				for (size_t j = 0; j < runLength && i < dataSize; j++, i++) data[i] = value;
+			}
+			compressor::file::tmpFile tmpFile(L"dummyKeyName");
+			ASSERT_TRUE(tmpFile.write(0, data.size(), data.data()));
+
+			// setup section and footer
+			compressor::file::footerStruct footer;
+			footer.blockSizeInBytes = blockSize;
+			compressor::file::sectionInfo sectionSingleThread;
+			sectionSingleThread.uncompressedSize	= data.size();
+			sectionSingleThread.numBlocks			= (unsigned int) (data.size() / blockSize + 1);
+			sectionSingleThread.blocks.resize(sectionSingleThread.numBlocks);
+			compressor::file::sectionInfo sectionMultiThread = sectionSingleThread;
+
+			// write both
+			std::fstream fsSingleThread(pathSingleThread, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+			std::fstream fsMultiThread (pathMultiThread,  std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+			ASSERT_TRUE(sectionSingleThread.writeData(fsSingleThread, footer, comp, tmpFile, true));
+			ASSERT_TRUE(sectionMultiThread .writeData(fsMultiThread,  footer, comp, tmpFile, false));
+			ASSERT_EQ(sectionSingleThread.compressedSize, sectionMultiThread.compressedSize);
+
+			// compare files
+			fsSingleThread.seekg(0, std::ios::beg);
+			fsMultiThread .seekg(0, std::ios::beg);
+			std::vector<char> dataSingleThread((std::istreambuf_iterator<char>(fsSingleThread)), std::istreambuf_iterator<char>());
+			std::vector<char> dataMultiThread ((std::istreambuf_iterator<char>(fsMultiThread)),  std::istreambuf_iterator<char>());
+			ASSERT_EQ(dataSingleThread, dataMultiThread) << "dataSize: " << dataSize << ", blockSize: " << blockSize;
+		}
+	}
+	std::filesystem::remove(pathSingleThread);
+	std::filesystem::remove(pathMultiThread);
+}
+
+// Reads ranges touching many blocks, which are decompressed by several threads, and compares them with the written data
+TEST_F(CompressorTest, ParallelRangeRead)
+{
+	compressor::file& 			file 			= *pFile;
+	const long long				dataSize		= 3000000;
+	std::vector<char>			expData			(dataSize, 0);
+	std::vector<char>			actData			(dataSize, 0);
+
+	// data with runs of equal bytes
+	srand(0);
+	for (long long i = 0; i < dataSize; ) {
+		long long runLength = 1 + rand() % 20;
+		char	  value		= (char) (rand() % 4);
+		for (long long j = 0; j < runLength && i < dataSize; j++, i++) expData[i] = value;
+	}
+
+	// write and reopen the file
+	ASSERT_TRUE(file.setBlockSize(1000));
+	ASSERT_TRUE(file.open(fileName, false));
+	ASSERT_TRUE(file.write(L"data", 0, dataSize, expData.data()));
+	ASSERT_TRUE(file.close());
+	ASSERT_TRUE(file.open(fileName, true));
+
+	// whole section
+	ASSERT_TRUE(file.read(L"data", 0, dataSize, actData.data()));
+	ASSERT_EQ(expData, actData);
+
+	// ranges starting and ending inside of blocks, and exactly at block borders
+	for (int i = 0; i < 200; i++) {
+		long long position	= (i % 3 == 0) ? (rand() % 3000) * 1000 : ((long long) rand() * rand()) % dataSize;
+		long long numBytes	= 1 + ((long long) rand() * rand()) % (dataSize - position);
+		if (i % 5 == 0) numBytes = std::min<long long>(dataSize - position, 1000 * (1 + rand() % 100));
+		std::fill(actData.begin(), actData.begin() + numBytes, 0);
+		ASSERT_TRUE(file.read(L"data", position, numBytes, actData.data()));
+		ASSERT_TRUE(std::equal(actData.begin(), actData.begin() + numBytes, expData.begin() + position)) << "position: " << position << ", numBytes: " << numBytes;
+	}
+
+	// ranges beyond the end of the section fail
+	ASSERT_FALSE(file.read(L"data", dataSize - 10, 11, actData.data()));
+	ASSERT_TRUE(file.close());
+}
+
+// creates short knot values with runs of equal values and a skewed distribution, four values per byte
+static std::vector<unsigned char> createSkvData(size_t numBytes, unsigned int maxRunLength)
+{
+	std::vector<unsigned char>	data(numBytes, 0);
+	const unsigned int			valueByRandom[] = { 1, 1, 1, 1, 1, 3, 3, 2, 0, 2 };		// lost is most frequent, invalid is rare
+	unsigned int				value			= 0;
+	unsigned int				runLength		= 0;
+	for (size_t symbolNo = 0; symbolNo < 4 * numBytes; symbolNo++) {
+		if (runLength == 0) {
+			value		= valueByRandom[rand() % 10];
+			runLength	= 1 + rand() % maxRunLength;
+		}
+		data[symbolNo / 4] |= value << (2 * (symbolNo % 4));
+		runLength--;
+	}
+	return data;
+}
+
+TEST(skvRansTests, RoundTrip)
+{
+	compressor::skvRans			comp;
+	const unsigned int			blockSize		= 10000;
+	std::vector<unsigned char>	compressed		(comp.estimateMaxSizeOfCompressedData(blockSize));
+	std::vector<unsigned char>	decompressed	(blockSize);
+	unsigned int				nBytesCompressed;
+	unsigned int				nBytesDecompressed;
+
+	srand(0);
+	for (unsigned int numBytes : { 1u, 2u, 3u, 17u, 1000u, 9999u, 10000u }) {
+		for (unsigned int maxRunLength : { 1u, 3u, 50u, 1000u, 100000u }) {
+			std::vector<unsigned char> data = createSkvData(numBytes, maxRunLength);
+			ASSERT_TRUE(comp.compress  (compressed.data(),   data.data(),       numBytes,         nBytesCompressed));
+			ASSERT_LE  (nBytesCompressed, numBytes + 1);
+			ASSERT_TRUE(comp.decompress(decompressed.data(), compressed.data(), nBytesCompressed, nBytesDecompressed));
+			ASSERT_EQ  (nBytesDecompressed, numBytes);
+			ASSERT_TRUE(std::equal(data.begin(), data.end(), decompressed.begin())) << "numBytes: " << numBytes << ", maxRunLength: " << maxRunLength;
+		}
+	}
+
+	// uniformly distributed bytes are stored uncompressed
+	std::vector<unsigned char> randomData(blockSize);
+	std::generate(randomData.begin(), randomData.end(), []() { return static_cast<unsigned char>(rand() % 256); });
+	ASSERT_TRUE(comp.compress  (compressed.data(),   randomData.data(), blockSize,        nBytesCompressed));
+	ASSERT_EQ  (nBytesCompressed, blockSize + 1);
+	ASSERT_TRUE(comp.decompress(decompressed.data(), compressed.data(), nBytesCompressed, nBytesDecompressed));
+	ASSERT_EQ  (randomData, decompressed);
+
+	// a long run of a single value is compressed to a few bytes
+	std::vector<unsigned char> constantData(blockSize, 0x55);
+	ASSERT_TRUE(comp.compress  (compressed.data(),   constantData.data(), blockSize,        nBytesCompressed));
+	ASSERT_LT  (nBytesCompressed, 20);
+	ASSERT_TRUE(comp.decompress(decompressed.data(), compressed.data(),   nBytesCompressed, nBytesDecompressed));
+	ASSERT_EQ  (constantData, decompressed);
+}
+
+TEST(skvRansTests, CorruptedData)
+{
+	compressor::skvRans			comp;
+	const unsigned int			blockSize		= 1000;
+	std::vector<unsigned char>	compressed		(comp.estimateMaxSizeOfCompressedData(blockSize));
+	std::vector<unsigned char>	decompressed	(blockSize);
+	unsigned int				nBytesCompressed;
+	unsigned int				nBytesDecompressed;
+
+	srand(0);
+	std::vector<unsigned char> data = createSkvData(blockSize, 50);
+	ASSERT_TRUE (comp.compress(compressed.data(), data.data(), blockSize, nBytesCompressed));
+	ASSERT_FALSE(comp.decompress(decompressed.data(), compressed.data(), 0, nBytesDecompressed));							// nothing to decompress
+	ASSERT_FALSE(comp.decompress(decompressed.data(), compressed.data(), 5, nBytesDecompressed));							// truncated header
+	compressed[0] = 7;
+	ASSERT_FALSE(comp.decompress(decompressed.data(), compressed.data(), nBytesCompressed, nBytesDecompressed));			// unknown method
+	compressed[0] = 1;
+	compressed[1] = 0xff;	compressed[2] = 0xff;
+	ASSERT_FALSE(comp.decompress(decompressed.data(), compressed.data(), nBytesCompressed, nBytesDecompressed));			// more tokens than fit into the destination
+	comp.estimateMaxSizeOfCompressedData(10);
+	ASSERT_TRUE (comp.compress(compressed.data(), data.data(), 100, nBytesCompressed));
+	ASSERT_FALSE(comp.decompress(decompressed.data(), compressed.data(), nBytesCompressed, nBytesDecompressed));			// destination too small
+}
+
+TEST(skvRansTests, CompressedFile)
+{
+	compressor::skvRans			comp;
+	compressor::file			file{comp};
+	const std::wstring 			fileName 	= (std::filesystem::temp_directory_path() / "temp_test_file_skvRans.dat").c_str();
+	const size_t				numBytes	= 123456;
+	unsigned char				singleByte	= 0;
+
+	srand(0);
+	std::vector<unsigned char> data = createSkvData(numBytes, 200);
+	std::vector<unsigned char> readData(numBytes);
+	std::filesystem::remove(fileName);
+	ASSERT_TRUE(file.setBlockSize(10000));
+	ASSERT_TRUE(file.open(fileName, false));
+	ASSERT_TRUE(file.write(L"skv", 0, numBytes, data.data()));
+	ASSERT_TRUE(file.close());
+	ASSERT_TRUE(file.open(fileName, true));
+	ASSERT_LT  (file.getSizeOfCompressedSection(L"skv"), (long long) numBytes / 2);
+	ASSERT_TRUE(file.read(L"skv", 0, numBytes, readData.data()));
+	ASSERT_EQ  (data, readData);
+	for (size_t position : { (size_t) 0, (size_t) 9999, (size_t) 10000, numBytes - 1 }) {							// single state reads
+		ASSERT_TRUE(file.read(L"skv", position, 1, &singleByte));
+		ASSERT_EQ  (singleByte, data[position]);
+	}
+	ASSERT_TRUE(file.close());
+	std::filesystem::remove(fileName);
+}
+
+// Compares compression ratio and speed with winCompApi. Layer dumps are emulated by data with runs of various lengths.
+// Disabled, so that it does not slow down the regular test run. Run it with --gtest_also_run_disabled_tests.
+TEST(skvRansTests, DISABLED_CompareWithWinCompApi)
+{
+	compressor::skvRans			skvRans;
+	compressor::winCompApi		winCompApi;
+	const unsigned int			blockSize		= 10000;
+	const size_t				numBytes		= 10000000;
+	std::vector<unsigned char>	compressed		(blockSize + 2000);
+	std::vector<unsigned char>	decompressed	(blockSize + 2000);
+
+	for (unsigned int maxRunLength : { 4u, 40u, 400u }) {
+		srand(0);
+		std::vector<unsigned char> data = createSkvData(numBytes, maxRunLength);
+		for (compressor::generalLib* comp : std::vector<compressor::generalLib*>{ &skvRans, &winCompApi }) {
+			size_t		totalCompressed		= 0;
+			double		compressSeconds		= 0;
+			double		decompressSeconds	= 0;
+			comp->estimateMaxSizeOfCompressedData(blockSize);
+			for (size_t offset = 0; offset < numBytes; offset += blockSize) {
+				unsigned int nBytesCompressed, nBytesDecompressed;
+				auto start = std::chrono::steady_clock::now();
+				ASSERT_TRUE(comp->compress(compressed.data(), &data[offset], blockSize, nBytesCompressed));
+				auto middle = std::chrono::steady_clock::now();
+				ASSERT_TRUE(comp->decompress(decompressed.data(), compressed.data(), nBytesCompressed, nBytesDecompressed));
+				auto end = std::chrono::steady_clock::now();
+				ASSERT_EQ(nBytesDecompressed, blockSize);
+				ASSERT_TRUE(std::equal(decompressed.begin(), decompressed.begin() + blockSize, data.begin() + offset));
+				totalCompressed		+= nBytesCompressed;
+				compressSeconds		+= std::chrono::duration<double>(middle - start).count();
+				decompressSeconds	+= std::chrono::duration<double>(end - middle).count();
+			}
+			std::wcout << comp->getName() << L", max run length " << maxRunLength << L": ratio " << (double) numBytes / totalCompressed
+				<< L", compress " << numBytes / compressSeconds / 1e6 << L" MB/s, decompress " << numBytes / decompressSeconds / 1e6 << L" MB/s" << std::endl;
+		}
+	}
+}
+
+// creates ply infos of neighbouring states, which differ only slightly. some states are drawn, invalid or uncalculated.
+static std::vector<unsigned short> createPlyInfoData(size_t numValues, unsigned int percentSpecial)
+{
+	std::vector<unsigned short>	data(numValues);
+	unsigned short				plyInfo		= 100;
+	for (auto& value : data) {
+		if ((unsigned int) (rand() % 100) < percentSpecial) {
+			value		= 65001 + rand() % 3;
+		} else {
+			plyInfo		= (unsigned short) std::min<int>(std::max<int>(0, plyInfo + rand() % 7 - 3), 65000);
+			value		= plyInfo;
+		}
+	}
+	return data;
+}
+
+TEST(plyInfoDeltaTests, RoundTrip)
+{
+	compressor::plyInfoDelta	comp{{65001, 65002, 65003}};
+	const unsigned int			blockSize		= 10001;
+	std::vector<unsigned char>	compressed		(comp.estimateMaxSizeOfCompressedData(blockSize));
+	std::vector<unsigned char>	decompressed	(blockSize);
+	unsigned int				nBytesCompressed;
+	unsigned int				nBytesDecompressed;
+
+	srand(0);
+	for (unsigned int numBytes : { 1u, 2u, 3u, 16u, 17u, 257u, 1000u, 10000u, 10001u }) {
+		for (unsigned int percentSpecial : { 0u, 5u, 50u, 100u }) {
+			std::vector<unsigned short> values = createPlyInfoData(numBytes / 2 + 1, percentSpecial);
+			const unsigned char* pData = (const unsigned char*) values.data();
+			ASSERT_TRUE(comp.compress  (compressed.data(),   (void*) pData,     numBytes,         nBytesCompressed));
+			ASSERT_LE  (nBytesCompressed, numBytes + 1);
+			ASSERT_TRUE(comp.decompress(decompressed.data(), compressed.data(), nBytesCompressed, nBytesDecompressed));
+			ASSERT_EQ  (nBytesDecompressed, numBytes);
+			ASSERT_TRUE(std::equal(pData, pData + numBytes, decompressed.begin())) << "numBytes: " << numBytes << ", percentSpecial: " << percentSpecial;
+			if (numBytes >= 1000) ASSERT_LT(nBytesCompressed, numBytes / 3);
+		}
+	}
+
+	// large jumps between the values wrap around and are still decoded correctly
+	std::vector<unsigned short> jumps(blockSize / 2);
+	for (size_t valueNo = 0; valueNo < jumps.size(); valueNo++) jumps[valueNo] = (valueNo % 2) ? 0xfffe : 1;
+	ASSERT_TRUE(comp.compress  (compressed.data(),   jumps.data(),      blockSize - 1,    nBytesCompressed));
+	ASSERT_TRUE(comp.decompress(decompressed.data(), compressed.data(), nBytesCompressed, nBytesDecompressed));
+	ASSERT_EQ  (nBytesDecompressed, blockSize - 1);
+	ASSERT_EQ  (memcmp(jumps.data(), decompressed.data(), blockSize - 1), 0);
+
+	// uniformly distributed bytes are stored uncompressed
+	std::vector<unsigned char> randomData(blockSize);
+	std::generate(randomData.begin(), randomData.end(), []() { return static_cast<unsigned char>(rand() % 256); });
+	ASSERT_TRUE(comp.compress  (compressed.data(),   randomData.data(), blockSize,        nBytesCompressed));
+	ASSERT_EQ  (nBytesCompressed, blockSize + 1);
+	ASSERT_TRUE(comp.decompress(decompressed.data(), compressed.data(), nBytesCompressed, nBytesDecompressed));
+	ASSERT_EQ  (randomData, decompressed);
+}
+
+TEST(plyInfoDeltaTests, CorruptedData)
+{
+	compressor::plyInfoDelta	comp{{65001, 65002, 65003}};
+	const unsigned int			blockSize		= 1000;
+	std::vector<unsigned char>	compressed		(comp.estimateMaxSizeOfCompressedData(blockSize));
+	std::vector<unsigned char>	decompressed	(blockSize);
+	unsigned int				nBytesCompressed;
+	unsigned int				nBytesDecompressed;
+
+	srand(0);
+	std::vector<unsigned short> values = createPlyInfoData(blockSize / 2, 10);
+	ASSERT_TRUE (comp.compress(compressed.data(), values.data(), blockSize, nBytesCompressed));
+	ASSERT_FALSE(comp.decompress(decompressed.data(), compressed.data(), 0, nBytesDecompressed));							// nothing to decompress
+	ASSERT_FALSE(comp.decompress(decompressed.data(), compressed.data(), 5, nBytesDecompressed));							// truncated header
+	ASSERT_FALSE(comp.decompress(decompressed.data(), compressed.data(), nBytesCompressed - 1, nBytesDecompressed));		// truncated residuals
+	compressed[0] = 7;
+	ASSERT_FALSE(comp.decompress(decompressed.data(), compressed.data(), nBytesCompressed, nBytesDecompressed));			// unknown method
+	compressed[0] = 1;
+	compressed[5] = 4;
+	ASSERT_FALSE(comp.decompress(decompressed.data(), compressed.data(), nBytesCompressed, nBytesDecompressed));			// too many special values
+	compressed[5] = 3;
+	compressed[1] = 0xff;	compressed[2] = 0xff;
+	ASSERT_FALSE(comp.decompress(decompressed.data(), compressed.data(), nBytesCompressed, nBytesDecompressed));			// more values than fit into the destination
+	comp.estimateMaxSizeOfCompressedData(10);
+	ASSERT_TRUE (comp.compress(compressed.data(), values.data(), 100, nBytesCompressed));
+	ASSERT_FALSE(comp.decompress(decompressed.data(), compressed.data(), nBytesCompressed, nBytesDecompressed));			// destination too small
+}
+
+// The sections of a file can use different libraries, like the skv and ply info sections of the miniMax database.
+TEST(plyInfoDeltaTests, SectionLibs)
+{
+	compressor::winCompApi		comp;
+	compressor::skvRans			skvComp;
+	compressor::plyInfoDelta	plyInfoComp{{65001, 65002, 65003}};
+	const std::wstring 			fileName 	= (std::filesystem::temp_directory_path() / "temp_test_file_sectionLibs.dat").c_str();
+	const size_t				numBytes	= 54321;
+
+	srand(0);
+	std::vector<unsigned char>	skvData			= createSkvData(numBytes, 200);
+	std::vector<unsigned short>	plyInfoData		= createPlyInfoData(numBytes / 2, 10);
+	std::vector<unsigned char>	otherData		(numBytes, 42);
+	std::vector<unsigned char>	readData		(numBytes);
+	std::filesystem::remove(fileName);
+	{
+		compressor::file file{comp};
+		ASSERT_TRUE(file.setBlockSize(10000));
+		ASSERT_TRUE(file.setSectionLib(L"skv",		skvComp));
+		ASSERT_TRUE(file.setSectionLib(L"plyInfo",	plyInfoComp));
+		ASSERT_TRUE(file.open(fileName, false));
+		ASSERT_TRUE(file.write(L"skv0",		0, numBytes,		skvData.data()));
+		ASSERT_TRUE(file.write(L"plyInfo0",	0, numBytes / 2 * 2,	plyInfoData.data()));
+		ASSERT_TRUE(file.write(L"other",	0, numBytes,		otherData.data()));
+		ASSERT_TRUE(file.close());
+	}
+
+	// all libraries are known
+	{
+		compressor::file file{comp};
+		ASSERT_TRUE(file.addLib(skvComp));
+		ASSERT_TRUE(file.addLib(plyInfoComp));
+		ASSERT_TRUE(file.open(fileName, true));
+		ASSERT_LT  (file.getSizeOfCompressedSection(L"plyInfo0"), (long long) numBytes / 3);
+		ASSERT_TRUE(file.read(L"skv0",		0, numBytes,		readData.data()));
+		ASSERT_EQ  (skvData, readData);
+		ASSERT_TRUE(file.read(L"plyInfo0",	0, numBytes / 2 * 2,	readData.data()));
+		ASSERT_EQ  (memcmp(plyInfoData.data(), readData.data(), numBytes / 2 * 2), 0);
+		ASSERT_TRUE(file.read(L"other",		0, numBytes,		readData.data()));
+		ASSERT_EQ  (otherData, readData);
+		ASSERT_TRUE(file.close());
+	}
+
+	// sections of unknown libraries cannot be read
+	{
+		compressor::file file{comp};
+		ASSERT_TRUE (file.open(fileName, true));
+		ASSERT_FALSE(file.read(L"plyInfo0",	0, 2,				readData.data()));
+		ASSERT_TRUE (file.read(L"other",	0, numBytes,		readData.data()));
+		ASSERT_EQ   (otherData, readData);
+		ASSERT_TRUE (file.close());
+	}
+	std::filesystem::remove(fileName);
+}
+
+// The block size of each section is chosen from the candidates, depending on the allowed increase of the compressed size.
+TEST_F(CompressorTest, AdaptiveBlockSize)
+{
+	compressor::uncompressed	comp;
+	compressor::skvRans			skvComp;
+	const size_t				numBytes	= 300000;
+
+	srand(0);
+	std::vector<unsigned char>	skvData		= createSkvData(numBytes, 200);
+	readData.resize(numBytes);
+	{
+		compressor::file file{comp};
+		ASSERT_TRUE (file.setBlockSize(1000));
+		ASSERT_TRUE (file.setSectionLib(L"skv", skvComp));
+		ASSERT_FALSE(file.setBlockSizeCandidates({1000, 0}, 0));
+		ASSERT_FALSE(file.setBlockSizeCandidates({1000}, -1));
+		ASSERT_TRUE (file.open(fileName, false));
+		ASSERT_TRUE (file.write(L"fixed",	0, numBytes, skvData.data()));
+		ASSERT_TRUE (file.flush());
+		ASSERT_TRUE (file.setBlockSizeCandidates({40000, 500, 4000}, 0));				// the largest blocks have the fewest block infos
+		ASSERT_TRUE (file.write(L"large",	0, numBytes, skvData.data()));
+		ASSERT_TRUE (file.write(L"tiny",	0, 100,      skvData.data()));
+		ASSERT_TRUE (file.flush());
+		ASSERT_TRUE (file.setBlockSizeCandidates({40000, 500, 4000}, 1));				// doubling the size is acceptable
+		ASSERT_TRUE (file.write(L"small",	0, numBytes, skvData.data()));
+		ASSERT_TRUE (file.write(L"skv",		0, numBytes, skvData.data()));
+		ASSERT_TRUE (file.close());
+	}
+	{
+		compressor::file file{comp};
+		ASSERT_TRUE(file.addLib(skvComp));
+		ASSERT_TRUE(file.open(fileName, true));
+		ASSERT_EQ  (file.getBlockSizeOfSection(L"fixed"),	1000);
+		ASSERT_EQ  (file.getBlockSizeOfSection(L"large"),	40000);
+		ASSERT_EQ  (file.getBlockSizeOfSection(L"small"),	500);
+		ASSERT_GT  (file.getBlockSizeOfSection(L"skv"),		0);
+		ASSERT_GT  (file.getBlockSizeOfSection(L"tiny"),	0);
+		for (const wchar_t* key : { L"fixed", L"large", L"small", L"skv" }) {
+			std::fill(readData.begin(), readData.end(), 0);
+			ASSERT_TRUE(file.read(key, 0, numBytes, readData.data()));
+			ASSERT_EQ  (skvData, readData) << key;
+			ASSERT_TRUE(file.read(key, 123456, 1, readData.data()));
+			ASSERT_EQ  (readData[0], skvData[123456]) << key;
+		}
+		ASSERT_TRUE(file.close());
+	}
+	std::filesystem::remove(fileName);
+}
+
+// Small sections are staged in memory, larger ones in temporary files of the configured directory.
+TEST_F(CompressorTest, StagingInMemory)
+{
+	compressor::file&			file			= *pFile;
+	const std::filesystem::path	tmpDirectory	= std::filesystem::temp_directory_path() / "compressorStaging";
+	std::vector<unsigned char>	data			(5000);
+	std::vector<unsigned char>	readBack		(5000);
+
+	std::generate(data.begin(), data.end(), []() { return static_cast<unsigned char>(rand() % 4); });
+	std::filesystem::remove_all(tmpDirectory);
+	ASSERT_FALSE(file.setTmpDirectory(L""));
+	ASSERT_TRUE (file.setTmpDirectory(tmpDirectory.wstring()));
+	ASSERT_FALSE(file.setMaxStagingSizeInMemory(-1));
+	ASSERT_TRUE (file.setMaxStagingSizeInMemory(1000));
+	ASSERT_TRUE (file.open(fileName, false));
+
+	// the small section stays in memory, the large one is written to the temporary directory
+	ASSERT_TRUE (file.write(L"small", 0, 1000, data.data()));
+	ASSERT_TRUE (file.write(L"large", 0, 5000, data.data()));
+	ASSERT_FALSE(std::filesystem::exists(tmpDirectory / "small.dat"));
+	ASSERT_TRUE (std::filesystem::exists(tmpDirectory / "large.dat"));
+	ASSERT_FALSE(file.setTmpDirectory(tmpDirectory.wstring()));						// not while sections are staged
+	ASSERT_TRUE (file.doesKeyExist(L"small"));
+	ASSERT_EQ   (file.getSizeOfUncompressedSection(L"small"), 1000);
+	ASSERT_TRUE (file.read(L"small", 0, 1000, readBack.data()));
+	ASSERT_TRUE (std::equal(data.begin(), data.begin() + 1000, readBack.begin()));
+
+	// growing beyond the limit moves the section to a temporary file
+	ASSERT_TRUE (file.write(L"grown", 0,   800, data.data()));
+	ASSERT_FALSE(std::filesystem::exists(tmpDirectory / "grown.dat"));
+	ASSERT_TRUE (file.write(L"grown", 800, 4200, &data[800]));
+	ASSERT_TRUE (std::filesystem::exists(tmpDirectory / "grown.dat"));
+	ASSERT_TRUE (file.read(L"grown", 0, 5000, readBack.data()));
+	ASSERT_EQ   (data, readBack);
+
+	// flushing removes the temporary files
+	ASSERT_TRUE (file.close());
+	ASSERT_FALSE(std::filesystem::exists(tmpDirectory / "large.dat"));
+	ASSERT_FALSE(std::filesystem::exists(tmpDirectory / "grown.dat"));
+	ASSERT_TRUE (file.open(fileName, true));
+	for (const wchar_t* key : { L"small", L"large", L"grown" }) {
+		long long numBytes = file.getSizeOfUncompressedSection(key);
+		ASSERT_TRUE(file.read(key, 0, numBytes, readBack.data()));
+		ASSERT_TRUE(std::equal(data.begin(), data.begin() + numBytes, readBack.begin())) << key;
+	}
+	ASSERT_TRUE (file.close());
+	std::filesystem::remove_all(tmpDirectory);
+}
+
+// When all sections staged in memory exceed the total limit, the largest one is moved to a temporary file.
+TEST_F(CompressorTest, StagingBudget)
+{
+	compressor::file&			file			= *pFile;
+	const std::filesystem::path	tmpDirectory	= std::filesystem::temp_directory_path() / "compressorStaging";
+	std::vector<unsigned char>	data			(1000);
+	std::vector<unsigned char>	readBack		(1000);
+
+	std::generate(data.begin(), data.end(), []() { return static_cast<unsigned char>(rand() % 4); });
+	std::filesystem::remove_all(tmpDirectory);
+	ASSERT_TRUE (file.setTmpDirectory(tmpDirectory.wstring()));
+	ASSERT_TRUE (file.setMaxStagingSizeInMemory(1000));
+	ASSERT_FALSE(file.setMaxTotalStagingSizeInMemory(-1));
+	ASSERT_TRUE (file.setMaxTotalStagingSizeInMemory(2000));
+	ASSERT_TRUE (file.open(fileName, false));
+
+	ASSERT_TRUE (file.write(L"a", 0, 800, data.data()));
+	ASSERT_TRUE (file.write(L"b", 0, 900, data.data()));
+	ASSERT_FALSE(std::filesystem::exists(tmpDirectory / "b.dat"));
+	ASSERT_TRUE (file.write(L"c", 0, 700, data.data()));								// 2400 bytes in memory
+	ASSERT_FALSE(std::filesystem::exists(tmpDirectory / "a.dat"));
+	ASSERT_TRUE (std::filesystem::exists(tmpDirectory / "b.dat"));
+	ASSERT_FALSE(std::filesystem::exists(tmpDirectory / "c.dat"));
+	ASSERT_TRUE (file.setMaxTotalStagingSizeInMemory(0));							// everything to temporary files
+	ASSERT_TRUE (std::filesystem::exists(tmpDirectory / "a.dat"));
+	ASSERT_TRUE (std::filesystem::exists(tmpDirectory / "c.dat"));
+	ASSERT_TRUE (file.read(L"b", 0, 900, readBack.data()));
+	ASSERT_TRUE (std::equal(data.begin(), data.begin() + 900, readBack.begin()));
+
+	ASSERT_TRUE (file.close());
+	ASSERT_TRUE (file.open(fileName, true));
+	for (const wchar_t* key : { L"a", L"b", L"c" }) {
+		long long numBytes = file.getSizeOfUncompressedSection(key);
+		ASSERT_TRUE(file.read(key, 0, numBytes, readBack.data()));
+		ASSERT_TRUE(std::equal(data.begin(), data.begin() + numBytes, readBack.begin())) << key;
+	}
+	ASSERT_TRUE (file.close());
+	std::filesystem::remove_all(tmpDirectory);
+}
+
+// A streamed section is identical to a staged one, but compressed while it is appended.
+TEST_F(CompressorTest, StreamingWriter)
+{
+	compressor::file&			file		= *pFile;
+	compressor::skvRans			skvComp;
+	const size_t				numBytes	= 100000;
+
+	srand(0);
+	std::vector<unsigned char>	data		= createSkvData(numBytes, 100);
+	readData.resize(numBytes);
+	ASSERT_TRUE (file.setBlockSize(3000));
+	ASSERT_TRUE (file.setSectionLib(L"skv", skvComp));
+	ASSERT_FALSE(file.beginSection(L"streamed"));										// file not open
+	ASSERT_TRUE (file.open(fileName, false));
+	ASSERT_FALSE(file.append(10, data.data()));											// no section begun
+	ASSERT_FALSE(file.endSection());
+
+	// staged and streamed section with the same data
+	ASSERT_TRUE (file.write(L"staged", 0, numBytes, data.data()));
+	ASSERT_FALSE(file.beginSection(L"staged"));
+	ASSERT_TRUE (file.flush());
+	ASSERT_TRUE (file.beginSection(L"streamed"));
+	ASSERT_FALSE(file.beginSection(L"other"));											// only one stream at once
+	ASSERT_FALSE(file.flush());
+	for (size_t position = 0, chunkSize = 1; position < numBytes; position += chunkSize, chunkSize = chunkSize * 3 + 1) {
+		chunkSize = std::min<size_t>(chunkSize, numBytes - position);
+		ASSERT_TRUE(file.append(chunkSize, &data[position]));
+	}
+	ASSERT_FALSE(file.doesKeyExist(L"streamed"));
+	ASSERT_TRUE (file.endSection());
+	ASSERT_TRUE (file.doesKeyExist(L"streamed"));
+	ASSERT_EQ   (file.getSizeOfCompressedSection(L"streamed"), file.getSizeOfCompressedSection(L"staged"));
+	ASSERT_TRUE (file.read(L"streamed", 0, numBytes, readData.data()));
+	ASSERT_EQ   (data, readData);
+
+	// the footer is written by endSection(), so that the file is valid without close()
+	{
+		compressor::file reader{comp};
+		std::fill(readData.begin(), readData.end(), 0);
+		ASSERT_TRUE (reader.setSectionLib(L"skv", skvComp));
+		ASSERT_TRUE (reader.open(fileName, true));
+		ASSERT_TRUE (reader.read(L"streamed", 0, numBytes, readData.data()));
+		ASSERT_EQ   (data, readData);
+		ASSERT_TRUE (reader.close());
+	}
+
+	// a section of another library with a chosen block size, which is ended by close()
+	ASSERT_TRUE (file.setBlockSizeCandidates({1000, 9000, 27000}, 0));
+	ASSERT_TRUE (file.beginSection(L"skv0"));
+	ASSERT_TRUE (file.append(numBytes, data.data()));
+	ASSERT_TRUE (file.close());
+
+	ASSERT_TRUE (file.open(fileName, true));
+	for (const wchar_t* key : { L"staged", L"streamed", L"skv0" }) {
+		std::fill(readData.begin(), readData.end(), 0);
+		ASSERT_EQ  (file.getSizeOfUncompressedSection(key), (long long) numBytes);
+		ASSERT_TRUE(file.read(key, 0, numBytes, readData.data()));
+		ASSERT_EQ  (data, readData) << key;
+		ASSERT_TRUE(file.read(key, 54321, 1, readData.data()));
+		ASSERT_EQ  (readData[0], data[54321]) << key;
+	}
+	ASSERT_EQ   (file.getBlockSizeOfSection(L"streamed"), 3000);
+	ASSERT_NE   (file.getBlockSizeOfSection(L"skv0"), 3000);
+	ASSERT_FALSE(file.beginSection(L"readOnly"));
+	ASSERT_TRUE (file.close());
+}
+
+// Several threads read random ranges of sections with different libraries at once, without any locking by the caller.
+TEST_F(CompressorTest, ConcurrentReads)
+{
+	compressor::uncompressed	defaultComp;
+	compressor::skvRans			skvComp;
+	compressor::plyInfoDelta	plyInfoComp{{65001, 65002, 65003}};
+	const size_t				numBytes	= 200000;
+	const unsigned int			numThreads	= 8;
+	const unsigned int			numReads	= 200;
+
+	srand(0);
+	std::vector<unsigned char>	skvData			= createSkvData(numBytes, 100);
+	std::vector<unsigned short>	plyInfoData		= createPlyInfoData(numBytes / 2, 10);
+	std::vector<unsigned char>	otherData		(numBytes);
+	std::generate(otherData.begin(), otherData.end(), []() { return static_cast<unsigned char>(rand() % 256); });
+	{
+		compressor::file file{defaultComp};
+		ASSERT_TRUE(file.setBlockSize(1000));
+		ASSERT_TRUE(file.setSectionLib(L"skv",		skvComp));
+		ASSERT_TRUE(file.setSectionLib(L"plyInfo",	plyInfoComp));
+		ASSERT_TRUE(file.open(fileName, false));
+		ASSERT_TRUE(file.write(L"skv0",		0, numBytes, skvData.data()));
+		ASSERT_TRUE(file.write(L"plyInfo0",	0, numBytes, plyInfoData.data()));
+		ASSERT_TRUE(file.write(L"other",	0, numBytes, otherData.data()));
+		ASSERT_TRUE(file.close());
+	}
+
+	compressor::file file{defaultComp};
+	ASSERT_TRUE(file.addLib(skvComp));
+	ASSERT_TRUE(file.addLib(plyInfoComp));
+	ASSERT_TRUE(file.open(fileName, true));
+
+	std::atomic<unsigned int>	numFailures		= 0;
+	std::vector<std::thread>	threads;
+	for (unsigned int threadNo = 0; threadNo < numThreads; threadNo++) {
+		threads.emplace_back([&, threadNo]() {
+			std::mt19937							generator(threadNo);
+			std::vector<unsigned char>				buffer(numBytes);
+			const std::wstring						keys[]		= { L"skv0", L"plyInfo0", L"other" };
+			const unsigned char*					expected[]	= { skvData.data(), (const unsigned char*) plyInfoData.data(), otherData.data() };
+			for (unsigned int readNo = 0; readNo < numReads; readNo++) {
+				unsigned int	sectionNo	= generator() % 3;
+				long long		numToRead	= (readNo % 10 == 0) ? 1 + generator() % 40000 : 1 + generator() % 4;		// some reads cover many blocks
+				long long		position	= generator() % (numBytes - numToRead + 1);
+				if (!file.read(keys[sectionNo], position, numToRead, buffer.data()) || memcmp(buffer.data(), expected[sectionNo] + position, numToRead) != 0) {
+					numFailures++;
+				}
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	ASSERT_EQ  (numFailures, 0);
+	ASSERT_TRUE(file.close());
+}
+
+// Several threads read a section, which is staged in a temporary file and not flushed yet.
+TEST_F(CompressorTest, ConcurrentStagedReads)
+{
+	compressor::file&			file		= *pFile;
+	const size_t				numBytes	= 100000;
+	const unsigned int			numThreads	= 4;
+	const unsigned int			numReads	= 200;
+
+	srand(0);
+	std::vector<unsigned char>	data		(numBytes);
+	std::generate(data.begin(), data.end(), []() { return static_cast<unsigned char>(rand() % 256); });
+	ASSERT_TRUE(file.setMaxStagingSizeInMemory(0));
+	ASSERT_TRUE(file.open(fileName, false));
+	ASSERT_TRUE(file.write(L"staged", 0, numBytes, data.data()));
+
+	std::atomic<unsigned int>	numFailures		= 0;
+	std::vector<std::thread>	threads;
+	for (unsigned int threadNo = 0; threadNo < numThreads; threadNo++) {
+		threads.emplace_back([&, threadNo]() {
+			std::mt19937				generator(threadNo);
+			std::vector<unsigned char>	buffer(numBytes);
+			for (unsigned int readNo = 0; readNo < numReads; readNo++) {
+				long long	numToRead	= 1 + generator() % 10000;
+				long long	position	= generator() % (numBytes - numToRead + 1);
+				if (!file.read(L"staged", position, numToRead, buffer.data()) || memcmp(buffer.data(), &data[position], numToRead) != 0) {
+					numFailures++;
+				}
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	ASSERT_EQ  (numFailures, 0);
+	ASSERT_TRUE(file.close());
+}
+
+// Several threads read a section, while further sections are streamed into the same file, like a database layer is saved during a calculation.
+TEST_F(CompressorTest, ReadWhileStreaming)
+{
+	compressor::file&			file		= *pFile;
+	compressor::skvRans			skvComp;
+	const size_t				numBytes	= 100000;
+	const unsigned int			numThreads	= 4;
+	const unsigned int			numSections	= 20;
+	const unsigned int			numReads	= 200;
+
+	srand(0);
+	std::vector<unsigned char>	data		= createSkvData(numBytes, 100);
+	ASSERT_TRUE(file.setBlockSize(3000));
+	ASSERT_TRUE(file.setSectionLib(L"skv", skvComp));
+	ASSERT_TRUE(file.open(fileName, false));
+	ASSERT_TRUE(file.beginSection(L"skv0"));
+	ASSERT_TRUE(file.append(numBytes, data.data()));
+	ASSERT_TRUE(file.endSection());
+
+	std::atomic<unsigned int>	numFailures		= 0;
+	std::vector<std::thread>	threads;
+	for (unsigned int threadNo = 0; threadNo < numThreads; threadNo++) {
+		threads.emplace_back([&, threadNo]() {
+			std::mt19937				generator(threadNo);
+			std::vector<unsigned char>	buffer(numBytes);
+			for (unsigned int readNo = 0; readNo < numReads; readNo++) {
+				long long	numToRead	= 1 + generator() % 10000;
+				long long	position	= generator() % (numBytes - numToRead + 1);
+				if (!file.read(L"skv0", position, numToRead, buffer.data()) || memcmp(buffer.data(), &data[position], numToRead) != 0) {
+					numFailures++;
+				}
+			}
+		});
+	}
+	for (unsigned int sectionNo = 1; sectionNo <= numSections; sectionNo++) {
+		ASSERT_TRUE(file.beginSection(L"skv" + std::to_wstring(sectionNo)));
+		ASSERT_TRUE(file.append(numBytes, data.data()));
+		ASSERT_TRUE(file.endSection());
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	ASSERT_EQ  (numFailures, 0);
+	ASSERT_TRUE(file.close());
+}
@@ -19,7 +19,8 @@ miniMax::alphaBeta::solver::solver(logger& log, threadManagerClass& tm, database
 
 //-----------------------------------------------------------------------------
 // Name: getBestChoice()
-// Desc: 
+// Desc: Searches either up to the fixed depth set by setSearchDepth() or, if a time budget is set and no database is open,
+//		 by iterative deepening until the time budget is exhausted.
 //-----------------------------------------------------------------------------
 bool miniMax::alphaBeta::solver::getBestChoice(unsigned int& choice, stateInfo& infoAboutChoices)
 {
@@ -31,44 +32,176 @@ bool miniMax::alphaBeta::solver::getBestChoice(unsigned int& choice, stateInfo&
 		return log.log(logger::logLevel::error, L"Max number of branches is zero"), false;
 	}
 
+	// locals
+	auto			startTime		= std::chrono::steady_clock::now();
+	float			rootValue		= 0;
+	bool			result;
+
+	// initialization
+	calcDatabase			= false;
+	stats.reset();
+	if (orderSettings.useTranspositionTable && !deterministic && !sharedTable) {
+		sharedTable			= std::make_unique<transpositionTable>(orderSettings.numTranspositionEntries);
+	}
+
+	// the database already knows the values, so iterative deepening is not necessary
+	if (timeBudgetInMs && !db.isOpen()) {
+		result				= searchIterativeDeepening(choice, infoAboutChoices);
+	} else {
+		result				= searchFixedDepth(choice, infoAboutChoices, rootValue, FPKV_MIN_VALUE, FPKV_MAX_VALUE);
+		stats.depthReached	= depthOfFullTree;
+	}
+	stats.elapsedSeconds	= std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// Name: searchIterativeDeepening()
+// Desc: Searches with increasing depth until depthOfFullTree is reached or the time budget is exhausted.
+//		 Each iteration uses an aspiration window around the value of the previous one. If the value falls outside,
+//		 the iteration is repeated with the full window. The result of the last completed iteration is returned.
+//-----------------------------------------------------------------------------
+bool miniMax::alphaBeta::solver::searchIterativeDeepening(unsigned int& choice, stateInfo& infoAboutChoices)
+{
+	// locals
+	unsigned int	maxDepth		= depthOfFullTree;			// depthOfFullTree is changed during the iterations
+	unsigned int	curChoice		= 0;						// result of the current iteration
+	stateInfo		curInfo;									// result of the current iteration
+	float			curValue		= 0;						// value of the root knot of the current iteration
+	float			lastValue		= 0;						// value of the root knot of the last completed iteration
+	searchStats		totalStats;									// node counters summed up over all iterations
+	bool			result			= true;
+
+	// the first iteration always runs to completion, so that there is a valid choice
+	deadline		= std::chrono::steady_clock::now() + std::chrono::milliseconds(timeBudgetInMs);
+	deadlineReached		= false;
+	useDeadline			= false;
+	windowInKnotFrame	= true;
+
+	for (unsigned int depth = 1; depth <= maxDepth; depth++) {
+
+		// narrow window around the last value, but not if the game is already decided
+		float alpha = FPKV_MIN_VALUE;
+		float beta  = FPKV_MAX_VALUE;
+		if (depth > 1 && aspirationWindow > 0 && lastValue - aspirationWindow > FPKV_MIN_VALUE && lastValue + aspirationWindow < FPKV_MAX_VALUE) {
+			alpha	= lastValue - aspirationWindow;
+			beta	= lastValue + aspirationWindow;
+		}
+
+		// search, repeat with full window if value is outside of the aspiration window
+		depthOfFullTree = depth;
+		while (true) {
+			stats.reset();
+			result = searchFixedDepth(curChoice, curInfo, curValue, alpha, beta);
+			totalStats.add(stats);
+			if (!result || deadlineReached) break;
+			if (curValue <= alpha && alpha > FPKV_MIN_VALUE) { alpha = FPKV_MIN_VALUE; continue; }
+			if (curValue >= beta  && beta  < FPKV_MAX_VALUE) { beta  = FPKV_MAX_VALUE; continue; }
+			break;
+		}
+		if (!result || deadlineReached) break;
+
+		// iteration completed
+		choice					= curChoice;
+		infoAboutChoices		= curInfo;
+		lastValue				= curValue;
+		totalStats.depthReached	= depth;
+		useDeadline				= true;
+
+		// no need to search deeper, if there is nothing to choose
+		if (curInfo.choices.size() <= 1) break;
+		if (std::chrono::steady_clock::now() >= deadline) break;
+	}
+
+	// the deadline cancelled the thread manager, which must be undone for the next call
+	if (deadlineReached) {
+		tm.reset();
+	}
+	depthOfFullTree		= maxDepth;
+	useDeadline			= false;
+	windowInKnotFrame	= false;
+	stats				= totalStats;
+
+	// an aborted iteration is not an error, since the last completed one is used
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// Name: searchFixedDepth()
+// Desc: Searches up to depthOfFullTree. alpha and beta are the search window from the perspective of the current player.
+//		 rootValue is the float value of the current state.
+//		 The branches of the root knot are searched in parallel, whether a database is open or not. Each branch gets the
+//		 window of the root knot, so that the branches are independent of each other. 
+//		 Each branch is a task of the thread manager, so that a few expensive branches do not stall the others.
+//		 The work is only split at the root, so no more threads than root branches are busy. The other threads start from
+//		 the state of thread zero, which is copied by gameInterface::copySituation(). If the game does not support this,
+//		 the caller must set the same state for each thread, as for setSituation().
+//-----------------------------------------------------------------------------
+bool miniMax::alphaBeta::solver::searchFixedDepth(unsigned int& choice, stateInfo& infoAboutChoices, float& rootValue, float alpha, float beta)
+{
 	// Locals
 	unsigned int 			layerNumber				= game.getLayerNumber(0);
 	knotStruct				root;
 	vector<knotStruct>		branches;
+	vector<unsigned int>	possibilityIds;
 	runAlphaBetaVars tva1(*this, layerNumber, L"");
 
-	// initialization
-	calcDatabase			= false;
+	// final states and forced moves are handled by letTheTreeGrow() on a single thread
+	if (depthOfFullTree > 2) {
+		game.getPossibilities(0, possibilityIds);
+	}
 
-	// if database is not available, use min-max algorithmn without database
-	if (!db.isOpen() && depthOfFullTree > 2) {
+	// without database there is nothing to choose, if no move is possible
+	if (!db.isOpen() && depthOfFullTree > 2 && possibilityIds.empty()) {
+		choice								= 0;
+		infoAboutChoices.choices.clear();
+		infoAboutChoices.shortValue			= SKV_VALUE_INVALID;
+		infoAboutChoices.plyInfo			= 0;
+		infoAboutChoices.bestAmountOfPlies	= 0;
+		rootValue							= 0;
+		return true;
+	}
+
+	// search the branches of the root knot in parallel
+	if (possibilityIds.size() > 1) {
 
-		// create one thread for each possibility
-		vector<unsigned int>	possibilityIds;
-		game.getPossibilities(0, possibilityIds);
-		if (!possibilityIds.size()) {
-			choice = 0;
-			infoAboutChoices.choices.clear();
-			infoAboutChoices.shortValue			= SKV_VALUE_INVALID;
-			infoAboutChoices.plyInfo			= 0;
-			infoAboutChoices.bestAmountOfPlies = 0;
-			return true;
-		}
 		branches.resize(possibilityIds.size());
+		root.initForCalculation(branches.data());
 		root.playerToMoveChanged	= true;
 		root.possibilityIds 		= possibilityIds;
-		root.numPossibilities 		= possibilityIds.size();
-		root.branches 				= branches.data();
+		root.numPossibilities 		= (unsigned int) possibilityIds.size();
 		threadManagerClass::threadVarsArray<runAlphaBetaVars> tva(tm.getNumThreads(), runAlphaBetaVars(*this, layerNumber, L""));
 		for (unsigned int i=0; i<tm.getNumThreads(); i++) {
 			tva.item[i].rootKnot	= &root;
+			tva.item[i].rootAlpha	= alpha;
+			tva.item[i].rootBeta	= beta;
+		}
+
+		// the other threads start from the state of thread zero. if the game cannot copy it, the caller must have set the state of each thread.
+		for (unsigned int i=1; i<tm.getNumThreads(); i++) {
+			game.copySituation(0, i);
 		}
 
-		switch (tm.executeParallelLoop(minMaxThreadProc, tva.getPointerToArray(), tva.getSizeOfArray(), TM_SCHEDULE_STATIC, 0, possibilityIds.size()-1, 1))
+		// each branch is a task, which uses the variables of the worker executing it. after a cancellation the remaining branches are skipped.
+		std::atomic<bool>	branchFailed	= false;
+		unsigned int		returnValue		= tm.executeTasks([&]() {
+			threadManagerClass::taskGroup group;
+			for (unsigned int index = 0; index < root.numPossibilities; index++) {
+				tm.spawn(group, [&, index]() {
+					if (!searchRootBranch(tva.item[tm.getThreadNumber()], index)) branchFailed = true;
+				});
+			}
+			tm.sync(group);
+		});
+
+		switch (returnValue)
 		{
 		case TM_RETURN_VALUE_OK: 			
+			if (branchFailed) return log.log(logger::logLevel::error, L"searchRootBranch() failed"), returnValues::falseOrStop();
 			break;
 		case TM_RETURN_VALUE_EXECUTION_CANCELLED:
+			if (deadlineReached) return true;
 			log << "\n" << "****************************************\nMain thread: Execution cancelled by user!\n****************************************\n";
 			return false;
 		default:
@@ -86,22 +219,35 @@ bool miniMax::alphaBeta::solver::getBestChoice(unsigned int& choice, stateInfo&
 		if (!root.calcPlyInfo()) {
 			return log.log(logger::logLevel::error, L"knot.calcPlyInfo() failed"), returnValues::falseOrStop();
 		}
-		if (!root.getBestBranchesBasedOnFloatValue(bestBranches)) {
-			return log.log(logger::logLevel::error, L"knot.getBestBranchesBasedOnFloatValue() failed"), returnValues::falseOrStop();
+		if (db.isOpen()) {
+			for (unsigned int curPoss = 0; curPoss < root.numPossibilities; curPoss++) {
+				root.increaseFreqValuesSubMoves(curPoss);
+			}
+			if (!root.getBestBranchesBasedOnSkvValue(bestBranches)) {
+				return log.log(logger::logLevel::error, L"knot.getBestBranchesBasedOnSkvValue() failed"), returnValues::falseOrStop();
+			}
+		} else {
+			if (!root.getBestBranchesBasedOnFloatValue(bestBranches)) {
+				return log.log(logger::logLevel::error, L"knot.getBestBranchesBasedOnFloatValue() failed"), returnValues::falseOrStop();
+			}
 		}
-		unsigned int bestBranch		= (bestBranches.size() ? bestBranches[rand() % bestBranches.size()] : 0);
-		root.bestMoveId				= root.possibilityIds[bestBranch];
+		root.bestMoveId				= root.possibilityIds[selectBestBranch(bestBranches)];
 
-	// use database, with one single thread
+	// single thread
 	} else {
 		tva1.curThreadNo = 0;
-		if (!letTheTreeGrow(root, tva1, depthOfFullTree, FPKV_MIN_VALUE, FPKV_MAX_VALUE)) {
+		if (!letTheTreeGrow(root, tva1, depthOfFullTree, alpha, beta)) {
 			return log.log(logger::logLevel::error, L"letTheTreeGrow() failed"), false;
 		}
+		stats.add(tva1.stats);
 	}
 	
+	// search was stopped by the deadline, so the result is incomplete
+	if (deadlineReached) return true;
+
 	// calc information about choices
 	choice					= root.bestMoveId;
+	rootValue				= root.floatValue;
 	root.getInfoAboutChoices(infoAboutChoices);
 	infoAboutChoices.updateBestAmountOfPlies();
 
@@ -109,10 +255,123 @@ bool miniMax::alphaBeta::solver::getBestChoice(unsigned int& choice, stateInfo&
 }
 
 //-----------------------------------------------------------------------------
-// Name: minMaxThreadProc()
-// Desc: 
+// Name: searchRootBranch()
+// Desc: Searches a single branch of the root knot with the variables of the calling thread.
+//		 The game state of the thread must be equal to the one of thread zero, see searchFixedDepth().
 //-----------------------------------------------------------------------------
-DWORD miniMax::alphaBeta::solver::minMaxThreadProc(void *pParameter, int64_t index)
+bool miniMax::alphaBeta::solver::searchRootBranch(runAlphaBetaVars& rabVars, unsigned int index)
+{
+	// locals
+	knotStruct &				root			= *rabVars.rootKnot;
+	void *						pBackup;
+	bool 						playerToMoveChanged;
+
+	// the result of a branch must not depend on the branches searched before by the same thread
+	if (deterministic) {
+		rabVars.ordering.clear();
+	}
+
+	// perform move for this thread with the corresponding possibility
+	game.move(rabVars.curThreadNo, root.possibilityIds[index], playerToMoveChanged, pBackup);
+	root.branches[index].playerToMoveChanged = playerToMoveChanged;
+
+	// during iterative deepening the search window of the branch is seen from the perspective of the player to move after the move
+	bool  negate	= windowInKnotFrame && playerToMoveChanged;
+	float alpha		= negate ? -rabVars.rootBeta  : rabVars.rootAlpha;
+	float beta		= negate ? -rabVars.rootAlpha : rabVars.rootBeta;
+
+	// calc value of considered possibility
+	if (!letTheTreeGrow(root.branches[index], rabVars, depthOfFullTree - 1, alpha, beta)) {
+		return log.log(logger::logLevel::error, L"letTheTreeGrow() failed"), false;
+	}
+
+	// undo move
+	game.undo(rabVars.curThreadNo, root.possibilityIds[index], playerToMoveChanged, pBackup);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: selectBestBranch()
+// Desc: Selects randomly one of the equivalent best branches, or the first one if the search must be deterministic.
+//-----------------------------------------------------------------------------
+unsigned int miniMax::alphaBeta::solver::selectBestBranch(const vector<unsigned int>& bestBranches) const
+{
+	if (bestBranches.empty())	return 0;
+	if (deterministic)			return bestBranches[0];
+	return bestBranches[rand() % bestBranches.size()];
+}
+
+//-----------------------------------------------------------------------------
+// Name: getBestChoices()
+// Desc: Searches the best choice of many states, e.g. for the analysis of game records. 
+//		 Each state is searched by a single thread with its own game context, while the threads process different states.
+//		 The states are processed sorted by layer and state number, so that database accesses of a thread stay close.
+//		 onResult is called once for each state as soon as it is calculated, with the index of the state in 'states'.
+//		 The calls are serialized, but happen from the worker threads in any order.
+//		 Invalid states are reported with shortValue SKV_VALUE_INVALID and without choices.
+//-----------------------------------------------------------------------------
+bool miniMax::alphaBeta::solver::getBestChoices(const std::vector<stateAdressStruct>& states, const batchCallback& onResult)
+{
+	// checks
+	if (depthOfFullTree == 0) {
+		return log.log(logger::logLevel::error, L"Depth of full tree is zero"), false;
+	}
+	if (maxNumBranches == 0) {
+		return log.log(logger::logLevel::error, L"Max number of branches is zero"), false;
+	}
+	if (states.empty()) {
+		return true;
+	}
+
+	// locals
+	auto			startTime		= std::chrono::steady_clock::now();
+
+	// initialization
+	calcDatabase			= false;
+	useDeadline				= false;
+	deadlineReached			= false;
+	stats.reset();
+	if (orderSettings.useTranspositionTable && !deterministic && !sharedTable) {
+		sharedTable			= std::make_unique<transpositionTable>(orderSettings.numTranspositionEntries);
+	}
+
+	// process the states grouped by layer
+	batchStates				= &states;
+	batchResultCallback		= &onResult;
+	nextBatchItem			= 0;
+	batchOrder.resize(states.size());
+	for (size_t i = 0; i < states.size(); i++) batchOrder[i] = i;
+	std::stable_sort(batchOrder.begin(), batchOrder.end(), [&states](size_t a, size_t b) { return states[a] < states[b]; });
+
+	threadManagerClass::threadVarsArray<runAlphaBetaVars> tva(tm.getNumThreads(), runAlphaBetaVars(*this, states[batchOrder[0]].layerNumber, L""));
+	unsigned int returnValue = tm.executeInParallel(batchThreadProc, tva.getPointerToArray(), tva.getSizeOfArray());
+	batchStates				= nullptr;
+	batchResultCallback		= nullptr;
+
+	switch (returnValue)
+	{
+	case TM_RETURN_VALUE_OK: 			
+		break;
+	case TM_RETURN_VALUE_EXECUTION_CANCELLED:
+		log << "\n" << "****************************************\nMain thread: Execution cancelled by user!\n****************************************\n";
+		return false;
+	default:
+	case TM_RETURN_VALUE_INVALID_PARAM:
+	case TM_RETURN_VALUE_UNEXPECTED_ERROR:
+		return returnValues::falseOrStop();
+	}
+	tva.reduce();
+
+	stats.depthReached		= depthOfFullTree;
+	stats.elapsedSeconds	= std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: batchThreadProc()
+// Desc: Searches states passed to getBestChoices() until all of them are taken by any thread.
+//-----------------------------------------------------------------------------
+DWORD miniMax::alphaBeta::solver::batchThreadProc(void* pParameter)
 {
 	// check
 	if (pParameter == NULL) return TM_RETURN_VALUE_TERMINATE_ALL_THREADS;
@@ -122,19 +381,46 @@ DWORD miniMax::alphaBeta::solver::minMaxThreadProc(void *pParameter, int64_t ind
 	solver &					abSolver		= rabVars.rSolver;
 	logger &					log				= abSolver.log;
 	gameInterface &				game			= abSolver.game;
-	void *						pBackup;
-	bool 						playerToMoveChanged;
+	size_t						item;
+	unsigned int				choice;
+	stateInfo					infoAboutChoices;
 
-	// perform move for this thread with the corresponding possibility
-	game.move(rabVars.curThreadNo, rabVars.rootKnot->possibilityIds[index], playerToMoveChanged, pBackup);
+	while ((item = abSolver.nextBatchItem++) < abSolver.batchOrder.size()) {
 
-	// calc value of considered possibility
-	if (!abSolver.letTheTreeGrow(rabVars.rootKnot->branches[index], rabVars, abSolver.depthOfFullTree - 1, FPKV_MIN_VALUE, FPKV_MAX_VALUE)) {
-		return log.log(logger::logLevel::error, L"letTheTreeGrow() failed"), TM_RETURN_VALUE_TERMINATE_ALL_THREADS;
-	}
+		// stop fetching states
+		abSolver.tm.pausePoint();
+		if (abSolver.tm.wasExecutionCancelled()) break;
 
-	// undo move
-	game.undo(rabVars.curThreadNo, rabVars.rootKnot->possibilityIds[index], playerToMoveChanged, pBackup);
+		size_t						index			= abSolver.batchOrder[item];
+		const stateAdressStruct &	state			= (*abSolver.batchStates)[index];
+		knotStruct					root;
+
+		// the result of a state must not depend on the states searched before by the same thread
+		if (abSolver.deterministic) {
+			rabVars.ordering.clear();
+		}
+
+		// search
+		if (game.setSituation(rabVars.curThreadNo, state.layerNumber, state.stateNumber)) {
+			rabVars.layerNumber = state.layerNumber;
+			if (!abSolver.letTheTreeGrow(root, rabVars, abSolver.depthOfFullTree, FPKV_MIN_VALUE, FPKV_MAX_VALUE)) {
+				return log.log(logger::logLevel::error, L"letTheTreeGrow() failed"), TM_RETURN_VALUE_TERMINATE_ALL_THREADS;
+			}
+			choice = root.bestMoveId;
+			root.getInfoAboutChoices(infoAboutChoices);
+			infoAboutChoices.updateBestAmountOfPlies();
+		} else {
+			choice = 0;
+			infoAboutChoices.choices.clear();
+			infoAboutChoices.shortValue			= SKV_VALUE_INVALID;
+			infoAboutChoices.plyInfo			= PLYINFO_VALUE_INVALID;
+			infoAboutChoices.bestAmountOfPlies	= PLYINFO_VALUE_INVALID;
+		}
+
+		// pass result to the caller
+		std::lock_guard<std::mutex> lock(abSolver.batchMutex);
+		(*abSolver.batchResultCallback)(index, choice, infoAboutChoices);
+	}
 
 	return TM_RETURN_VALUE_OK;
 }
@@ -193,6 +479,59 @@ void miniMax::alphaBeta::solver::setSearchDepth(unsigned int maxAlphaBetaSearchD
 	depthOfFullTree = maxAlphaBetaSearchDepth; 
 }
 
+//-----------------------------------------------------------------------------
+// Name: setTimeBudget()
+// Desc: If milliseconds is non-zero, getBestChoice() deepens the search iteratively up to the depth set by setSearchDepth()
+//		 and returns the best choice of the last completed depth, when the time is up. 
+//		 aspirationWindow is the half width of the search window around the value of the previous depth. Zero disables it.
+//-----------------------------------------------------------------------------
+void miniMax::alphaBeta::solver::setTimeBudget(unsigned int milliseconds, float aspirationWindow)
+{
+	timeBudgetInMs			= milliseconds;
+	this->aspirationWindow	= aspirationWindow;
+}
+
+//-----------------------------------------------------------------------------
+// Name: setMoveOrdering()
+// Desc: Selects the heuristics used to sort the possibilities before they are explored.
+//-----------------------------------------------------------------------------
+void miniMax::alphaBeta::solver::setMoveOrdering(const moveOrdering::settings& newSettings)
+{
+	orderSettings = newSettings;
+	sharedTable.reset();
+}
+
+//-----------------------------------------------------------------------------
+// Name: setDeterministic()
+// Desc: If enabled, getBestChoice() returns the same choice and values on each call, independent of the number of threads
+//		 and their timing. Therefore the first of equivalent moves is chosen instead of a random one, the transposition table 
+//		 is not shared between threads, and the move ordering is reset before each branch of the root knot.
+//		 Iterative deepening with a time budget stays non-deterministic, since the reached depth depends on the timing.
+//-----------------------------------------------------------------------------
+void miniMax::alphaBeta::solver::setDeterministic(bool enabled)
+{
+	deterministic = enabled;
+	sharedTable.reset();
+}
+
+//-----------------------------------------------------------------------------
+// Name: getSharedTable()
+// Desc: Returns the transposition table shared by all threads, or nullptr if each thread shall use its own one.
+//-----------------------------------------------------------------------------
+miniMax::alphaBeta::transpositionTable* miniMax::alphaBeta::solver::getSharedTable()
+{
+	return (deterministic || calcDatabase) ? nullptr : sharedTable.get();
+}
+
+//-----------------------------------------------------------------------------
+// Name: getSearchStats()
+// Desc: Returns the node counters of the last search, e.g. to measure the effect of the move ordering.
+//-----------------------------------------------------------------------------
+const miniMax::alphaBeta::searchStats& miniMax::alphaBeta::solver::getSearchStats() const
+{
+	return stats;
+}
+
 //-----------------------------------------------------------------------------
 // Name: init()
 // Desc: The function setSituation is called for each state to mark the invalid ones.
@@ -240,6 +579,11 @@ bool miniMax::alphaBeta::solver::init(unsigned int layerNumber)
 		return returnValues::falseOrStop();
 	}
 
+	// load balance of the threads
+	if (tm.isProfilingEnabled()) {
+		log.log(logger::logLevel::info, L"Thread profile of initialization of the alpha-beta layer: " + tm.getLastProfile().toJson());
+	}
+
 	// reduce and delete thread specific data
 	tva.reduce();
 
@@ -341,10 +685,11 @@ bool miniMax::alphaBeta::solver::run(unsigned int layerNumber)
 	log << "\n" << "*** Calculate layer " << layerNumber << " with function letTheTreeGrow(): ***" << "\n";
 	totalNumStatesProcessed 		= 0;
 	roughTotalNumStatesProcessed 	= 0;
+	stats.reset();
 	threadManagerClass::threadVarsArray<runAlphaBetaVars> tva(tm.getNumThreads(), runAlphaBetaVars(*this, layerNumber, L""));
 
 	// process each state in the current layer
-	switch (tm.executeParallelLoop(runThreadProc, tva.getPointerToArray(), tva.getSizeOfArray(), TM_SCHEDULE_STATIC, 0, db.getNumberOfKnots(layerNumber) - 1, 1))
+	switch (tm.executeParallelLoop(runThreadProc, tva.getPointerToArray(), tva.getSizeOfArray(), TM_SCHEDULE_DYNAMIC, 0, db.getNumberOfKnots(layerNumber) - 1, 1))
 	{
 	case TM_RETURN_VALUE_OK: 			
 		break;
@@ -357,6 +702,11 @@ bool miniMax::alphaBeta::solver::run(unsigned int layerNumber)
 		return returnValues::falseOrStop();
 	}
 
+	// load balance of the threads
+	if (tm.isProfilingEnabled()) {
+		log.log(logger::logLevel::info, L"Thread profile of alpha-beta layer calculation: " + tm.getLastProfile().toJson());
+	}
+
 	// reduce and delete thread specific data
 	tva.reduce();
 	if (totalNumStatesProcessed != db.getNumberOfKnots(layerNumber)) {
@@ -443,8 +793,17 @@ bool miniMax::alphaBeta::solver::letTheTreeGrow(knotStruct& knot, runAlphaBetaVa
 	unsigned int	stateNumber							= 0;		// state number of current state
 	unsigned int	maxWonfreqValuesSubMoves			= 0;		// maximum number of freqValuesSubMoves[SKV_VALUE_GAME_WON]
 
+	rabVars.stats.numNodes++;
+
+	// time budget exhausted or cancelled by user. the result is discarded by the caller.
+	if (isSearchAborted(rabVars)) {
+		knot.setInvalid();
+		return true;
+	}
+
 	// evaluate situation, if last search depth level
 	if (tilLevel == 0) {
+		rabVars.stats.numLeafNodes++;
 		
 		// If tilLevel is equal to zero while calculating the database, this indicates that the recursion has reached its maximum depth and exhausted available memory resources.
 		// Each recursive step consumes memory, so hitting zero means the algorithm cannot continue deeper, which may result in incomplete calculations or failure to store all required states.
@@ -465,9 +824,12 @@ bool miniMax::alphaBeta::solver::letTheTreeGrow(knotStruct& knot, runAlphaBetaVa
 		// get layer and state number of current state and look if short knot value can be found in database or in an array
 		if (tryDataBase(knot, rabVars, tilLevel, layerNumber, stateNumber)) return true;
 
-		// get number of possiblities
-		game.getPossibilities(rabVars.curThreadNo, knot.possibilityIds);
-		knot.numPossibilities = (unsigned int) knot.possibilityIds.size();
+		// get number of possiblities. the knots of the same ply are expanded one after another, so they share the storage.
+		vector<unsigned int>& possibilityIds = rabVars.possibilityArena[depthOfFullTree - tilLevel];
+		possibilityIds.clear();
+		game.getPossibilities(rabVars.curThreadNo, possibilityIds);
+		knot.possibilityIds   = possibilityIds;
+		knot.numPossibilities = (unsigned int) possibilityIds.size();
 
 		// debug print
 		if (log.getLevel() >= logger::logLevel::trace) {
@@ -517,8 +879,7 @@ bool miniMax::alphaBeta::solver::letTheTreeGrow(knotStruct& knot, runAlphaBetaVa
 						return log.log(logger::logLevel::error, L"knot.getBestBranchesBasedOnFloatValue() failed"), returnValues::falseOrStop();
 					}
 				}
-				unsigned int bestBranch		= (bestBranches.size() ? bestBranches[rand() % bestBranches.size()] : 0);
-				knot.bestMoveId				= knot.possibilityIds[bestBranch];
+				knot.bestMoveId				= knot.possibilityIds[selectBestBranch(bestBranches)];
 			} else if (!calcDatabase) {
 				knot.bestMoveId = (knot.possibilityIds.size() > 0) ? knot.possibilityIds[0] : 0;
 			}
@@ -562,12 +923,15 @@ bool miniMax::alphaBeta::solver::tryDataBase(knotStruct& knot, const runAlphaBet
 	// use database ?
 	if (db.isOpen() && (calcDatabase || db.isLayerCompleteAndInFile(rabVars.layerNumber))) {
 
-		// lock mutex for database access
-		std::lock_guard<std::mutex> lock(dbMutex);	
-
-		// situation already existend in database ?
+		// the game state belongs to this thread, so no lock is needed here
 		game.getLayerAndStateNumber(rabVars.curThreadNo, layerNumber, stateNumber, symOp);
+
+		// lock mutex for database access, unless a completed layer is read from a file allowing concurrent reads
 		bool layerInDatabaseAndCompleted = db.isLayerCompleteAndInFile(layerNumber);
+		std::unique_lock<std::mutex> lock(dbMutex, std::defer_lock);
+		if (calcDatabase || !layerInDatabaseAndCompleted || !db.allowsConcurrentReads()) lock.lock();
+
+		// situation already existend in database ?
 		if (!db.readKnotValueFromDatabase(layerNumber, stateNumber, shortKnotValue)) {
 			return log.log(logger::logLevel::error, L"db.readKnotValueFromDatabase() failed"), returnValues::falseOrStop();
 		}
@@ -626,6 +990,19 @@ bool miniMax::alphaBeta::solver::tryPossibilities(knotStruct& knot, runAlphaBeta
 	// locals
 	void *			pBackup;
 	unsigned int	curPoss;
+	unsigned int	ply					= depthOfFullTree - tilLevel;		// distance to the root knot
+	uint64_t		positionKey			= 0;								// key of the current state for the transposition table
+	bool			hasPositionKey		= false;							// true if the game supplies position keys
+	bool			useMoveOrdering		= isMoveOrderingUseful(tilLevel) && rabVars.ordering.isActive();	// sort possibilities so that cut offs happen early
+
+	// try the most promising possibilities first
+	if (useMoveOrdering) {
+		if (orderSettings.useTranspositionTable) {
+			hasPositionKey = game.getPositionKey(rabVars.curThreadNo, positionKey);
+		}
+		// sorted in place, so knot.possibilityIds still points to the same storage
+		rabVars.ordering.sortPossibilities(game, rabVars.curThreadNo, ply, hasPositionKey, positionKey, rabVars.possibilityArena[ply], rabVars.stats);
+	}
 
 	for (curPoss=0; curPoss<knot.numPossibilities; curPoss++) {
 
@@ -642,8 +1019,9 @@ bool miniMax::alphaBeta::solver::tryPossibilities(knotStruct& knot, runAlphaBeta
 			log << wstring(2*(depthOfFullTree-tilLevel), L' ') << "Moved according to possiblity " << curPoss;
 		}		
 
-		// recursive call
-		if (!letTheTreeGrow(knot.branches[curPoss], rabVars, tilLevel - 1, alpha, beta)) {
+		// recursive call. during iterative deepening the window is seen from the perspective of the player to move in the branch.
+		bool  negate = windowInKnotFrame && knot.branches[curPoss].playerToMoveChanged;
+		if (!letTheTreeGrow(knot.branches[curPoss], rabVars, tilLevel - 1, negate ? -beta : alpha, negate ? -alpha : beta)) {
 			return log.log(logger::logLevel::error, L"letTheTreeGrow() failed"), returnValues::falseOrStop();
 		}
 
@@ -672,12 +1050,54 @@ bool miniMax::alphaBeta::solver::tryPossibilities(knotStruct& knot, runAlphaBeta
 		if (db.isOpen() && tilLevel + 1 >= depthOfFullTree)	continue;
 
 		// check if we can spare the other possibilities according to alpha beta algorithmn
-		if (knot.canCutOff(curPoss, alpha, beta)) break;
+		if (windowInKnotFrame ? knot.canCutOffInKnotFrame(curPoss, alpha, beta) : knot.canCutOff(curPoss, alpha, beta)) {
+			rabVars.stats.numCutOffs++;
+			if (curPoss == 0) rabVars.stats.numFirstMoveCutOffs++;
+			if (useMoveOrdering) rabVars.ordering.storeCutOff(ply, tilLevel, knot.possibilityIds[curPoss]);
+			break;
+		}
+	}
+
+	// remember the best move for the next visit of this state. after a cut off it is the last explored one.
+	if (hasPositionKey && knot.numPossibilities > 0) {
+		unsigned int bestBranch = (curPoss < knot.numPossibilities) ? curPoss : moveOrdering::getBestBranch(knot);
+		rabVars.ordering.storeBestMove(positionKey, knot.possibilityIds[bestBranch]);
 	}
 
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// Name: isSearchAborted()
+// Desc: Returns true if the time budget of getBestChoice() is exhausted or the user cancelled the execution.
+//		 The clock is only read every 1024 knots. Never aborts a database calculation.
+//-----------------------------------------------------------------------------
+bool miniMax::alphaBeta::solver::isSearchAborted(runAlphaBetaVars& rabVars)
+{
+	if (!useDeadline || calcDatabase)				return false;
+	if (deadlineReached)							return true;
+	if (tm.wasExecutionCancelled())					return true;
+	if ((rabVars.stats.numNodes & 1023) != 0)		return false;
+	if (std::chrono::steady_clock::now() < deadline)	return false;
+
+	// stop all other threads as well
+	deadlineReached = true;
+	tm.cancelExecution();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: isMoveOrderingUseful()
+// Desc: Move ordering only pays off where cut offs are possible. The root knot and its direct branches keep
+//		 the order of the game, since all of them are explored anyway and their order is visible in stateInfo.
+//-----------------------------------------------------------------------------
+bool miniMax::alphaBeta::solver::isMoveOrderingUseful(unsigned int tilLevel)
+{
+	if (calcDatabase)							return false;
+	if (tilLevel + 1 >= depthOfFullTree)		return false;
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // Name: saveInDatabase()
 // Desc: 
@@ -758,9 +1178,11 @@ miniMax::alphaBeta::initAlphaBetaVars::initAlphaBetaVars(initAlphaBetaVars const
 //-----------------------------------------------------------------------------
 miniMax::alphaBeta::runAlphaBetaVars::runAlphaBetaVars(solver& rSolver, unsigned int layerNumber, const wstring& filepath) : 
 	rSolver(rSolver),
-	commonThreadVars(layerNumber, filepath, rSolver.db.getNumberOfKnots(layerNumber), rSolver.roughTotalNumStatesProcessed, rSolver.totalNumStatesProcessed, rSolver.log)
+	commonThreadVars(layerNumber, filepath, rSolver.db.getNumberOfKnots(layerNumber), rSolver.roughTotalNumStatesProcessed, rSolver.totalNumStatesProcessed, rSolver.log),
+	ordering(rSolver.depthOfFullTree, rSolver.orderSettings, rSolver.getSharedTable())
 {
 	branchArray.resize(rSolver.maxNumBranches * rSolver.depthOfFullTree);
+	reserveArena();
 }
 
 //-----------------------------------------------------------------------------
@@ -768,8 +1190,31 @@ miniMax::alphaBeta::runAlphaBetaVars::runAlphaBetaVars(solver& rSolver, unsigned
 // Desc: 
 //-----------------------------------------------------------------------------
 miniMax::alphaBeta::runAlphaBetaVars::runAlphaBetaVars(runAlphaBetaVars const& master) : 
-	commonThreadVars(master), symStates(master.symStates), rSolver(master.rSolver)
+	commonThreadVars(master), symStates(master.symStates), rSolver(master.rSolver), ordering(master.ordering)
 {
 	branchArray.resize(master.rSolver.maxNumBranches * master.rSolver.depthOfFullTree); 
+	reserveArena();
+}
+
+//-----------------------------------------------------------------------------
+// Name: reserveArena()
+// Desc: Allocates the storage for the possibility ids of each ply at once. It is not copied from the master, since it only holds temporary data.
+//-----------------------------------------------------------------------------
+void miniMax::alphaBeta::runAlphaBetaVars::reserveArena()
+{
+	possibilityArena.resize(rSolver.depthOfFullTree + 1);
+	for (auto& possibilityIds : possibilityArena) {
+		possibilityIds.reserve(rSolver.maxNumBranches);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name: reduce()
+// Desc: Adds the node counters of this thread to the solver
+//-----------------------------------------------------------------------------
+void miniMax::alphaBeta::runAlphaBetaVars::reduce()
+{
+	commonThreadVars::reduce();
+	rSolver.stats.add(stats);
 }
 #pragma endregion
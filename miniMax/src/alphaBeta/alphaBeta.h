@@ -12,9 +12,14 @@
 #include "miniMax/src/database/database.h"
 #include "miniMax/src/alphaBeta/knotStruct.h"
 #include "miniMax/src/alphaBeta/commonThreadVars.h"
+#include "miniMax/src/alphaBeta/moveOrdering.h"
 
 #include <mutex>
 #include <vector>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <functional>
 
 namespace miniMax
 {
@@ -37,10 +42,19 @@ namespace alphaBeta
 		solver& 										rSolver;
 		std::vector<knotStruct>							branchArray;												// array of size [(depthOfFullTree - tilLevel) * maxNumBranches] for storage of the branches at each search depth
 		std::vector<stateAdressStruct>					symStates;													// filled by game->getSymmetricStates()
-		knotStruct*										rootKnot;													// used to run the min-max calculation without database
+		std::vector<std::vector<unsigned int>>			possibilityArena;											// [ply] possibility ids of the knot currently expanded at each distance to the root. reserved once, so that the search does not allocate.
+		knotStruct*										rootKnot;													// root knot shared by all threads searching its branches in parallel
+		float											rootAlpha						= FPKV_MIN_VALUE;			// search window of the root knot, from the perspective of the root knot
+		float											rootBeta						= FPKV_MAX_VALUE;			// search window of the root knot, from the perspective of the root knot
+		moveOrdering									ordering;													// killer moves, history scores and transposition table of this thread
+		searchStats										stats;														// node counters of this thread
 
 														runAlphaBetaVars				(runAlphaBetaVars const& master);
 														runAlphaBetaVars				(solver& rSolver, unsigned int layerNumber, const wstring& filepath);
+		void											reduce							();
+
+	private:
+		void											reserveArena					();
 	};
 
 	class solver
@@ -50,10 +64,18 @@ namespace alphaBeta
 	friend struct runAlphaBetaVars;
 
 	public:
+		// called by getBestChoices() for each state with its index in the passed vector
+		using batchCallback = std::function<void(size_t index, unsigned int choice, const stateInfo& infoAboutChoices)>;
+
 														solver							(logger& log, threadManagerClass& tm, database::database& db, gameInterface& game);
 		bool											getBestChoice					(unsigned int& choice, stateInfo& infoAboutChoices);
+		bool											getBestChoices					(const std::vector<stateAdressStruct>& states, const batchCallback& onResult);
 		bool											calcKnotValuesByAlphaBeta		(std::vector<unsigned int>& layersToCalculate);
 		void											setSearchDepth					(unsigned int maxAlphaBetaSearchDepth);
+		void											setMoveOrdering					(const moveOrdering::settings& newSettings);
+		void											setTimeBudget					(unsigned int milliseconds, float aspirationWindow);
+		void											setDeterministic				(bool enabled);
+		const searchStats&								getSearchStats					() const;
 
 	private:
 		logger &										log;													// logger, used for output
@@ -66,18 +88,40 @@ namespace alphaBeta
 		unsigned int									maxNumBranches					= 0;					// maximum number of branches/moves
 		bool											calcDatabase					= false;				// true if the database is currently beeing calculated
 		std::mutex 										dbMutex;
+		moveOrdering::settings							orderSettings;											// heuristics used to sort the possibilities of each knot
+		searchStats										stats;													// node counters of the last search
+		unsigned int									timeBudgetInMs					= 0;					// if non-zero getBestChoice() uses iterative deepening and stops after this time
+		float											aspirationWindow				= 0;					// half width of the search window around the value of the previous iteration. zero disables aspiration windows.
+		bool											useDeadline						= false;				// true while a time budgeted search is running
+		bool											windowInKnotFrame				= false;				// true while a time budgeted search is running. alpha and beta are then negated for branches with another player to move.
+		std::chrono::steady_clock::time_point			deadline;												// point in time, when the time budgeted search must stop
+		std::atomic<bool>								deadlineReached					= false;				// set by the thread, which detected that the deadline has been reached
+		bool											deterministic					= false;				// same result on each call, independent of thread timing
+		std::unique_ptr<transpositionTable>				sharedTable;											// transposition table used by all threads of getBestChoice(), allocated on first use
+		const std::vector<stateAdressStruct>*			batchStates						= nullptr;				// states passed to getBestChoices()
+		const batchCallback*							batchResultCallback				= nullptr;				// callback passed to getBestChoices()
+		std::vector<size_t>								batchOrder;												// indices of batchStates sorted by layer and state number
+		std::atomic<size_t>								nextBatchItem					= 0;					// index into batchOrder of the next state, which is not taken by any thread yet
+		std::mutex										batchMutex;												// serializes the calls of batchResultCallback
 
 		bool											init							(unsigned int layerNumber);
+		bool											searchFixedDepth				(unsigned int& choice, stateInfo& infoAboutChoices, float& rootValue, float alpha, float beta);
+		bool											searchIterativeDeepening		(unsigned int& choice, stateInfo& infoAboutChoices);
+		bool											isSearchAborted					(runAlphaBetaVars& rabVars);
+		bool											searchRootBranch				(runAlphaBetaVars& rabVars, unsigned int index);
 		bool											run								(unsigned int layerNumber);
 		bool											letTheTreeGrow					(	   knotStruct& knot, 	   runAlphaBetaVars& rabVars, unsigned int tilLevel, float alpha, float beta);
 		bool											tryDataBase						(	   knotStruct& knot, const runAlphaBetaVars& rabVars, unsigned int tilLevel, unsigned int &layerNumber, unsigned int &stateNumber);
 		bool											tryPossibilities				(	   knotStruct& knot, 	   runAlphaBetaVars& rabVars, unsigned int tilLevel, unsigned int &maxWonfreqValuesSubMoves, float &alpha, float &beta);
 		bool											saveInDatabase					(const knotStruct& knot, 	   runAlphaBetaVars& rabVars, unsigned int layerNumber, unsigned int stateNumber);
+		bool											isMoveOrderingUseful			(unsigned int tilLevel);
+		unsigned int									selectBestBranch				(const std::vector<unsigned int>& bestBranches) const;
+		transpositionTable*								getSharedTable					();
 
 		// static thread functions
 		static DWORD									initThreadProc					(void* pParameter, int64_t index);		// used to initialize the database calculation
 		static DWORD									runThreadProc					(void* pParameter, int64_t index);		// used to run the database calculation
-		static DWORD									minMaxThreadProc				(void* pParameter, int64_t index);		// used to run the min-max calculation without database
+		static DWORD									batchThreadProc					(void* pParameter);						// used to search the states passed to getBestChoices() in parallel
 	};
 
 } // namespace alphaBeta
@@ -16,6 +16,7 @@ bool miniMax::alphaBeta::knotStruct::initForCalculation(knotStruct* branchArray)
 	if (branchArray == nullptr) return false;
 	
 	branches										= branchArray;
+	possibilityIds									= {};
 	numPossibilities								= 0;
 	bestMoveId										= 0;
 	plyInfo											= PLYINFO_VALUE_UNCALCULATED;
@@ -315,3 +316,32 @@ bool miniMax::alphaBeta::knotStruct::canCutOff(unsigned int curPoss, float & alp
 	}
 	return false;
 }
+
+//-----------------------------------------------------------------------------
+// Name: canCutOffInKnotFrame()
+// Desc: returns true if a cut off (ignoring further possible moves) can be used
+//		 In contrast to canCutOff() alpha and beta are the search window from the perspective of this knot,
+//		 as required by narrowed windows, which must be negated when passed to a branch with another player to move.
+//		 Required are: branches[curPoss].floatValue
+//					   branches[curPoss].shortValue
+//					   branches[curPoss].playerToMoveChanged
+//		 Output:	   alpha, numPossibilities
+//-----------------------------------------------------------------------------
+bool miniMax::alphaBeta::knotStruct::canCutOffInKnotFrame(unsigned int curPoss, float & alpha, float & beta)
+{
+	// invalid branches are ignored by calcKnotValue() as well
+	if (branches[curPoss].shortValue == SKV_VALUE_INVALID) {
+		return false;
+	}
+
+	// value of the branch from the perspective of this knot
+	float fv = (branches[curPoss].playerToMoveChanged ? -1.0f : 1.0f) * branches[curPoss].floatValue;
+
+	if (fv >= beta) {
+		numPossibilities = curPoss + 1;
+		return true;
+	} else if (fv > alpha) {
+		alpha = fv;
+	}
+	return false;
+}
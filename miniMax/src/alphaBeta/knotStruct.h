@@ -8,6 +8,8 @@
 
 #include "miniMax/src/typeDef.h"
 
+#include <span>
+
 namespace miniMax
 {
 
@@ -24,8 +26,9 @@ namespace alphaBeta
 		plyInfoVarType				plyInfo								= 0;						// number of moves till win/lost
 		knotStruct*					branches							= nullptr;					// pointer to branches, in sync with possibilityIds
 		unsigned int				freqValuesSubMoves[SKV_NUM_VALUES] 	= {0,0,0,0};				// number of branches leading to a state with a certain value, from the perspective of the current player
-		vector<unsigned int>		possibilityIds;													// filled by game->getPossibilities(); contains IDs for all possible moves, 
+		std::span<unsigned int>		possibilityIds;													// filled by game->getPossibilities(); contains IDs for all possible moves, 
 																									// while 'branches' points to the corresponding knotStructs for moves that are actually explored (may differ in size if cutoffs occur)
+																									// not owned by the knot. during the search it points into runAlphaBetaVars::possibilityArena.
 
 		bool                        initForCalculation                  (knotStruct* branchArray);
 		void						setInvalid							();
@@ -36,5 +39,6 @@ namespace alphaBeta
 		bool 						getInfoAboutChoices					(stateInfo& infoAboutChoices);
 		bool						increaseFreqValuesSubMoves			(unsigned int curPoss);
 		bool						canCutOff							(unsigned int curPoss, float& alpha, float& beta);
+		bool						canCutOffInKnotFrame				(unsigned int curPoss, float& alpha, float& beta);
 	};
 }}
@@ -0,0 +1,280 @@
+/*********************************************************************
+	moveOrdering.cpp
+ 	Copyright (c) Thomas Weber. All rights reserved.
+	Licensed under the MIT License.
+	https://github.com/madweasel/weaselLibrary
+\*********************************************************************/
+
+#include "moveOrdering.h"
+#include <algorithm>
+
+#pragma region searchStats
+//-----------------------------------------------------------------------------
+// Name: add()
+// Desc: Adds the node counters of another thread
+//-----------------------------------------------------------------------------
+void miniMax::alphaBeta::searchStats::add(const searchStats& other)
+{
+	numNodes				+= other.numNodes;
+	numLeafNodes			+= other.numLeafNodes;
+	numCutOffs				+= other.numCutOffs;
+	numFirstMoveCutOffs		+= other.numFirstMoveCutOffs;
+	numTranspositionHits	+= other.numTranspositionHits;
+}
+
+//-----------------------------------------------------------------------------
+// Name: reset()
+// Desc: Sets all counters to zero
+//-----------------------------------------------------------------------------
+void miniMax::alphaBeta::searchStats::reset()
+{
+	*this = searchStats{};
+}
+
+//-----------------------------------------------------------------------------
+// Name: getNodesPerSecond()
+// Desc: Number of visited knots per second of the whole search
+//-----------------------------------------------------------------------------
+double miniMax::alphaBeta::searchStats::getNodesPerSecond() const
+{
+	return (elapsedSeconds > 0) ? numNodes / elapsedSeconds : 0;
+}
+#pragma endregion
+
+#pragma region transpositionTable
+//-----------------------------------------------------------------------------
+// Name: transpositionTable()
+// Desc: Constructor. numEntries is rounded up to the next power of two.
+//-----------------------------------------------------------------------------
+miniMax::alphaBeta::transpositionTable::transpositionTable(unsigned int numEntries)
+{
+	this->numEntries = moveOrdering::roundUpToPowerOfTwo(numEntries);
+	entries = std::make_unique<entry[]>(this->numEntries);
+	clear();
+}
+
+//-----------------------------------------------------------------------------
+// Name: store()
+// Desc: Remembers the best move of a state. Existing entries are always replaced.
+//-----------------------------------------------------------------------------
+void miniMax::alphaBeta::transpositionTable::store(uint64_t positionKey, unsigned int possibilityId)
+{
+	entry& e = entries[positionKey & (numEntries - 1)];
+	e.data .store(possibilityId, 				std::memory_order_relaxed);
+	e.check.store(positionKey ^ possibilityId,	std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+// Name: lookUp()
+// Desc: Returns the stored best move or noMove. An entry being overwritten concurrently is regarded as missing.
+//-----------------------------------------------------------------------------
+unsigned int miniMax::alphaBeta::transpositionTable::lookUp(uint64_t positionKey) const
+{
+	const entry& e		= entries[positionKey & (numEntries - 1)];
+	uint64_t	 data	= e.data .load(std::memory_order_relaxed);
+	uint64_t	 check	= e.check.load(std::memory_order_relaxed);
+	return ((check ^ data) == positionKey) ? (unsigned int) data : noMove;
+}
+
+//-----------------------------------------------------------------------------
+// Name: clear()
+// Desc: Removes all entries. Must not be called while any thread uses the table.
+//-----------------------------------------------------------------------------
+void miniMax::alphaBeta::transpositionTable::clear()
+{
+	for (size_t i = 0; i < numEntries; i++) {
+		entries[i].data .store(noMove, 		std::memory_order_relaxed);
+		entries[i].check.store(0,			std::memory_order_relaxed);		// check ^ data only matches the key noMove, for which noMove is returned anyway
+	}
+}
+#pragma endregion
+
+#pragma region moveOrdering
+//-----------------------------------------------------------------------------
+// Name: moveOrdering()
+// Desc: Constructor. If sharedTable is not null, it is used instead of a transposition table of this thread.
+//-----------------------------------------------------------------------------
+miniMax::alphaBeta::moveOrdering::moveOrdering(unsigned int maxNumPlies, const settings& orderSettings, transpositionTable* sharedTable) :
+	orderSettings(orderSettings), sharedTable(sharedTable)
+{
+	if (orderSettings.useKillerMoves) {
+		killerMoves.resize((maxNumPlies + 1) * numKillerMoves, noMove);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name: isActive()
+// Desc: Returns true if any heuristic is enabled
+//-----------------------------------------------------------------------------
+bool miniMax::alphaBeta::moveOrdering::isActive() const
+{
+	return orderSettings.useTranspositionTable || orderSettings.useKillerMoves || orderSettings.useHistoryHeuristic || orderSettings.useGameHook;
+}
+
+//-----------------------------------------------------------------------------
+// Name: clear()
+// Desc: Forgets all stored killer moves, history scores and transposition entries
+//-----------------------------------------------------------------------------
+void miniMax::alphaBeta::moveOrdering::clear()
+{
+	std::fill(killerMoves.begin(), killerMoves.end(), noMove);
+	historyScores.clear();
+	ownTable.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Name: sortPossibilities()
+// Desc: Sorts possibilityIds in place. 'ply' is the distance to the root knot.
+//		 The sort is stable, so the order of the game is kept for moves without any information.
+//-----------------------------------------------------------------------------
+void miniMax::alphaBeta::moveOrdering::sortPossibilities(gameInterface& game, unsigned int threadNo, unsigned int ply, bool hasPositionKey, uint64_t positionKey, vector<unsigned int>& possibilityIds, searchStats& stats)
+{
+	// nothing to sort
+	if (possibilityIds.size() < 2) return;
+
+	// let the game do a domain specific pre-sorting
+	if (orderSettings.useGameHook) {
+		game.orderPossibilities(threadNo, possibilityIds);
+	}
+
+	// locals
+	unsigned int	ttMove			= (orderSettings.useTranspositionTable && hasPositionKey) ? lookUpBestMove(positionKey) : noMove;
+	unsigned int*	killers			= (orderSettings.useKillerMoves && (ply + 1) * numKillerMoves <= killerMoves.size()) ? &killerMoves[ply * numKillerMoves] : nullptr;
+	bool			anyScore		= false;
+
+	if (ttMove != noMove) stats.numTranspositionHits++;
+
+	// calc score of each move. the upper 32 bits contain the priority, the lower ones the history score.
+	sortBuffer.resize(possibilityIds.size());
+	for (size_t i = 0; i < possibilityIds.size(); i++) {
+		unsigned int	id			= possibilityIds[i];
+		uint64_t		priority	= 0;
+		uint64_t		history		= 0;
+
+		if (id == ttMove) {
+			priority = numKillerMoves + 1;
+		} else if (killers != nullptr) {
+			for (unsigned int slot = 0; slot < numKillerMoves; slot++) {
+				if (killers[slot] == id) {
+					priority = numKillerMoves - slot;
+					break;
+				}
+			}
+		}
+		if (orderSettings.useHistoryHeuristic && id < historyScores.size()) {
+			history = historyScores[id];
+		}
+		sortBuffer[i].first		= (priority << 32) | history;
+		sortBuffer[i].second	= id;
+		if (sortBuffer[i].first) anyScore = true;
+	}
+
+	// keep the order of the game if no information is available
+	if (!anyScore) return;
+
+	std::stable_sort(sortBuffer.begin(), sortBuffer.end(), [](const std::pair<uint64_t, unsigned int>& a, const std::pair<uint64_t, unsigned int>& b) {
+		return a.first > b.first;
+	});
+	for (size_t i = 0; i < possibilityIds.size(); i++) {
+		possibilityIds[i] = sortBuffer[i].second;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name: storeCutOff()
+// Desc: Called when 'possibilityId' caused a cut off at distance 'ply' from the root with 'tilLevel' remaining plies.
+//-----------------------------------------------------------------------------
+void miniMax::alphaBeta::moveOrdering::storeCutOff(unsigned int ply, unsigned int tilLevel, unsigned int possibilityId)
+{
+	// killer moves: most recent one in slot 0, no duplicates
+	if (orderSettings.useKillerMoves && (ply + 1) * numKillerMoves <= killerMoves.size()) {
+		unsigned int* killers = &killerMoves[ply * numKillerMoves];
+		if (killers[0] != possibilityId) {
+			for (unsigned int slot = numKillerMoves - 1; slot > 0; slot--) {
+				killers[slot] = killers[slot - 1];
+			}
+			killers[0] = possibilityId;
+		}
+	}
+
+	// history heuristic: cut offs close to the root are weighted higher
+	if (orderSettings.useHistoryHeuristic && possibilityId < maxHistoryId) {
+		if (possibilityId >= historyScores.size()) {
+			historyScores.resize(possibilityId + 1, 0);
+		}
+		uint64_t newScore = (uint64_t) historyScores[possibilityId] + (uint64_t) tilLevel * tilLevel;
+		historyScores[possibilityId] = (uint32_t) std::min<uint64_t>(newScore, 0xFFFFFFFF);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name: storeBestMove()
+// Desc: Remembers the best move of a state. Existing entries are always replaced.
+//-----------------------------------------------------------------------------
+void miniMax::alphaBeta::moveOrdering::storeBestMove(uint64_t positionKey, unsigned int possibilityId)
+{
+	if (!orderSettings.useTranspositionTable || orderSettings.numTranspositionEntries == 0) return;
+
+	// table shared by all threads
+	if (sharedTable != nullptr) {
+		sharedTable->store(positionKey, possibilityId);
+		return;
+	}
+
+	// allocate on first use, since many threads do not need the table at all. the size must be a power of two, since the key is masked.
+	if (ownTable.empty()) {
+		ownTable.resize(roundUpToPowerOfTwo(orderSettings.numTranspositionEntries));
+	}
+
+	transpositionEntry& entry	= ownTable[positionKey & (ownTable.size() - 1)];
+	entry.positionKey			= positionKey;
+	entry.bestMoveId			= possibilityId;
+}
+
+//-----------------------------------------------------------------------------
+// Name: lookUpBestMove()
+// Desc: Returns the stored best move or noMove
+//-----------------------------------------------------------------------------
+unsigned int miniMax::alphaBeta::moveOrdering::lookUpBestMove(uint64_t positionKey) const
+{
+	if (sharedTable != nullptr) return sharedTable->lookUp(positionKey);
+	if (ownTable.empty()) return noMove;
+
+	const transpositionEntry& entry = ownTable[positionKey & (ownTable.size() - 1)];
+	return (entry.positionKey == positionKey) ? entry.bestMoveId : noMove;
+}
+
+//-----------------------------------------------------------------------------
+// Name: roundUpToPowerOfTwo()
+// Desc: Returns the smallest power of two, which is not smaller than value. Returns one for zero.
+//-----------------------------------------------------------------------------
+size_t miniMax::alphaBeta::moveOrdering::roundUpToPowerOfTwo(size_t value)
+{
+	size_t result = 1;
+	while (result < value) result <<= 1;
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// Name: getBestBranch()
+// Desc: Returns the index of the branch with the highest float value from the perspective of the knot.
+//		 Required are: branches[i].floatValue
+//					   branches[i].playerToMoveChanged
+//					   numPossibilities
+//-----------------------------------------------------------------------------
+unsigned int miniMax::alphaBeta::moveOrdering::getBestBranch(const knotStruct& knot)
+{
+	unsigned int	bestBranch	= 0;
+	float			bestValue	= FPKV_INV_VALUE;
+
+	for (unsigned int curPoss = 0; curPoss < knot.numPossibilities; curPoss++) {
+		if (knot.branches[curPoss].shortValue == SKV_VALUE_INVALID) continue;
+		float fv = knot.branches[curPoss].playerToMoveChanged ? -knot.branches[curPoss].floatValue : knot.branches[curPoss].floatValue;
+		if (fv > bestValue) {
+			bestValue	= fv;
+			bestBranch	= curPoss;
+		}
+	}
+	return bestBranch;
+}
+#pragma endregion
@@ -0,0 +1,113 @@
+/*********************************************************************\
+	moveOrdering.h
+ 	Copyright (c) Thomas Weber. All rights reserved.
+	Licensed under the MIT License.
+	https://github.com/madweasel/weaselLibrary
+\*********************************************************************/
+#pragma once
+
+#include "miniMax/src/typeDef.h"
+#include "miniMax/src/alphaBeta/knotStruct.h"
+
+#include <vector>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+
+namespace miniMax
+{
+
+namespace alphaBeta
+{
+	// node counters of the alpha-beta search, summed up over all threads
+	struct searchStats
+	{
+		int64_t										numNodes						= 0;						// number of knots visited by letTheTreeGrow()
+		int64_t										numLeafNodes					= 0;						// number of knots evaluated at search depth zero
+		int64_t										numCutOffs						= 0;						// number of alpha-beta cut offs in tryPossibilities()
+		int64_t										numFirstMoveCutOffs				= 0;						// number of cut offs caused by the first explored move. high ratio means good move ordering.
+		int64_t										numTranspositionHits			= 0;						// number of knots where the transposition table supplied a best move
+		unsigned int								depthReached					= 0;						// search depth of the last completed iteration
+		double										elapsedSeconds					= 0;						// duration of the whole search
+
+		void										add								(const searchStats& other);
+		void										reset							();
+		double										getNodesPerSecond				() const;
+	};
+
+	// Maps a position key to the best move found so far. Can be shared by all threads without locks.
+	// Each entry stores the key xor'ed with the data, so that torn writes of concurrent threads are detected on reading.
+	class transpositionTable
+	{
+	public:
+		static constexpr unsigned int				noMove							= 0xFFFFFFFF;				// returned by lookUp() if the key is not stored
+
+													transpositionTable				(unsigned int numEntries);
+
+		void										store							(uint64_t positionKey, unsigned int possibilityId);
+		unsigned int								lookUp							(uint64_t positionKey) const;
+		void										clear							();
+		size_t										getNumEntries					() const { return numEntries; };
+
+	private:
+		struct entry
+		{
+			std::atomic<uint64_t>					check							= 0;						// positionKey ^ data
+			std::atomic<uint64_t>					data							= noMove;					// possibility id of the best move
+		};
+
+		size_t										numEntries						= 0;						// power of two
+		std::unique_ptr<entry[]>					entries;													// direct mapped
+	};
+
+	// Sorts the possibilities of a knot, so that alpha-beta cut offs happen as early as possible.
+	// The order is: best move of the transposition table, killer moves of the same ply, remaining moves by history score.
+	// Moves with equal score keep the order returned by the game (or by gameInterface::orderPossibilities()).
+	// Each thread owns its own instance. Only the optional shared transposition table is accessed by several threads.
+	class moveOrdering
+	{
+	public:
+		struct settings
+		{
+			bool									useTranspositionTable			= true;						// try the best move of a previous visit of the same state first
+			bool									useKillerMoves					= true;						// try moves first, which caused a cut off in a sibling knot at the same ply
+			bool									useHistoryHeuristic				= true;						// prefer moves which caused many cut offs anywhere in the tree
+			bool									useGameHook						= true;						// call gameInterface::orderPossibilities() before applying the heuristics
+			unsigned int							numTranspositionEntries			= 1 << 16;					// number of entries of the transposition table, rounded up to the next power of two
+		};
+
+													moveOrdering					(unsigned int maxNumPlies, const settings& orderSettings, transpositionTable* sharedTable = nullptr);
+
+		bool										isActive						() const;
+		void										sortPossibilities				(gameInterface& game, unsigned int threadNo, unsigned int ply, bool hasPositionKey, uint64_t positionKey, vector<unsigned int>& possibilityIds, searchStats& stats);
+		void										storeCutOff						(unsigned int ply, unsigned int tilLevel, unsigned int possibilityId);
+		void										storeBestMove					(uint64_t positionKey, unsigned int possibilityId);
+		void										clear							();
+
+		static unsigned int							getBestBranch					(const knotStruct& knot);
+		static size_t								roundUpToPowerOfTwo				(size_t value);
+
+	private:
+		static constexpr unsigned int				numKillerMoves					= 2;						// number of killer moves stored per ply
+		static constexpr unsigned int				maxHistoryId					= 1 << 20;					// possibility ids above this value are ignored by the history heuristic
+		static constexpr unsigned int				noMove							= 0xFFFFFFFF;				// marks an empty killer or transposition table slot
+
+		struct transpositionEntry
+		{
+			uint64_t								positionKey						= 0;						// key returned by gameInterface::getPositionKey()
+			unsigned int							bestMoveId						= noMove;					// possibility id of the best move found so far
+		};
+
+		settings									orderSettings;												// which heuristics are used
+		vector<unsigned int>						killerMoves;												// [ply * numKillerMoves + slot] possibility ids causing a cut off
+		vector<uint32_t>							historyScores;												// [possibilityId] accumulated score of cut offs
+		vector<transpositionEntry>					ownTable;													// direct mapped table of this thread, allocated on first use
+		transpositionTable*							sharedTable						= nullptr;					// if set, this table shared by all threads is used instead of ownTable
+		vector<std::pair<uint64_t, unsigned int>>	sortBuffer;													// (score, possibilityId), reused to avoid allocations
+
+		unsigned int								lookUpBestMove					(uint64_t positionKey) const;
+	};
+
+} // namespace alphaBeta
+
+} // namespace miniMax
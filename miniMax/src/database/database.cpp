@@ -94,8 +94,9 @@ bool miniMax::database::database::resizeSkv(layerStatsStruct& myLss, unsigned in
 	// check again if layer is already loaded, since another thread might have loaded it in the meantime
 	if (!myLss.isSkvResized) {
 
-		// reserve memory for this layer & create array for skv with default value
-		myLss.skv.resize((myLss.knotsInLayer + 3) / 4, SKV_WHOLE_BYTE_IS_INVALID);
+		// reserve memory for this layer & set default value. the pages are touched first by the threads processing them.
+		myLss.skv.resize((myLss.knotsInLayer + 3) / 4);
+		fillArray(myLss.skv.data(), myLss.skv.size(), (twoBit) SKV_WHOLE_BYTE_IS_INVALID);
 
 		// if layer is in database and completed, then load layer from file into memory, set default value otherwise
 		if (myLss.completedAndInFile) {
@@ -104,7 +105,7 @@ bool miniMax::database::database::resizeSkv(layerStatsStruct& myLss, unsigned in
 			}
 		}
 
-		if (!arrayInfos.addArray(layerNumber, arrayInfoStruct::arrayType::layerStats, myLss.skv.size() * sizeof(twoBit), 0)) {
+		if (!arrayInfos.addArray(layerNumber, arrayInfoStruct::arrayType::layerStats, myLss.skv.size() * sizeof(twoBit), 0, myLss.skv.data())) {
 			return log.log(logger::logLevel::error, L"ERROR: Adding array to arrayInfos failed!");
 		}
 
@@ -125,8 +126,9 @@ bool miniMax::database::database::resizePlyInfo(layerStatsStruct& myLss, unsigne
 	// check again if layer is already loaded, since another thread might have loaded it in the meantime
 	if (!myLss.isPlyInfoResized) {
 		
-		// reserve memory for this layer & create array for ply info with default value
-		myLss.plyInfo.resize(myLss.knotsInLayer, PLYINFO_VALUE_UNCALCULATED);	
+		// reserve memory for this layer & set default value. the pages are touched first by the threads processing them.
+		myLss.plyInfo.resize(myLss.knotsInLayer);
+		fillArray(myLss.plyInfo.data(), myLss.plyInfo.size(), (plyInfoVarType) PLYINFO_VALUE_UNCALCULATED);
 		
 		// if layer is in database and completed, then load layer from file into memory; set default value otherwise
 		if (myLss.completedAndInFile) {
@@ -136,7 +138,7 @@ bool miniMax::database::database::resizePlyInfo(layerStatsStruct& myLss, unsigne
 		}
 
 		// statistics
-		if (!arrayInfos.addArray(layerNumber, arrayInfoStruct::arrayType::plyInfos, myLss.plyInfo.size() * sizeof(plyInfoVarType), 0)) {
+		if (!arrayInfos.addArray(layerNumber, arrayInfoStruct::arrayType::plyInfos, myLss.plyInfo.size() * sizeof(plyInfoVarType), 0, myLss.plyInfo.data())) {
 			return log.log(logger::logLevel::error, L"ERROR: Adding array to arrayInfos failed!");
 		}
 
@@ -487,7 +489,8 @@ bool miniMax::database::database::readKnotValueFromDatabase(unsigned int layerNu
 
 	//  if database is complete get just single byte from file directly
 	if ((dbStats.completed || myLss.completedAndInFile) && !loadFullLayerOnRead) {
-		std::lock_guard<std::mutex> lock(csDatabaseMutex);
+		std::unique_lock<std::mutex> lock(csDatabaseMutex, std::defer_lock);
+		if (!file->allowsConcurrentReads()) lock.lock();
 		file->readSkv(layerNumber, databaseByte, stateNumber);
 	} else {
 
@@ -539,7 +542,8 @@ bool miniMax::database::database::readPlyInfoFromDatabase(unsigned int layerNumb
 
 	// if database is complete get whole byte from file
 	if ((dbStats.completed || myLss.completedAndInFile) && !loadFullLayerOnRead) {
-		std::lock_guard<std::mutex> lock(csDatabaseMutex);
+		std::unique_lock<std::mutex> lock(csDatabaseMutex, std::defer_lock);
+		if (!file->allowsConcurrentReads()) lock.lock();
 		file->readPlyInfo(layerNumber, value, stateNumber);
 	} else {
 
@@ -38,9 +38,11 @@ namespace database
 		// setter
 		bool						setAsComplete					();
 		bool 						setLoadingOfFullLayerOnRead		();
+		void						setThreadManager				(threadManagerClass* tm)	{ this->tm = tm; };
 		
 		// getter
 		bool						isOpen							()							{ return file ? file->isOpen() : false; };
+		bool						allowsConcurrentReads			()							{ return file && file->allowsConcurrentReads() && !loadFullLayerOnRead; };	// true if completed layers are read from the file by several threads at once
 		bool						isComplete						();
 		bool						isLayerCompleteAndInFile		(unsigned int layerNumber);
 		unsigned int				getNumberOfKnots				(unsigned int layerNumber);
@@ -71,11 +73,13 @@ namespace database
 		// functions
 		bool 						resizePlyInfo					(layerStatsStruct& myLss, unsigned int layerNumber);
 		bool 						resizeSkv						(layerStatsStruct& myLss, unsigned int layerNumber);
+		template <class T> void		fillArray						(T* data, size_t count, const T& value)	{ if (tm) tm->fillParallel(data, count, value); else std::fill(data, data + count, value); };
 
 		// general 
 		logger&						log;											// logger
 		gameInterface *				game							= nullptr;		// master class
 		genericFile *				file							= nullptr;		// file handler
+		threadManagerClass *		tm								= nullptr;		// threads filling the arrays, so that the pages are placed on their NUMA nodes. can be nullptr.
 		std::mutex 					csDatabaseMutex;								// mutex for I/O operations
 		databaseStatsStruct			dbStats;										// general information about the database
 		vector<layerStatsStruct>	layerStats;										// layer specific information 
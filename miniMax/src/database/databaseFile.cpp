@@ -167,7 +167,7 @@ bool miniMax::database::uncompFile::isOpen()
 // Desc: Read all short knot values from the database for a given layer.
 //		 The passed vector must have the correct size myLayerStats[layerNum].sizeInBytes, which can be 0.
 //-----------------------------------------------------------------------------
-bool miniMax::database::uncompFile::readSkv(unsigned int layerNum, vector<twoBit>& skv)
+bool miniMax::database::uncompFile::readSkv(unsigned int layerNum, skvArray& skv)
 {
 	if (layerNum >= myLayerStats.size()) return log.log(logger::logLevel::error, L"readSkv() failed. Layer number out of range.");
 	if (skv.size() != myLayerStats[layerNum].sizeInBytes) return log.log(logger::logLevel::error, L"readSkv() failed. Size of passed vector does not match size of layer.");
@@ -199,7 +199,7 @@ bool miniMax::database::uncompFile::readSkv(unsigned int layerNum, twoBit& datab
 // Desc: Write all short knot values to the database for a given layer. 
 //		 The passed vector must have the correct size myLayerStats[layerNum].sizeInBytes, which can be 0.
 //-----------------------------------------------------------------------------
-bool miniMax::database::uncompFile::writeSkv(unsigned int layerNum, const vector<twoBit>& skv)
+bool miniMax::database::uncompFile::writeSkv(unsigned int layerNum, const skvArray& skv)
 {
 	if (layerNum >= myLayerStats.size()) return log.log(logger::logLevel::error, L"writeSkv() failed. Layer number out of range.");
 	if (skv.size() != myLayerStats[layerNum].sizeInBytes) return log.log(logger::logLevel::error, L"writeSkv() failed. Size of passed vector does not match size of layer.");
@@ -215,7 +215,7 @@ bool miniMax::database::uncompFile::writeSkv(unsigned int layerNum, const vector
 // Desc: Read all ply information from the database for a given layer. 
 // 		 The passed vector must have the correct size plyInfos[layerNum].sizeInBytes, which can be 0.
 //-----------------------------------------------------------------------------
-bool miniMax::database::uncompFile::readPlyInfo(unsigned int layerNum, vector<plyInfoVarType>& plyInfo)
+bool miniMax::database::uncompFile::readPlyInfo(unsigned int layerNum, plyInfoArray& plyInfo)
 {
 	if (layerNum >= plyInfos.size()) return log.log(logger::logLevel::error, L"readPlyInfo() failed. Layer number out of range.");
 	if (plyInfo.size() != plyInfos[layerNum].knotsInLayer) return log.log(logger::logLevel::error, L"readPlyInfo() failed. Size of passed vector does not match size of layer.");
@@ -245,7 +245,7 @@ bool miniMax::database::uncompFile::readPlyInfo(unsigned int layerNum, plyInfoVa
 // Name: writePlyInfo()
 // Desc: Write all ply information to the database for a given layer.
 //-----------------------------------------------------------------------------
-bool miniMax::database::uncompFile::writePlyInfo(unsigned int layerNum, const vector<plyInfoVarType>& plyInfo)
+bool miniMax::database::uncompFile::writePlyInfo(unsigned int layerNum, const plyInfoArray& plyInfo)
 {
 	if (layerNum >= plyInfos.size()) return log.log(logger::logLevel::error, L"writePlyInfo() failed. Layer number out of range.");
 	if (plyInfo.size() != plyInfos[layerNum].knotsInLayer) return log.log(logger::logLevel::error, L"writePlyInfo() failed. Size of passed vector does not match size of layer.");
@@ -665,6 +665,9 @@ bool miniMax::database::uncompFile::skvFileLayerStruct::saveVectorToFile(HANDLE
 miniMax::database::compFile::compFile(gameInterface* game, logger& log) : genericFile{game, log}
 {
 	file.setBlockSize(blockSizeInBytes);
+	file.setSectionLib(L"skv",		skvComp);
+	file.setSectionLib(L"plyInfo",	plyInfoComp);
+	file.setBlockSizeCandidates({2500, 10000, 40000, 160000}, allowedSizeIncrease);
 }
 
 //-----------------------------------------------------------------------------
@@ -706,6 +709,7 @@ void miniMax::database::compFile::closeDatabase()
 	dbStatsCache.completed	= false;
 	dbStatsCache.numLayers	= 0;
 	layerStatsCache.clear();
+	layerInFile.clear();
 }
 
 //-----------------------------------------------------------------------------
@@ -738,8 +742,11 @@ void miniMax::database::compFile::updateCache(const databaseStatsStruct& dbStats
 {
 	dbStatsCache 	= dbStats;
 	layerStatsCache.resize(layerStats.size());
+	if (layerInFile.size() != layerStats.size()) {
+		layerInFile = vector<std::atomic<bool>>(layerStats.size());
+	}
 	for (size_t i=0; i<layerStats.size(); i++) {
-		layerStatsCache[i].completedAndInFile 	= layerStats[i].completedAndInFile;	
+		layerInFile[i].store(layerStats[i].completedAndInFile, std::memory_order_release);
 		layerStatsCache[i].partnerLayer		 	= layerStats[i].partnerLayer;		
 		layerStatsCache[i].knotsInLayer		 	= layerStats[i].knotsInLayer;		
 		layerStatsCache[i].numWonStates		 	= layerStats[i].numWonStates;		
@@ -856,11 +863,11 @@ bool miniMax::database::compFile::isOpen()
 // Name: readSkv()
 // Desc: 
 //-----------------------------------------------------------------------------
-bool miniMax::database::compFile::readSkv(unsigned int layerNum, vector<twoBit>& skv)
+bool miniMax::database::compFile::readSkv(unsigned int layerNum, skvArray& skv)
 {
 	if (!isOpen()) return log.log(logger::logLevel::error, L"Cannot read skv, since database is not open.");
 	if (layerNum >= layerStatsCache.size()) return log.log(logger::logLevel::error, L"Layer number out of range.");
-	if (!layerStatsCache[layerNum].completedAndInFile) return log.log(logger::logLevel::error, L"Layer is not in file.");
+	if (!layerInFile[layerNum].load(std::memory_order_acquire)) return log.log(logger::logLevel::error, L"Layer is not in file.");
 	if (skv.size() != layerStatsCache[layerNum].getLayerSizeInBytesForSkv()) return log.log(logger::logLevel::error, L"Size of passed vector does not match size of layer.");
 	if (!file.read(wstring(L"skv") + to_wstring(layerNum), 0, skv.size() * sizeof(twoBit), &skv[0])) return log.log(logger::logLevel::error, L"Failed to read skv.");
 	return true;
@@ -874,7 +881,7 @@ bool miniMax::database::compFile::readSkv(unsigned int layerNum, twoBit& databas
 {
 	if (!isOpen()) return log.log(logger::logLevel::error, L"Cannot read skv, since database is not open.");
 	if (layerNum >= layerStatsCache.size()) return log.log(logger::logLevel::error, L"Layer number out of range.");
-	if (!layerStatsCache[layerNum].completedAndInFile) return log.log(logger::logLevel::error, L"Layer is not in file.");
+	if (!layerInFile[layerNum].load(std::memory_order_acquire)) return log.log(logger::logLevel::error, L"Layer is not in file.");
 	if (stateNumber >= layerStatsCache[layerNum].knotsInLayer) return log.log(logger::logLevel::error, L"State number out of range.");
 	if (!file.read(wstring(L"skv") + to_wstring(layerNum), (stateNumber/4) * sizeof(twoBit), 1, &databaseByte)) return log.log(logger::logLevel::error, L"Failed to read skv.");
 	return true;
@@ -884,13 +891,15 @@ bool miniMax::database::compFile::readSkv(unsigned int layerNum, twoBit& databas
 // Name: writeSkv()
 // Desc: 
 //-----------------------------------------------------------------------------
-bool miniMax::database::compFile::writeSkv(unsigned int layerNum, const vector<twoBit>& skv)
+bool miniMax::database::compFile::writeSkv(unsigned int layerNum, const skvArray& skv)
 {
 	if (!isOpen()) return log.log(logger::logLevel::error, L"Cannot read skv, since database is not open.");
 	if (layerNum >= layerStatsCache.size()) return log.log(logger::logLevel::error, L"Layer number out of range.");
 	if (skv.size() != layerStatsCache[layerNum].getLayerSizeInBytesForSkv()) return log.log(logger::logLevel::error, L"Size of passed vector does not match size of layer.");
-	if (!file.write(wstring(L"skv") + to_wstring(layerNum), 0, skv.size() * sizeof(twoBit), &skv[0])) return log.log(logger::logLevel::error, L"Failed to write skv.");
-	layerStatsCache[layerNum].completedAndInFile = true;
+	if (!file.beginSection(wstring(L"skv") + to_wstring(layerNum))) return log.log(logger::logLevel::error, L"Failed to write skv.");
+	if (!file.append(skv.size() * sizeof(twoBit), &skv[0]))		return log.log(logger::logLevel::error, L"Failed to write skv.");
+	if (!file.endSection())										return log.log(logger::logLevel::error, L"Failed to write skv.");
+	layerInFile[layerNum].store(true, std::memory_order_release);
 	return true;
 }
 
@@ -898,11 +907,11 @@ bool miniMax::database::compFile::writeSkv(unsigned int layerNum, const vector<t
 // Name: readPlyInfo()
 // Desc: 
 //-----------------------------------------------------------------------------
-bool miniMax::database::compFile::readPlyInfo(unsigned int layerNum, vector<plyInfoVarType>& plyInfo)
+bool miniMax::database::compFile::readPlyInfo(unsigned int layerNum, plyInfoArray& plyInfo)
 {
 	if (!isOpen()) return log.log(logger::logLevel::error, L"Cannot read skv, since database is not open.");
 	if (layerNum >= layerStatsCache.size()) return log.log(logger::logLevel::error, L"Layer number out of range.");
-	if (!layerStatsCache[layerNum].completedAndInFile) return log.log(logger::logLevel::error, L"Layer is not in file.");
+	if (!layerInFile[layerNum].load(std::memory_order_acquire)) return log.log(logger::logLevel::error, L"Layer is not in file.");
 	if (plyInfo.size() != layerStatsCache[layerNum].knotsInLayer) return log.log(logger::logLevel::error, L"Size of passed vector does not match size of layer.");
 	if (!file.read(wstring(L"plyInfo") + to_wstring(layerNum), 0, plyInfo.size() * sizeof(plyInfoVarType), &plyInfo[0])) return log.log(logger::logLevel::error, L"Failed to read ply info.");
 	return true;
@@ -916,7 +925,7 @@ bool miniMax::database::compFile::readPlyInfo(unsigned int layerNum, plyInfoVarT
 {
 	if (!isOpen()) return log.log(logger::logLevel::error, L"Cannot read skv, since database is not open.");
 	if (layerNum >= layerStatsCache.size()) return log.log(logger::logLevel::error, L"Layer number out of range.");
-	if (!layerStatsCache[layerNum].completedAndInFile) return log.log(logger::logLevel::error, L"Layer is not in file.");
+	if (!layerInFile[layerNum].load(std::memory_order_acquire)) return log.log(logger::logLevel::error, L"Layer is not in file.");
 	if (stateNumber >= layerStatsCache[layerNum].knotsInLayer) return log.log(logger::logLevel::error, L"State number out of range.");
 	if (!file.read(wstring(L"plyInfo") + to_wstring(layerNum), stateNumber * sizeof(plyInfoVarType), sizeof(plyInfoVarType), &singlePlyInfo)) return log.log(logger::logLevel::error, L"Failed to read ply info.");
 	return true;
@@ -926,14 +935,16 @@ bool miniMax::database::compFile::readPlyInfo(unsigned int layerNum, plyInfoVarT
 // Name: writePlyInfo()
 // Desc: 
 //-----------------------------------------------------------------------------
-bool miniMax::database::compFile::writePlyInfo(unsigned int layerNum, const vector<plyInfoVarType>& plyInfo)
+bool miniMax::database::compFile::writePlyInfo(unsigned int layerNum, const plyInfoArray& plyInfo)
 {
 	if (!isOpen()) return log.log(logger::logLevel::error, L"Cannot read skv, since database is not open.");
 	if (layerNum >= layerStatsCache.size()) return log.log(logger::logLevel::error, L"Layer number out of range.");
-	if (!layerStatsCache[layerNum].completedAndInFile) return log.log(logger::logLevel::error, L"Layer is not in file.");
+	if (!layerInFile[layerNum].load(std::memory_order_acquire)) return log.log(logger::logLevel::error, L"Layer is not in file.");
 	if (plyInfo.size() != layerStatsCache[layerNum].knotsInLayer) return log.log(logger::logLevel::error, L"Size of passed vector does not match size of layer.");
-	if (!file.write(wstring(L"plyInfo") + to_wstring(layerNum), 0, plyInfo.size() * sizeof(plyInfoVarType), &plyInfo[0])) return log.log(logger::logLevel::error, L"Failed to write ply info.");
-	layerStatsCache[layerNum].completedAndInFile = true;
+	if (!file.beginSection(wstring(L"plyInfo") + to_wstring(layerNum)))		return log.log(logger::logLevel::error, L"Failed to write ply info.");
+	if (!file.append(plyInfo.size() * sizeof(plyInfoVarType), &plyInfo[0]))	return log.log(logger::logLevel::error, L"Failed to write ply info.");
+	if (!file.endSection())													return log.log(logger::logLevel::error, L"Failed to write ply info.");
+	layerInFile[layerNum].store(true, std::memory_order_release);
 	return true;
 }
 #pragma endregion
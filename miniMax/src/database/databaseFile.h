@@ -8,8 +8,11 @@
 
 #include <vector>
 #include <functional>
+#include <atomic>
 
 #include "compressor/src/compLib_winCompApi.h"
+#include "compressor/src/compLib_skvRans.h"
+#include "compressor/src/compLib_plyInfoDelta.h"
 #include "weaselEssentials/src/logger.h"
 #include "databaseTypes.h"
 
@@ -32,7 +35,8 @@ namespace database
 	// Writing is supposed for one whole layer at a time. Reading is supposed for one whole layer at a time or for one state of a layer.
 	// All reading/writing operations are directly accessing the database files.
 	// The database files are opened and closed by the functions openDatabase() and closeDatabase(), prior to and after reading/writing.
-	// Thread safety: The database files are NOT thread safe.
+	// Thread safety: The database files are NOT thread safe, unless allowsConcurrentReads() returns true.
+	//                Then single states may be read by several threads at once, as long as no other thread writes.
 	class genericFile
 	{
 	public:
@@ -40,14 +44,15 @@ namespace database
 		virtual void					closeDatabase					()																						{};
 		virtual bool					removeFile						(wstring const &fileDirectory = L"")													{ return false; };
 		virtual bool					isOpen							()																						{ return false; };
+		virtual bool					allowsConcurrentReads			()																						{ return false; };
 		virtual bool 					loadHeader						(databaseStatsStruct& dbStats, vector<layerStatsStruct>& layerStats)					{ return false; };
 		virtual bool					saveHeader						(const databaseStatsStruct& dbStats, const vector<layerStatsStruct>& layerStats)		{ return false; };
-		virtual bool					readSkv							(unsigned int layerNum, vector<twoBit>& skv)											{ return false; };
+		virtual bool					readSkv							(unsigned int layerNum, skvArray& skv)													{ return false; };
 		virtual bool					readSkv							(unsigned int layerNum, twoBit& databaseByte, unsigned int stateNumber)					{ return false; };
-		virtual bool					writeSkv						(unsigned int layerNum, const vector<twoBit>& skv)										{ return false; };
-		virtual bool					readPlyInfo						(unsigned int layerNum, vector<plyInfoVarType>& plyInfo)								{ return false; };
+		virtual bool					writeSkv						(unsigned int layerNum, const skvArray& skv)											{ return false; };
+		virtual bool					readPlyInfo						(unsigned int layerNum, plyInfoArray& plyInfo)											{ return false; };
 		virtual bool					readPlyInfo						(unsigned int layerNum, plyInfoVarType& singlePlyInfo, unsigned int stateNumber)		{ return false; };
-		virtual bool					writePlyInfo					(unsigned int layerNum, const vector<plyInfoVarType>& plyInfo)							{ return false; };
+		virtual bool					writePlyInfo					(unsigned int layerNum, const plyInfoArray& plyInfo)									{ return false; };
 		virtual							~genericFile					()																						{ closeDatabase(); };
 		wstring							getFileDirectory				()																						{ return fileDirectory; };
 
@@ -72,12 +77,12 @@ namespace database
 		bool 							loadHeader						(databaseStatsStruct& dbStats, vector<layerStatsStruct>& layerStats)				override;
 		bool							saveHeader						(const databaseStatsStruct& dbStats, const vector<layerStatsStruct>& layerStats)	override;
 		bool							isOpen							()																					override;
-		bool							readSkv							(unsigned int layerNum, vector<twoBit>& skv)										override;
+		bool							readSkv							(unsigned int layerNum, skvArray& skv)												override;
 		bool							readSkv							(unsigned int layerNum, twoBit& databaseByte, unsigned int stateNumber)				override;
-		bool							writeSkv						(unsigned int layerNum, const vector<twoBit>& skv)									override;
-		bool							readPlyInfo						(unsigned int layerNum, vector<plyInfoVarType>& plyInfo)							override;
+		bool							writeSkv						(unsigned int layerNum, const skvArray& skv)										override;
+		bool							readPlyInfo						(unsigned int layerNum, plyInfoArray& plyInfo)										override;
 		bool							readPlyInfo						(unsigned int layerNum, plyInfoVarType& singlePlyInfo, unsigned int stateNumber)	override;
-		bool							writePlyInfo					(unsigned int layerNum, const vector<plyInfoVarType>& plyInfo)						override;
+		bool							writePlyInfo					(unsigned int layerNum, const plyInfoArray& plyInfo)								override;
 
 	private:
 		struct skvFileHeaderStruct																	// header of the short knot value file
@@ -143,6 +148,7 @@ namespace database
 	};
 
     // Compressed database file, to spare disk space during usage. The database is converted to this format after calculation.
+	// Concurrent reads are allowed even while a layer is written, since the compressed file guards its list of sections.
 	class compFile : public genericFile
 	{
 	public:
@@ -153,22 +159,27 @@ namespace database
 		bool 							loadHeader						(databaseStatsStruct& dbStats, vector<layerStatsStruct>& layerStats)				override;
 		bool							saveHeader						(const databaseStatsStruct& dbStats, const vector<layerStatsStruct>& layerStats)	override;
 		bool							isOpen							()																					override;
-		bool							readSkv							(unsigned int layerNum, vector<twoBit>& skv)										override;
+		bool							allowsConcurrentReads			()																					override	{ return true; };
+		bool							readSkv							(unsigned int layerNum, skvArray& skv)												override;
 		bool							readSkv							(unsigned int layerNum, twoBit& databaseByte, unsigned int stateNumber)				override;
-		bool							writeSkv						(unsigned int layerNum, const vector<twoBit>& skv)									override;
-		bool							readPlyInfo						(unsigned int layerNum, vector<plyInfoVarType>& plyInfo)							override;
+		bool							writeSkv						(unsigned int layerNum, const skvArray& skv)										override;
+		bool							readPlyInfo						(unsigned int layerNum, plyInfoArray& plyInfo)										override;
 		bool							readPlyInfo						(unsigned int layerNum, plyInfoVarType& singlePlyInfo, unsigned int stateNumber)	override;
-		bool							writePlyInfo					(unsigned int layerNum, const vector<plyInfoVarType>& plyInfo)						override;
+		bool							writePlyInfo					(unsigned int layerNum, const plyInfoArray& plyInfo)								override;
 
 	private:	
-		static constexpr unsigned int 	blockSizeInBytes				= 10000;		// size of one block in bytes. each section is stored in blocks of this fixed size. this enables random read access.
+		static constexpr unsigned int 	blockSizeInBytes				= 10000;		// size of the blocks of the header. each section is stored in blocks of a fixed size. this enables random read access.
+		static constexpr double			allowedSizeIncrease				= 0.1;			// the block size of the skv and ply info sections is the smallest one, which increases the compressed size by at most 10 %
 
-		compressor::winCompApi			comp;											// compression algorithmn
+		compressor::winCompApi			comp;											// compression algorithmn, used for the header
+		compressor::skvRans				skvComp;										// compression algorithmn for the short knot values
+		compressor::plyInfoDelta		plyInfoComp{{PLYINFO_VALUE_DRAWN, PLYINFO_VALUE_UNCALCULATED, PLYINFO_VALUE_INVALID}};	// compression algorithmn for the ply infos
 		compressor::file				file{comp};										// compressed database file
 		wstring							fileName;										// name of the database file
 		bool							fileOpened						= false;		// true if the database file is open
 		databaseStatsStruct 			dbStatsCache;									// own copy of the database stats, used when reading/writing the database. updated when the header is loaded/written.
 		vector<layerStatsStruct> 		layerStatsCache;								// own copy of the layer stats, used when reading/writing the database. updated when the header is loaded/written.
+		vector<std::atomic<bool>>		layerInFile;									// [layerNum] true if the layer was written. atomic, since readers do not lock the database while a layer is written.
 
 		bool							readSection						(const wstring& key, vector<unsigned int>& buffer);
 		void							updateFileName					();
@@ -66,8 +66,9 @@ void miniMax::database::speedometer::measureIops()
 //		 Type must be valid
 //		 If the array already exists, the function returns false
 // 		 If the array is added, the function returns true
+//		 If data is passed, the placement of its pages on the NUMA nodes is determined
 //-----------------------------------------------------------------------------
-bool miniMax::database::arrayInfoContainer::addArray(unsigned int layerNumber, arrayInfoStruct::arrayType type, long long size, long long compressedSize)
+bool miniMax::database::arrayInfoContainer::addArray(unsigned int layerNumber, arrayInfoStruct::arrayType type, long long size, long long compressedSize, const void* data)
 {
 	// checks
 	if (!size) return false;
@@ -93,6 +94,9 @@ bool miniMax::database::arrayInfoContainer::addArray(unsigned int layerNumber, a
 	ais.compressedSizeInBytes	= compressedSize;
 	ais.sizeInBytes				= size;
 	ais.type					= type;
+	if (data != nullptr) {
+		ais.bytesPerNumaNode	= threadManagerClass::getBytesPerNumaNode(data, (size_t) size);
+	}
 	listArrays.push_back(ais);
 
 	// notify change
@@ -108,7 +112,7 @@ bool miniMax::database::arrayInfoContainer::addArray(unsigned int layerNumber, a
 	memoryUsed += size;
 	
 	// update GUI
-	log.log(logger::logLevel::trace, L"Allocated " + to_wstring(size) + L" bytes in memory for array type " + ais.getArrTypeName() + L" of layer " + to_wstring(layerNumber));
+	log.log(logger::logLevel::trace, L"Allocated " + to_wstring(size) + L" bytes in memory for array type " + ais.getArrTypeName() + L" of layer " + to_wstring(layerNumber) + ais.getNumaPlacement());
 
 	return true;
 }
@@ -130,6 +134,23 @@ const std::wstring miniMax::database::arrayInfoStruct::getArrTypeName()
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Name: getNumaPlacement()
+// Desc: Returns the share of the array on each NUMA node, e.g. " (node 0: 50%, node 1: 50%)". 
+//		 Returns an empty string if there is only one node or the placement is unknown.
+//-----------------------------------------------------------------------------
+const std::wstring miniMax::database::arrayInfoStruct::getNumaPlacement()
+{
+	if (bytesPerNumaNode.size() < 2 || sizeInBytes == 0) return L"";
+
+	std::wstring placement = L" (";
+	for (size_t node = 0; node < bytesPerNumaNode.size(); node++) {
+		if (node) placement += L", ";
+		placement += L"node " + to_wstring(node) + L": " + to_wstring(bytesPerNumaNode[node] * 100 / sizeInBytes) + L"%";
+	}
+	return placement + L")";
+}
+
 //-----------------------------------------------------------------------------
 // Name: arrayInfoContainer::removeArray()
 // Desc: Remove an array from the database
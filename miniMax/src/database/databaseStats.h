@@ -14,6 +14,7 @@
 #include <windows.h>
 
 #include "weaselEssentials/src/logger.h"
+#include "weaselEssentials/src/threadManager.h"
 
 namespace miniMax
 {
@@ -52,8 +53,10 @@ namespace database
 		long long					sizeInBytes					= 0;					// Size of the array in bytes
 		long long					compressedSizeInBytes		= 0;					// Size of the array in bytes after compression
 		unsigned int				belongsToLayer				= 0;					// Layer number the array belongs to
+		vector<long long>			bytesPerNumaNode;									// Estimated number of bytes located on each NUMA node. Empty if unknown.
 
 		const std::wstring 			getArrTypeName				();
+		const std::wstring 			getNumaPlacement			();
 	};
 
 	// Helper structure to update the GUI
@@ -87,7 +90,7 @@ namespace database
 									arrayInfoContainer				(logger& log) : log(log) {};
 									~arrayInfoContainer				() {};
 
-		bool						addArray						(unsigned int layerNumber, arrayInfoStruct::arrayType type, long long size, long long compressedSize);
+		bool						addArray						(unsigned int layerNumber, arrayInfoStruct::arrayType type, long long size, long long compressedSize, const void* data = nullptr);
 		bool						removeArray						(unsigned int layerNumber, arrayInfoStruct::arrayType type, long long size, long long compressedSize);
 
 		void						init							(unsigned int numLayers);
@@ -10,6 +10,7 @@
 #include <shared_mutex>
 
 #include "../typeDef.h"
+#include "weaselEssentials/src/threadManager.h"
 
 namespace miniMax
 {
@@ -18,6 +19,10 @@ namespace database
 {
     using namespace std;
 
+	// the big arrays are not initialized on allocation, so that they can be filled in parallel by the threads working on them
+	using skvArray			= vector<twoBit,         defaultInitAllocator<twoBit>>;
+	using plyInfoArray		= vector<plyInfoVarType, defaultInitAllocator<plyInfoVarType>>;
+
 	// basic information about the database
 	struct databaseStatsStruct
 	{
@@ -42,8 +47,8 @@ namespace database
 
 		vector<unsigned int>		partnerLayers;												// layer id relevant when switching current and opponent player
 		vector<unsigned int>		succLayers;													// array containing the layer ids of the succeding layers
-		vector<twoBit>				skv;														// array of size [(knotsInLayer + 3) / 4] containing the short knot values
-		vector<plyInfoVarType>		plyInfo;													// array of size [knotsInLayer] containing the ply info for each knot in this layer
+		skvArray					skv;														// array of size [(knotsInLayer + 3) / 4] containing the short knot values
+		plyInfoArray				plyInfo;													// array of size [knotsInLayer] containing the ply info for each knot in this layer
 		bool 						isPlyInfoResized 				= false;					// true if the ply info array has been resized. this is needed for the ply info array to be resized in the database file
 		bool						isSkvResized					= false;					// true if the skv array has been resized. this is needed for the skv array to be resized in the database file
 
@@ -144,10 +144,10 @@ bool dbCompTrans::checkIfEqual(wstring const& fromFilepath, wstring const& toFil
 		readFromFileAndCalcCheckSum(fileB, layerNum, layerStatsB, checkSumSkvB, checkSumPlyInfoB);
 
 		// free memory
-		vector<twoBit        >().swap( layerStatsA[layerNum].skv     );
-		vector<plyInfoVarType>().swap( layerStatsA[layerNum].plyInfo );
-		vector<twoBit        >().swap( layerStatsB[layerNum].skv     );
-		vector<plyInfoVarType>().swap( layerStatsB[layerNum].plyInfo );
+		database::skvArray    ().swap( layerStatsA[layerNum].skv     );
+		database::plyInfoArray().swap( layerStatsA[layerNum].plyInfo );
+		database::skvArray    ().swap( layerStatsB[layerNum].skv     );
+		database::plyInfoArray().swap( layerStatsB[layerNum].plyInfo );
 
 		// compare checksums
 		if (checkSumSkvA	 != checkSumSkvB    ) return printError(wstring(L"ERROR: Short knot value of layer ") + to_wstring(layerNum) + wstring(L" differ!"));
@@ -241,8 +241,8 @@ bool dbCompTrans::transferDataBase(wstring const& fromFilepath, wstring const& t
 		fileTo  .writePlyInfo(layerNum, layerStats[layerNum].plyInfo);
 
 		// free memory
-		vector<twoBit        >().swap( layerStats[layerNum].skv     );
-		vector<plyInfoVarType>().swap( layerStats[layerNum].plyInfo );
+		database::skvArray    ().swap( layerStats[layerNum].skv     );
+		database::plyInfoArray().swap( layerStats[layerNum].plyInfo );
 	}
 
 	// save the header
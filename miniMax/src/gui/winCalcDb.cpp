@@ -169,7 +169,8 @@ bool miniMaxWinCalcDb::createControls()
 	rcCol = {0, 0,  40, 20};	hListViewArray	.insertColumn_plainButton2D(0, wstring(L"layer"				), hFontOutputBox,  40,    0, 0.5f, rcCol, buttonImagesVoid, 0);
 	rcCol = {0, 0, 120, 20};	hListViewArray	.insertColumn_plainButton2D(1, wstring(L"type"				), hFontOutputBox, 120,    0, 0.5f, rcCol, buttonImagesVoid, 0);
 	rcCol = {0, 0, 120, 20};	hListViewArray	.insertColumn_plainButton2D(2, wstring(L"size in bytes"		), hFontOutputBox, 120,    0, 0.5f, rcCol, buttonImagesVoid, 0);
-	rcCol = {0, 0, 120, 20};	hListViewArray	.insertColumn_plainButton2D(3, wstring(L"compression ratio"	), hFontOutputBox, 120,    0, 0.5f, rcCol, buttonImagesVoid, 1);
+	rcCol = {0, 0, 120, 20};	hListViewArray	.insertColumn_plainButton2D(3, wstring(L"compression ratio"	), hFontOutputBox, 120,    0, 0.5f, rcCol, buttonImagesVoid, 0);
+	rcCol = {0, 0, 120, 20};	hListViewArray	.insertColumn_plainButton2D(4, wstring(L"NUMA nodes"		), hFontOutputBox, 120,    0, 0.5f, rcCol, buttonImagesVoid, 1);
 	
 	// alignment
 	hButtonCalcContinue			.setAlignment(amCalcButtons, 0);	
@@ -605,6 +606,15 @@ void miniMaxWinCalcDb::updateListItemArray(database::arrayInfoChange infoChange)
 			wssTmp << infoChange.arrayInfo->compressedSizeInBytes;
 		}
 		hListViewArray.setItemText(hListViewArray.getItemIndex(infoChange.itemIndex, 3), 0, wssTmp.str().c_str());
+		wssTmp.str(L"");
+		if (infoChange.arrayInfo->bytesPerNumaNode.empty()) {
+			wssTmp << "-";
+		} else {
+			for (size_t node = 0; node < infoChange.arrayInfo->bytesPerNumaNode.size(); node++) {
+				wssTmp << (node ? " / " : "") << infoChange.arrayInfo->bytesPerNumaNode[node];
+			}
+		}
+		hListViewArray.setItemText(hListViewArray.getItemIndex(infoChange.itemIndex, 4), 0, wssTmp.str().c_str());
 	}
 }
 #pragma endregion
@@ -25,6 +25,7 @@ miniMax::miniMax::miniMax(gameInterface* game, unsigned int maxAlphaBetaSearchDe
 	// init default values
 	curCalculatedLayer			= 0;
 	abSolver.setSearchDepth(maxAlphaBetaSearchDepth);
+	db.setThreadManager(&threadManager);
 
 	InitializeCriticalSection(&csOsPrint);
 	srand((unsigned int)time(NULL));
@@ -55,6 +56,42 @@ void miniMax::miniMax::setSearchDepth(unsigned int maxAlphaBetaSearchDepth)
 	abSolver.setSearchDepth(maxAlphaBetaSearchDepth);
 }
 
+//-----------------------------------------------------------------------------
+// Name: setMoveOrdering()
+// Desc: Selects the heuristics used by the alpha-beta search to sort the possibilities.
+//-----------------------------------------------------------------------------
+void miniMax::miniMax::setMoveOrdering(const alphaBeta::moveOrdering::settings& orderSettings)
+{
+	abSolver.setMoveOrdering(orderSettings);
+}
+
+//-----------------------------------------------------------------------------
+// Name: setTimeBudget()
+// Desc: If milliseconds is non-zero, getBestChoice() uses iterative deepening and returns the best choice of the last depth completed in time.
+//-----------------------------------------------------------------------------
+void miniMax::miniMax::setTimeBudget(unsigned int milliseconds, float aspirationWindow)
+{
+	abSolver.setTimeBudget(milliseconds, aspirationWindow);
+}
+
+//-----------------------------------------------------------------------------
+// Name: setDeterministic()
+// Desc: If enabled, getBestChoice() returns the same choice on each call, independent of the number of threads.
+//-----------------------------------------------------------------------------
+void miniMax::miniMax::setDeterministic(bool enabled)
+{
+	abSolver.setDeterministic(enabled);
+}
+
+//-----------------------------------------------------------------------------
+// Name: getSearchStats()
+// Desc: Node counters, reached depth and duration of the last call of getBestChoice().
+//-----------------------------------------------------------------------------
+const miniMax::alphaBeta::searchStats& miniMax::miniMax::getSearchStats() const
+{
+	return abSolver.getSearchStats();
+}
+
 //-----------------------------------------------------------------------------
 // Name: getBestChoice()
 // Desc: Returns the best choice if the database has been opened and calculates the best choice for that if database is not open.
@@ -65,6 +102,15 @@ bool miniMax::miniMax::getBestChoice(unsigned int& choice, stateInfo& infoAboutC
 	return abSolver.getBestChoice(choice, infoAboutChoices);
 }
 
+//-----------------------------------------------------------------------------
+// Name: getBestChoices()
+// Desc: Returns the best choice of many states at once. onResult is called for each state as soon as it is calculated.
+//-----------------------------------------------------------------------------
+bool miniMax::miniMax::getBestChoices(const vector<stateAdressStruct>& states, const alphaBeta::solver::batchCallback& onResult)
+{
+	return abSolver.getBestChoices(states, onResult);
+}
+
 //-----------------------------------------------------------------------------
 // Name: calculateDatabase()
 // Desc: Calculates the database, which must be already open.
@@ -180,13 +226,25 @@ bool miniMax::miniMax::calculateStatistics()
 //-----------------------------------------------------------------------------
 bool miniMax::miniMax::calcLayer(unsigned int layerNumber)
 {
+	// locals
+	bool		useRetroAnalysis	= game->shallRetroAnalysisBeUsed(layerNumber);
+	int64_t		numKnots			= 0;
+	bool		success;
+
+	for (auto layer : layersToCalculate) {
+		numKnots += db.getNumberOfKnots(layer);
+	}
+
 	// moves can be done reverse, leading to too depth searching trees
-	if (game->shallRetroAnalysisBeUsed(layerNumber)) {
-		if (!rtSolver.calcKnotValuesByRetroAnalysis(layersToCalculate)) return false;
+	threadManager.beginPhase(useRetroAnalysis ? L"retroAnalysis" : L"alphaBeta", numKnots);
+	if (useRetroAnalysis) {
+		success = rtSolver.calcKnotValuesByRetroAnalysis(layersToCalculate);
 	// use minimax-algorithm
 	} else {
-		if (!abSolver.calcKnotValuesByAlphaBeta(layersToCalculate)) return false;
+		success = abSolver.calcKnotValuesByAlphaBeta(layersToCalculate);
 	}
+	threadManager.endPhase(numKnots);
+	if (!success) return false;
 
 	// save layers
 	for (auto layer : layersToCalculate) {
@@ -194,11 +252,19 @@ bool miniMax::miniMax::calcLayer(unsigned int layerNumber)
 	}
 
 	// test layers
+	threadManager.beginPhase(L"testLayer", numKnots);
 	for (auto layer : layersToCalculate) {
 		if (!checker.testLayer(layer)) {
+			threadManager.endPhase(0);
 			return log.log(logger::logLevel::error, L"ERROR: Layer calculation cancelled or failed!");
 		}
 	}
+	threadManager.endPhase(numKnots);
+
+	// remember the thread counts found so far for the next run
+	if (threadManager.isAutoTuningEnabled()) {
+		threadManager.getTuner().save(getThreadTuningFilePath());
+	}
 
 	// update output information
 	EnterCriticalSection(&csOsPrint);
@@ -283,7 +349,24 @@ bool miniMax::miniMax::openDatabase(wstring const& directory, bool useCompFileIf
 	if (db.isOpen()) {
 		return log.log(logger::logLevel::trace, L"Database already open!");
 	}
-	return db.openDatabase(fileDirectory, useCompFileIfBothExist);
+	if (!db.openDatabase(fileDirectory, useCompFileIfBothExist)) {
+		return false;
+	}
+
+	// thread counts tuned in a previous run
+	if (threadManager.isAutoTuningEnabled()) {
+		threadManager.getTuner().load(getThreadTuningFilePath());
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: getThreadTuningFilePath()
+// Desc: File in the database directory containing the number of threads chosen for each phase.
+//-----------------------------------------------------------------------------
+wstring miniMax::miniMax::getThreadTuningFilePath()
+{
+	return fileDirectory + L"\\threadTuning.txt";
 }
 
 //-----------------------------------------------------------------------------
@@ -304,6 +387,39 @@ bool miniMax::miniMax::setNumThreads(unsigned int numThreads)
 	return threadManager.setNumThreads(numThreads);
 }
 
+//-----------------------------------------------------------------------------
+// Name: setThreadPinning()
+// Desc: Pins the worker threads node by node to the processors of the NUMA nodes
+//-----------------------------------------------------------------------------
+bool miniMax::miniMax::setThreadPinning(bool enabled)
+{
+	return threadManager.setThreadPinning(enabled);
+}
+
+//-----------------------------------------------------------------------------
+// Name: setThreadProfiling()
+// Desc: Logs the busy time, barrier waits and chunk durations of each thread after each parallel phase
+//-----------------------------------------------------------------------------
+bool miniMax::miniMax::setThreadProfiling(bool enabled)
+{
+	return threadManager.setProfiling(enabled);
+}
+
+//-----------------------------------------------------------------------------
+// Name: setThreadAutoTuning()
+// Desc: Chooses the number of threads for retro analysis, alpha-beta and layer testing separately by measuring
+//		 the states per second of the first layers. The number set by setNumThreads() is the upper limit.
+//		 The result is stored in the database directory and reused when the database is opened again.
+//-----------------------------------------------------------------------------
+bool miniMax::miniMax::setThreadAutoTuning(bool enabled)
+{
+	if (!threadManager.setAutoTuning(enabled)) return false;
+	if (enabled && db.isOpen()) {
+		threadManager.getTuner().load(getThreadTuningFilePath());
+	}
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // Name: anyFreshlyCalculatedLayer()
 // Desc: called by MAIN-thread in pMiniMax->csOsPrint critical-section
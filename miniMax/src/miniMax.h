@@ -95,7 +95,12 @@ public:
 
 	// Functions for getting the best choice
 	bool 					getBestChoice					(unsigned int& choice, stateInfo& infoAboutChoices);
+	bool					getBestChoices					(const vector<stateAdressStruct>& states, const alphaBeta::solver::batchCallback& onResult);
 	void					setSearchDepth					(unsigned int maxAlphaBetaSearchDepth);
+	void					setMoveOrdering					(const alphaBeta::moveOrdering::settings& orderSettings);
+	void					setTimeBudget					(unsigned int milliseconds, float aspirationWindow);
+	void					setDeterministic				(bool enabled);
+	const alphaBeta::searchStats& getSearchStats			() const;
 
 	// Database functions
 	bool					openDatabase					(wstring const& directory, bool useCompFileIfBothExist = true);
@@ -110,6 +115,9 @@ public:
 	unsigned int 			getLastCalculatedLayer			();
 	bool					setOutputStream					(wostream& theStream);
 	bool 					setNumThreads					(unsigned int numThreads);
+	bool					setThreadPinning				(bool enabled);
+	bool					setThreadProfiling				(bool enabled);
+	bool					setThreadAutoTuning				(bool enabled);
 
 private:
 
@@ -130,6 +138,7 @@ private:
 
 	// Progress report functions
 	bool					calcLayer						(unsigned int layerNumber);
+	wstring					getThreadTuningFilePath			();
 	void					setCurrentActivity				(activity newAction);
 };
 
@@ -90,6 +90,7 @@ bool miniMax::retroAnalysis::solver::calcKnotValuesByRetroAnalysis(vector<unsign
 	statesToProcess.reserve(tm.getNumThreads());
 	for (unsigned int threadNo=0; threadNo<tm.getNumThreads(); threadNo++) {
 		statesToProcess.push_back(stateQueue(log, db.getFileDirectory(), threadNo));
+		statesToProcess[threadNo].setCompression(COMPRESS_STATE_QUEUES);
 
 		// resize state queue for each thread
 		for (unsigned int plyNumber = 0; plyNumber < PLYINFO_EXP_VALUE; plyNumber++) {
@@ -196,6 +197,11 @@ bool miniMax::retroAnalysis::solver::initRetroAnalysis()
 			return returnValues::falseOrStop();
 		}
 
+		// load balance of the threads
+		if (tm.isProfilingEnabled()) {
+			log.log(logger::logLevel::info, L"Thread profile of initialization of the retro analysis: " + tm.getLastProfile().toJson());
+		}
+
 		// reduce and delete thread specific data
 		tva.reduce();
 
@@ -345,6 +351,24 @@ bool miniMax::retroAnalysis::solver::performRetroAnalysis()
 	case TM_RETURN_VALUE_UNEXPECTED_ERROR:
 		return returnValues::falseOrStop();
 	}
+
+	// load balance of the threads
+	if (tm.isProfilingEnabled()) {
+		log.log(logger::logLevel::info, L"Thread profile of retro analysis: " + tm.getLastProfile().toJson());
+	}
+
+	// compression of the state queues
+	if (COMPRESS_STATE_QUEUES) {
+		for (plyInfoVarType plyNumber = 0; plyNumber < PLYINFO_EXP_VALUE; plyNumber++) {
+			uint64_t numStates = 0, numBytes = 0;
+			for (auto& queue : statesToProcess) {
+				numStates += queue.getNumStatesPushed(plyNumber);
+				numBytes  += queue.getNumBytesPushed(plyNumber);
+			}
+			if (numBytes == 0) continue;
+			log.log(logger::logLevel::info, L"    Ply " + std::to_wstring(plyNumber) + L": " + std::to_wstring(numStates) + L" queued states, compression ratio " + std::to_wstring((double) (numStates * sizeof(stateAdressStruct)) / numBytes));
+		}
+	}
 	
 	// if there are still states to process, than something went wrong
 	for (auto& queue : statesToProcess) {
@@ -415,7 +439,10 @@ DWORD miniMax::retroAnalysis::solver::performRetroAnalysisThreadProc(void* pPara
 	stateQueue&					queue						= retroVars.statesToProcess[threadNo];
 	long long					numStatesProcessed			= 0;			// number of states already processed by this thread
 	plyInfoVarType				curNumPlies					= 0;			// current number of plies considered
-	stateAdressStruct			curState;									// current state counter for while-loop
+	vector<stateAdressStruct>	curStates(NUM_STATES_PER_QUEUE_SPAN);		// states taken at once from the queue
+	size_t						numCurStates				= 0;			// number of valid entries in curStates
+	vector<stateAdressStruct>	newStates;									// decided predecessors, which are pushed at once into the queue
+	plyInfoVarType				newStatesPly				= 0;			// ply number of the states in newStates
 
 	// iterate through all states in the queue, ply by ply
 	// IMPORTANT: All threads must process all plies, since the barrier below expects all threads
@@ -424,47 +451,57 @@ DWORD miniMax::retroAnalysis::solver::performRetroAnalysisThreadProc(void* pPara
 		// IMPORTANT: Since the barrier below expects all threads we cannot skip here
 		// if (!queue.size(curNumPlies)) continue;
 		
-		// process all states in the queue
-		while (queue.pop_front(curState, curNumPlies)) {
-
-			// execution cancelled by user?
-			if (tm.wasExecutionCancelled()) {
-				log << "\n" << "****************************************\nSub-thread no. " << threadNo << ": Execution cancelled by user!\n****************************************\n";
-				return TM_RETURN_VALUE_EXECUTION_CANCELLED;
-			}
+		// process all states in the queue, span by span
+		while (queue.popSpan(curStates, curNumPlies, numCurStates)) {
+			for (const stateAdressStruct& curState : span(curStates.data(), numCurStates)) {
+
+				// execution paused or cancelled by user?
+				tm.pausePoint();
+				if (tm.wasExecutionCancelled()) {
+					log << "\n" << "****************************************\nSub-thread no. " << threadNo << ": Execution cancelled by user!\n****************************************\n";
+					return TM_RETURN_VALUE_EXECUTION_CANCELLED;
+				}
 			
-			// console output
-			if (numStatesProcessed % OUTPUT_EVERY_N_STATES == 0) {
-				wstringstream ss;
-				ss << "    Current number of plies: " << (unsigned int) curNumPlies << "/" << queue.getMaxPlyInfoValue()
-				   << "      States to process for thread " << threadNo << ": " << queue.getNumStatesToProcess();
-				log.log(logger::logLevel::info, ss.str());
-			}
-			numStatesProcessed++;
-
-			// set current selected situation
-			if (!game.setSituation(threadNo, curState.layerNumber, curState.stateNumber)) {
-				log.log(logger::logLevel::error, L"No database file open!");
-				return TM_RETURN_VALUE_TERMINATE_ALL_THREADS;
-			}
-
-			// DEBUGGING
-			// if (curState.layerNumber == 65 && curState.stateNumber == 17961264) {
-			// 	game.printField(threadNo, SKV_VALUE_INVALID, 0);
-			// }
-
-			// get list with statenumbers of predecessors
-			predVars.clear();
-			game.getPredecessors(threadNo, predVars);
+				// console output
+				if (numStatesProcessed % OUTPUT_EVERY_N_STATES == 0) {
+					wstringstream ss;
+					ss << "    Current number of plies: " << (unsigned int) curNumPlies << "/" << queue.getMaxPlyInfoValue()
+					   << "      States to process for thread " << threadNo << ": " << queue.getNumStatesToProcess();
+					log.log(logger::logLevel::info, ss.str());
+				}
+				numStatesProcessed++;
 
-			// iteration
-			for (auto& predState : predVars) {
-				if (!retroVars.processPredecessor(queue, curState, predState)) {
-					log.log(logger::logLevel::error, L"processPredecessor() returned false!");
-					log.log(logger::logLevel::error, L"Thread no. " + std::to_wstring(threadNo) + L" Layer: " + std::to_wstring(curState.layerNumber) + L" State: " + std::to_wstring(curState.stateNumber));
+				// set current selected situation
+				if (!game.setSituation(threadNo, curState.layerNumber, curState.stateNumber)) {
+					log.log(logger::logLevel::error, L"No database file open!");
 					return TM_RETURN_VALUE_TERMINATE_ALL_THREADS;
 				}
+
+				// DEBUGGING
+				// if (curState.layerNumber == 65 && curState.stateNumber == 17961264) {
+				// 	game.printField(threadNo, SKV_VALUE_INVALID, 0);
+				// }
+
+				// get list with statenumbers of predecessors
+				predVars.clear();
+				game.getPredecessors(threadNo, predVars);
+
+				// iteration
+				for (auto& predState : predVars) {
+					if (!retroVars.processPredecessor(queue, newStates, newStatesPly, curState, predState)) {
+						log.log(logger::logLevel::error, L"processPredecessor() returned false!");
+						log.log(logger::logLevel::error, L"Thread no. " + std::to_wstring(threadNo) + L" Layer: " + std::to_wstring(curState.layerNumber) + L" State: " + std::to_wstring(curState.stateNumber));
+						return TM_RETURN_VALUE_TERMINATE_ALL_THREADS;
+					}
+				}
 			}
+
+			// add the predecessors decided by the whole span to the queue
+			if (!queue.pushSpan(newStates, newStatesPly)) {
+				log.log(logger::logLevel::error, L"pushSpan() returned false!");
+				return TM_RETURN_VALUE_TERMINATE_ALL_THREADS;
+			}
+			newStates.clear();
 		}
 
 		// there might be other threads still processing states with this ply number
@@ -477,9 +514,10 @@ DWORD miniMax::retroAnalysis::solver::performRetroAnalysisThreadProc(void* pPara
 
 //-----------------------------------------------------------------------------
 // Name: processPredecessor()
-// Desc: 
+// Desc: Decided predecessors are appended to 'newStates' and pushed into the queue by the caller. 
+//		 Only when the ply number changes, the states collected so far are pushed here.
 //-----------------------------------------------------------------------------
-bool miniMax::retroAnalysis::solver::processPredecessor(stateQueue& queue, const stateAdressStruct& curState, const predVars& predVarState)
+bool miniMax::retroAnalysis::solver::processPredecessor(stateQueue& queue, vector<stateAdressStruct>& newStates, plyInfoVarType& newStatesPly, const stateAdressStruct& curState, const predVars& predVarState)
 {
 	// locals
 	twoBit 						curStateValue;				// value of the current state
@@ -544,8 +582,7 @@ bool miniMax::retroAnalysis::solver::processPredecessor(stateQueue& queue, const
 				return false;
 			}
 			// add state to queue
-			if (!queue.push_back(predState, curNumPlies + 1, db.getNumberOfKnots(predState.layerNumber))) {
-				log.log(logger::logLevel::error, L"push_back() returned false!");
+			if (!addNewState(queue, newStates, newStatesPly, predState, curNumPlies + 1)) {
 				return false;
 			}
 			if (v) log.log(logger::logLevel::info, L"ThreadId " + std::to_wstring(tm.getThreadNumber()) + L": Current state is a won game with " + std::to_wstring(curNumPlies + 1) + L" plies.");
@@ -582,8 +619,7 @@ bool miniMax::retroAnalysis::solver::processPredecessor(stateQueue& queue, const
 					log.log(logger::logLevel::error, L"writeKnotValueInDatabase() returned false!");
 					return false;
 				}
-				if (!queue.push_back(predState, curNumPlies + 1, db.getNumberOfKnots(predState.layerNumber))) {
-					log.log(logger::logLevel::error, L"push_back() returned false!");
+				if (!addNewState(queue, newStates, newStatesPly, predState, curNumPlies + 1)) {
 					return false;
 				}
 				if (v) log.log(logger::logLevel::info, L"ThreadId " + std::to_wstring(tm.getThreadNumber()) + L": Current state is a lost game with " + std::to_wstring(curNumPlies + 1) + L" plies.");
@@ -595,6 +631,23 @@ bool miniMax::retroAnalysis::solver::processPredecessor(stateQueue& queue, const
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// Name: addNewState()
+// Desc: Appends the state to 'newStates'. If the collected states belong to another ply number, they are pushed into the queue before.
+//-----------------------------------------------------------------------------
+bool miniMax::retroAnalysis::solver::addNewState(stateQueue& queue, vector<stateAdressStruct>& newStates, plyInfoVarType& newStatesPly, const stateAdressStruct& state, plyInfoVarType plyNumber)
+{
+	if (!newStates.empty() && newStatesPly != plyNumber) {
+		if (!queue.pushSpan(newStates, newStatesPly)) {
+			return log.log(logger::logLevel::error, L"pushSpan() returned false!"), false;
+		}
+		newStates.clear();
+	}
+	newStatesPly = plyNumber;
+	newStates.push_back(state);
+	return true;
+}
+
 #pragma endregion
 
 #pragma region retro analysis thread structs
@@ -45,7 +45,8 @@ namespace retroAnalysis
 		bool											initRetroAnalysis				();
 		bool 											prepareCountArrays				();
 		bool											performRetroAnalysis			();
-		bool											processPredecessor				(stateQueue& queue, const stateAdressStruct& curState, const predVars& predVarState);
+		bool											processPredecessor				(stateQueue& queue, vector<stateAdressStruct>& newStates, plyInfoVarType& newStatesPly, const stateAdressStruct& curState, const predVars& predVarState);
+		bool											addNewState						(stateQueue& queue, vector<stateAdressStruct>& newStates, plyInfoVarType& newStatesPly, const stateAdressStruct& state, plyInfoVarType plyNumber);
 		size_t 											estimateTotalNumberOfKnots		();
 
 		// static thread functions
@@ -15,6 +15,7 @@ miniMax::retroAnalysis::stateQueue::stateQueue(logger& log, const wstring& fileD
 	log(log), numStatesToProcess(0), maxPlyInfoValue(0), fileDirectory(fileDirectory), threadNo(threadNo)
 {
 	statesToProcess.resize(PLYINFO_EXP_VALUE, nullptr);
+	plyInfos.resize(PLYINFO_EXP_VALUE);
 }
 
 //-----------------------------------------------------------------------------
@@ -35,6 +36,8 @@ miniMax::retroAnalysis::stateQueue::~stateQueue()
 miniMax::retroAnalysis::stateQueue::stateQueue(stateQueue&& other) noexcept :
 	log(other.log), 
 	statesToProcess(std::move(other.statesToProcess)), 
+	plyInfos(std::move(other.plyInfos)), 
+	compress(other.compress), 
 	fileDirectory(std::move(other.fileDirectory)), 
 	numStatesToProcess(other.numStatesToProcess), 
 	maxPlyInfoValue(other.maxPlyInfoValue), 
@@ -55,6 +58,8 @@ miniMax::retroAnalysis::stateQueue& miniMax::retroAnalysis::stateQueue::operator
 	{
 		log = std::move(other.log);
 		statesToProcess = std::move(other.statesToProcess);
+		plyInfos = std::move(other.plyInfos);
+		compress = other.compress;
 		fileDirectory = std::move(other.fileDirectory);
 		numStatesToProcess = other.numStatesToProcess;
 		maxPlyInfoValue = other.maxPlyInfoValue;
@@ -92,8 +97,12 @@ bool miniMax::retroAnalysis::stateQueue::resize(plyInfoVarType plyNumber, size_t
 	ssStatesToProcessFilePath.str(L"");
 	ssStatesToProcessFilePath << ssStatesToProcessPath.str() << "\\statesToProcessWithPlyCounter=" << plyNumber << "andThread=" << threadNo << ".dat";
 	
+	// small queues are kept in memory, large ones in a file bypassing the file cache, since each block is written and read only once
+	static_assert(BLOCK_SIZE_IN_CYCLIC_ARRAY * sizeof(stateAdressStruct) % unbufferedFileBlockStorage::SECTOR_SIZE == 0, "block size must be a multiple of the sector size");
+	blockStorage::type storageType = (numberOfKnots * sizeof(stateAdressStruct) <= MAX_STATE_QUEUE_SIZE_IN_MEMORY) ? blockStorage::type::memory : blockStorage::type::unbufferedFile;
+
 	// create cyclic array for this ply number
-	statesToProcess[plyNumber] = new cyclicArray(BLOCK_SIZE_IN_CYCLIC_ARRAY * sizeof(stateAdressStruct), (numberOfKnots / BLOCK_SIZE_IN_CYCLIC_ARRAY) + 1, ssStatesToProcessFilePath.str().c_str(), log);
+	statesToProcess[plyNumber] = new cyclicArray(BLOCK_SIZE_IN_CYCLIC_ARRAY * sizeof(stateAdressStruct), (numberOfKnots / BLOCK_SIZE_IN_CYCLIC_ARRAY) + 1, ssStatesToProcessFilePath.str().c_str(), log, storageType);
 	
 	log.log(logger::logLevel::trace, L"Created cyclic array: " + ssStatesToProcessFilePath.str());
     return true;
@@ -122,6 +131,7 @@ bool miniMax::retroAnalysis::stateQueue::push_back(const stateAdressStruct& stat
 	// resize vector if too small
 	if (plyNumber >= statesToProcess.size()) {
 		statesToProcess.resize(max((size_t) (plyNumber+1), 10*statesToProcess.size()), nullptr);
+		plyInfos.resize(statesToProcess.size());
 		log.log(logger::logLevel::warning, L"statesToProcess resized to " + std::to_wstring(statesToProcess.size()));
 	}
 
@@ -134,15 +144,7 @@ bool miniMax::retroAnalysis::stateQueue::push_back(const stateAdressStruct& stat
 	}
 
 	// add state
-	if (!statesToProcess[plyNumber]->addBytes(sizeof(stateAdressStruct), (unsigned char*) &state)) {
-		log << "ERROR: Cyclic list to small! numStatesToProcess:" << numStatesToProcess << "\n";
-		log << "ERROR: getNumBlocks() = " << statesToProcess[plyNumber]->getNumBlocks() << "\n";
-		return returnValues::falseOrStop();
-	}
-
-	// everything was fine
-	numStatesToProcess++;
-	return true;
+	return addStates(span(&state, 1), plyNumber);
 }
 
 //-----------------------------------------------------------------------------
@@ -154,16 +156,50 @@ bool miniMax::retroAnalysis::stateQueue::pop_front(stateAdressStruct& state, ply
 	// check parameter
 	if (plyNumber >= statesToProcess.size() || statesToProcess[plyNumber] == nullptr) return false;
 	if (numStatesToProcess == 0) return false;
-	if (statesToProcess[plyNumber]->bytesAvailable() < sizeof(stateAdressStruct)) return false;
+	if (plyInfos[plyNumber].numStates == 0) return false;
 
 	// take state
-	if (!statesToProcess[plyNumber]->takeBytes(sizeof(stateAdressStruct), (unsigned char*) &state)) {
-		log << "ERROR: takeBytes failed! numStatesToProcess:" << numStatesToProcess << "\n";
-		return returnValues::falseOrStop();
+	return takeStates(span(&state, 1), plyNumber);
+}
+
+//-----------------------------------------------------------------------------
+// Name: pushSpan()
+// Desc: Adds many states at once to the queue for the given ply number. In contrast to push_back() the state numbers are not checked.
+//-----------------------------------------------------------------------------
+bool miniMax::retroAnalysis::stateQueue::pushSpan(span<const stateAdressStruct> states, plyInfoVarType plyNumber)
+{
+	// checks
+	if (states.empty()) return true;
+	if (plyNumber >= statesToProcess.size() || statesToProcess[plyNumber] == nullptr) {
+		return log.log(logger::logLevel::error, L"ERROR: statesToProcess[" + std::to_wstring(plyNumber) + L"] not initialized! Call resize() first"), returnValues::falseOrStop();
 	}
 
-	// everything was fine
-	numStatesToProcess--;
+	// set max ply info value
+	if (plyNumber > maxPlyInfoValue) maxPlyInfoValue = plyNumber;
+
+	// add states
+	return addStates(states, plyNumber);
+}
+
+//-----------------------------------------------------------------------------
+// Name: popSpan()
+// Desc: Takes as many states as fit into 'states' from the queue for the given ply number. 
+//		 'numStatesPopped' is set to the number of taken states. Returns false if the queue is empty.
+//-----------------------------------------------------------------------------
+bool miniMax::retroAnalysis::stateQueue::popSpan(span<stateAdressStruct> states, plyInfoVarType plyNumber, size_t& numStatesPopped)
+{
+	// check parameter
+	numStatesPopped = 0;
+	if (plyNumber >= statesToProcess.size() || statesToProcess[plyNumber] == nullptr) return false;
+	if (numStatesToProcess == 0) return false;
+
+	// take states
+	numStatesPopped = std::min<size_t>(states.size(), plyInfos[plyNumber].numStates);
+	if (numStatesPopped == 0) return false;
+	if (!takeStates(states.first(numStatesPopped), plyNumber)) {
+		numStatesPopped = 0;
+		return false;
+	}
 	return true;
 }
 
@@ -177,5 +213,199 @@ unsigned int miniMax::retroAnalysis::stateQueue::size(plyInfoVarType plyNumber)
 	if (plyNumber >= statesToProcess.size() || statesToProcess[plyNumber] == nullptr) return 0;
 
 	// get size
-	return statesToProcess[plyNumber]->bytesAvailable() / sizeof(stateAdressStruct);
+	return (unsigned int) plyInfos[plyNumber].numStates;
+}
+
+//-----------------------------------------------------------------------------
+// Name: setCompression()
+// Desc: Enables the delta encoding of the queued states. Must be called while all queues are empty.
+//-----------------------------------------------------------------------------
+void miniMax::retroAnalysis::stateQueue::setCompression(bool enabled)
+{
+	if (numStatesToProcess) {
+		log.log(logger::logLevel::error, L"ERROR: The compression of a state queue cannot be changed while it contains states!");
+		return;
+	}
+	compress = enabled;
+	for (auto& curPlyInfo : plyInfos) {
+		curPlyInfo.lastPushedState = curPlyInfo.lastPoppedState = stateAdressStruct{0, 0};
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name: getNumStatesPushed()
+// Desc: Returns the total number of states pushed into the queue of the given ply number.
+//-----------------------------------------------------------------------------
+uint64_t miniMax::retroAnalysis::stateQueue::getNumStatesPushed(plyInfoVarType plyNumber) const
+{
+	return plyNumber < plyInfos.size() ? plyInfos[plyNumber].numStatesPushed : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name: getNumBytesPushed()
+// Desc: Returns the total number of bytes written into the cyclic array of the given ply number.
+//		 Compared to getNumStatesPushed() * sizeof(stateAdressStruct) this gives the compression ratio.
+//-----------------------------------------------------------------------------
+uint64_t miniMax::retroAnalysis::stateQueue::getNumBytesPushed(plyInfoVarType plyNumber) const
+{
+	return plyNumber < plyInfos.size() ? plyInfos[plyNumber].numBytesPushed : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name: addStates()
+// Desc: Writes the states into the cyclic array of the given ply number, either as they are or delta encoded.
+//-----------------------------------------------------------------------------
+bool miniMax::retroAnalysis::stateQueue::addStates(span<const stateAdressStruct> states, plyInfoVarType plyNumber)
+{
+	// locals
+	plyInfo&				curPlyInfo	= plyInfos[plyNumber];
+	cyclicArray&			queue		= *statesToProcess[plyNumber];
+	unsigned int			numBytes	= (unsigned int) states.size_bytes();
+	const unsigned char*	pData		= (const unsigned char*) states.data();
+	stateAdressStruct		lastState	= curPlyInfo.lastPushedState;
+
+	// encode states
+	if (compress) {
+		if (codingBuffer.size() < states.size() * MAX_ENCODED_STATE_SIZE) {
+			codingBuffer.resize(states.size() * MAX_ENCODED_STATE_SIZE);
+		}
+		numBytes = 0;
+		for (auto& state : states) {
+			numBytes += encodeState(state, lastState, &codingBuffer[numBytes]);
+		}
+		pData = codingBuffer.data();
+	}
+
+	// add states
+	if (!queue.addBytes(numBytes, pData)) {
+		log << "ERROR: Cyclic list to small! numStatesToProcess:" << numStatesToProcess << "\n";
+		log << "ERROR: getNumBlocks() = " << queue.getNumBlocks() << "\n";
+		return returnValues::falseOrStop();
+	}
+
+	// everything was fine
+	curPlyInfo.lastPushedState	 = lastState;
+	curPlyInfo.numStates		+= states.size();
+	curPlyInfo.numStatesPushed	+= states.size();
+	curPlyInfo.numBytesPushed	+= numBytes;
+	numStatesToProcess			+= states.size();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: takeStates()
+// Desc: Reads states from the cyclic array of the given ply number. The caller ensures that there are enough states.
+//-----------------------------------------------------------------------------
+bool miniMax::retroAnalysis::stateQueue::takeStates(span<stateAdressStruct> states, plyInfoVarType plyNumber)
+{
+	// locals
+	plyInfo&				curPlyInfo	= plyInfos[plyNumber];
+	cyclicArray&			queue		= *statesToProcess[plyNumber];
+
+	// take states
+	if (compress) {
+
+		// locals
+		size_t			numDecoded		= 0;		// number of states already decoded
+		unsigned int	numPending		= 0;		// bytes at the beginning of codingBuffer belonging to a partly read state
+		unsigned int	numBuffered;				// valid bytes in codingBuffer
+		unsigned int	pos;						// position of the next state in codingBuffer
+		unsigned int	stateSize;					// size of the currently decoded state
+
+		// each encoded state takes at least one byte, so reading one byte per missing state never reads beyond the requested states
+		while (numDecoded < states.size()) {
+			numBuffered = numPending + (unsigned int) (states.size() - numDecoded);
+			if (codingBuffer.size() < numBuffered) {
+				codingBuffer.resize(std::max<size_t>(numBuffered, states.size() * MAX_ENCODED_STATE_SIZE));
+			}
+			if (!queue.takeBytes(numBuffered - numPending, &codingBuffer[numPending])) {
+				log << "ERROR: takeBytes failed! numStatesToProcess:" << numStatesToProcess << "\n";
+				return returnValues::falseOrStop();
+			}
+
+			// decode all complete states
+			for (pos = 0; numDecoded < states.size(); pos += stateSize, numDecoded++) {
+				stateSize = decodeState(&codingBuffer[pos], numBuffered - pos, curPlyInfo.lastPoppedState, states[numDecoded]);
+				if (!stateSize) break;
+			}
+
+			// keep the bytes of the incomplete state
+			numPending = numBuffered - pos;
+			if (numPending > MAX_ENCODED_STATE_SIZE) {
+				log << "ERROR: decodeState failed! numStatesToProcess:" << numStatesToProcess << "\n";
+				return returnValues::falseOrStop();
+			}
+			memmove(&codingBuffer[0], &codingBuffer[pos], numPending);
+		}
+	} else if (!queue.takeBytes((unsigned int) states.size_bytes(), (unsigned char*) states.data())) {
+		log << "ERROR: takeBytes failed! numStatesToProcess:" << numStatesToProcess << "\n";
+		return returnValues::falseOrStop();
+	}
+
+	// everything was fine
+	curPlyInfo.numStates	-= states.size();
+	numStatesToProcess		-= states.size();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: encodeState()
+// Desc: Writes the state relative to 'lastState' into the buffer, which must hold MAX_ENCODED_STATE_SIZE bytes. 
+//		 Returns the number of written bytes and sets 'lastState' to 'state'.
+//-----------------------------------------------------------------------------
+unsigned int miniMax::retroAnalysis::stateQueue::encodeState(const stateAdressStruct& state, stateAdressStruct& lastState, unsigned char* buffer)
+{
+	// locals
+	int64_t			delta			= (int64_t) state.stateNumber - (int64_t) lastState.stateNumber;
+	bool			layerChanged	= state.layerNumber != lastState.layerNumber;
+	uint64_t		token			= ((((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63)) << 1) | (layerChanged ? 1 : 0);
+	unsigned int	numBytes		= 0;
+
+	// varint with 7 bits per byte, the highest bit marks a following byte
+	while (token >= 0x80) {
+		buffer[numBytes++]	= (unsigned char) (token | 0x80);
+		token			  >>= 7;
+	}
+	buffer[numBytes++] = (unsigned char) token;
+
+	// a new run of states of another layer begins
+	if (layerChanged) {
+		buffer[numBytes++] = state.layerNumber;
+	}
+
+	lastState = state;
+	return numBytes;
+}
+
+//-----------------------------------------------------------------------------
+// Name: decodeState()
+// Desc: Reads a state written by encodeState() from the buffer containing 'numBytes' bytes. 
+//		 Returns the number of read bytes, or zero if the buffer ends before the state is complete.
+//-----------------------------------------------------------------------------
+unsigned int miniMax::retroAnalysis::stateQueue::decodeState(const unsigned char* buffer, size_t numBytes, stateAdressStruct& lastState, stateAdressStruct& state)
+{
+	// locals
+	uint64_t		token			= 0;
+	unsigned char	curByte			= 0x80;
+	unsigned int	pos				= 0;
+	int64_t			delta;
+
+	// varint
+	for (unsigned int shift = 0; curByte & 0x80; shift += 7) {
+		if (pos >= numBytes || pos >= MAX_ENCODED_STATE_SIZE) return 0;
+		curByte	 = buffer[pos++];
+		token	|= (uint64_t) (curByte & 0x7f) << shift;
+	}
+	delta = (int64_t) ((token >> 2) ^ (0 - ((token >> 1) & 1)));
+
+	// layer number
+	state.layerNumber = lastState.layerNumber;
+	if (token & 1) {
+		if (pos >= numBytes) return 0;
+		state.layerNumber = buffer[pos++];
+	}
+	state.stateNumber = (stateNumberVarType) ((int64_t) lastState.stateNumber + delta);
+
+	lastState = state;
+	return pos;
 }
@@ -6,6 +6,8 @@
 \*********************************************************************/
 #pragma once
 
+#include <span>
+
 #include "weaselEssentials/src/logger.h"
 #include "weaselEssentials/src/cyclicArray.h"
 #include "miniMax/src/typeDef.h"
@@ -21,6 +23,8 @@ namespace retroAnalysis
 	// The cyclic arrays are dynamically resized as needed, and each queue maintains its own state count.
 	// Usage pattern: Each thread should instantiate its own stateQueue instance to avoid concurrency issues.
 	// The class is not thread safe; concurrent access must be managed externally.
+	// Optionally the states are stored delta encoded: the queues of a ply mostly contain states of few layers in nearly sorted order.
+	// Then each state is stored as varint of (zigzag(stateNumber - previous stateNumber) << 1 | layerChanged), followed by the layer number if it changed.
 	// Expected usage: Push states to the queue for processing, pop states when processed, and resize queues as the search depth changes.
 	class stateQueue
 	{
@@ -34,18 +38,43 @@ namespace retroAnalysis
 		bool 											resize							(plyInfoVarType plyNumber, size_t numberOfKnots);																
 		bool 											push_back						(const stateAdressStruct& state, plyInfoVarType plyNumber, stateNumberVarType numberOfKnots);
 		bool 											pop_front						(stateAdressStruct& state, plyInfoVarType plyNumber);
+		bool											pushSpan						(span<const stateAdressStruct> states, plyInfoVarType plyNumber);
+		bool											popSpan							(span<stateAdressStruct> states, plyInfoVarType plyNumber, size_t& numStatesPopped);
 		unsigned int				 					size							(plyInfoVarType plyNumber);
+		void											setCompression					(bool enabled);
+		bool											isCompressed					() const { return compress; }
+		uint64_t										getNumStatesPushed				(plyInfoVarType plyNumber) const;
+		uint64_t										getNumBytesPushed				(plyInfoVarType plyNumber) const;
 		long long 						 				getNumStatesToProcess			() { return numStatesToProcess; }
 		plyInfoVarType									getMaxPlyInfoValue				() { return maxPlyInfoValue; }
 	
 	private:
+		static constexpr unsigned int					MAX_ENCODED_STATE_SIZE			= 6;					// varint of at most 34 bits plus the layer number
+
+		struct plyInfo																							// bookkeeping of the queue of one ply
+		{
+			size_t										numStates						= 0;					// number of states in the queue
+			stateAdressStruct							lastPushedState					= {0, 0};				// deltas of the encoding refer to the previous state
+			stateAdressStruct							lastPoppedState					= {0, 0};				// ''
+			uint64_t									numStatesPushed					= 0;					// total number of states ever pushed, for the compression ratio
+			uint64_t									numBytesPushed					= 0;					// total number of bytes ever written to the cyclic array
+		};
+
 		logger& 										log;													// logger, used for output
 		vector<cyclicArray*>							statesToProcess;										// cyclic array containing the states, whose short knot value are known for sure. they have to be processed
+		vector<plyInfo>									plyInfos;												// [plyNumber]
 		long long										numStatesToProcess				= 0;					// Number of states in 'statesToProcess' which have to be processed
+		bool											compress						= false;				// true if the states are stored delta encoded
 		plyInfoVarType									maxPlyInfoValue					= 0;					// maximum ply info value
 		wstring 										fileDirectory;											// directory where the files are stored
         unsigned int                                    threadNo                        = 0xffff;               // thread number, used for file names
+		vector<unsigned char>							codingBuffer;											// scratch buffer for encoding and decoding, reused to avoid allocations per call
 		alignas(64) char 								dummy_cache_align;										// Align to cache line (64 bytes)
+
+		bool											addStates						(span<const stateAdressStruct> states, plyInfoVarType plyNumber);
+		bool											takeStates						(span<stateAdressStruct> states, plyInfoVarType plyNumber);
+		static unsigned int								encodeState						(const stateAdressStruct& state, stateAdressStruct& lastState, unsigned char* buffer);
+		static unsigned int								decodeState						(const unsigned char* buffer, size_t numBytes, stateAdressStruct& lastState, stateAdressStruct& state);
 	};
     
 } // namespace retroAnalysis
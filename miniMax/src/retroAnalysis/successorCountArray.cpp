@@ -79,7 +79,7 @@ bool miniMax::retroAnalysis::successorCountManager::init(vector<unsigned int>& l
 
 	// allocate memory for the successor count arrays, one for each layer in 'layersToCalculate'
 	for (size_t id = 0; id < layersToCalculate.size(); id++) {
-		succCountArrays.push_back(new successorCountArray(log, db, layersToCalculate[id]));
+		succCountArrays.push_back(new successorCountArray(log, db, layersToCalculate[id], &tm));
 	}
 
 	// prepare file read/write
@@ -223,6 +223,11 @@ bool miniMax::retroAnalysis::successorCountManager::addNumSuccedors(unsigned int
 		return returnValues::falseOrStop();
 	}
 
+	// load balance of the threads
+	if (tm.isProfilingEnabled()) {
+		log.log(logger::logLevel::info, L"Thread profile of counting the successors: " + tm.getLastProfile().toJson());
+	}
+
 	// reduce and delete thread specific data
 	tva.reduce();
 	if (totalNumStatesProcessed != db.getNumberOfKnots(layerNumber)) {
@@ -318,15 +323,21 @@ DWORD miniMax::retroAnalysis::successorCountManager::addNumSuccedorsThreadProc(v
 #pragma region successorCountArray
 //-----------------------------------------------------------------------------
 // Name: successorCountArray()
-// Desc: Constructor for the successor count array
+// Desc: Constructor for the successor count array.
+//		 If tm is passed, the array is initialized by the threads, which process the same states in executeParallelLoop() with TM_SCHEDULE_STATIC.
 //-----------------------------------------------------------------------------
-miniMax::retroAnalysis::successorCountArray::successorCountArray(logger& log, database::database& db, unsigned int layerNumber)
+miniMax::retroAnalysis::successorCountArray::successorCountArray(logger& log, database::database& db, unsigned int layerNumber, threadManagerClass* tm)
 	: log(log), db(db), layerNumber(layerNumber)
 {
 	// allocate memory for count arrays and set default value to 0
 	long long numKnotsInCurLayer = db.getNumberOfKnots(layerNumber);
-	succCountArray.resize(numKnotsInCurLayer, 0);
-	db.arrayInfos.addArray(layerNumber, database::arrayInfoStruct::arrayType::countArray, numKnotsInCurLayer * sizeof(countArrayVarType), 0);
+	succCountArray.resize(numKnotsInCurLayer);
+	if (tm) {
+		tm->fillParallel(succCountArray.data(), succCountArray.size(), (countArrayVarType) 0);
+	} else {
+		std::fill(succCountArray.begin(), succCountArray.end(), (countArrayVarType) 0);
+	}
+	db.arrayInfos.addArray(layerNumber, database::arrayInfoStruct::arrayType::countArray, numKnotsInCurLayer * sizeof(countArrayVarType), 0, succCountArray.data());
 }
 
 //-----------------------------------------------------------------------------
@@ -27,7 +27,7 @@ namespace retroAnalysis
 	class successorCountArray
 	{
 		public:
-														successorCountArray				(logger& log, database::database& db, unsigned int layerNumber);
+														successorCountArray				(logger& log, database::database& db, unsigned int layerNumber, threadManagerClass* tm = nullptr);
 														~successorCountArray			();
 			countArrayVarType							increaseCounter					(stateNumberVarType stateNumber);	
 			countArrayVarType							decreaseCounter					(stateNumberVarType stateNumber);
@@ -36,7 +36,7 @@ namespace retroAnalysis
 			logger& 									log;													// logger, used for output
 			database::database& 						db;														// database, for storing the calculated values
 			const unsigned int 							layerNumber;											// layer number
-			vector<countArrayVarType>					succCountArray;											// count array for the number of drawn/unknown successors for each state
+			vector<countArrayVarType, defaultInitAllocator<countArrayVarType>> succCountArray;					// count array for the number of drawn/unknown successors for each state
 			mutex										succCountArrayMutex;									// mutex for the count array
 	};
 
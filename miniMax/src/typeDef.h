@@ -48,7 +48,10 @@ const plyInfoVarType		PLYINFO_VALUE_INVALID			= 65003;		// ply info is invalid,
 #else
 	const long long			OUTPUT_EVERY_N_STATES			= 10000000;		// print progress every n-th processed knot
 #endif
-const size_t				BLOCK_SIZE_IN_CYCLIC_ARRAY		= 10000;		// BLOCK_SIZE_IN_CYCLIC_ARRAY*sizeof(stateAdressStruct) = block size in bytes for the cyclic arrays
+const size_t				BLOCK_SIZE_IN_CYCLIC_ARRAY		= 8192;			// BLOCK_SIZE_IN_CYCLIC_ARRAY*sizeof(stateAdressStruct) = block size in bytes for the cyclic arrays, a multiple of the sector size
+const size_t				MAX_STATE_QUEUE_SIZE_IN_MEMORY	= 16777216;		// state queues up to this size in bytes are kept in memory instead of an unbuffered file
+const size_t				NUM_STATES_PER_QUEUE_SPAN		= 1024;			// number of states taken at once from a state queue of the retro analysis
+const bool					COMPRESS_STATE_QUEUES			= true;			// true or false - delta encoding of the states in the queues of the retro analysis
 const size_t				MAX_NUM_PREDECESSORS			= 10000;		// maximum number of predecessors. important for array sizes
 const size_t				FILE_BUFFER_SIZE				= 1000000;		// size in bytes
 
@@ -145,11 +148,14 @@ public:
 	virtual bool			isStateIntegrityOk				(unsigned int threadNo)																								{ return false;		};	// do some checks if the state variables are consistent to each other
 	virtual void			applySymOp						(unsigned int threadNo, unsigned char symmetryOperationNumber, bool doInverseOperation, bool playerToMoveChanged)	{					};  // apply this (inverse) symmetry operation on the current state of a certain thread
 	virtual bool			lostIfUnableToMove				(unsigned int threadNo)																								{ return false;		};	// does it mean that the game is lost, when unable to move?
+	virtual bool			getPositionKey					(unsigned int threadNo, uint64_t& positionKey)																		{ return false;		};	// optional: unique key of the current state of a thread, used by the transposition table of the alpha-beta search
+	virtual void			orderPossibilities				(unsigned int threadNo, vector<unsigned int>& possibilityIds)														{ 					};	// optional: sort the possibilities so that promising moves come first, to speed up the alpha-beta search
 
 	// setter
 	virtual bool			setSituation					(unsigned int threadNo, unsigned int layerNum, unsigned int stateNumber)											{ return false;		};	// set a certain game state for a thread. even if the state is invalid, the function should set the state and return false 
 	virtual void			move							(unsigned int threadNo, unsigned int idPossibility, bool& playerToMoveChanged, void* &pBackup)						{ 					};	//   do a move based on the ids returned by getPossibilities() 
 	virtual void			undo							(unsigned int threadNo, unsigned int idPossibility, bool& playerToMoveChanged, void*  pBackup)						{ 					};	// undo a move based on the ids returned by getPossibilities() 
+	virtual bool			copySituation					(unsigned int fromThreadNo, unsigned int toThreadNo)																{ return false;		};	// optional: copy the current state of a thread to another one. if not supported, the caller of the alpha-beta search must set the state of each thread
 	
 	// output
 	virtual void			printField						(unsigned int threadNo, twoBit value, unsigned int indentSpaces = 0)												{ 					};	// for console
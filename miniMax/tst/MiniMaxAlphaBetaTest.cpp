@@ -13,6 +13,8 @@
 #include "miniMax/tst/MiniMaxGameStub.h"
 
 #include <filesystem>
+#include <thread>
+#include <atomic>
 
 using namespace miniMax;
 
@@ -232,12 +234,13 @@ TEST_F(MiniMaxAlphaBeta_KnotStruct, increaseFreqValuesSubMoves)
 TEST_F(MiniMaxAlphaBeta_KnotStruct, getInfoAboutChoices)
 {
 	// locals
-	stateInfo info;
+	stateInfo				info;
+	vector<unsigned int>	possibilityIds	= {20, 21, 22};
 
 	knot.shortValue 				= SKV_VALUE_GAME_WON;
 	knot.numPossibilities 			= 3;
 	knot.plyInfo					= 11;
-	knot.possibilityIds 			= {20, 21, 22};
+	knot.possibilityIds 			= possibilityIds;
 	knot.branches[0].shortValue 	= SKV_VALUE_GAME_WON;
 	knot.branches[1].shortValue 	= SKV_VALUE_GAME_LOST;
 	knot.branches[2].shortValue 	= SKV_VALUE_GAME_DRAWN;
@@ -335,13 +338,133 @@ TEST_F(MiniMaxAlphaBeta_KnotStruct, getBestBranchesBasedOnFloatValue)
 TEST_F(MiniMaxAlphaBeta_KnotStruct, canCutOff)
 {
 	// locals
-	float alpha, beta;
+	float alpha = -10.0f, beta = 10.0f;
+
+	// same player: better value raises alpha, cut off when beta is reached
+	knot.branches[0].floatValue = 5.0f;
+	testCanCutOff(0, false, alpha, beta, false, 5.0f, 10.0f);
+	knot.branches[1].floatValue = 10.0f;
+	testCanCutOff(1, false, alpha, beta, true, 5.0f, 10.0f);
+	EXPECT_EQ(knot.numPossibilities, 2);
+
+	// player changed: lower value lowers beta, cut off when alpha is reached
+	knot.branches[2].floatValue = 8.0f;
+	testCanCutOff(2, true, alpha, beta, false, 5.0f, 8.0f);
+	knot.branches[3].floatValue = 5.0f;
+	testCanCutOff(3, true, alpha, beta, true, 5.0f, 8.0f);
+	EXPECT_EQ(knot.numPossibilities, 4);
+}
 
-	// TODO: implement tests
+TEST_F(MiniMaxAlphaBeta_KnotStruct, canCutOffInKnotFrame)
+{
+	// locals
+	float alpha = -10.0f, beta = 10.0f;
+	knot.numPossibilities = 4;
+
+	// invalid branches are ignored
+	knot.branches[0].shortValue = SKV_VALUE_INVALID;		knot.branches[0].floatValue = FPKV_INV_VALUE;	knot.branches[0].playerToMoveChanged = true;
+	EXPECT_FALSE(knot.canCutOffInKnotFrame(0, alpha, beta));
+	EXPECT_EQ(alpha, -10.0f);
+
+	// better value raises alpha
+	knot.branches[1].shortValue = SKV_VALUE_GAME_DRAWN;		knot.branches[1].floatValue = 5.0f;				knot.branches[1].playerToMoveChanged = false;
+	EXPECT_FALSE(knot.canCutOffInKnotFrame(1, alpha, beta));
+	EXPECT_EQ(alpha, 5.0f);
+	EXPECT_EQ(beta, 10.0f);
+
+	// value of the opponent is negated
+	knot.branches[2].shortValue = SKV_VALUE_GAME_DRAWN;		knot.branches[2].floatValue = -7.0f;			knot.branches[2].playerToMoveChanged = true;
+	EXPECT_FALSE(knot.canCutOffInKnotFrame(2, alpha, beta));
+	EXPECT_EQ(alpha, 7.0f);
+
+	// cut off when beta is reached
+	knot.branches[3].shortValue = SKV_VALUE_GAME_DRAWN;		knot.branches[3].floatValue = -10.0f;			knot.branches[3].playerToMoveChanged = true;
+	EXPECT_TRUE(knot.canCutOffInKnotFrame(3, alpha, beta));
+	EXPECT_EQ(knot.numPossibilities, 4);
+	beta = 5.0f;
+	EXPECT_TRUE(knot.canCutOffInKnotFrame(1, alpha, beta));
+	EXPECT_EQ(knot.numPossibilities, 2);
 }
 
 #pragma endregion
 
+#pragma region moveOrdering
+TEST(MiniMaxAlphaBeta_moveOrdering, sortPossibilities)
+{
+	// locals
+	gameInterface					game;
+	alphaBeta::searchStats			stats;
+	alphaBeta::moveOrdering			ordering(5, alphaBeta::moveOrdering::settings{});
+	vector<unsigned int>			ids = {0, 1, 2, 3, 4};
+
+	// without any information the order of the game is kept
+	ordering.sortPossibilities(game, 0, 1, false, 0, ids, stats);
+	EXPECT_EQ(ids, (vector<unsigned int>{0, 1, 2, 3, 4}));
+
+	// history heuristic: move 3 caused a cut off at another ply
+	ordering.storeCutOff(3, 2, 3);
+	ordering.sortPossibilities(game, 0, 1, false, 0, ids, stats);
+	EXPECT_EQ(ids, (vector<unsigned int>{3, 0, 1, 2, 4}));
+
+	// killer move of the same ply is tried before the history moves
+	ordering.storeCutOff(1, 1, 4);
+	ids = {0, 1, 2, 3, 4};
+	ordering.sortPossibilities(game, 0, 1, false, 0, ids, stats);
+	EXPECT_EQ(ids, (vector<unsigned int>{4, 3, 0, 1, 2}));
+
+	// best move of the transposition table comes first
+	ordering.storeBestMove(42, 2);
+	ids = {0, 1, 2, 3, 4};
+	ordering.sortPossibilities(game, 0, 1, true, 42, ids, stats);
+	EXPECT_EQ(ids, (vector<unsigned int>{2, 4, 3, 0, 1}));
+	EXPECT_EQ(stats.numTranspositionHits, 1);
+
+	// a different position key does not hit
+	ids = {0, 1, 2, 3, 4};
+	ordering.sortPossibilities(game, 0, 1, true, 43, ids, stats);
+	EXPECT_EQ(ids, (vector<unsigned int>{4, 3, 0, 1, 2}));
+	EXPECT_EQ(stats.numTranspositionHits, 1);
+
+	// after clear() the order of the game is kept again
+	ordering.clear();
+	ids = {0, 1, 2, 3, 4};
+	ordering.sortPossibilities(game, 0, 1, true, 42, ids, stats);
+	EXPECT_EQ(ids, (vector<unsigned int>{0, 1, 2, 3, 4}));
+}
+
+TEST(MiniMaxAlphaBeta_transpositionTable, storeAndLookUp)
+{
+	alphaBeta::transpositionTable table(1000);
+	EXPECT_EQ(table.getNumEntries(), 1024);
+	EXPECT_EQ(table.lookUp(42), alphaBeta::transpositionTable::noMove);
+
+	// keys mapping to the same entry replace each other
+	table.store(42, 7);
+	EXPECT_EQ(table.lookUp(42), 7);
+	table.store(42 + 1024, 8);
+	EXPECT_EQ(table.lookUp(42), alphaBeta::transpositionTable::noMove);
+	EXPECT_EQ(table.lookUp(42 + 1024), 8);
+
+	// concurrent writers never let a reader see a move stored for another key
+	std::atomic<bool> wrongMove = false;
+	auto writer = [&](uint64_t firstKey) {
+		for (uint64_t key = firstKey; key < firstKey + 100000; key++) {
+			table.store(key, (unsigned int) (key * 3));
+			unsigned int move = table.lookUp(key ^ 1);
+			if (move != alphaBeta::transpositionTable::noMove && move != (unsigned int) ((key ^ 1) * 3)) wrongMove = true;
+		}
+	};
+	std::thread t1(writer, 0), t2(writer, 512);
+	t1.join();
+	t2.join();
+	EXPECT_FALSE(wrongMove);
+
+	// clear() removes everything
+	table.clear();
+	EXPECT_EQ(table.lookUp(42 + 1024), alphaBeta::transpositionTable::noMove);
+}
+#pragma endregion
+
 #pragma region solver
 class MiniMaxAlphaBeta_solver : public MiniMaxTestGameFixture {
 protected:
@@ -407,5 +530,229 @@ TEST_F(MiniMaxAlphaBeta_solver, depthSearch)
 	EXPECT_EQ(infoAboutChoices.choices[0].freqValuesSubMoves[SKV_VALUE_GAME_DRAWN], 0);
 	EXPECT_EQ(infoAboutChoices.choices[0].freqValuesSubMoves[SKV_VALUE_GAME_WON], 	1);
 }
+
+TEST_F(MiniMaxAlphaBeta_solver, searchStats)
+{
+	// locals
+	unsigned int 	choice;
+	stateInfo 		infoAboutChoices;
+
+	// prepare solver
+	solver.setSearchDepth(3);
+
+	// node counters are filled by getBestChoice()
+	EXPECT_TRUE(game.setSituation(0, 0, 2));
+	EXPECT_TRUE(solver.getBestChoice(choice, infoAboutChoices));
+	EXPECT_GT(solver.getSearchStats().numNodes, 0);
+	EXPECT_LE(solver.getSearchStats().numLeafNodes, solver.getSearchStats().numNodes);
+	EXPECT_LE(solver.getSearchStats().numFirstMoveCutOffs, solver.getSearchStats().numCutOffs);
+
+	// same result without move ordering
+	alphaBeta::moveOrdering::settings noOrdering{false, false, false, false};
+	solver.setMoveOrdering(noOrdering);
+	EXPECT_TRUE(solver.getBestChoice(choice, infoAboutChoices));
+	EXPECT_EQ(infoAboutChoices.shortValue, 			SKV_VALUE_GAME_LOST);
+	EXPECT_EQ(solver.getSearchStats().numTranspositionHits, 0);
+}
+
+TEST_F(MiniMaxAlphaBeta_solver, batchSearch)
+{
+	// locals
+	vector<stateAdressStruct>	states			= {{2, 0}, {1, 0}, {0, 0}, {2, 0}};
+	vector<stateInfo>			infos(states.size());
+	vector<unsigned int>		numCalls(states.size(), 0);
+
+	// prepare solver
+	solver.setSearchDepth(3);
+
+	// each state is reported exactly once
+	EXPECT_TRUE(solver.getBestChoices(states, [&](size_t index, unsigned int choice, const stateInfo& info) {
+		numCalls[index]++;
+		infos[index] = info;
+	}));
+	EXPECT_EQ(numCalls, (vector<unsigned int>{1, 1, 1, 1}));
+
+	// lost state
+	EXPECT_EQ(infos[0].shortValue, 							SKV_VALUE_GAME_LOST);
+	EXPECT_EQ(infos[0].plyInfo, 							1);
+	EXPECT_EQ(infos[0].choices.size(), 						1);
+	EXPECT_EQ(infos[3].shortValue, 							SKV_VALUE_GAME_LOST);
+
+	// won state
+	EXPECT_EQ(infos[1].shortValue, 							SKV_VALUE_GAME_WON);
+	EXPECT_EQ(infos[1].plyInfo, 							0);
+	EXPECT_EQ(infos[1].choices.size(), 						0);
+
+	// invalid state
+	EXPECT_EQ(infos[2].shortValue, 							SKV_VALUE_INVALID);
+	EXPECT_EQ(infos[2].choices.size(), 						0);
+
+	// empty batch
+	unsigned int numEmptyCalls = 0;
+	EXPECT_TRUE(solver.getBestChoices({}, [&](size_t, unsigned int, const stateInfo&) { numEmptyCalls++; }));
+	EXPECT_EQ(numEmptyCalls, 								0);
+}
+
+TEST_F(MiniMaxAlphaBeta_solver, deterministic)
+{
+	// locals
+	unsigned int 	choice1, choice2;
+	stateInfo 		info1, info2;
+
+	// prepare solver
+	db.closeDatabase();
+	solver.setSearchDepth(3);
+	solver.setDeterministic(true);
+
+	// repeated calls give the same result
+	EXPECT_TRUE(game.setSituation(0, 0, 2));
+	EXPECT_TRUE(game.setSituation(1, 0, 2));
+	EXPECT_TRUE(solver.getBestChoice(choice1, info1));
+	EXPECT_TRUE(solver.getBestChoice(choice2, info2));
+	EXPECT_EQ(choice1, 										choice2);
+	EXPECT_EQ(info1.shortValue, 							info2.shortValue);
+	EXPECT_EQ(info1.plyInfo, 								info2.plyInfo);
+	ASSERT_EQ(info1.choices.size(), 						info2.choices.size());
+	for (size_t i = 0; i < info1.choices.size(); i++) {
+		EXPECT_EQ(info1.choices[i].possibilityId, 			info2.choices[i].possibilityId);
+		EXPECT_EQ(info1.choices[i].shortValue, 				info2.choices[i].shortValue);
+	}
+	EXPECT_EQ(solver.getSearchStats().numTranspositionHits, 0);
+}
+
+TEST_F(MiniMaxAlphaBeta_solver, copySituation)
+{
+	// locals
+	syntheticGame		game{tm.getNumThreads(), 8};
+	database::database	db{game, log};
+	alphaBeta::solver	solver{log, tm, db, game};
+	unsigned int 		choice1, choice2;
+	stateInfo 			info1, info2;
+	int64_t				numNodes1;
+
+	solver.setSearchDepth(6);
+	solver.setDeterministic(true);
+
+	// only thread zero knows the state, the others must get it copied
+	for (unsigned int threadNo = 0; threadNo < tm.getNumThreads(); threadNo++) {
+		EXPECT_TRUE(game.setSituation(threadNo, 0, threadNo == 0 ? 1 : 2));
+	}
+	EXPECT_TRUE(solver.getBestChoice(choice1, info1));
+	numNodes1 = solver.getSearchStats().numNodes;
+
+	// same result, if each thread is set to the state
+	for (unsigned int threadNo = 0; threadNo < tm.getNumThreads(); threadNo++) {
+		EXPECT_TRUE(game.setSituation(threadNo, 0, 1));
+	}
+	EXPECT_TRUE(solver.getBestChoice(choice2, info2));
+	EXPECT_EQ(choice1, 										choice2);
+	EXPECT_EQ(info1.choices.size(), 						info2.choices.size());
+	EXPECT_EQ(numNodes1, 									solver.getSearchStats().numNodes);
+}
+
+TEST_F(MiniMaxAlphaBeta_solver, withoutCopySituation)
+{
+	// game without support of copySituation(), like the default of gameInterface
+	class noCopyGame : public syntheticGame {
+	public:
+		using syntheticGame::syntheticGame;
+		bool 			copySituation(unsigned int fromThreadNo, unsigned int toThreadNo) override { return false; }
+	};
+
+	// locals
+	syntheticGame		copyGame{tm.getNumThreads(), 8};
+	noCopyGame			game{tm.getNumThreads(), 8};
+	database::database	copyDb{copyGame, log};
+	database::database	db{game, log};
+	alphaBeta::solver	copySolver{log, tm, copyDb, copyGame};
+	alphaBeta::solver	solver{log, tm, db, game};
+	unsigned int 		choice1, choice2;
+	stateInfo 			info1, info2;
+
+	copySolver.setSearchDepth(6);
+	copySolver.setDeterministic(true);
+	solver.setSearchDepth(6);
+	solver.setDeterministic(true);
+
+	// the caller sets the state of each thread, so all threads search the branches
+	for (unsigned int threadNo = 0; threadNo < tm.getNumThreads(); threadNo++) {
+		EXPECT_TRUE(copyGame.setSituation(threadNo, 0, 1));
+		EXPECT_TRUE(game.setSituation(threadNo, 0, 1));
+	}
+	EXPECT_TRUE(copySolver.getBestChoice(choice1, info1));
+	EXPECT_TRUE(solver.getBestChoice(choice2, info2));
+	EXPECT_EQ(choice1, 										choice2);
+	ASSERT_EQ(info1.choices.size(), 						info2.choices.size());
+	for (size_t i = 0; i < info1.choices.size(); i++) {
+		EXPECT_EQ(info1.choices[i].possibilityId, 			info2.choices[i].possibilityId);
+		EXPECT_EQ(info1.choices[i].shortValue, 				info2.choices[i].shortValue);
+	}
+	EXPECT_EQ(copySolver.getSearchStats().numNodes, 		solver.getSearchStats().numNodes);
+}
+
+TEST_F(MiniMaxAlphaBeta_solver, iterativeDeepening)
+{
+	// locals
+	unsigned int 	choice;
+	stateInfo 		infoAboutChoices;
+
+	// prepare solver. iterative deepening is only used without database.
+	db.closeDatabase();
+	solver.setSearchDepth(3);
+	solver.setTimeBudget(10000, 1.0f);
+
+	// stopped early since there is only one choice
+	EXPECT_TRUE(game.setSituation(0, 0, 2));
+	EXPECT_TRUE(solver.getBestChoice(choice, infoAboutChoices));
+	EXPECT_EQ(choice, 										0);
+	EXPECT_EQ(infoAboutChoices.choices.size(), 				1);
+	EXPECT_EQ(infoAboutChoices.shortValue, 					SKV_VALUE_GAME_LOST);
+	EXPECT_EQ(solver.getSearchStats().depthReached, 		1);
+	EXPECT_GE(solver.getSearchStats().elapsedSeconds, 		0.0);
+
+	// the thread manager is usable afterwards
+	EXPECT_FALSE(tm.wasExecutionCancelled());
+	solver.setTimeBudget(0, 0);
+	EXPECT_TRUE(solver.getBestChoice(choice, infoAboutChoices));
+	EXPECT_EQ(solver.getSearchStats().depthReached, 		3);
+}
 #pragma endregion
 
+
+#pragma region benchmark
+// Measures the speed of the search in nodes per second. Not part of the ctest run, since it takes a while.
+// Run with: MiniMaxTest --gtest_filter=MiniMaxBenchmark*
+TEST(MiniMaxBenchmark_alphaBeta, nodesPerSecond)
+{
+	// locals
+	logger 					log{logger::logLevel::info, logger::logType::console, L""};
+	threadManagerClass		tm;
+	unsigned int 			choice;
+	stateInfo 				infoAboutChoices;
+
+	// larger synthetic tree, searched by all threads in parallel
+	{
+		syntheticGame		game{tm.getNumThreads(), 8};
+		database::database	db{game, log};
+		alphaBeta::solver	solver{log, tm, db, game};
+		solver.setSearchDepth(9);
+		EXPECT_TRUE(solver.getBestChoice(choice, infoAboutChoices));
+		EXPECT_EQ(infoAboutChoices.choices.size(), 8);
+		EXPECT_GT(solver.getSearchStats().numNodes, 0);
+		std::wcout << L"synthetic game: " << solver.getSearchStats().numNodes << L" nodes, " << solver.getSearchStats().getNodesPerSecond() << L" nodes/s" << std::endl;
+	}
+
+	// many small searches of the test game
+	{
+		testGame			game;
+		database::database	db{game, log};
+		alphaBeta::solver	solver{log, tm, db, game};
+		vector<stateAdressStruct> states(100000, stateAdressStruct{2, 0});
+		game.setNumberOfThreads(tm.getNumThreads());
+		solver.setSearchDepth(3);
+		EXPECT_TRUE(solver.getBestChoices(states, [](size_t, unsigned int, const stateInfo&) {}));
+		EXPECT_GT(solver.getSearchStats().numNodes, 0);
+		std::wcout << L"test game: " << solver.getSearchStats().numNodes << L" nodes, " << solver.getSearchStats().getNodesPerSecond() << L" nodes/s" << std::endl;
+	}
+}
+#pragma endregion
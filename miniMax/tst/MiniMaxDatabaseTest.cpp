@@ -241,8 +241,8 @@ protected:
 		layerStats[0].numInvalidStates 	= 0;
 		layerStats[0].succLayers 		= {1, 0};
 		layerStats[0].partnerLayers 	= {1};
-		layerStats[0].skv 				= vector<miniMax::twoBit>(numSkvBytes0, miniMax::SKV_VALUE_INVALID);
-		layerStats[0].plyInfo 			= vector<miniMax::plyInfoVarType>(numKnotsInLayer0, miniMax::PLYINFO_VALUE_INVALID);
+		layerStats[0].skv 				= miniMax::database::skvArray(numSkvBytes0, miniMax::SKV_VALUE_INVALID);
+		layerStats[0].plyInfo 			= miniMax::database::plyInfoArray(numKnotsInLayer0, miniMax::PLYINFO_VALUE_INVALID);
 
 		layerStats[1].completedAndInFile = true;
 		layerStats[1].partnerLayer 		= 0;
@@ -253,15 +253,15 @@ protected:
 		layerStats[1].numInvalidStates 	= 0;
 		layerStats[1].succLayers 		= {1, 0};
 		layerStats[1].partnerLayers		 = {0};
-		layerStats[1].skv 				= vector<miniMax::twoBit>(numSkvBytes1, miniMax::SKV_VALUE_INVALID);
-		layerStats[1].plyInfo 			= vector<miniMax::plyInfoVarType>(numKnotsInLayer1, miniMax::PLYINFO_VALUE_INVALID);
+		layerStats[1].skv 				= miniMax::database::skvArray(numSkvBytes1, miniMax::SKV_VALUE_INVALID);
+		layerStats[1].plyInfo 			= miniMax::database::plyInfoArray(numKnotsInLayer1, miniMax::PLYINFO_VALUE_INVALID);
 	}
 
 	void TearDown() override {
 	}
 };
 
-void fillSkvAndPlyInfoWithRandomData(vector<miniMax::twoBit>& skv, vector<miniMax::plyInfoVarType>& plyInfo, unsigned int numKnotsInLayer0) 
+void fillSkvAndPlyInfoWithRandomData(miniMax::database::skvArray& skv, miniMax::database::plyInfoArray& plyInfo, unsigned int numKnotsInLayer0) 
 {
 	for (unsigned int i = 0; i < numKnotsInLayer0; i++) {
 		skv[i / 4] = (miniMax::twoBit)(rand() % 4);
@@ -277,8 +277,8 @@ void runGenericFileTest(
 {
 	// locals
 	miniMax::twoBit dbByte, expected_dbByte;
-	vector<miniMax::twoBit> skv, expected_skv;
-	vector<miniMax::plyInfoVarType> plyInfo, expected_plyInfo;
+	miniMax::database::skvArray skv, expected_skv;
+	miniMax::database::plyInfoArray plyInfo, expected_plyInfo;
 	miniMax::plyInfoVarType plyInfoVar, expected_plyInfoVar;
 	miniMax::database::databaseStatsStruct expected_dbStats = dbStats;
 	vector<miniMax::database::layerStatsStruct> expected_layerStats = layerStats;
@@ -302,11 +302,11 @@ void runGenericFileTest(
 	ASSERT_FALSE(gf.readSkv(0, skv));									// fails, as the database is not open
 	ASSERT_EQ(skv.size(), 0);											// skv should be unchanged
 	ASSERT_FALSE(gf.readSkv(0, dbByte, 0));
-	ASSERT_FALSE(gf.writeSkv(0, vector<miniMax::twoBit>()));
+	ASSERT_FALSE(gf.writeSkv(0, miniMax::database::skvArray()));
 	ASSERT_FALSE(gf.readPlyInfo(0, plyInfo));
 	ASSERT_EQ(plyInfo.size(), 0);										// plyInfo should be unchanged
 	ASSERT_FALSE(gf.readPlyInfo(0, plyInfoVar, 0));
-	ASSERT_FALSE(gf.writePlyInfo(0, vector<miniMax::plyInfoVarType>()));
+	ASSERT_FALSE(gf.writePlyInfo(0, miniMax::database::plyInfoArray()));
 	ASSERT_FALSE(gf.openDatabase(L"z:\\doesNotExist"));					// fails, as the folder does not exist
 
 	// Positive tests
@@ -342,6 +342,13 @@ void testGame::undo(unsigned int threadNo, unsigned int idPossibility, bool& pla
     playerToMoveChanged             = backupState->playerToMoveHasChanged;
 }
 
+bool testGame::copySituation(unsigned int fromThreadNo, unsigned int toThreadNo)
+{
+    if (fromThreadNo >= states.size() || toThreadNo >= states.size()) return false;
+    states[toThreadNo] = states[fromThreadNo];
+    return true;
+}
+
 wstring testGame::getOutputInformation(unsigned int layerNum) 
 {
     wstringstream wss;
@@ -358,6 +365,96 @@ void testGame::printField(unsigned int threadNo, twoBit value, unsigned int inde
 }
 #pragma endregion
 
+#pragma region syntheticGame
+syntheticGame::syntheticGame(unsigned int numThreads, unsigned int numPossibilities) :
+    numPossibilities(numPossibilities), positionKeys(numThreads)
+{
+    for (unsigned int threadNo = 0; threadNo < numThreads; threadNo++) {
+        setSituation(threadNo, 0, 0);
+    }
+}
+
+uint64_t syntheticGame::mix(uint64_t value)
+{
+    // splitmix64
+    value += 0x9E3779B97F4A7C15ull;
+    value  = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value  = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+void syntheticGame::getPossibilities(unsigned int threadNo, vector<unsigned int>& possibilityIds)
+{
+    for (unsigned int possibilityId = 0; possibilityId < numPossibilities; possibilityId++) {
+        possibilityIds.push_back(possibilityId);
+    }
+}
+
+unsigned int syntheticGame::getMaxNumPossibilities()
+{
+    return numPossibilities;
+}
+
+unsigned int syntheticGame::getNumberOfLayers()
+{
+    return 1;
+}
+
+unsigned int syntheticGame::getMaxNumPlies()
+{
+    return maxNumPlies;
+}
+
+unsigned int syntheticGame::getNumberOfKnotsInLayer(unsigned int layerNum)
+{
+    return 1;
+}
+
+void syntheticGame::getValueOfSituation(unsigned int threadNo, float& floatValue, twoBit& shortValue)
+{
+    floatValue = (float) (mix(positionKeys[threadNo].back()) % 2001) - 1000.0f;
+    shortValue = SKV_VALUE_GAME_DRAWN;
+}
+
+unsigned int syntheticGame::getLayerNumber(unsigned int threadNo)
+{
+    return 0;
+}
+
+bool syntheticGame::getPositionKey(unsigned int threadNo, uint64_t& positionKey)
+{
+    positionKey = positionKeys[threadNo].back();
+    return true;
+}
+
+bool syntheticGame::setSituation(unsigned int threadNo, unsigned int layerNum, unsigned int stateNumber)
+{
+    positionKeys[threadNo].clear();
+    positionKeys[threadNo].reserve(maxNumPlies + 1);
+    positionKeys[threadNo].push_back(mix(stateNumber));
+    return true;
+}
+
+void syntheticGame::move(unsigned int threadNo, unsigned int idPossibility, bool& playerToMoveChanged, void* &pBackup)
+{
+    positionKeys[threadNo].push_back(mix(positionKeys[threadNo].back() ^ idPossibility));
+    playerToMoveChanged = true;
+    pBackup             = nullptr;
+}
+
+void syntheticGame::undo(unsigned int threadNo, unsigned int idPossibility, bool& playerToMoveChanged, void* pBackup)
+{
+    positionKeys[threadNo].pop_back();
+    playerToMoveChanged = true;
+}
+
+bool syntheticGame::copySituation(unsigned int fromThreadNo, unsigned int toThreadNo)
+{
+    positionKeys[toThreadNo] = positionKeys[fromThreadNo];
+    return true;
+}
+#pragma endregion
+
 #pragma region MiniMaxTestGameFixture
 
 MiniMaxTestGameFixture::MiniMaxTestGameFixture(const string folderName)
@@ -124,6 +124,7 @@ public:
 	virtual bool			setSituation					(unsigned int threadNo, unsigned int layerNum, unsigned int stateNumber)											override;
 	virtual void			move							(unsigned int threadNo, unsigned int idPossibility, bool& playerToMoveChanged, void* &pBackup)						override;
 	virtual void			undo							(unsigned int threadNo, unsigned int idPossibility, bool& playerToMoveChanged, void*  pBackup)						override;
+	virtual bool			copySituation					(unsigned int fromThreadNo, unsigned int toThreadNo)																override;
 	
 	// output
 	virtual void			printField						(unsigned int threadNo, twoBit value, unsigned int indentSpaces = 0)												override;
@@ -131,6 +132,35 @@ public:
 	virtual wstring			getOutputInformation			(unsigned int layerNum)																								override;
 };
 
+// uniform game tree with pseudo random values, to measure the speed of the search on a larger tree than the one of testGame
+class syntheticGame : public gameInterface {
+public:
+							syntheticGame					(unsigned int numThreads, unsigned int numPossibilities);
+
+	// getter
+	virtual void			getPossibilities				(unsigned int threadNo, vector<unsigned int>& possibilityIds)														override;
+	virtual unsigned int	getMaxNumPossibilities			()																													override;
+	virtual unsigned int	getNumberOfLayers				()																													override;
+	virtual unsigned int 	getMaxNumPlies					()																													override;
+	virtual unsigned int	getNumberOfKnotsInLayer			(unsigned int layerNum)																								override;
+	virtual void			getValueOfSituation				(unsigned int threadNo, float& floatValue, twoBit& shortValue)														override;
+	virtual unsigned int	getLayerNumber					(unsigned int threadNo)																								override;
+	virtual bool			getPositionKey					(unsigned int threadNo, uint64_t& positionKey)																		override;
+
+	// setter
+	virtual bool			setSituation					(unsigned int threadNo, unsigned int layerNum, unsigned int stateNumber)											override;
+	virtual void			move							(unsigned int threadNo, unsigned int idPossibility, bool& playerToMoveChanged, void* &pBackup)						override;
+	virtual void			undo							(unsigned int threadNo, unsigned int idPossibility, bool& playerToMoveChanged, void*  pBackup)						override;
+	virtual bool			copySituation					(unsigned int fromThreadNo, unsigned int toThreadNo)																override;
+
+private:
+	static constexpr unsigned int maxNumPlies				= 64;							// maximum depth of the tree
+	unsigned int			numPossibilities;												// number of moves of each state
+	vector<vector<uint64_t>> positionKeys;													// [threadNo] keys of the states from the root to the current one
+	
+	static uint64_t			mix								(uint64_t value);
+};
+
 class MiniMaxTestGameFixture : public ::testing::Test {
 protected:
 	logger 					log{logger::logLevel::debug, logger::logType::console, L""};
@@ -116,6 +116,70 @@ TEST_F(MiniMaxRetroAnalysis_stateQueue_Test, stateQueue)
 	EXPECT_EQ(sq.getNumStatesToProcess(), 0);						// empty queue
 	EXPECT_EQ(sq.getMaxPlyInfoValue(), 3);							// max ply is 3
 }
+
+TEST_F(MiniMaxRetroAnalysis_stateQueue_Test, stateQueueSpan) 
+{
+	vector<stateAdressStruct>	states(25000);
+	vector<stateAdressStruct>	poppedStates(1000);
+	size_t						numPopped		= 0;
+	size_t						numPoppedTotal	= 0;
+	for (size_t i = 0; i < states.size(); i++) {
+		states[i] = stateAdressStruct{(stateNumberVarType) i, (unsigned char) (i % 3)};
+	}
+
+	EXPECT_FALSE(sq.pushSpan(states, 2));							// fail, since not resized
+	EXPECT_TRUE(sq.resize(2, 30000));								// more than two blocks of the cyclic array
+	EXPECT_FALSE(sq.popSpan(poppedStates, 2, numPopped));			// empty queue
+	EXPECT_EQ(numPopped, 0);
+	EXPECT_TRUE(sq.pushSpan(span(states).first(10000), 2));			// add the states in two spans
+	EXPECT_TRUE(sq.pushSpan(span(states).subspan(10000), 2));
+	EXPECT_EQ(sq.size(2), states.size());
+	EXPECT_EQ(sq.getNumStatesToProcess(), states.size());
+	EXPECT_EQ(sq.getMaxPlyInfoValue(), 2);
+	while (sq.popSpan(poppedStates, 2, numPopped)) {				// take them span by span
+		ASSERT_LE(numPoppedTotal + numPopped, states.size());
+		EXPECT_TRUE(std::equal(poppedStates.begin(), poppedStates.begin() + numPopped, states.begin() + numPoppedTotal));
+		numPoppedTotal += numPopped;
+	}
+	EXPECT_EQ(numPoppedTotal, states.size());
+	EXPECT_EQ(sq.size(2), 0);										// empty queue
+	EXPECT_EQ(sq.getNumStatesToProcess(), 0);						// empty queue
+}
+
+TEST_F(MiniMaxRetroAnalysis_stateQueue_Test, stateQueueCompression) 
+{
+	vector<stateAdressStruct>	states(20000);
+	vector<stateAdressStruct>	poppedStates(states.size());
+	stateAdressStruct			actState;
+	size_t						numPopped		= 0;
+	for (size_t i = 0; i < states.size(); i++) {					// nearly sorted runs of two layers, and a few large jumps
+		states[i] = stateAdressStruct{(stateNumberVarType) (i < 10000 ? 3 * i + i % 2 : 4000000000u - i), (unsigned char) (i / 5000)};
+	}
+
+	sq.setCompression(true);
+	EXPECT_TRUE(sq.isCompressed());
+	EXPECT_TRUE(sq.resize(1, 30000));
+	EXPECT_TRUE(sq.push_back(states[0], 1, 4000000000u));			// single state
+	EXPECT_TRUE(sq.pushSpan(span(states).subspan(1), 1));			// and all others at once
+	EXPECT_EQ(sq.size(1), states.size());
+	EXPECT_EQ(sq.getNumStatesPushed(1), states.size());
+	EXPECT_GT(sq.getNumStatesPushed(1) * sizeof(stateAdressStruct), 3 * sq.getNumBytesPushed(1));	// at least three times smaller
+	EXPECT_TRUE(sq.pop_front(actState, 1));
+	EXPECT_EQ(actState, states[0]);
+	EXPECT_TRUE(sq.popSpan(span(poppedStates).subspan(1), 1, numPopped));
+	EXPECT_EQ(numPopped, states.size() - 1);
+	EXPECT_TRUE(std::equal(states.begin() + 1, states.end(), poppedStates.begin() + 1));
+	EXPECT_FALSE(sq.pop_front(actState, 1));						// empty queue
+	EXPECT_EQ(sq.getNumStatesToProcess(), 0);
+
+	EXPECT_TRUE(sq.pushSpan(states, 1));							// taking small spans must not read bytes of the following states
+	for (size_t i = 0; i < states.size(); i += numPopped) {
+		EXPECT_TRUE(sq.popSpan(span(poppedStates).subspan(i, std::min<size_t>(7, states.size() - i)), 1, numPopped));
+		ASSERT_GT(numPopped, 0);
+	}
+	EXPECT_TRUE(std::equal(states.begin(), states.end(), poppedStates.begin()));
+	EXPECT_EQ(sq.getNumStatesToProcess(), 0);
+}
 #pragma endregion
 
 #pragma region successorCountArray
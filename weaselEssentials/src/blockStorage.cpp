@@ -0,0 +1,376 @@
+/*********************************************************************
+	blockStorage.cpp
+ 	Copyright (c) Thomas Weber. All rights reserved.
+	Licensed under the MIT License.
+	https://github.com/madweasel/madweasels-cpp
+\*********************************************************************/
+
+#include "blockStorage.h"
+
+//-----------------------------------------------------------------------------
+// Name: create()
+// Desc: Creates a block storage of the passed type. The file name is ignored for memory storages.
+//		 Returns nullptr if the storage could not be created.
+//-----------------------------------------------------------------------------
+blockStorage* blockStorage::create(type storageType, wstring const& fileName, uint64_t blockSize, uint64_t numBlocks, logger& log)
+{
+	// locals
+	blockStorage* storage = nullptr;
+
+	switch (storageType)
+	{
+	case type::memory:			storage = new memoryBlockStorage		(blockSize, numBlocks, log);			break;
+	case type::file:			storage = new fileBlockStorage			(fileName, blockSize, numBlocks, log);	break;
+	case type::mappedFile:		storage = new mappedFileBlockStorage	(fileName, blockSize, numBlocks, log);	break;
+	case type::unbufferedFile:	storage = new unbufferedFileBlockStorage(fileName, blockSize, numBlocks, log);	break;
+	}
+
+	if (storage != nullptr && !storage->isOpen()) {
+		log.log(logger::logLevel::error, L"ERROR: Could not create block storage for " + fileName);
+		delete storage;
+		return nullptr;
+	}
+	return storage;
+}
+
+//-----------------------------------------------------------------------------
+// Name: startIo()
+// Desc: Starts reading or writing a whole block. The buffer must not be touched until finishIo() was called for the request.
+//		 Storages without background I/O complete the request immediately.
+//-----------------------------------------------------------------------------
+bool blockStorage::startIo(request& ioRequest)
+{
+	if (ioRequest.isWrite) {
+		if (!writeBlock(ioRequest.block, ioRequest.buffer)) return false;
+	} else {
+		if (!readBlock (ioRequest.block, ioRequest.buffer)) return false;
+	}
+	ioRequest.pending = true;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: finishIo()
+// Desc: Waits until a request started by startIo() has completed.
+//-----------------------------------------------------------------------------
+bool blockStorage::finishIo(request& ioRequest)
+{
+	ioRequest.pending = false;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: allocBuffer()
+// Desc: Allocates a buffer for one block.
+//-----------------------------------------------------------------------------
+unsigned char* blockStorage::allocBuffer()
+{
+	return new unsigned char[blockSize];
+}
+
+//-----------------------------------------------------------------------------
+// Name: freeBuffer()
+// Desc: Frees a buffer allocated by allocBuffer().
+//-----------------------------------------------------------------------------
+void blockStorage::freeBuffer(unsigned char* buffer)
+{
+	delete [] buffer;
+}
+
+//-----------------------------------------------------------------------------
+// Name: writeDataToFile()
+// Desc: Writes 'sizeInBytes'-bytes to the position 'offset' to the file.
+//		 The file offset is passed in an OVERLAPPED structure, so that the file can be opened with or without FILE_FLAG_OVERLAPPED.
+//-----------------------------------------------------------------------------
+bool blockStorage::writeDataToFile(HANDLE hFile, uint64_t offset, unsigned int sizeInBytes, const void *pData, logger& log)
+{
+	if (hFile == NULL) return log.log(logger::logLevel::error, L"ERROR: File handle is NULL!");
+	if (sizeInBytes == 0) return true;
+	if (pData == NULL) return log.log(logger::logLevel::error, L"ERROR: Pointer to data is NULL!");
+
+	DWORD			dwBytesWritten	= 0;
+	OVERLAPPED		overlapped		= {};
+	unsigned int	restingBytes	= sizeInBytes;
+	unsigned int   	numRetries		= 0;
+	bool			ioSucceeded;
+
+	overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	while (restingBytes > 0) {
+		overlapped.Offset		= (DWORD) (offset & 0xFFFFFFFF);
+		overlapped.OffsetHigh	= (DWORD) (offset >> 32);
+		ioSucceeded				= WriteFile(hFile, pData, restingBytes, NULL, &overlapped) == TRUE || GetLastError() == ERROR_IO_PENDING;
+		ioSucceeded				= ioSucceeded && GetOverlappedResult(hFile, &overlapped, &dwBytesWritten, TRUE) == TRUE && dwBytesWritten > 0;
+		if (ioSucceeded) {
+			restingBytes -= dwBytesWritten;
+			offset		 += dwBytesWritten;
+			pData		  = (const void*) (((const unsigned char*) pData) + dwBytesWritten);
+			if (restingBytes > 0) {
+				log << L"Still " << restingBytes << L" to write!" << L"\n";
+			}
+		} else {
+			log << L"WriteFile Failed! Retry counter:" << numRetries << L"\n";
+			numRetries++;
+			if (numRetries > MAX_NUM_RETRIES) {
+				CloseHandle(overlapped.hEvent);
+				return log.log(logger::logLevel::error, L"ERROR: WriteFile failed! numRetries:" + std::to_wstring(numRetries));
+			}
+			Sleep(SLEEP_TIME_IN_MS);
+		}
+	}
+	CloseHandle(overlapped.hEvent);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: readDataFromFile()
+// Desc: Reads 'sizeInBytes'-bytes from the position 'offset' of the file.
+//		 The file offset is passed in an OVERLAPPED structure, so that the file can be opened with or without FILE_FLAG_OVERLAPPED.
+//-----------------------------------------------------------------------------
+bool blockStorage::readDataFromFile(HANDLE hFile, uint64_t offset, unsigned int sizeInBytes, void *pData, logger& log)
+{
+	if (hFile == NULL) return log.log(logger::logLevel::error, L"ERROR: File handle is NULL!");
+	if (sizeInBytes == 0) return true;
+	if (pData == NULL) return log.log(logger::logLevel::error, L"ERROR: Pointer to data is NULL!");
+
+	DWORD			dwBytesRead		= 0;
+	OVERLAPPED		overlapped		= {};
+	unsigned int	restingBytes	= sizeInBytes;
+	unsigned int   	numRetries		= 0;
+	bool			ioSucceeded;
+
+	overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	while (restingBytes > 0) {
+		overlapped.Offset		= (DWORD) (offset & 0xFFFFFFFF);
+		overlapped.OffsetHigh	= (DWORD) (offset >> 32);
+		ioSucceeded				= ReadFile(hFile, pData, restingBytes, NULL, &overlapped) == TRUE || GetLastError() == ERROR_IO_PENDING;
+		ioSucceeded				= ioSucceeded && GetOverlappedResult(hFile, &overlapped, &dwBytesRead, TRUE) == TRUE && dwBytesRead > 0;
+		if (ioSucceeded) {
+			restingBytes -= dwBytesRead;
+			offset		 += dwBytesRead;
+			pData		  = (void*) (((unsigned char*) pData) + dwBytesRead);
+			if (restingBytes > 0) {
+				log << L"Still " << restingBytes << L" to read!" << L"\n";
+			}
+		} else {
+			log << L"ReadFile Failed! Retry counter:" << numRetries << L"\n";
+			numRetries++;
+			if (numRetries > MAX_NUM_RETRIES) {
+				CloseHandle(overlapped.hEvent);
+				return log.log(logger::logLevel::error, L"ERROR: ReadFile failed! numRetries:" + std::to_wstring(numRetries));
+			}
+			Sleep(SLEEP_TIME_IN_MS);
+		}
+	}
+	CloseHandle(overlapped.hEvent);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: readBlock()
+// Desc: Copies a block from memory.
+//-----------------------------------------------------------------------------
+bool memoryBlockStorage::readBlock(uint64_t block, unsigned char* buffer)
+{
+	if ((block + 1) * blockSize > data.size()) return log.log(logger::logLevel::error, L"ERROR: Block " + std::to_wstring(block) + L" was never written!");
+	memcpy(buffer, &data[block * blockSize], blockSize);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: writeBlock()
+// Desc: Copies a block into memory. The memory grows until the highest block written so far fits into it.
+//-----------------------------------------------------------------------------
+bool memoryBlockStorage::writeBlock(uint64_t block, const unsigned char* buffer)
+{
+	if (block >= numBlocks) return log.log(logger::logLevel::error, L"ERROR: Block " + std::to_wstring(block) + L" is out of range!");
+	if ((block + 1) * blockSize > data.size()) {
+		data.resize((block + 1) * blockSize);
+	}
+	memcpy(&data[block * blockSize], buffer, blockSize);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: fileBlockStorage()
+// Desc: Opens the file for overlapped I/O. Further flags, like FILE_FLAG_NO_BUFFERING, can be passed.
+//-----------------------------------------------------------------------------
+fileBlockStorage::fileBlockStorage(wstring const& fileName, uint64_t blockSize, uint64_t numBlocks, logger& log, DWORD flags) :
+	blockStorage(blockSize, numBlocks, log)
+{
+	// Open Database-File (FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH | FILE_FLAG_RANDOM_ACCESS)
+	hFile = CreateFile(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | flags, NULL);
+
+	// opened file succesfully
+	if (hFile == INVALID_HANDLE_VALUE) {
+		hFile = NULL;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name: ~fileBlockStorage()
+// Desc: Closes the file.
+//-----------------------------------------------------------------------------
+fileBlockStorage::~fileBlockStorage()
+{
+	if (hFile != NULL) CloseHandle(hFile);
+}
+
+//-----------------------------------------------------------------------------
+// Name: readBlock()
+// Desc: Reads a block synchronously from the file.
+//-----------------------------------------------------------------------------
+bool fileBlockStorage::readBlock(uint64_t block, unsigned char* buffer)
+{
+	return readDataFromFile(hFile, block * blockSize, (unsigned int) blockSize, buffer, log);
+}
+
+//-----------------------------------------------------------------------------
+// Name: writeBlock()
+// Desc: Writes a block synchronously to the file.
+//-----------------------------------------------------------------------------
+bool fileBlockStorage::writeBlock(uint64_t block, const unsigned char* buffer)
+{
+	return writeDataToFile(hFile, block * blockSize, (unsigned int) blockSize, buffer, log);
+}
+
+//-----------------------------------------------------------------------------
+// Name: startIo()
+// Desc: Starts reading or writing a whole block in the background using overlapped I/O.
+//		 If the request cannot be started asynchronously, it is done synchronously.
+//-----------------------------------------------------------------------------
+bool fileBlockStorage::startIo(request& ioRequest)
+{
+	// locals
+	uint64_t	offset	= ioRequest.block * blockSize;
+	HANDLE		hEvent	= ioRequest.overlapped.hEvent;
+	BOOL		started;
+
+	// without event there is nothing to overlap
+	if (hEvent == NULL) {
+		return blockStorage::startIo(ioRequest);
+	}
+
+	ioRequest.overlapped			= {};
+	ioRequest.overlapped.Offset		= (DWORD) (offset & 0xFFFFFFFF);
+	ioRequest.overlapped.OffsetHigh	= (DWORD) (offset >> 32);
+	ioRequest.overlapped.hEvent		= hEvent;
+
+	// start request
+	ResetEvent(hEvent);
+	if (ioRequest.isWrite) {
+		started = WriteFile(hFile, ioRequest.buffer, (DWORD) blockSize, NULL, &ioRequest.overlapped) == TRUE || GetLastError() == ERROR_IO_PENDING;
+	} else {
+		started = ReadFile (hFile, ioRequest.buffer, (DWORD) blockSize, NULL, &ioRequest.overlapped) == TRUE || GetLastError() == ERROR_IO_PENDING;
+	}
+	if (!started) {
+		return blockStorage::startIo(ioRequest);
+	}
+	ioRequest.pending = true;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: finishIo()
+// Desc: Waits until a request started by startIo() has completed. A failed or incomplete request is repeated synchronously.
+//-----------------------------------------------------------------------------
+bool fileBlockStorage::finishIo(request& ioRequest)
+{
+	// locals
+	DWORD	numBytesTransferred = 0;
+
+	if (!ioRequest.pending) return true;
+	ioRequest.pending = false;
+
+	if (GetOverlappedResult(hFile, &ioRequest.overlapped, &numBytesTransferred, TRUE) == TRUE && numBytesTransferred == blockSize) {
+		return true;
+	}
+	log << L"Overlapped I/O of block " << ioRequest.block << L" failed! Retrying synchronously." << L"\n";
+	return ioRequest.isWrite ? writeBlock(ioRequest.block, ioRequest.buffer) : readBlock(ioRequest.block, ioRequest.buffer);
+}
+
+//-----------------------------------------------------------------------------
+// Name: unbufferedFileBlockStorage()
+// Desc: Opens the file bypassing the file cache. The block size must be a multiple of the sector size.
+//-----------------------------------------------------------------------------
+unbufferedFileBlockStorage::unbufferedFileBlockStorage(wstring const& fileName, uint64_t blockSize, uint64_t numBlocks, logger& log) :
+	fileBlockStorage(fileName, blockSize, numBlocks, log, FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING)
+{
+	if (blockSize % SECTOR_SIZE != 0 && hFile != NULL) {
+		log.log(logger::logLevel::error, L"ERROR: Block size " + std::to_wstring(blockSize) + L" is not a multiple of the sector size " + std::to_wstring(SECTOR_SIZE) + L"!");
+		CloseHandle(hFile);
+		hFile = NULL;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name: allocBuffer()
+// Desc: Allocates a page aligned buffer, as required by FILE_FLAG_NO_BUFFERING.
+//-----------------------------------------------------------------------------
+unsigned char* unbufferedFileBlockStorage::allocBuffer()
+{
+	return (unsigned char*) VirtualAlloc(NULL, blockSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+}
+
+//-----------------------------------------------------------------------------
+// Name: freeBuffer()
+// Desc: Frees a buffer allocated by allocBuffer().
+//-----------------------------------------------------------------------------
+void unbufferedFileBlockStorage::freeBuffer(unsigned char* buffer)
+{
+	if (buffer != nullptr) VirtualFree(buffer, 0, MEM_RELEASE);
+}
+
+//-----------------------------------------------------------------------------
+// Name: mappedFileBlockStorage()
+// Desc: Creates the file with the size of all blocks and maps it completely into the address space.
+//-----------------------------------------------------------------------------
+mappedFileBlockStorage::mappedFileBlockStorage(wstring const& fileName, uint64_t blockSize, uint64_t numBlocks, logger& log) :
+	blockStorage(blockSize, numBlocks, log)
+{
+	// locals
+	uint64_t fileSize = blockSize * numBlocks;
+
+	hFile = CreateFile(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		hFile = NULL;
+		return;
+	}
+	hMapping = CreateFileMapping(hFile, NULL, PAGE_READWRITE, (DWORD) (fileSize >> 32), (DWORD) (fileSize & 0xFFFFFFFF), NULL);
+	if (hMapping == NULL) return;
+	view = (unsigned char*) MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+}
+
+//-----------------------------------------------------------------------------
+// Name: ~mappedFileBlockStorage()
+// Desc: Unmaps and closes the file.
+//-----------------------------------------------------------------------------
+mappedFileBlockStorage::~mappedFileBlockStorage()
+{
+	if (view     != nullptr) UnmapViewOfFile(view);
+	if (hMapping != NULL)    CloseHandle(hMapping);
+	if (hFile    != NULL)    CloseHandle(hFile);
+}
+
+//-----------------------------------------------------------------------------
+// Name: readBlock()
+// Desc: Copies a block from the mapped file.
+//-----------------------------------------------------------------------------
+bool mappedFileBlockStorage::readBlock(uint64_t block, unsigned char* buffer)
+{
+	if (block >= numBlocks) return log.log(logger::logLevel::error, L"ERROR: Block " + std::to_wstring(block) + L" is out of range!");
+	memcpy(buffer, view + block * blockSize, blockSize);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: writeBlock()
+// Desc: Copies a block into the mapped file.
+//-----------------------------------------------------------------------------
+bool mappedFileBlockStorage::writeBlock(uint64_t block, const unsigned char* buffer)
+{
+	if (block >= numBlocks) return log.log(logger::logLevel::error, L"ERROR: Block " + std::to_wstring(block) + L" is out of range!");
+	memcpy(view + block * blockSize, buffer, blockSize);
+	return true;
+}
@@ -0,0 +1,139 @@
+/*********************************************************************\
+	blockStorage.h
+ 	Copyright (c) Thomas Weber. All rights reserved.
+	Licensed under the MIT License.
+	https://github.com/madweasel/madweasels-cpp
+\*********************************************************************/
+#ifndef BLOCK_STORAGE_H
+#define BLOCK_STORAGE_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include "logger.h"
+
+using namespace std;
+
+/*** Description *********************************************************
+ * blockStorage is the backing store of a cyclicArray. It holds 'numBlocks' blocks of 'blockSize' bytes each,
+ * which are always read and written as a whole. The following implementations exist:
+ *  - memory:			a growable memory buffer. Only the blocks written so far occupy memory.
+ *  - file:				a file, accessed by positional overlapped I/O. Reads and writes can run in the background.
+ *  - mappedFile:		a memory mapped file. The operating system decides which blocks are kept in memory.
+ *  - unbufferedFile:	a file opened with FILE_FLAG_NO_BUFFERING, so that huge queues do not fill the file cache.
+ *						The block size must be a multiple of the sector size and the buffers are page aligned.
+ * Buffers passed to readBlock() and writeBlock() must be allocated with allocBuffer().
+ * The classes are not thread-safe.
+**************************************************************************/
+
+class blockStorage
+{
+public:
+	// Types
+	enum class type { memory, file, mappedFile, unbufferedFile };
+
+	struct request														// read or write of a whole block, which may run in the background
+	{
+		OVERLAPPED					overlapped			= {};			// file offset and completion event of the request
+		unsigned char*				buffer				= nullptr;		// block being read or written
+		uint64_t					block				= 0;			// index of the block
+		bool						isWrite				= false;		// true for a write, false for a read
+		bool						pending				= false;		// true until finishIo() was called for the request
+
+									request				()				{ overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL); }
+									~request			()				{ if (overlapped.hEvent != NULL) CloseHandle(overlapped.hEvent); }
+									request				(const request&) = delete;
+		request&					operator=			(const request&) = delete;
+	};
+
+	// Constructor / destructor
+	static blockStorage*			create				(type storageType, wstring const& fileName, uint64_t blockSize, uint64_t numBlocks, logger& log);
+	virtual							~blockStorage		() {}
+
+	// Functions
+	virtual bool					isOpen				() const = 0;
+	virtual bool					readBlock			(uint64_t block, unsigned char* buffer) = 0;
+	virtual bool					writeBlock			(uint64_t block, const unsigned char* buffer) = 0;
+	virtual bool					startIo				(request& ioRequest);
+	virtual bool					finishIo			(request& ioRequest);
+	virtual unsigned char*			allocBuffer			();
+	virtual void					freeBuffer			(unsigned char* buffer);
+	uint64_t						getBlockSize		() const { return blockSize; }
+	uint64_t						getNumBlocks		() const { return numBlocks; }
+
+	// Helper for files opened with or without FILE_FLAG_OVERLAPPED
+	static bool						writeDataToFile		(HANDLE hFile, uint64_t offset, unsigned int sizeInBytes, const void *pData, logger& log);
+	static bool						readDataFromFile	(HANDLE hFile, uint64_t offset, unsigned int sizeInBytes, void *pData, logger& log);
+
+protected:
+	// Constants
+	static const unsigned int 		MAX_NUM_RETRIES		= 10;			// max number of retries for reading/writing to file
+	static const unsigned int 		SLEEP_TIME_IN_MS	= 1000;			// sleep time in ms for waiting for file access
+
+	// Variables
+	logger& 						log;								// logger, used for output
+	const uint64_t					blockSize;							// size in bytes of a block
+	const uint64_t					numBlocks;							// amount of blocks
+
+									blockStorage		(uint64_t blockSize, uint64_t numBlocks, logger& log) : log(log), blockSize(blockSize), numBlocks(numBlocks) {}
+};
+
+class memoryBlockStorage : public blockStorage
+{
+public:
+									memoryBlockStorage	(uint64_t blockSize, uint64_t numBlocks, logger& log) : blockStorage(blockSize, numBlocks, log) {}
+
+	bool							isOpen				() const override { return true; }
+	bool							readBlock			(uint64_t block, unsigned char* buffer) override;
+	bool							writeBlock			(uint64_t block, const unsigned char* buffer) override;
+
+private:
+	vector<unsigned char>			data;								// blocks written so far, grows on demand
+};
+
+class fileBlockStorage : public blockStorage
+{
+public:
+									fileBlockStorage	(wstring const& fileName, uint64_t blockSize, uint64_t numBlocks, logger& log, DWORD flags = FILE_FLAG_OVERLAPPED);
+									~fileBlockStorage	();
+
+	bool							isOpen				() const override { return hFile != NULL; }
+	bool							readBlock			(uint64_t block, unsigned char* buffer) override;
+	bool							writeBlock			(uint64_t block, const unsigned char* buffer) override;
+	bool							startIo				(request& ioRequest) override;
+	bool							finishIo			(request& ioRequest) override;
+
+protected:
+	HANDLE							hFile				= NULL;			// Handle of the file
+};
+
+class unbufferedFileBlockStorage : public fileBlockStorage
+{
+public:
+	static const uint64_t			SECTOR_SIZE			= 4096;			// block size and buffers must be aligned to the sector size of the disk
+
+									unbufferedFileBlockStorage(wstring const& fileName, uint64_t blockSize, uint64_t numBlocks, logger& log);
+
+	unsigned char*					allocBuffer			() override;
+	void							freeBuffer			(unsigned char* buffer) override;
+};
+
+class mappedFileBlockStorage : public blockStorage
+{
+public:
+									mappedFileBlockStorage(wstring const& fileName, uint64_t blockSize, uint64_t numBlocks, logger& log);
+									~mappedFileBlockStorage();
+
+	bool							isOpen				() const override { return view != nullptr; }
+	bool							readBlock			(uint64_t block, unsigned char* buffer) override;
+	bool							writeBlock			(uint64_t block, const unsigned char* buffer) override;
+
+private:
+	HANDLE							hFile				= NULL;			// Handle of the file
+	HANDLE							hMapping			= NULL;			// Handle of the file mapping
+	unsigned char*					view				= nullptr;		// mapped view of the whole file
+};
+
+#endif
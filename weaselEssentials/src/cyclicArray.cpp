@@ -11,8 +11,8 @@
 // Name: cyclicArray()
 // Desc: Creates a cyclic array. The passed file is used as temporary data buffer for the cyclic array.
 //-----------------------------------------------------------------------------
-cyclicArray::cyclicArray(unsigned int blockSizeInBytes, unsigned int numberOfBlocks, wstring const& fileName, logger& log) :
-	hFile(NULL), blockSize(blockSizeInBytes), numBlocks(numberOfBlocks), readingBlock(nullptr), writingBlock(nullptr), log(log)
+cyclicArray::cyclicArray(unsigned int blockSizeInBytes, unsigned int numberOfBlocks, wstring const& fileName, logger& log, blockStorage::type storageType) :
+	storage(nullptr), blockSize(blockSizeInBytes), numBlocks(numberOfBlocks), readingBlock(nullptr), writingBlock(nullptr), spareWritingBlock(nullptr), prefetchBlock(nullptr), log(log)
 {
 	// checks
 	if (blockSize > MAX_BLOCK_SIZE) return;
@@ -21,22 +21,19 @@ cyclicArray::cyclicArray(unsigned int blockSizeInBytes, unsigned int numberOfBlo
 	if (fileName.length() > MAX_PATH_LENGTH) return;
 	if (blockSize == 0) return;
 	if (numBlocks == 0) return;
-	if (fileName.length() == 0) return;
+	if (fileName.length() == 0 && storageType != blockStorage::type::memory) return;
+
+	// Open storage
+	storage = blockStorage::create(storageType, fileName, blockSize, numBlocks, log);
+	if (storage == nullptr) return;
 
 	// Init blocks
-	readingBlock			= new unsigned char[blockSize];
-	writingBlock			= new unsigned char[blockSize];
+	readingBlock			= storage->allocBuffer();
+	writingBlock			= storage->allocBuffer();
+	spareWritingBlock		= storage->allocBuffer();
+	prefetchBlock			= storage->allocBuffer();
 	reset();
 	log.log(logger::logLevel::trace, L"cyclicArray created: " + fileName + L" with blockSize: " + std::to_wstring(blockSize) + L" bytes and " + std::to_wstring(numBlocks) + L" blocks.");
-	
-	// Open Database-File (FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH | FILE_FLAG_RANDOM_ACCESS)
-	hFile = CreateFile(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-
-	// opened file succesfully
-	if (hFile == INVALID_HANDLE_VALUE) {
-		hFile = NULL;
-		return;
-	}
 }
 
 //-----------------------------------------------------------------------------
@@ -45,12 +42,21 @@ cyclicArray::cyclicArray(unsigned int blockSizeInBytes, unsigned int numberOfBlo
 //-----------------------------------------------------------------------------
 cyclicArray::~cyclicArray()
 {
+	// storage without buffers
+	if (storage == nullptr) return;
+
+	// the buffers must not be freed while the system is still using them
+	finishIo(writeRequest);
+	finishIo(prefetchRequest);
+
 	// delete arrays
-	if (readingBlock != nullptr) delete [] readingBlock;
-	if (writingBlock != nullptr) delete [] writingBlock;
+	storage->freeBuffer(readingBlock);
+	storage->freeBuffer(writingBlock);
+	storage->freeBuffer(spareWritingBlock);
+	storage->freeBuffer(prefetchBlock);
 
 	// close file
-	if (hFile != NULL) CloseHandle(hFile);
+	delete storage;
 }
 
 //-----------------------------------------------------------------------------
@@ -59,6 +65,10 @@ cyclicArray::~cyclicArray()
 //-----------------------------------------------------------------------------
 void cyclicArray::reset()
 {
+	// pending writes must reach the file, a prefetched block is discarded
+	finishIo(writeRequest);
+	finishIo(prefetchRequest);
+
 	curReadingPos		= 0;
 	curWritingPos		= 0;
 	curReadingPointer	= writingBlock;
@@ -69,95 +79,51 @@ void cyclicArray::reset()
 }
 
 //-----------------------------------------------------------------------------
-// Name: writeDataToFile()
-// Desc: Writes 'sizeInBytes'-bytes to the position 'offset' to the file.
+// Name: startIo()
+// Desc: Starts reading or writing a whole block in the background. 
+//		 The buffer must not be touched until finishIo() was called for the request.
 //-----------------------------------------------------------------------------
-bool cyclicArray::writeDataToFile(HANDLE hFile, uint64_t offset, unsigned int sizeInBytes, void *pData)
+bool cyclicArray::startIo(blockStorage::request& request, bool isWrite, uint64_t block, unsigned char* buffer)
 {
-	if (hFile == NULL) return log.log(logger::logLevel::error, L"ERROR: File handle is NULL!");
-	if (sizeInBytes == 0) return true;
-	if (pData == NULL) return log.log(logger::logLevel::error, L"ERROR: Pointer to data is NULL!");
-	if (sizeInBytes > MAX_BLOCK_SIZE) return log.log(logger::logLevel::error, L"ERROR: Size of data to write is too large! sizeInBytes:" + std::to_wstring(sizeInBytes) + L" bytes!");
-	if (offset < 0) return log.log(logger::logLevel::error, L"ERROR: Offset is negative! offset:" + std::to_wstring(offset) + L" bytes!");
-	if (offset + sizeInBytes > MAX_FILE_SIZE) return log.log(logger::logLevel::error, L"ERROR: Offset + sizeInBytes is greater than max file size! offset:" + std::to_wstring(offset) + L" bytes! sizeInBytes:" + std::to_wstring(sizeInBytes) + L" bytes!");
-
-	DWORD			dwBytesWritten;
-	LARGE_INTEGER	liDistanceToMove;
-	unsigned int	restingBytes = sizeInBytes;
-	unsigned int   	numRetries	 = 0;
-
-	liDistanceToMove.QuadPart = offset;
-
-	while (!SetFilePointerEx(hFile, liDistanceToMove, NULL, FILE_BEGIN)) {
-		log << L"SetFilePointerEx  failed! Retry counter:" << numRetries << L"\n";
-		numRetries++;
-		if (numRetries > MAX_NUM_RETRIES) return false;
-		Sleep(SLEEP_TIME_IN_MS);
-	}
-	
-	while (restingBytes > 0) {
-		if (WriteFile(hFile, pData, sizeInBytes, &dwBytesWritten, NULL) == TRUE) {
-			restingBytes -= dwBytesWritten;
-			pData		  = (void*) (((unsigned char*) pData) + dwBytesWritten);
-			if (restingBytes > 0) {
-				log << L"Still " << restingBytes << L" to write!" << L"\n";
-			}
-		} else {
-			log << L"WriteFile Failed! Retry counter:" << numRetries << L"\n";
-			numRetries++;
-			if (numRetries > MAX_NUM_RETRIES) {
-				return log.log(logger::logLevel::error, L"ERROR: WriteFile failed! numRetries:" + std::to_wstring(numRetries));
-			}
-			Sleep(SLEEP_TIME_IN_MS);
-		}
+	request.buffer					= buffer;
+	request.block					= block;
+	request.isWrite					= isWrite;
+
+	// in synchronous mode there is nothing to overlap
+	if (!asyncIo) {
+		return isWrite ? storage->writeBlock(block, buffer) : storage->readBlock(block, buffer);
 	}
-	return true;
+	return storage->startIo(request);
 }
 
 //-----------------------------------------------------------------------------
-// Name: readDataFromFile()
-// Desc: Reads 'sizeInBytes'-bytes from the position 'offset' of the file.
+// Name: finishIo()
+// Desc: Waits until a request started by startIo() has completed.
 //-----------------------------------------------------------------------------
-bool cyclicArray::readDataFromFile(HANDLE hFile, uint64_t offset, unsigned int sizeInBytes, void *pData)
+bool cyclicArray::finishIo(blockStorage::request& request)
 {
-	if (hFile == NULL) return log.log(logger::logLevel::error, L"ERROR: File handle is NULL!");
-	if (sizeInBytes == 0) return true;
-	if (pData == NULL) return log.log(logger::logLevel::error, L"ERROR: Pointer to data is NULL!");
-	if (sizeInBytes > MAX_BLOCK_SIZE) return log.log(logger::logLevel::error, L"ERROR: Size of data to read is too large! sizeInBytes:" + std::to_wstring(sizeInBytes) + L" bytes!");
-	if (offset < 0) return log.log(logger::logLevel::error, L"ERROR: Offset is negative! offset:" + std::to_wstring(offset) + L" bytes!");
-	if (offset + sizeInBytes > MAX_FILE_SIZE) return log.log(logger::logLevel::error, L"ERROR: Offset + sizeInBytes is greater than max file size! offset:" + std::to_wstring(offset) + L" bytes! sizeInBytes:" + std::to_wstring(sizeInBytes) + L" bytes!");
-
-	DWORD			dwBytesRead;
-	LARGE_INTEGER	liDistanceToMove;
-	unsigned int	restingBytes = sizeInBytes;
-	unsigned int   	numRetries	 = 0;
-
-	liDistanceToMove.QuadPart = offset;
-
-	while (!SetFilePointerEx(hFile, liDistanceToMove, NULL, FILE_BEGIN)) {
-		log << L"SetFilePointerEx failed! Retry counter:" << numRetries << L"\n";
-		numRetries++;
-		if (numRetries > MAX_NUM_RETRIES) return false;
-		Sleep(SLEEP_TIME_IN_MS);
-	}
-	
-	while (restingBytes > 0) {
-		if (ReadFile(hFile, pData, sizeInBytes, &dwBytesRead, NULL) == TRUE) {
-			restingBytes -= dwBytesRead;
-			pData		  = (void*) (((unsigned char*) pData) + dwBytesRead);
-			if (restingBytes > 0) {
-				log << L"Still " << restingBytes << L" to read!" << L"\n";
-			}
-		} else {
-			log << "ReadFile Failed! Retry counter:" << numRetries << L"\n";
-			numRetries++;
-			if (numRetries > MAX_NUM_RETRIES) {
-				return log.log(logger::logLevel::error, L"ERROR: ReadFile failed! numRetries:" + std::to_wstring(numRetries));
-			}
-			Sleep(SLEEP_TIME_IN_MS);
-		}
-	}
-	return true;
+	return storage == nullptr || storage->finishIo(request);
+}
+
+//-----------------------------------------------------------------------------
+// Name: prefetchNextBlock()
+// Desc: Starts reading the block after the current reading block into the prefetch buffer.
+//		 Must only be called when the current reading block is read from the file. Then the next block is either
+//		 the writing block, which is not in the file, or a full block.
+//-----------------------------------------------------------------------------
+bool cyclicArray::prefetchNextBlock()
+{
+	// locals
+	uint64_t	nextBlock	= (curReadingBlock + 1) % numBlocks;
+
+	if (!asyncIo)							return true;
+	if (prefetchRequest.pending)			return true;
+	if (nextBlock == curWritingBlock)		return true;
+
+	// overlapped requests are not ordered, so the block is not read while it is still written
+	if (writeRequest.pending && writeRequest.block == nextBlock) return true;
+
+	return startIo(prefetchRequest, false, nextBlock, prefetchBlock);
 }
 
 //-----------------------------------------------------------------------------
@@ -212,36 +178,41 @@ bool cyclicArray::addBytes(unsigned int numBytes, const unsigned char* pData)
 	// checks
 	if (numBytes == 0) return true;
 	if (pData == NULL) return log.log(logger::logLevel::error, L"ERROR: Pointer to data is NULL!");
-	if (hFile == NULL) return log.log(logger::logLevel::error, L"ERROR: File handle is NULL!");
+	if (storage == nullptr) return log.log(logger::logLevel::error, L"ERROR: Storage is not open!");
 	if (numBytes > writeableBytes()) return log.log(logger::logLevel::error, L"ERROR: Not enough space in cyclic array! numBytes:" + std::to_wstring(numBytes) + L" bytes! writeableBytes:" + std::to_wstring(writeableBytes()) + L" bytes!");
 
 	// locals
 	unsigned int	bytesWritten = 0;
+	unsigned int	bytesToCopy;
 
-	// write each byte
+	// write block by block
 	while (bytesWritten < numBytes) {
 
-		// store byte in current reading block
-		*curWritingPointer = *pData;
-		curWritingPointer++;
-		curWritingPos++;
-		bytesWritten++;
-		pData++;
+		// store as many bytes as fit into the current writing block
+		bytesToCopy = (unsigned int) std::min<uint64_t>(numBytes - bytesWritten, writingBlock + blockSize - curWritingPointer);
+		memcpy(curWritingPointer, pData, bytesToCopy);
+		curWritingPointer	+= bytesToCopy;
+		curWritingPos		+= bytesToCopy;
+		bytesWritten		+= bytesToCopy;
+		pData				+= bytesToCopy;
 
 		// when block is full then save current one to file and begin new one
 		if (curWritingPointer == writingBlock + blockSize) {
 
-			// copy data into reading block, if reading block is the same as writing block
+			// if the reading pointer is in the writing block, then the full block becomes the reading block.
+			// it is never read from the file, so it does not need to be written there. curReadingPointer stays valid.
 			if (curReadingBlock == curWritingBlock) {
-				memcpy(readingBlock, writingBlock, blockSize);
-				// until now the reading pointer was using the writing block
-				// now it has to use the reading block
-				curReadingPointer = readingBlock + (curReadingPointer - writingBlock);
-			}
+				std::swap(readingBlock, writingBlock);
 
-			// store block in file
-			if (!writeDataToFile(hFile, blockSize * curWritingBlock, blockSize, writingBlock)) {
-				return log.log(logger::logLevel::error, L"ERROR: writeDataToFile failed! curWritingBlock:" + std::to_wstring(curWritingBlock) + L" bytesWritten:" + std::to_wstring(bytesWritten) + L" bytes!");
+			// otherwise store block in file in the background and continue in the spare writing block, as soon as its previous write has finished
+			} else {
+				if (!finishIo(writeRequest)) {
+					return log.log(logger::logLevel::error, L"ERROR: Writing block " + std::to_wstring(writeRequest.block) + L" failed! curWritingBlock:" + std::to_wstring(curWritingBlock) + L" bytesWritten:" + std::to_wstring(bytesWritten) + L" bytes!");
+				}
+				std::swap(writingBlock, spareWritingBlock);
+				if (!startIo(writeRequest, true, curWritingBlock, spareWritingBlock)) {
+					return log.log(logger::logLevel::error, L"ERROR: Writing block failed! curWritingBlock:" + std::to_wstring(curWritingBlock) + L" bytesWritten:" + std::to_wstring(bytesWritten) + L" bytes!");
+				}
 			}
 
 			// set pointer to beginnig of writing block
@@ -268,21 +239,25 @@ bool cyclicArray::takeBytes(unsigned int numBytes, unsigned char* pData)
 	// checks
 	if (numBytes == 0) return true;
 	if (pData == NULL) return log.log(logger::logLevel::error, L"ERROR: Pointer to data is NULL!");
-	if (hFile == NULL) return log.log(logger::logLevel::error, L"ERROR: File handle is NULL!");
+	if (storage == nullptr) return log.log(logger::logLevel::error, L"ERROR: Storage is not open!");
 	if (bytesAvailable() < numBytes) return log.log(logger::logLevel::error, L"ERROR: Not enough data in cyclic array! numBytes:" + std::to_wstring(numBytes) + L" bytes! bytesAvailable:" + std::to_wstring(bytesAvailable()) + L" bytes!");
 
 	// locals
-	unsigned int bytesRead = 0;
+	unsigned int	bytesRead = 0;
+	unsigned int	bytesToCopy;
+	unsigned char*	curBlockStart;
 
-	// read each byte 
+	// read block by block
 	while (bytesRead < numBytes) {
 
-		// read current byte
-		*pData = *curReadingPointer;
-		curReadingPointer++;
-		curReadingPos++;
-		bytesRead++;
-		pData++;
+		// take as many bytes as the current block contains. in the writing block bytesAvailable() ensures that only written bytes are taken.
+		curBlockStart	= (curReadingBlock == curWritingBlock && readWriteInSameRound) ? writingBlock : readingBlock;
+		bytesToCopy		= (unsigned int) std::min<uint64_t>(numBytes - bytesRead, curBlockStart + blockSize - curReadingPointer);
+		memcpy(pData, curReadingPointer, bytesToCopy);
+		curReadingPointer	+= bytesToCopy;
+		curReadingPos		+= bytesToCopy;
+		bytesRead			+= bytesToCopy;
+		pData				+= bytesToCopy;
 
 		// load next block?
 		if (curReadingPointer == readingBlock + blockSize) {
@@ -300,12 +275,29 @@ bool cyclicArray::takeBytes(unsigned int numBytes, unsigned char* pData)
 
 			} else {
 			
+				// use the prefetched block
+				if (prefetchRequest.pending && prefetchRequest.block == curReadingBlock) {
+					if (!finishIo(prefetchRequest)) {
+						return log.log(logger::logLevel::error, L"ERROR: Prefetching failed! curReadingBlock:" + std::to_wstring(curReadingBlock) + L" bytesRead:" + std::to_wstring(bytesRead) + L" bytes!");
+					}
+					std::swap(readingBlock, prefetchBlock);
+
+				// or read whole block from file, after it has been written completely
+				} else {
+					if (writeRequest.pending && writeRequest.block == curReadingBlock && !finishIo(writeRequest)) {
+						return log.log(logger::logLevel::error, L"ERROR: Writing block " + std::to_wstring(curReadingBlock) + L" failed! bytesRead:" + std::to_wstring(bytesRead) + L" bytes!");
+					}
+					if (!storage->readBlock(curReadingBlock, readingBlock)) {
+						return log.log(logger::logLevel::error, L"ERROR: Reading block failed! curReadingBlock:" + std::to_wstring(curReadingBlock) + L" bytesRead:" + std::to_wstring(bytesRead) + L" bytes!");
+					}
+				}
+
 				// set pointer to beginnig of reading block
 				curReadingPointer	= readingBlock;
 
-				// read whole block from file
-				if (!readDataFromFile(hFile, blockSize * curReadingBlock, blockSize, readingBlock)) {
-					return log.log(logger::logLevel::error, L"ERROR: readDataFromFile failed! curReadingBlock:" + std::to_wstring(curReadingBlock) + L" bytesRead:" + std::to_wstring(bytesRead) + L" bytes!");
+				// read the following block in the background
+				if (!prefetchNextBlock()) {
+					return log.log(logger::logLevel::error, L"ERROR: Prefetching failed! curReadingBlock:" + std::to_wstring(curReadingBlock) + L" bytesRead:" + std::to_wstring(bytesRead) + L" bytes!");
 				}
 			}
 		}
@@ -334,7 +326,7 @@ bool cyclicArray::loadFile(wstring const& fileName, uint64_t &numBytesLoaded)
 						numBytesLoaded		= 0;
 
 	// cyclic array file must be open
-	if (hFile == NULL) return log.log(logger::logLevel::error, L"ERROR: File handle is NULL!");
+	if (storage == nullptr) return log.log(logger::logLevel::error, L"ERROR: Storage is not open!");
 
 	// Open Database-File (FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH | FILE_FLAG_RANDOM_ACCESS)
 	hLoadFile = CreateFile(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
@@ -365,7 +357,7 @@ bool cyclicArray::loadFile(wstring const& fileName, uint64_t &numBytesLoaded)
 	for (curBlock=0; curBlock<numBlocksInFile-1; curBlock++, curOffset += blockSize) {
 		
 		// load data from file
-		if (!readDataFromFile(hLoadFile, curOffset, blockSize, dataInFile)) {
+		if (!blockStorage::readDataFromFile(hLoadFile, curOffset, (unsigned int) blockSize, dataInFile, log)) {
 			delete [] dataInFile;
 			CloseHandle(hLoadFile);
 			return log.log(logger::logLevel::error, L"ERROR: readDataFromFile failed! curBlock:" + std::to_wstring(curBlock) + L" bytesLoaded:" + std::to_wstring(numBytesLoaded) + L" bytes!");
@@ -380,7 +372,7 @@ bool cyclicArray::loadFile(wstring const& fileName, uint64_t &numBytesLoaded)
 	}
 
 	// last block
-	readDataFromFile(hLoadFile, curOffset, numBytesInLastBlock, dataInFile); 
+	blockStorage::readDataFromFile(hLoadFile, curOffset, (unsigned int) numBytesInLastBlock, dataInFile, log); 
 	if (!addBytes(numBytesInLastBlock, dataInFile)) {
 		delete [] dataInFile;
 		CloseHandle(hLoadFile);
@@ -416,8 +408,13 @@ bool cyclicArray::saveFile(wstring const& fileName)
 	void	*			pointer;
 
 	// cyclic array file must be open
-	if (hFile == NULL) {
-		return log.log(logger::logLevel::error, L"ERROR: File handle is NULL!");
+	if (storage == nullptr) {
+		return log.log(logger::logLevel::error, L"ERROR: Storage is not open!");
+	}
+
+	// blocks are read from the file below
+	if (!finishIo(writeRequest)) {
+		return log.log(logger::logLevel::error, L"ERROR: Writing block " + std::to_wstring(writeRequest.block) + L" failed!");
 	}
 
 	// Open Database-File (FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH | FILE_FLAG_RANDOM_ACCESS)
@@ -430,7 +427,7 @@ bool cyclicArray::saveFile(wstring const& fileName)
 
 	// alloc mem
 	curBlock			= curReadingBlock;
-	dataInFile			= new unsigned char[blockSize];
+	dataInFile			= storage->allocBuffer();
 	totalBytesToWrite	= bytesAvailable();
 	totalBytesWritten	= 0;
 
@@ -457,18 +454,18 @@ bool cyclicArray::saveFile(wstring const& fileName)
 			bytesToWrite = blockSize - (curReadingPointer - readingBlock);
 		// store data from file
 		} else {
-			if (!readDataFromFile(hFile, curBlock * blockSize, blockSize, dataInFile)) {
-				delete [] dataInFile;
+			if (!storage->readBlock(curBlock, dataInFile)) {
+				storage->freeBuffer(dataInFile);
 				CloseHandle(hSaveFile);
-				return log.log(logger::logLevel::error, L"ERROR: readDataFromFile failed! curBlock:" + std::to_wstring(curBlock) + L" bytesWritten:" + std::to_wstring(totalBytesWritten) + L" bytes!");
+				return log.log(logger::logLevel::error, L"ERROR: Reading block failed! curBlock:" + std::to_wstring(curBlock) + L" bytesWritten:" + std::to_wstring(totalBytesWritten) + L" bytes!");
 			}
 			pointer		 = dataInFile;
 			bytesToWrite = blockSize;
 		}
 
 		// save data to file
-		if (!writeDataToFile(hSaveFile, totalBytesWritten, bytesToWrite, pointer)) {
-			delete [] dataInFile;
+		if (!blockStorage::writeDataToFile(hSaveFile, totalBytesWritten, (unsigned int) bytesToWrite, pointer, log)) {
+			storage->freeBuffer(dataInFile);
 			CloseHandle(hSaveFile);
 			return log.log(logger::logLevel::error, L"ERROR: writeDataToFile failed! curBlock:" + std::to_wstring(curBlock) + L" bytesWritten:" + std::to_wstring(totalBytesWritten) + L" bytes!");
 		}
@@ -479,13 +476,13 @@ bool cyclicArray::saveFile(wstring const& fileName)
 
 	// exceeded maximum iterations?
 	if (iterationCount >= MAX_ITERATIONS && totalBytesWritten < totalBytesToWrite) {
-		delete [] dataInFile;
+		storage->freeBuffer(dataInFile);
 		CloseHandle(hSaveFile);
 		return log.log(logger::logLevel::error, L"ERROR: saveFile exceeded maximum iterations, possible corrupted state!");
 	}
 
 	// everything ok
-	delete [] dataInFile;
+	storage->freeBuffer(dataInFile);
 	CloseHandle(hSaveFile);
 	return true;
 }
@@ -12,17 +12,24 @@
 #include <string>
 
 #include "logger.h"
+#include "blockStorage.h"
 
 using namespace std;
 
 /*** Description *********************************************************
  * cyclicArray is a class for cyclic data access.
- * The class uses a file as temporary data buffer for the cyclic array.
+ * The class uses a blockStorage as temporary data buffer for the cyclic array, by default a file.
+ * Small arrays can be kept in memory, huge ones can bypass the file cache. See blockStorage.h.
  * The class is designed for high performance file access of single bytes, on a very large file.
  * The reading and writing operations are buffered in memory, and are only written to the file when the buffer is full.
+ * The blocks are double-buffered: a full writing block is written to the storage in the background, e.g. using overlapped I/O,
+ * while the next block is filled in the spare writing buffer. Likewise, the block following the current reading block
+ * is read into a prefetch buffer in the background, so that takeBytes() seldom has to wait for the file.
+ * A block, which is still filled while it is read, is never written to the file. When it is full it becomes the reading block.
+ * So a reader close behind the writer is served from memory only.
  * The class is not thread-safe. 
  * 
- * |-------------------------------------------------|   <- File on disk (hFile)
+ * |-------------------------------------------------|   <- File on disk (storage)
  * | Block 0 | Block 1 | Block 2 | Block 3 | Block N |
  * |xxxxxxxxx|         |         |xxxxxxxxx|         |   <- blocks loaded in memory (readingBlock, writingBlock)
  * |        ^						^				 |
@@ -39,14 +46,17 @@ private:
 	static const uint64_t 			MAX_NUM_BLOCKS		= 1e8;			// 1 Million
 	static const uint64_t 			MAX_FILE_SIZE		= 1e15;			// 1 PetaByte
 	static const unsigned int 		MAX_PATH_LENGTH		= 260;			// max length of a path
-	static const unsigned int 		MAX_NUM_RETRIES		= 10;			// max number of retries for reading/writing to file
-	static const unsigned int 		SLEEP_TIME_IN_MS	= 1000;			// sleep time in ms for waiting for file access
 
 	// Variables
 	logger& 						log;								// logger, used for output
-	HANDLE							hFile;								// Handle of the file
+	blockStorage*					storage;							// blocks, which are not in memory
 	unsigned char*					readingBlock;						// Array of size [blockSize] containing the data of the block, where reading is taking place
 	unsigned char*					writingBlock;						//			''
+	unsigned char*					spareWritingBlock;					// second writing buffer, which is written to the file in the background while writingBlock is filled
+	unsigned char*					prefetchBlock;						// second reading buffer, into which the block after curReadingBlock is read in the background
+	blockStorage::request			writeRequest;						// background write of spareWritingBlock
+	blockStorage::request			prefetchRequest;					// background read into prefetchBlock
+	bool							asyncIo				= true;			// false if blocks are read and written synchronously
 	unsigned char*  				curReadingPointer;					// pointer to the byte which is currently read
 	unsigned char*  				curWritingPointer;					//			''
 	uint64_t						curReadingPos;						// position in the file, where reading is taking place
@@ -58,12 +68,13 @@ private:
 	bool							readWriteInSameRound;				// true if curReadingBlock > curWritingBlock, false otherwise
 
 	// Functions	
-	bool 							writeDataToFile			(HANDLE hFile, uint64_t offset, unsigned int sizeInBytes, void *pData);
-	bool 							readDataFromFile		(HANDLE hFile, uint64_t offset, unsigned int sizeInBytes, void *pData);
+	bool							startIo					(blockStorage::request& request, bool isWrite, uint64_t block, unsigned char* buffer);
+	bool							finishIo				(blockStorage::request& request);
+	bool							prefetchNextBlock		();
 
 public:	
     // Constructor / destructor	
-    								cyclicArray				(unsigned int blockSizeInBytes, unsigned int numberOfBlocks, wstring const& fileName, logger& log);
+    								cyclicArray				(unsigned int blockSizeInBytes, unsigned int numberOfBlocks, wstring const& fileName, logger& log, blockStorage::type storageType = blockStorage::type::file);
     								~cyclicArray			();
 
 	// Functions	
@@ -75,6 +86,7 @@ public:
 	uint64_t						bytesAvailable			() const;
 	uint64_t 						writeableBytes			() const;
 	uint64_t						getNumBlocks			() const { return numBlocks; }
+	void							setAsyncIo				(bool enabled) { asyncIo = enabled; }
 };
 
 #endif
@@ -0,0 +1,174 @@
+/*********************************************************************
+	threadCountTuner.cpp
+ 	Copyright (c) Thomas Weber. All rights reserved.
+	Licensed under the MIT License.
+	https://github.com/madweasel/madweasels-cpp
+\*********************************************************************/
+
+#include "threadCountTuner.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+
+//-----------------------------------------------------------------------------
+// Name: getPhaseOfSize()
+// Desc: Returns the name of the phase extended by the size class of workSize, e.g. "alphaBeta@4^10".
+//		 The size classes are powers of four, so that the work sizes within a class differ by less than a factor of four.
+//-----------------------------------------------------------------------------
+wstring threadCountTuner::getPhaseOfSize(const wstring& phase, int64_t workSize)
+{
+	unsigned int sizeClass = 0;
+	while (workSize >= 4) {
+		workSize >>= 2;
+		sizeClass++;
+	}
+	return phase + L"@4^" + to_wstring(sizeClass);
+}
+
+//-----------------------------------------------------------------------------
+// Name: setMaxNumThreads()
+// Desc: Sets the upper limit of the thread count. Phases tuned for another limit are tuned again.
+//-----------------------------------------------------------------------------
+void threadCountTuner::setMaxNumThreads(unsigned int maxNumThreads)
+{
+	if (maxNumThreads == 0 || maxNumThreads == this->maxNumThreads) return;
+	this->maxNumThreads = maxNumThreads;
+	phases.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Name: getNumThreads()
+// Desc: Returns the number of threads for the next execution of the phase.
+//-----------------------------------------------------------------------------
+unsigned int threadCountTuner::getNumThreads(const wstring& phaseName)
+{
+	phaseInfo& phase = phases[phaseName];
+	if (phase.trialNumThreads == 0) {
+		phase.trialNumThreads = maxNumThreads;
+	}
+	return phase.trialNumThreads;
+}
+
+//-----------------------------------------------------------------------------
+// Name: addMeasurement()
+// Desc: Passes the throughput of an execution of the phase. Measurements of a tuned phase,
+//		 of another thread count than the current trial, or of too short executions are ignored.
+//-----------------------------------------------------------------------------
+void threadCountTuner::addMeasurement(const wstring& phaseName, unsigned int numThreads, int64_t numStates, double seconds)
+{
+	// locals
+	auto itPhase = phases.find(phaseName);
+
+	// use this measurement?
+	if (itPhase == phases.end())							return;
+	phaseInfo& phase = itPhase->second;
+	if (phase.tuned)										return;
+	if (numThreads != phase.trialNumThreads)				return;
+	if (numStates <= 0 || seconds < minTrialSeconds)		return;
+
+	// keep the best thread count
+	double throughput = numStates / seconds;
+	phase.throughputs[numThreads] = throughput;
+	if (phase.bestNumThreads == 0) {
+		phase.bestNumThreads	= numThreads;
+		phase.bestThroughput	= throughput;
+		phase.stepSize			= std::max<unsigned int>(1, maxNumThreads / 2);
+	} else if (throughput > phase.bestThroughput * (1 + minImprovement)) {
+		phase.bestNumThreads	= numThreads;
+		phase.bestThroughput	= throughput;
+	}
+	chooseNextTrial(phase);
+}
+
+//-----------------------------------------------------------------------------
+// Name: chooseNextTrial()
+// Desc: Tries the untested neighbours of the best thread count.
+//		 If both are slower, the step size is halved. The hill-climb ends after step size 1.
+//-----------------------------------------------------------------------------
+void threadCountTuner::chooseNextTrial(phaseInfo& phase)
+{
+	while (phase.stepSize > 0) {
+		unsigned int lower = phase.bestNumThreads - phase.stepSize;
+		unsigned int upper = phase.bestNumThreads + phase.stepSize;
+		if (phase.bestNumThreads > phase.stepSize && !phase.throughputs.count(lower)) {
+			phase.trialNumThreads = lower;
+			return;
+		}
+		if (upper <= maxNumThreads && !phase.throughputs.count(upper)) {
+			phase.trialNumThreads = upper;
+			return;
+		}
+		phase.stepSize /= 2;
+	}
+	phase.tuned				= true;
+	phase.trialNumThreads	= phase.bestNumThreads;
+}
+
+//-----------------------------------------------------------------------------
+// Name: isTuned()
+// Desc: Returns true if the best thread count of the phase has been found.
+//-----------------------------------------------------------------------------
+bool threadCountTuner::isTuned(const wstring& phaseName) const
+{
+	auto itPhase = phases.find(phaseName);
+	return itPhase != phases.end() && itPhase->second.tuned;
+}
+
+//-----------------------------------------------------------------------------
+// Name: clear()
+// Desc: Forgets all measurements.
+//-----------------------------------------------------------------------------
+void threadCountTuner::clear()
+{
+	phases.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Name: load()
+// Desc: Reads the tuned thread counts saved by save(). Entries for another maximum number of threads are ignored.
+//		 Returns false if the file could not be read.
+//-----------------------------------------------------------------------------
+bool threadCountTuner::load(const wstring& filePath)
+{
+	// locals
+	wifstream		file{filesystem::path(filePath)};
+	wstring			line;
+
+	if (!file.is_open()) return false;
+
+	// one line per phase: name, best thread count, throughput, maximum thread count
+	while (getline(file, line)) {
+		wstringstream	ss(line);
+		wstring			phaseName;
+		unsigned int	bestNumThreads	= 0;
+		double			bestThroughput	= 0;
+		unsigned int	savedMaxThreads	= 0;
+		if (!(ss >> phaseName >> bestNumThreads >> bestThroughput >> savedMaxThreads)) continue;
+		if (savedMaxThreads != maxNumThreads || bestNumThreads == 0 || bestNumThreads > maxNumThreads) continue;
+
+		phaseInfo& phase		= phases[phaseName];
+		phase.bestNumThreads	= bestNumThreads;
+		phase.bestThroughput	= bestThroughput;
+		phase.trialNumThreads	= bestNumThreads;
+		phase.stepSize			= 0;
+		phase.tuned				= true;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: save()
+// Desc: Writes the thread counts of all tuned phases into a text file. Returns false if the file could not be written.
+//-----------------------------------------------------------------------------
+bool threadCountTuner::save(const wstring& filePath) const
+{
+	wofstream file{filesystem::path(filePath), ios::trunc};
+	if (!file.is_open()) return false;
+
+	for (auto& [phaseName, phase] : phases) {
+		if (!phase.tuned) continue;
+		file << phaseName << L" " << phase.bestNumThreads << L" " << phase.bestThroughput << L" " << maxNumThreads << L"\n";
+	}
+	return file.good();
+}
@@ -0,0 +1,65 @@
+/*********************************************************************\
+	threadCountTuner.h
+ 	Copyright (c) Thomas Weber. All rights reserved.
+	Licensed under the MIT License.
+	https://github.com/madweasel/madweasels-cpp
+\*********************************************************************/
+#ifndef THREAD_COUNT_TUNER_H
+#define THREAD_COUNT_TUNER_H
+
+#include <string>
+#include <map>
+#include <cstdint>
+
+using namespace std;
+
+/*** Description *********************************************************
+ * threadCountTuner chooses the number of threads for each phase of a calculation.
+ * A phase is identified by its name, e.g. "alphaBeta" or "retroAnalysis", and is executed many times, e.g. once per layer.
+ * The first executions of a phase are used as trials: each one runs with another number of threads and its throughput
+ * (states per second) is measured. Starting with the maximum number of threads a hill-climb with decreasing step size
+ * searches the best number. Afterwards each execution of the phase uses this number.
+ * Since the throughput also depends on the amount of work, e.g. on the size of a layer, the caller should pass the phase name returned by
+ * getPhaseOfSize(). Then only executions with a similar amount of work are compared with each other.
+ * The results can be saved to a file and loaded in the next run, so that the trials are only done once per machine.
+ * The class is not thread-safe.
+**************************************************************************/
+
+class threadCountTuner
+{
+public:
+	// Constants
+	static constexpr double			minTrialSeconds			= 0.05;				// shorter executions are too noisy and not used as trial
+	static constexpr double			minImprovement			= 0.05;				// a thread count must be 5% faster to replace the best one
+
+	// Functions
+	static wstring					getPhaseOfSize			(const wstring& phase, int64_t workSize);
+	void							setMaxNumThreads		(unsigned int maxNumThreads);
+	unsigned int					getMaxNumThreads		() const { return maxNumThreads; };
+	unsigned int					getNumThreads			(const wstring& phase);
+	void							addMeasurement			(const wstring& phase, unsigned int numThreads, int64_t numStates, double seconds);
+	bool							isTuned					(const wstring& phase) const;
+	void							clear					();
+	bool							load					(const wstring& filePath);
+	bool							save					(const wstring& filePath) const;
+
+private:
+	struct phaseInfo
+	{
+		unsigned int				bestNumThreads			= 0;				// thread count with the highest throughput so far, 0 if nothing was measured yet
+		double						bestThroughput			= 0;				// states per second of bestNumThreads
+		unsigned int				trialNumThreads			= 0;				// thread count of the next execution
+		unsigned int				stepSize				= 0;				// distance of the neighbours of bestNumThreads, which are tried next
+		bool						tuned					= false;			// true if the hill-climb has finished
+		map<unsigned int, double>	throughputs;								// [numThreads] measured states per second, so that no count is tried twice
+	};
+
+	// Variables
+	unsigned int					maxNumThreads			= 1;				// upper limit, normally the number of threads set by the user
+	map<wstring, phaseInfo>			phases;										// [phase name]
+
+	// Functions
+	void							chooseNextTrial			(phaseInfo& phase);
+};
+
+#endif
@@ -7,15 +7,22 @@
 
 #include "threadManager.h"
 
+thread_local threadManagerClass*	threadManagerClass::currentTaskManager		= nullptr;
+thread_local unsigned int			threadManagerClass::currentTaskThreadNo		= 0;
+thread_local uint32_t				threadManagerClass::stealSeed				= 0;
+thread_local threadManagerClass::threadProfile*	threadManagerClass::currentProfile	= nullptr;
+
 //-----------------------------------------------------------------------------
 // Name: threadItem()
 // Desc: threadItem class constructor
 //-----------------------------------------------------------------------------
 threadManagerClass::threadItem::threadItem()
 {
-	threadNo 	= 0;
-	hThread		= NULL;
-	threadId	= 0;
+	threadNo 		= 0;
+	hThread			= NULL;
+	threadId		= 0;
+	threadManager	= nullptr;
+	numaNode		= -1;
 }
 
 //-----------------------------------------------------------------------------
@@ -40,6 +47,8 @@ threadManagerClass::threadManagerClass()
 	SYSTEM_INFO		m_si			= {0};
 	GetSystemInfo(&m_si);
 	numThreads						= m_si.dwNumberOfProcessors;
+	userNumThreads					= numThreads;
+	tuner.setMaxNumThreads(numThreads);
 	resizeArrays();
 	reset();
 }
@@ -52,11 +61,15 @@ threadManagerClass::~threadManagerClass()
 {
 	cancelExecution();
 	waitForAllThreadsToTerminate();
+	stopWorkers();
+	delete pBarrier;
 }
 
 //-----------------------------------------------------------------------------
 // Name: resizeArrays()
 // Desc: Resizes the arrays. Returns false if any thread is running.
+//		 The arrays never shrink. Workers with a number above numThreads stay parked and do not take part in the jobs.
+//		 Only if more workers are needed than ever before, the workers are recreated, since each one refers to its item in 'threads'.
 //-----------------------------------------------------------------------------
 bool threadManagerClass::resizeArrays()
 {
@@ -64,50 +77,187 @@ bool threadManagerClass::resizeArrays()
 	if (anyThreadRunning()) {
 		return false;
 	}
-	threads.resize(numThreads);
+	if (numThreads > threads.size()) {
+		stopWorkers();
+		threads.resize(numThreads);
+		taskDeques.resize(numThreads);
+		taskPools.resize(numThreads);
+	}
+	for (auto& deque : taskDeques) {
+		if (!deque) deque = std::make_unique<workStealingDeque<taskItem>>();
+	}
+	for (auto& pool : taskPools) {
+		if (!pool) pool = std::make_unique<taskPool>();
+	}
 	if (pBarrier) {
 		delete pBarrier;
 		pBarrier = nullptr;
 	}
 	pBarrier = new std::barrier(numThreads);
-	for (unsigned int i=0; i<numThreads; i++) {
-		threads[i].threadNo = i;
+	for (unsigned int i=0; i<threads.size(); i++) {
+		threads[i].threadNo 		= i;
+		threads[i].threadManager	= this;
 	}
 	return true;
 }
 
 //-----------------------------------------------------------------------------
-// Name: reset()
-// Desc: Resets to the initial state.
+// Name: startWorkers()
+// Desc: Creates the worker threads, if not done yet. They wait for jobs passed by runJob().
 //-----------------------------------------------------------------------------
-void threadManagerClass::reset()
+bool threadManagerClass::startWorkers()
 {
-	cancelExecution();
-	waitForAllThreadsToTerminate();
-	terminateAllThreads				= false;
-	executionPaused					= false;
-	executionCancelled				= false;
-	anyThreadOnLastIteration		= false;
+	// already started?
+	if (threads.size() && threads[0].hThread) return true;
+
+	// locals
+	SIZE_T			dwStackSize		= 0;							// initital stack size of each thread. 0 means default size ~1MB
+
+	// new workers start waiting for the job after generation zero
+	shutdownWorkers	= false;
+	jobGeneration	= 0;
+	for (auto& thread : threads) {
+		thread.hThread = CreateThread(NULL, dwStackSize, workerThreadProc, (LPVOID) &thread, CREATE_SUSPENDED, &thread.threadId);
+		if (thread.hThread == NULL) {
+			stopWorkers();
+			return false;
+		}
+		SetThreadPriority(thread.hThread, THREAD_PRIORITY_BELOW_NORMAL);
+	}
+	if (pinThreads) {
+		pinWorkers();
+	}
+
+	// start threads. in pause mode they park at the first checkpoint of a job.
+	for (auto& thread : threads) {
+		ResumeThread(thread.hThread);
+	}
+	return true;
 }
 
 //-----------------------------------------------------------------------------
-// Name: waitForAllThreadsToTerminate()
-// Desc: Waits for all threads to terminate.
+// Name: pinWorkers()
+// Desc: Binds each worker thread to one logical processor. The processors are ordered by NUMA node, 
+//		 so that the contiguous blocks of neighbouring threads in TM_SCHEDULE_STATIC are processed on the same node.
 //-----------------------------------------------------------------------------
-void threadManagerClass::waitForAllThreadsToTerminate()
+void threadManagerClass::pinWorkers()
+{
+	// locals
+	ULONG						highestNode		= 0;
+	vector<GROUP_AFFINITY>		processors;										// one entry for each logical processor
+	vector<int>					processorNode;									// NUMA node of each entry in 'processors'
+
+	// collect all logical processors, node by node
+	if (!GetNumaHighestNodeNumber(&highestNode)) return;
+	for (ULONG node = 0; node <= highestNode; node++) {
+		GROUP_AFFINITY nodeMask = {0};
+		if (!GetNumaNodeProcessorMaskEx((USHORT) node, &nodeMask)) continue;
+		for (unsigned int bit = 0; bit < sizeof(KAFFINITY) * 8; bit++) {
+			if (!(nodeMask.Mask & ((KAFFINITY) 1 << bit))) continue;
+			GROUP_AFFINITY processor = {0};
+			processor.Group	= nodeMask.Group;
+			processor.Mask	= (KAFFINITY) 1 << bit;
+			processors.push_back(processor);
+			processorNode.push_back((int) node);
+		}
+	}
+	if (processors.empty()) return;
+
+	// spread the threads evenly over all processors
+	for (auto& thread : threads) {
+		size_t processorId = (size_t) thread.threadNo * processors.size() / threads.size();
+		if (SetThreadGroupAffinity(thread.hThread, &processors[processorId], NULL)) {
+			thread.numaNode = processorNode[processorId];
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name: setThreadPinning()
+// Desc: Enables or disables binding each worker thread to one logical processor. The workers are recreated on the next execution.
+//		 Returns false if any thread is running.
+//-----------------------------------------------------------------------------
+bool threadManagerClass::setThreadPinning(bool enabled)
+{
+	if (anyThreadRunning()) return false;
+	if (pinThreads == enabled) return true;
+	pinThreads = enabled;
+	stopWorkers();
+	for (auto& thread : threads) {
+		thread.numaNode = -1;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: getNumaNodeOfThread()
+// Desc: Returns the NUMA node the thread is bound to. Returns -1 if the thread is not pinned or does not exist.
+//-----------------------------------------------------------------------------
+int threadManagerClass::getNumaNodeOfThread(unsigned int threadNo)
 {
-	// checks
-	if (numThreads == 0) return;
-	if (!anyThreadRunning()) return;
+	if (threadNo >= numThreads) return -1;
+	return threads[threadNo].numaNode;
+}
+
+//-----------------------------------------------------------------------------
+// Name: getBytesPerNumaNode()
+// Desc: Estimates how many bytes of the array are located on each NUMA node, by querying up to 'maxNumSamples' pages.
+//		 Pages not yet touched are not counted. The returned vector has one element per node.
+//-----------------------------------------------------------------------------
+vector<long long> threadManagerClass::getBytesPerNumaNode(const void* data, size_t sizeInBytes)
+{
+	// locals
+	static constexpr size_t		maxNumSamples	= 1024;
+	ULONG						highestNode		= 0;
+	SYSTEM_INFO					si				= {0};
+
+	GetSystemInfo(&si);
+	if (!GetNumaHighestNodeNumber(&highestNode)) highestNode = 0;
+	vector<long long> bytesPerNode(highestNode + 1, 0);
+	if (data == nullptr || sizeInBytes == 0 || si.dwPageSize == 0) return bytesPerNode;
+
+	// sample pages evenly distributed over the array
+	size_t numPages		= (sizeInBytes + si.dwPageSize - 1) / si.dwPageSize;
+	size_t numSamples	= std::min<size_t>(numPages, maxNumSamples);
+	vector<PSAPI_WORKING_SET_EX_INFORMATION> samples(numSamples);
+	for (size_t i = 0; i < numSamples; i++) {
+		samples[i].VirtualAddress = (PVOID) ((const char*) data + (i * numPages / numSamples) * si.dwPageSize);
+	}
+	if (!QueryWorkingSetEx(GetCurrentProcess(), samples.data(), (DWORD) (samples.size() * sizeof(PSAPI_WORKING_SET_EX_INFORMATION)))) {
+		return bytesPerNode;
+	}
+
+	// extrapolate to the whole array
+	for (auto& sample : samples) {
+		if (!sample.VirtualAttributes.Valid) continue;
+		if (sample.VirtualAttributes.Node > highestNode) continue;
+		bytesPerNode[sample.VirtualAttributes.Node] += (long long) (sizeInBytes / numSamples);
+	}
+	return bytesPerNode;
+}
 
+//-----------------------------------------------------------------------------
+// Name: stopWorkers()
+// Desc: Lets the worker threads exit and waits for them. Must not be called while a job is running.
+//-----------------------------------------------------------------------------
+void threadManagerClass::stopWorkers()
+{
 	// map member variable of vector items to linear array
 	vector<HANDLE> hThreads;
 	for (auto& thread : threads) {
-		hThreads.push_back(thread.hThread);
+		if (thread.hThread) hThreads.push_back(thread.hThread);
+	}
+	if (hThreads.empty()) return;
+
+	// wake up all workers
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		shutdownWorkers = true;
 	}
+	poolWakeUp.notify_all();
 
 	// wait for every thread to end
-	WaitForMultipleObjects(numThreads, hThreads.data(), TRUE, INFINITE);
+	WaitForMultipleObjects((DWORD) hThreads.size(), hThreads.data(), TRUE, INFINITE);
 
 	// Close all thread handles upon completion.
 	for (auto& thread : threads) {
@@ -119,6 +269,121 @@ void threadManagerClass::waitForAllThreadsToTerminate()
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Name: workerThreadProc()
+// Desc: Main function of each worker thread. Waits for a new job, executes it and waits again.
+//-----------------------------------------------------------------------------
+DWORD WINAPI threadManagerClass::workerThreadProc(LPVOID lpParameter)
+{
+	// locals
+	threadItem &			thread			= *((threadItem *) lpParameter);
+	threadManagerClass &	tm				= *thread.threadManager;
+	uint64_t				lastGeneration	= 0;
+
+	while (true) {
+
+		// wait for a new job. parked workers are not part of it.
+		std::unique_lock<std::mutex> lock(tm.poolMutex);
+		tm.poolWakeUp.wait(lock, [&] { return tm.shutdownWorkers || (tm.jobGeneration != lastGeneration && thread.threadNo < tm.numJobThreads); });
+		if (tm.shutdownWorkers) break;
+		lastGeneration = tm.jobGeneration;
+		lock.unlock();
+
+		// execute
+		tm.job(thread.threadNo);
+
+		// the last worker wakes up the waiting thread
+		lock.lock();
+		if (--tm.numWorkersBusy == 0) {
+			tm.poolJobDone.notify_all();
+		}
+	}
+	return TM_RETURN_VALUE_OK;
+}
+
+//-----------------------------------------------------------------------------
+// Name: runJob()
+// Desc: Passes a job to all worker threads and waits until each of them finished it.
+//-----------------------------------------------------------------------------
+unsigned int threadManagerClass::runJob(std::function<void(unsigned int threadNo)> newJob)
+{
+	if (!startWorkers()) return TM_RETURN_VALUE_UNEXPECTED_ERROR;
+
+	// locals
+	auto wallStart = std::chrono::steady_clock::now();
+
+	// let each worker measure its execution in its own slot
+	if (profilingEnabled) {
+		profileSlots.assign(numThreads, profileSlot{});
+		newJob = [this, userJob = std::move(newJob)](unsigned int threadNo) {
+			threadProfile& profile	= profileSlots[threadNo].profile;
+			auto start				= std::chrono::steady_clock::now();
+			currentProfile			= &profile;
+			userJob(threadNo);
+			currentProfile			= nullptr;
+			profile.busySeconds		= std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() - profile.barrierWaitSeconds - profile.pausedSeconds;
+		};
+	}
+
+	// wake up the workers
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		job				= std::move(newJob);
+		numWorkersBusy	= numThreads;
+		numJobThreads	= numThreads;
+		jobGeneration++;
+	}
+	poolWakeUp.notify_all();
+
+	// wait for every thread to finish
+	waitForAllThreadsToTerminate();
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		job				= nullptr;
+		numJobThreads	= 0;
+	}
+
+	// collect the measurements. the workers do not touch their slots anymore.
+	lastProfile = executionProfile{};
+	if (profilingEnabled) {
+		lastProfile.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+		for (auto& slot : profileSlots) {
+			lastProfile.threads.push_back(slot.profile);
+		}
+	}
+
+	// everything ok
+	if (executionCancelled) {
+		return TM_RETURN_VALUE_EXECUTION_CANCELLED;
+	} else {
+		return TM_RETURN_VALUE_OK;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name: reset()
+// Desc: Resets to the initial state.
+//-----------------------------------------------------------------------------
+void threadManagerClass::reset()
+{
+	cancelExecution();
+	waitForAllThreadsToTerminate();
+	terminateAllThreads				= false;
+	executionPaused					= false;
+	executionCancelled				= false;
+	anyThreadOnLastIteration		= false;
+}
+
+//-----------------------------------------------------------------------------
+// Name: waitForAllThreadsToTerminate()
+// Desc: Waits until all threads finished the current execution. The worker threads themselves stay alive.
+//-----------------------------------------------------------------------------
+void threadManagerClass::waitForAllThreadsToTerminate()
+{
+	std::unique_lock<std::mutex> lock(poolMutex);
+	poolJobDone.wait(lock, [this] { return numWorkersBusy == 0; });
+}
+
 //-----------------------------------------------------------------------------
 // Name: waitForOtherThreads()
 // Desc: Waits for all other threads to reach the barrier.
@@ -135,8 +400,15 @@ void threadManagerClass::waitForAllThreadsToTerminate()
 //-----------------------------------------------------------------------------
 void threadManagerClass::waitForOtherThreads()
 {
+	pausePoint();
 	if (anyThreadOnLastIteration) return;	// no need to wait if the last iteration is reached
-	pBarrier->arrive_and_wait(); 
+	if (currentProfile) {
+		auto start = std::chrono::steady_clock::now();
+		pBarrier->arrive_and_wait(); 
+		currentProfile->barrierWaitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} else {
+		pBarrier->arrive_and_wait(); 
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -150,16 +422,25 @@ unsigned int threadManagerClass::getNumThreads()
 
 //-----------------------------------------------------------------------------
 // Name: anyThreadRunning()
-// Desc: Returns true if any thread is running.
+// Desc: Returns true if any thread is executing a job. Waiting worker threads do not count.
 //-----------------------------------------------------------------------------
 bool threadManagerClass::anyThreadRunning()
 {
-	for (auto& thread : threads) {
-		if (thread.hThread) {
-			return true;
-		}
+	std::lock_guard<std::mutex> lock(poolMutex);
+	return numWorkersBusy > 0;
+}
+
+//-----------------------------------------------------------------------------
+// Name: getNumTaskItems()
+// Desc: Returns the number of task items allocated by all workers for spawn(). Must not be called during executeTasks().
+//-----------------------------------------------------------------------------
+size_t threadManagerClass::getNumTaskItems()
+{
+	size_t numItems = 0;
+	for (auto& pool : taskPools) {
+		numItems += pool->items.size();
 	}
-	return false;
+	return numItems;
 }
 
 //-----------------------------------------------------------------------------
@@ -169,37 +450,216 @@ bool threadManagerClass::anyThreadRunning()
 bool threadManagerClass::setNumThreads(unsigned int newNumThreads)
 {
 	if (newNumThreads == 0) return false;
-	if (newNumThreads == numThreads) return true;
+	if (newNumThreads == numThreads && newNumThreads == userNumThreads) return true;
 
 	// cancel if any thread running
 	if (anyThreadRunning()) {
 		return false;
 	}
+	if (!changeNumThreads(newNumThreads)) {
+		return false;
+	}
+	userNumThreads = newNumThreads;
+	tuner.setMaxNumThreads(newNumThreads);
+	reset();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: changeNumThreads()
+// Desc: Changes the number of threads taking part in the executions. Returns false if any thread is running.
+//-----------------------------------------------------------------------------
+bool threadManagerClass::changeNumThreads(unsigned int newNumThreads)
+{
+	if (newNumThreads == numThreads) return true;
+	unsigned int oldNumThreads = numThreads;
 	numThreads = newNumThreads;
 	if (!resizeArrays()) {
+		numThreads = oldNumThreads;
 		return false;
 	}
-	reset();
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// Name: setAutoTuning()
+// Desc: Enables or disables choosing the number of threads of each phase by its throughput.
+//		 The number of threads set by setNumThreads() is the upper limit. Returns false if any thread is running.
+//-----------------------------------------------------------------------------
+bool threadManagerClass::setAutoTuning(bool enabled)
+{
+	if (anyThreadRunning()) return false;
+	autoTuning = enabled;
+	if (!enabled) {
+		curPhase.clear();
+		changeNumThreads(userNumThreads);
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: beginPhase()
+// Desc: Sets the number of threads chosen by the tuner for the phase and starts the time measurement.
+//		 workSize is the expected number of states processed by the phase. Since the throughput depends on it, 
+//		 executions of the phase are only compared with others of a similar size. 
+//		 Must be called before the per thread variables are created with getNumThreads(). Does nothing if auto tuning is disabled.
+//-----------------------------------------------------------------------------
+void threadManagerClass::beginPhase(const wstring& phaseName, int64_t workSize)
+{
+	if (!autoTuning || anyThreadRunning()) return;
+	wstring phaseOfSize = threadCountTuner::getPhaseOfSize(phaseName, workSize);
+	if (!changeNumThreads(tuner.getNumThreads(phaseOfSize))) return;
+	curPhase	= phaseOfSize;
+	phaseStart	= std::chrono::steady_clock::now();
+}
+
+//-----------------------------------------------------------------------------
+// Name: endPhase()
+// Desc: Passes the throughput since beginPhase() to the tuner and restores the number of threads set by the user.
+//		 Cancelled phases are not measured.
+//-----------------------------------------------------------------------------
+void threadManagerClass::endPhase(int64_t numStatesProcessed)
+{
+	if (curPhase.empty()) return;
+	if (!executionCancelled) {
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - phaseStart).count();
+		tuner.addMeasurement(curPhase, numThreads, numStatesProcessed, seconds);
+	}
+	curPhase.clear();
+	changeNumThreads(userNumThreads);
+}
+
 //-----------------------------------------------------------------------------
 // Name: pauseExecution()
-// Desc: Suspends all threads. Call this function again to resume execution. 
+// Desc: Pauses all threads at their next checkpoint. Call this function again to resume execution. 
+//		 In contrast to suspending the threads, no thread is stopped while holding a lock.
 //-----------------------------------------------------------------------------
 void threadManagerClass::pauseExecution()
 {
+	bool paused = !executionPaused.load();
+	executionPaused.store(paused);
+	if (!paused) {
+		executionPaused.notify_all();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name: parkWhilePaused()
+// Desc: Called by pausePoint(). Blocks the calling thread without spinning until the execution is resumed or cancelled.
+//-----------------------------------------------------------------------------
+void threadManagerClass::parkWhilePaused()
+{
+	auto start = startChunk();
+	numThreadsParked++;
+	while (executionPaused.load(std::memory_order_acquire)) {
+		executionPaused.wait(true, std::memory_order_acquire);
+	}
+	numThreadsParked--;
+	if (currentProfile) {
+		currentProfile->pausedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name: setProfiling()
+// Desc: Enables or disables measuring the execution of each thread. Returns false if any thread is running.
+//-----------------------------------------------------------------------------
+bool threadManagerClass::setProfiling(bool enabled)
+{
+	if (anyThreadRunning()) return false;
+	profilingEnabled = enabled;
+	if (!enabled) {
+		profileSlots.clear();
+		lastProfile = executionProfile{};
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: finishChunk()
+// Desc: Adds a processed chunk to the measurements of the current thread, if profiling is enabled.
+//-----------------------------------------------------------------------------
+void threadManagerClass::finishChunk(std::chrono::steady_clock::time_point chunkStart, int64_t numIterations)
+{
+	if (!currentProfile) return;
+
+	// locals
+	int64_t			microseconds	= std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - chunkStart).count();
+	unsigned int	bucket			= 0;
+
+	while (microseconds > 0 && bucket < threadProfile::numHistogramBuckets - 1) {
+		microseconds >>= 1;
+		bucket++;
+	}
+	currentProfile->chunkHistogram[bucket]++;
+	currentProfile->numChunks++;
+	currentProfile->numIterations += numIterations;
+}
+
+//-----------------------------------------------------------------------------
+// Name: getImbalance()
+// Desc: Returns the maximum busy time of all threads divided by the average one. 
+//		 1 means that all threads were busy for the same time. Returns 0 if nothing was measured.
+//-----------------------------------------------------------------------------
+double threadManagerClass::executionProfile::getImbalance() const
+{
+	double maxBusy		= 0;
+	double sumBusy		= 0;
 	for (auto& thread : threads) {
-		
-		// unsuspend all threads
-		if (!executionPaused) {
-			SuspendThread(thread.hThread);
-		// suspend all threads
-		} else {
-			ResumeThread(thread.hThread);
+		maxBusy	 = std::max<double>(maxBusy, thread.busySeconds);
+		sumBusy	+= thread.busySeconds;
+	}
+	if (sumBusy <= 0) return 0;
+	return maxBusy * threads.size() / sumBusy;
+}
+
+//-----------------------------------------------------------------------------
+// Name: toJson()
+// Desc: Returns the measurements as a JSON object, e.g. for logging. The histogram is cut after the last non-empty bucket.
+//-----------------------------------------------------------------------------
+std::wstring threadManagerClass::executionProfile::toJson() const
+{
+	std::wstringstream ss;
+	ss << L"{\"wallSeconds\":" << wallSeconds << L",\"imbalance\":" << getImbalance() << L",\"threads\":[";
+	for (size_t threadNo = 0; threadNo < threads.size(); threadNo++) {
+		const threadProfile& thread = threads[threadNo];
+		size_t numBuckets = threadProfile::numHistogramBuckets;
+		while (numBuckets > 0 && thread.chunkHistogram[numBuckets - 1] == 0) numBuckets--;
+
+		if (threadNo) ss << L",";
+		ss	<< L"{\"thread\":"				<< threadNo
+			<< L",\"busySeconds\":"			<< thread.busySeconds
+			<< L",\"barrierWaitSeconds\":"	<< thread.barrierWaitSeconds
+			<< L",\"pausedSeconds\":"			<< thread.pausedSeconds
+			<< L",\"iterations\":"			<< thread.numIterations
+			<< L",\"chunks\":"				<< thread.numChunks
+			<< L",\"chunkHistogramLog2Us\":[";
+		for (size_t bucket = 0; bucket < numBuckets; bucket++) {
+			if (bucket) ss << L",";
+			ss << thread.chunkHistogram[bucket];
 		}
+		ss << L"]}";
 	}
-	executionPaused = (!executionPaused);
+	ss << L"]}";
+	return ss.str();
+}
+
+//-----------------------------------------------------------------------------
+// Name: isExecutionPaused()
+// Desc: Tells if the execution is paused.
+//-----------------------------------------------------------------------------
+bool threadManagerClass::isExecutionPaused()
+{
+	return executionPaused;
+}
+
+//-----------------------------------------------------------------------------
+// Name: getNumPausedThreads()
+// Desc: Returns the number of threads, which reached a checkpoint since pauseExecution() was called.
+//-----------------------------------------------------------------------------
+unsigned int threadManagerClass::getNumPausedThreads()
+{
+	return numThreadsParked;
 }
 
 //-----------------------------------------------------------------------------
@@ -211,8 +671,8 @@ void threadManagerClass::cancelExecution()
 {
 	terminateAllThreads  = true;
 	executionCancelled = true;
-	if (executionPaused) {
-		pauseExecution();
+	if (executionPaused.exchange(false)) {
+		executionPaused.notify_all();
 	}
 }
 
@@ -234,6 +694,9 @@ unsigned int threadManagerClass::getThreadNumber()
 	// locals
 	DWORD			curThreadId = GetCurrentThreadId();
 
+	// no need to search, since tasks might call this often
+	if (isTaskThread()) return currentTaskThreadNo;
+
 	for (auto& thread : threads) {
 		if (curThreadId == thread.threadId) {
 			return thread.threadNo;
@@ -250,10 +713,6 @@ unsigned int threadManagerClass::getThreadNumber()
 //-----------------------------------------------------------------------------
 unsigned int threadManagerClass::executeInParallel(DWORD threadProc(void* pParameter), void *pParameter, unsigned int parameterStructSize)
 {
-	// locals
-	unsigned int	curThreadNo;
-	SIZE_T			dwStackSize		= 0;
-
 	// parameters ok?
 	if (pParameter == NULL)			return TM_RETURN_VALUE_INVALID_PARAM;
 	if (numThreads == 0)			return TM_RETURN_VALUE_INVALID_PARAM;
@@ -265,41 +724,35 @@ unsigned int threadManagerClass::executeInParallel(DWORD threadProc(void* pParam
 	terminateAllThreads			= false;
 	anyThreadOnLastIteration 	= false;
 
-	// create threads
-	for (curThreadNo=0; curThreadNo<numThreads; curThreadNo++) {
-		
-		void* pUser 					= (void*) (((char *) pParameter) + curThreadNo * parameterStructSize);
-		threads[curThreadNo].hThread 	= CreateThread(NULL, dwStackSize, (LPTHREAD_START_ROUTINE) threadProc, pUser, CREATE_SUSPENDED, &threads[curThreadNo].threadId);
-		SetThreadPriority(threads[curThreadNo].hThread, THREAD_PRIORITY_BELOW_NORMAL);
-		
-		if (threads[curThreadNo].hThread == NULL) {
-			for (curThreadNo; curThreadNo>0; curThreadNo--) {
-				CloseHandle(threads[curThreadNo-1].hThread);
-				threads[curThreadNo-1].hThread = NULL;
-			}
-			return TM_RETURN_VALUE_UNEXPECTED_ERROR;
-		}
-	}
-
-	// start threads
-	for (auto& thread : threads) {
-		if (!executionPaused) ResumeThread(thread.hThread);
-	}
-
-	// wait for every thread to end
-	waitForAllThreadsToTerminate();
+	// let each worker call the user function with its own parameter struct
+	return runJob([=](unsigned int threadNo) {
+		threadProc((void*) (((char *) pParameter) + threadNo * parameterStructSize));
+	});
+}
 
-	// everything ok
-	if (executionCancelled) {
-		return TM_RETURN_VALUE_EXECUTION_CANCELLED;
-	} else {
-		return TM_RETURN_VALUE_OK;
-	}
+//-----------------------------------------------------------------------------
+// Name: setRuntimeSchedule()
+// Desc: Selects the schedule used by executeParallelLoop() with TM_SCHEDULE_RUNTIME.
+//		 chunkSize is the number of iterations fetched at once by dynamic loops, and the minimum for guided loops.
+//		 0 means automatic. Returns false if the schedule type is invalid.
+//-----------------------------------------------------------------------------
+bool threadManagerClass::setRuntimeSchedule(unsigned int scheduleType, int64_t chunkSize)
+{
+	if (scheduleType == TM_SCHEDULE_USER_DEFINED)		return false;
+	if (scheduleType == TM_SCHEDULE_RUNTIME)			return false;
+	if (scheduleType >= TM_SCHEDULE_NUM_TYPES)			return false;
+	if (chunkSize < 0)									return false;
+	runtimeScheduleType	= scheduleType;
+	scheduleChunkSize	= chunkSize;
+	return true;
 }
 
 //-----------------------------------------------------------------------------
 // Name: executeInParallel()
 // Desc: Runs a loop in parallel. The loop is divided into chunks and each thread gets a chunk to work on.
+//		 With TM_SCHEDULE_STATIC each thread gets one chunk of the same size. With TM_SCHEDULE_DYNAMIC and TM_SCHEDULE_GUIDED
+//		 the threads fetch the next chunk when done, which balances iterations of different duration.
+//		 waitForOtherThreads() should only be used with TM_SCHEDULE_STATIC, since otherwise the threads do different numbers of iterations.
 // pParameter  - an array of size numThreads containing the user defined structures
 // finalValue  - this value is part of the iteration, meaning that index ranges from initialValue to finalValue including both border values
 //-----------------------------------------------------------------------------
@@ -311,6 +764,11 @@ unsigned int threadManagerClass::executeParallelLoop(	DWORD 			threadProc(void*
 														int64_t			finalValue, 
 														int64_t			increment)
 {
+	// the schedule is chosen by a setting
+	if (scheduleType == TM_SCHEDULE_RUNTIME) {
+		scheduleType = runtimeScheduleType;
+	}
+
 	// parameters ok?
 	if (numThreads		== 0)							return TM_RETURN_VALUE_INVALID_PARAM;
 	if (threadProc		== NULL)						return TM_RETURN_VALUE_INVALID_PARAM;
@@ -319,19 +777,21 @@ unsigned int threadManagerClass::executeParallelLoop(	DWORD 			threadProc(void*
 	if (scheduleType >= TM_SCHEDULE_NUM_TYPES)			return TM_RETURN_VALUE_INVALID_PARAM;
 	if (increment	 == 0)								return TM_RETURN_VALUE_INVALID_PARAM;
 	if (abs(finalValue-initialValue)+1 < abs(increment))return TM_RETURN_VALUE_INVALID_PARAM;
+	if (anyThreadRunning())								return TM_RETURN_VALUE_UNEXPECTED_ERROR;
 
 	// locals
 	unsigned int	curThreadNo;														// the threads are enumerated from 0 to numThreads-1
 	int64_t			numIterations		= (finalValue - initialValue) / increment + 1;	// total number of iterations
 	int64_t			chunkSize			= 0;											// number of iterations per chunk
-	SIZE_T			dwStackSize			= 0;											// initital stack size of each thread. 0 means default size ~1MB
+	int64_t			dynamicChunkSize	= getChunkSize(scheduleType, numIterations);	// number of iterations per chunk fetched by dynamic and guided loops
+	loopCounter		counter;															// shared by the threads of a dynamic or guided loop
 	std::vector<forLoopStruct> forLoopParameters(numThreads); 							// array of size numThreads containing the parameters for the threads
 
 	// globals
 	terminateAllThreads			= false;
 	anyThreadOnLastIteration 	= false;
 
-	// create threads
+	// prepare parameters of each thread
 	for (curThreadNo=0; curThreadNo<numThreads; curThreadNo++) {
 
 		forLoopParameters[curThreadNo].pParameter			= (pParameter!=NULL ? (void*) (((char *) pParameter) + curThreadNo * parameterStructSize) : NULL);
@@ -339,6 +799,9 @@ unsigned int threadManagerClass::executeParallelLoop(	DWORD 			threadProc(void*
 		forLoopParameters[curThreadNo].threadProc			= threadProc;
 		forLoopParameters[curThreadNo].increment			= increment;
 		forLoopParameters[curThreadNo].scheduleType			= scheduleType;
+		forLoopParameters[curThreadNo].counter				= &counter;
+		forLoopParameters[curThreadNo].numIterations		= numIterations;
+		forLoopParameters[curThreadNo].chunkSize			= dynamicChunkSize;
 		
 		switch (scheduleType)
 		{
@@ -353,42 +816,20 @@ unsigned int threadManagerClass::executeParallelLoop(	DWORD 			threadProc(void*
 			forLoopParameters[curThreadNo].finalValue		= forLoopParameters[curThreadNo].initialValue + (chunkSize-1) * increment;
 			break;
 		case TM_SCHEDULE_DYNAMIC:
-			return TM_RETURN_VALUE_INVALID_PARAM;
-			break;
 		case TM_SCHEDULE_GUIDED:
-			return TM_RETURN_VALUE_INVALID_PARAM;
+			forLoopParameters[curThreadNo].initialValue		= initialValue;
+			forLoopParameters[curThreadNo].finalValue		= finalValue;
 			break;
 		case TM_SCHEDULE_RUNTIME:
 			return TM_RETURN_VALUE_INVALID_PARAM;
 			break;
 		}
-
-		// create suspended thread
-		threads[curThreadNo].hThread = CreateThread(NULL, dwStackSize, threadForLoop, (LPVOID) (&forLoopParameters[curThreadNo]), CREATE_SUSPENDED, &threads[curThreadNo].threadId);
-		SetThreadPriority(threads[curThreadNo].hThread, THREAD_PRIORITY_BELOW_NORMAL);
-		if (threads[curThreadNo].hThread == NULL) {
-			for (curThreadNo; curThreadNo>0; curThreadNo--) {
-				CloseHandle(threads[curThreadNo-1].hThread);
-				threads[curThreadNo-1].hThread = NULL;
-			}
-			return TM_RETURN_VALUE_UNEXPECTED_ERROR;
-		}
-	}
-
-	// start threads, but don't resume if in pause mode
-	for (curThreadNo=0; curThreadNo<numThreads; curThreadNo++) {
-		if (!executionPaused) ResumeThread(threads[curThreadNo].hThread);
 	}
 
-	// wait for every thread to end
-	waitForAllThreadsToTerminate();
-
-	// everything ok
-	if (executionCancelled) {
-		return TM_RETURN_VALUE_EXECUTION_CANCELLED;
-	} else {
-		return TM_RETURN_VALUE_OK;
-	}
+	// let each worker run its part of the loop
+	return runJob([&forLoopParameters](unsigned int threadNo) {
+		threadForLoop((LPVOID) &forLoopParameters[threadNo]);
+	});
 }
 
 //-----------------------------------------------------------------------------
@@ -403,13 +844,17 @@ DWORD WINAPI threadManagerClass::threadForLoop(LPVOID lpParameter)
 
 	switch (forLoopParameters->scheduleType)
 	{
-	case TM_SCHEDULE_STATIC: 
+	case TM_SCHEDULE_STATIC: {
+		// the whole block of the thread counts as one chunk
+		auto	chunkStart		= startChunk();
+		int64_t	numDone			= 0;
 		// loop through the iterations 
 		for (index=forLoopParameters->initialValue; (forLoopParameters->increment < 0) ? index >= forLoopParameters->finalValue : index <= forLoopParameters->finalValue; index += forLoopParameters->increment) {
 			// check if this is the last iteration
 			if (index == forLoopParameters->finalValue) {
 				forLoopParameters->threadManager->anyThreadOnLastIteration = true;
 			}
+			forLoopParameters->threadManager->pausePoint();
 			// call the user function
 			switch (forLoopParameters->threadProc(forLoopParameters->pParameter, index))
 			{
@@ -421,15 +866,37 @@ DWORD WINAPI threadManagerClass::threadForLoop(LPVOID lpParameter)
 			default:
 				break;
 			}
+			numDone++;
 			// check if the execution was cancelled
 			if (forLoopParameters->threadManager->terminateAllThreads) break;
 		}
+		finishChunk(chunkStart, numDone);
 		break;
+	}
 	case TM_SCHEDULE_DYNAMIC:
-		return TM_RETURN_VALUE_INVALID_PARAM;
-		break;
 	case TM_SCHEDULE_GUIDED:
-		return TM_RETURN_VALUE_INVALID_PARAM;
+		// process chunks until all iterations are taken
+		int64_t firstIteration, lastIteration;
+		while (fetchChunk(*forLoopParameters, firstIteration, lastIteration)) {
+			auto chunkStart = startChunk();
+			for (int64_t iteration = firstIteration; iteration <= lastIteration; iteration++) {
+				index = forLoopParameters->initialValue + iteration * forLoopParameters->increment;
+				if (iteration == forLoopParameters->numIterations - 1) {
+					forLoopParameters->threadManager->anyThreadOnLastIteration = true;
+				}
+				forLoopParameters->threadManager->pausePoint();
+				// call the user function
+				if (forLoopParameters->threadProc(forLoopParameters->pParameter, index) == TM_RETURN_VALUE_TERMINATE_ALL_THREADS) {
+					forLoopParameters->threadManager->terminateAllThreads = true;
+				}
+				// check if the execution was cancelled
+				if (forLoopParameters->threadManager->terminateAllThreads) {
+					finishChunk(chunkStart, iteration - firstIteration + 1);
+					return TM_RETURN_VALUE_OK;
+				}
+			}
+			finishChunk(chunkStart, lastIteration - firstIteration + 1);
+		}
 		break;
 	case TM_SCHEDULE_RUNTIME:
 		return TM_RETURN_VALUE_INVALID_PARAM;
@@ -438,3 +905,292 @@ DWORD WINAPI threadManagerClass::threadForLoop(LPVOID lpParameter)
 
 	return TM_RETURN_VALUE_OK;
 }
+
+//-----------------------------------------------------------------------------
+// Name: executeRangeJob()
+// Desc: Called by executeParallelRange(). Each thread gets sub-ranges of at most chunkSize indices.
+//		 With TM_SCHEDULE_STATIC the sub-ranges of a thread are consecutive and cover one contiguous block,
+//		 like the iterations of executeParallelLoop() with the same schedule.
+//-----------------------------------------------------------------------------
+unsigned int threadManagerClass::executeRangeJob(const rangeProc& threadProc, void *pParameter, unsigned int parameterStructSize, unsigned int scheduleType, int64_t begin, int64_t end)
+{
+	// the schedule is chosen by a setting
+	if (scheduleType == TM_SCHEDULE_RUNTIME) {
+		scheduleType = runtimeScheduleType;
+	}
+
+	// parameters ok?
+	if (numThreads		== 0)							return TM_RETURN_VALUE_INVALID_PARAM;
+	if (!threadProc)									return TM_RETURN_VALUE_INVALID_PARAM;
+	if (executionCancelled == true)						return TM_RETURN_VALUE_EXECUTION_CANCELLED;
+	if (pParameter   == NULL)							return TM_RETURN_VALUE_INVALID_PARAM;
+	if (scheduleType == TM_SCHEDULE_USER_DEFINED)		return TM_RETURN_VALUE_INVALID_PARAM;
+	if (scheduleType >= TM_SCHEDULE_NUM_TYPES)			return TM_RETURN_VALUE_INVALID_PARAM;
+	if (end < begin)									return TM_RETURN_VALUE_INVALID_PARAM;
+	if (end == begin)									return TM_RETURN_VALUE_OK;
+	if (anyThreadRunning())								return TM_RETURN_VALUE_UNEXPECTED_ERROR;
+
+	// locals
+	int64_t			numIterations		= end - begin;									// total number of indices
+	int64_t			blockBegin			= begin;										// first index of the block of the current thread
+	loopCounter		counter;															// shared by the threads of a dynamic or guided loop
+	std::vector<forLoopStruct> forLoopParameters(numThreads); 							// array of size numThreads containing the parameters for the threads
+
+	// globals
+	terminateAllThreads			= false;
+	anyThreadOnLastIteration 	= false;
+
+	// prepare parameters of each thread
+	for (unsigned int curThreadNo=0; curThreadNo<numThreads; curThreadNo++) {
+
+		forLoopStruct& loop			= forLoopParameters[curThreadNo];
+		loop.pParameter				= (void*) (((char *) pParameter) + curThreadNo * parameterStructSize);
+		loop.threadManager			= this;
+		loop.rangeFunction			= &threadProc;
+		loop.increment				= 1;
+		loop.scheduleType			= scheduleType;
+		loop.counter				= &counter;
+		loop.numIterations			= numIterations;
+		loop.chunkSize				= getChunkSize(scheduleType, numIterations);
+
+		// same blocks as executeParallelLoop() with TM_SCHEDULE_STATIC. finalValue is excluded here.
+		if (scheduleType == TM_SCHEDULE_STATIC) {
+			int64_t blockSize		= numIterations / numThreads + (curThreadNo < numIterations % numThreads ? 1 : 0);
+			loop.initialValue		= blockBegin;
+			loop.finalValue			= blockBegin + blockSize;
+			blockBegin				= loop.finalValue;
+		} else {
+			loop.initialValue		= begin;
+			loop.finalValue			= end;
+		}
+	}
+
+	// let each worker process its sub-ranges
+	return runJob([&forLoopParameters](unsigned int threadNo) {
+		threadForRange((LPVOID) &forLoopParameters[threadNo]);
+	});
+}
+
+//-----------------------------------------------------------------------------
+// Name: threadForRange()
+// Desc: Calls the user function of executeParallelRange() for each sub-range of the thread.
+//-----------------------------------------------------------------------------
+DWORD WINAPI threadManagerClass::threadForRange(LPVOID lpParameter)
+{
+	// locals
+	forLoopStruct &			loop			= *((forLoopStruct *) lpParameter);
+	threadManagerClass &	tm				= *loop.threadManager;
+	int64_t					firstIteration;
+	int64_t					lastIteration;
+	int64_t					staticBegin		= loop.initialValue;
+
+	while (!tm.terminateAllThreads) {
+
+		tm.pausePoint();
+
+		// next sub-range
+		int64_t begin, end;
+		if (loop.scheduleType == TM_SCHEDULE_STATIC) {
+			if (staticBegin >= loop.finalValue) break;
+			begin		= staticBegin;
+			end			= std::min<int64_t>(staticBegin + loop.chunkSize, loop.finalValue);
+			staticBegin	= end;
+		} else {
+			if (!fetchChunk(loop, firstIteration, lastIteration)) break;
+			begin		= loop.initialValue + firstIteration;
+			end			= loop.initialValue + lastIteration + 1;
+		}
+		if (end == loop.initialValue + loop.numIterations) {
+			tm.anyThreadOnLastIteration = true;
+		}
+
+		// call the user function
+		auto chunkStart = startChunk();
+		if ((*loop.rangeFunction)(loop.pParameter, begin, end) == TM_RETURN_VALUE_TERMINATE_ALL_THREADS) {
+			tm.terminateAllThreads = true;
+		}
+		finishChunk(chunkStart, end - begin);
+	}
+	return TM_RETURN_VALUE_OK;
+}
+
+//-----------------------------------------------------------------------------
+// Name: getChunkSize()
+// Desc: Returns the chunk size set by setRuntimeSchedule(), or a default value. 
+//		 The default are a few chunks per thread, and single iterations as lower limit for guided loops.
+//-----------------------------------------------------------------------------
+int64_t threadManagerClass::getChunkSize(unsigned int scheduleType, int64_t numIterations)
+{
+	if (scheduleChunkSize > 0)					return scheduleChunkSize;
+	if (scheduleType == TM_SCHEDULE_GUIDED)		return 1;
+	return std::max<int64_t>(1, numIterations / (numThreads * 16));
+}
+
+//-----------------------------------------------------------------------------
+// Name: fetchChunk()
+// Desc: Takes the next iterations of a dynamic or guided loop from the shared counter. 
+//		 Returns false if no iterations are left. The iterations are counted from zero.
+//-----------------------------------------------------------------------------
+bool threadManagerClass::fetchChunk(forLoopStruct& loop, int64_t& firstIteration, int64_t& lastIteration)
+{
+	std::atomic<int64_t>& nextIteration = loop.counter->nextIteration;
+
+	// fixed chunk size
+	if (loop.scheduleType == TM_SCHEDULE_DYNAMIC) {
+		firstIteration = nextIteration.fetch_add(loop.chunkSize, std::memory_order_relaxed);
+		if (firstIteration >= loop.numIterations) return false;
+		lastIteration  = std::min<int64_t>(firstIteration + loop.chunkSize, loop.numIterations) - 1;
+		return true;
+	}
+
+	// guided: half of the remaining iterations per thread, but at least chunkSize
+	int64_t numThreads	= loop.threadManager->numThreads;
+	int64_t	size;
+	firstIteration		= nextIteration.load(std::memory_order_relaxed);
+	do {
+		if (firstIteration >= loop.numIterations) return false;
+		size = std::max<int64_t>(loop.chunkSize, (loop.numIterations - firstIteration) / (2 * numThreads));
+		size = std::min<int64_t>(size, loop.numIterations - firstIteration);
+	} while (!nextIteration.compare_exchange_weak(firstIteration, firstIteration + size, std::memory_order_relaxed));
+	lastIteration		= firstIteration + size - 1;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: executeTasks()
+// Desc: Runs rootTask on the first worker thread and lets the other workers steal the tasks spawned meanwhile.
+//		 Returns when rootTask returned, which must have synced all its spawned tasks.
+//-----------------------------------------------------------------------------
+unsigned int threadManagerClass::executeTasks(std::function<void()> rootTask)
+{
+	// parameters ok?
+	if (numThreads == 0)			return TM_RETURN_VALUE_INVALID_PARAM;
+	if (!rootTask)					return TM_RETURN_VALUE_INVALID_PARAM;
+	if (executionCancelled)			return TM_RETURN_VALUE_EXECUTION_CANCELLED;
+	if (isTaskThread())				return TM_RETURN_VALUE_UNEXPECTED_ERROR;
+	if (anyThreadRunning())			return TM_RETURN_VALUE_UNEXPECTED_ERROR;
+
+	// globals
+	terminateAllThreads			= false;
+	anyThreadOnLastIteration 	= false;
+	tasksFinished				= false;
+
+	// first worker runs the root task, the others look for work until it returned
+	return runJob([this, &rootTask](unsigned int threadNo) {
+		currentTaskManager	= this;
+		currentTaskThreadNo	= threadNo;
+		stealSeed			= (threadNo * 2654435761u) | 1;
+		if (threadNo == 0) {
+			rootTask();
+			tasksFinished = true;
+		} else {
+			// a worker between two tasks has synced all tasks it spawned, so it can leave when cancelled
+			while (!tasksFinished && !terminateAllThreads) {
+				pausePoint();
+				if (!executeOneTask()) std::this_thread::yield();
+			}
+		}
+		currentTaskManager	= nullptr;
+	});
+}
+
+//-----------------------------------------------------------------------------
+// Name: spawn()
+// Desc: Passes a task to the deque of the current worker, where it can be stolen by idle workers.
+//		 The task is executed immediately if the deque is full or if not called from within executeTasks().
+//		 After cancelExecution() the task is not executed anymore.
+//-----------------------------------------------------------------------------
+void threadManagerClass::spawn(taskGroup& group, std::function<void()> task)
+{
+	if (!isTaskThread()) {
+		task();
+		return;
+	}
+	if (terminateAllThreads) return;
+
+	// reuse an item of the current worker, including those passed back by other workers
+	taskPool& pool = *taskPools[currentTaskThreadNo];
+	if (pool.freeItems.empty()) {
+		for (taskItem* returned = pool.returnedItems.exchange(nullptr, std::memory_order_acquire); returned != nullptr; returned = returned->nextReturned) {
+			pool.freeItems.push_back(returned);
+		}
+	}
+	if (pool.freeItems.empty()) {
+		pool.items.push_back(std::make_unique<taskItem>());
+		pool.items.back()->ownerThreadNo = currentTaskThreadNo;
+		pool.freeItems.push_back(pool.items.back().get());
+	}
+	taskItem* item = pool.freeItems.back();
+	pool.freeItems.pop_back();
+	item->function	= std::move(task);
+	item->group		= &group;
+	group.numPending.fetch_add(1, std::memory_order_relaxed);
+	if (!taskDeques[currentTaskThreadNo]->push(item)) {
+		runTask(item);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name: sync()
+// Desc: Returns when all tasks spawned into the group are finished. Meanwhile other tasks are executed.
+//-----------------------------------------------------------------------------
+void threadManagerClass::sync(taskGroup& group)
+{
+	// outside of executeTasks() the tasks were already executed by spawn()
+	if (!isTaskThread()) return;
+
+	while (group.numPending.load(std::memory_order_acquire) > 0) {
+		pausePoint();
+		if (!executeOneTask()) std::this_thread::yield();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Name: executeOneTask()
+// Desc: Executes the newest task of the own deque, or a task stolen from a randomly chosen worker.
+//		 Returns false if no task was found.
+//-----------------------------------------------------------------------------
+bool threadManagerClass::executeOneTask()
+{
+	// own tasks first, depth first
+	taskItem* item = taskDeques[currentTaskThreadNo]->pop();
+
+	// steal the oldest task of another worker, which is usually the largest one
+	if (item == nullptr && numThreads > 1) {
+		stealSeed ^= stealSeed << 13;
+		stealSeed ^= stealSeed >> 17;
+		stealSeed ^= stealSeed << 5;
+		unsigned int firstVictim = stealSeed % numThreads;
+		for (unsigned int i = 0; i < numThreads && item == nullptr; i++) {
+			unsigned int victim = (firstVictim + i) % numThreads;
+			if (victim == currentTaskThreadNo) continue;
+			item = taskDeques[victim]->steal();
+		}
+	}
+
+	if (item == nullptr) return false;
+	runTask(item);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Name: runTask()
+// Desc: Executes a task, unless the execution was cancelled, and marks it as finished in its group.
+//		 The item is passed back to the pool of the worker which spawned it, so that the pools do not grow with each steal.
+//-----------------------------------------------------------------------------
+void threadManagerClass::runTask(taskItem* task)
+{
+	taskGroup* group = task->group;
+	if (!terminateAllThreads) {
+		task->function();
+	}
+	task->function = nullptr;
+	taskPool& owner = *taskPools[task->ownerThreadNo];
+	if (task->ownerThreadNo == currentTaskThreadNo) {
+		owner.freeItems.push_back(task);
+	} else {
+		task->nextReturned = owner.returnedItems.load(std::memory_order_relaxed);
+		while (!owner.returnedItems.compare_exchange_weak(task->nextReturned, task, std::memory_order_release, std::memory_order_relaxed));
+	}
+	group->numPending.fetch_sub(1, std::memory_order_release);
+}
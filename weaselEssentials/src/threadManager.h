@@ -9,20 +9,32 @@
 
 // standard library & win32 api
 #include <windows.h>
+#include <psapi.h>
 #include <cstdio>
 #include <iostream>
 #include <vector>
 #include <memory>
 #include <barrier> 
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <sstream>
+
+#include "threadCountTuner.h"
 
 using namespace std;														// use standard library namespace
 
 /*** Constants ******************************************************/
 #define TM_SCHEDULE_USER_DEFINED					0						// user defined scheduling
 #define TM_SCHEDULE_STATIC							1						// each thread gets the same number of iterations
-#define TM_SCHEDULE_DYNAMIC							2						// not implemented yet
-#define TM_SCHEDULE_GUIDED							3						// not implemented yet
-#define TM_SCHEDULE_RUNTIME							4						// not implemented yet
+#define TM_SCHEDULE_DYNAMIC							2						// the threads fetch chunks of fixed size, until all iterations are done
+#define TM_SCHEDULE_GUIDED							3						// like dynamic, but the chunk size decreases with the number of remaining iterations
+#define TM_SCHEDULE_RUNTIME							4						// the schedule set by setRuntimeSchedule() is used
 #define TM_SCHEDULE_NUM_TYPES						5						// number of scheduling types
 
 #define TM_RETURN_VALUE_OK							0						// return values of the execution functions
@@ -33,19 +45,141 @@ using namespace std;														// use standard library namespace
 
 /*** Classes *********************************************************/
 
+// Allocator which does not initialize the elements when a vector is resized without a value.
+// The pages of such a vector are first touched when the values are written, e.g. in parallel by threadManagerClass::fillParallel().
+// Since the operating system places a page on the NUMA node of the thread touching it first, each part of the array ends up close to the thread working on it.
+template <class T> class defaultInitAllocator : public std::allocator<T>
+{
+public:
+	template <class U> struct rebind { using other = defaultInitAllocator<U>; };
+
+	defaultInitAllocator() noexcept = default;
+	template <class U> defaultInitAllocator(const defaultInitAllocator<U>&) noexcept {};
+
+	template <class U> void construct(U* p) noexcept(std::is_nothrow_default_constructible_v<U>) { ::new ((void*) p) U; };
+	template <class U, class... Args> void construct(U* p, Args&&... args) { ::new ((void*) p) U(std::forward<Args>(args)...); };
+};
+
+// Chase-Lev deque with fixed capacity. The owner thread pushes and pops at the bottom, any other thread steals from the top.
+// Only pointers are stored, the items themselves are owned by the caller.
+template <class itemType> class workStealingDeque
+{
+public:
+	static constexpr int64_t				capacity			= 1 << 12;			// maximum number of items, power of two
+
+	workStealingDeque() : buffer(std::make_unique<std::atomic<itemType*>[]>(capacity)) {};
+
+	// called by the owner. returns false if the deque is full.
+	bool push(itemType* item)
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed);
+		int64_t t = top.load(std::memory_order_acquire);
+		if (b - t >= capacity) return false;
+		buffer[b & (capacity - 1)].store(item, std::memory_order_relaxed);
+		bottom.store(b + 1, std::memory_order_seq_cst);
+		return true;
+	};
+
+	// called by the owner. returns the item pushed last, or nullptr if empty.
+	itemType* pop()
+	{
+		int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_seq_cst);
+		if (t > b) {
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		itemType* item = buffer[b & (capacity - 1)].load(std::memory_order_relaxed);
+		if (t == b) {
+			// last item: race against the thieves
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				item = nullptr;
+			}
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return item;
+	};
+
+	// called by any other thread. returns the oldest item, or nullptr if empty or another thread was faster.
+	itemType* steal()
+	{
+		int64_t t = top.load(std::memory_order_seq_cst);
+		int64_t b = bottom.load(std::memory_order_seq_cst);
+		if (t >= b) return nullptr;
+		itemType* item = buffer[t & (capacity - 1)].load(std::memory_order_relaxed);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			return nullptr;
+		}
+		return item;
+	};
+
+private:
+	alignas(64) std::atomic<int64_t>		top					= 0;				// index of the oldest item, incremented by thieves
+	alignas(64) std::atomic<int64_t>		bottom				= 0;				// index after the newest item, only changed by the owner
+	std::unique_ptr<std::atomic<itemType*>[]> buffer;								// ring buffer of size 'capacity'
+};
+
 // In principle, the class threadManagerClass is a wrapper for the win32 api functions for creating and managing threads.
 // The class provides a simple interface for executing a function in parallel on multiple threads.
 // It is possible to execute a function in parallel on multiple threads, or to execute a loop in parallel on multiple threads.
 // The loop is divided into chunks and each thread gets a chunk to work on.
 // The class also provides a barrier function, which can be used to synchronize the threads.
 // The class also provides a function to pause and cancel the execution of the threads.
+// Pausing is cooperative: the threads park at the next checkpoint, which are the iterations of a loop, the sub-ranges of executeParallelRange(),
+// the tasks and waitForOtherThreads(). Thus a thread is never stopped while holding a lock. User functions of executeInParallel() call pausePoint().
 // The class also provides a function to set a callback function which is called every x-milliseconds during execution between two iterations.
+// The worker threads are created on the first execution and kept alive until the object is destroyed. If the number of threads
+// is reduced, e.g. by beginPhase(), the surplus workers are parked. They are only recreated, if more threads are needed than ever before.
+// Between two executions they wait on a condition variable, so that starting an execution only costs a single wake-up.
+// If setProfiling(true) was called, each thread measures its busy time, barrier waits and chunk durations. See getLastProfile().
+// If setAutoTuning(true) was called, the executions between beginPhase() and endPhase() use the number of threads chosen by a threadCountTuner.
 class threadManagerClass
 {
+public:
+
+	// user function of executeParallelRange(), which processes the indices from 'begin' to 'end' excluding 'end'
+	using rangeProc = std::function<DWORD(void* pParameter, int64_t begin, int64_t end)>;
+
+	// measurements of a single thread during the last execution. only collected if setProfiling(true) was called.
+	struct threadProfile
+	{
+		static constexpr unsigned int			numHistogramBuckets		= 24;		// the last bucket contains all chunks longer than 2^22 microseconds
+
+		double									busySeconds				= 0;		// time in the user functions, without barrier waits and pauses
+		double									barrierWaitSeconds		= 0;		// time spent in waitForOtherThreads()
+		double									pausedSeconds			= 0;		// time parked in a checkpoint due to pauseExecution()
+		int64_t									numIterations			= 0;		// number of loop iterations or range indices processed
+		int64_t									numChunks				= 0;		// number of chunks or sub-ranges processed
+		std::array<int64_t, numHistogramBuckets> chunkHistogram			= {};		// [0] chunks shorter than 1 us, [i] chunks taking from 2^(i-1) to 2^i microseconds
+	};
+
+	// measurements of all threads during the last execution
+	struct executionProfile
+	{
+		double									wallSeconds				= 0;		// duration of the whole execution as seen by the calling thread
+		vector<threadProfile>					threads;							// [threadNo]
+
+		double									getImbalance			() const;	// maximum busy time divided by the average one. 1 means perfectly balanced.
+		std::wstring							toJson					() const;	// all values as a JSON object
+	};
+
+	// counts the tasks passed to spawn(), which are not finished yet. sync() waits until it is zero.
+	class taskGroup
+	{
+		friend class threadManagerClass;
+		std::atomic<int64_t>	numPending		= 0;								// number of spawned but unfinished tasks
+	};
+
 private:
 
 	// structures
-	struct forLoopStruct														// structure used in threadForLoop()
+	struct alignas(64) loopCounter												// shared by all threads of a dynamic or guided loop. own cache line to avoid false sharing.
+	{
+		std::atomic<int64_t> nextIteration			= 0;						// number of the next iteration not taken by any thread, counted from zero
+	};
+
+	struct alignas(64) forLoopStruct											// structure used in threadForLoop(). own cache line for each thread.
 	{
 		unsigned int		scheduleType			= TM_SCHEDULE_USER_DEFINED;	// type of scheduling, for load balancing
 		int64_t				increment				= 1;						// step size of the loop
@@ -54,13 +188,39 @@ private:
 		void *				pParameter				= nullptr;					// pointer to the user defined structure
 		DWORD				(*threadProc)(void* pParameter, int64_t index)	= nullptr;	// pointer to the user function to be executed by the threads
 		threadManagerClass *threadManager;										// pointer to the threadManagerClass object
+		loopCounter *		counter					= nullptr;					// shared iteration counter for dynamic and guided scheduling
+		int64_t				numIterations			= 0;						// total number of iterations of the loop
+		int64_t				chunkSize				= 1;						// number of iterations per chunk (dynamic) or minimum number (guided)
+		const rangeProc *	rangeFunction			= nullptr;					// user function of executeParallelRange()
 	};
 	
+	struct alignas(64) profileSlot												// measurements of one thread. own cache line, since only written by the owner thread.
+	{
+		threadProfile		profile;
+	};
+
+	struct taskItem																// a task passed to spawn()
+	{
+		std::function<void()>	function;										// the user function
+		taskGroup *				group;											// its numPending is decremented when the function returned
+		unsigned int			ownerThreadNo;									// worker whose pool the item belongs to
+		taskItem *				nextReturned;									// next item in the returned list of the owner
+	};
+
+	struct alignas(64) taskPool													// task items of one worker, reused so that spawn() does not allocate each item on the heap
+	{
+		vector<unique_ptr<taskItem>>	items;									// all items allocated by this worker
+		vector<taskItem*>		freeItems;										// items not in use. only accessed by the owner.
+		std::atomic<taskItem*>	returnedItems				= nullptr;			// items executed by other workers, passed back to the owner as a lock-free list
+	};
+
 	struct threadItem
 	{
 		HANDLE				hThread;											// the thread handle given by the system
 		DWORD				threadId;											// the thread id given by the system
 		unsigned int		threadNo;											// the thread number from 0 to numThreads-1
+		threadManagerClass *threadManager;										// pointer to the threadManagerClass object, used by workerThreadProc()
+		int					numaNode;											// NUMA node the thread is pinned to, or -1 if not pinned
 
 							threadItem();
 							~threadItem();
@@ -68,16 +228,69 @@ private:
 
 	// Variables
 	unsigned int			numThreads						= 0;				// number of threads
-	bool					terminateAllThreads				= false;			// true when cancelExecution() was called
-	bool					executionPaused					= false;			// true if thread execution is currently paused
-	bool					executionCancelled				= false;			// true when cancelExecution() was called
-	vector<threadItem>		threads;											// array of size 'numThreads' containing the thread handles, thread ids
+	std::atomic<bool>		terminateAllThreads				= false;			// true when cancelExecution() was called or a user function returned TM_RETURN_VALUE_TERMINATE_ALL_THREADS
+	std::atomic<bool>		executionPaused					= false;			// true if thread execution is currently paused. the threads park on this flag.
+	std::atomic<bool>		executionCancelled				= false;			// true when cancelExecution() was called
+	std::atomic<unsigned int> numThreadsParked				= 0;				// number of threads currently waiting in pausePoint()
+	vector<threadItem>		threads;											// array of at least size 'numThreads' containing the thread handles, thread ids
 	std::barrier<>*			pBarrier						= nullptr;			// pointer to a barrier object
-	bool 					anyThreadOnLastIteration		= false;			// true if any thread is on the last iteration
+	std::atomic<bool>		anyThreadOnLastIteration		= false;			// true if any thread is on the last iteration
+	unsigned int			runtimeScheduleType				= TM_SCHEDULE_DYNAMIC;	// schedule used for TM_SCHEDULE_RUNTIME
+	int64_t					scheduleChunkSize				= 0;				// chunk size for dynamic and guided scheduling. 0 means automatic.
+	bool					pinThreads						= false;			// true if each worker thread is bound to one logical processor
+
+	static constexpr size_t	minFillParallelCount			= 1 << 16;			// fillParallel() uses a single thread for smaller arrays
+
+	// persistent worker threads
+	std::mutex				poolMutex;											// protects the following variables
+	std::condition_variable	poolWakeUp;											// signals the workers that a new job is available or that they shall exit
+	std::condition_variable	poolJobDone;										// signals that all workers finished the current job
+	std::function<void(unsigned int threadNo)> job;								// function executed by each worker for the current job
+	uint64_t				jobGeneration					= 0;				// incremented for each new job
+	unsigned int			numWorkersBusy					= 0;				// number of workers, which did not finish the current job yet
+	unsigned int			numJobThreads					= 0;				// number of workers executing the current job, zero between two jobs. the others are parked.
+	bool					shutdownWorkers					= false;			// true when the workers shall exit
+
+	// fork/join tasks
+	vector<unique_ptr<workStealingDeque<taskItem>>>	taskDeques;					// [threadNo] tasks spawned by each worker
+	vector<unique_ptr<taskPool>>	taskPools;									// [threadNo] task items of each worker
+	std::atomic<bool>		tasksFinished					= false;			// true when the root task of executeTasks() returned
+	static thread_local threadManagerClass*	currentTaskManager;					// manager whose executeTasks() the current thread is working for, otherwise nullptr
+	static thread_local unsigned int		currentTaskThreadNo;				// thread number within executeTasks()
+	static thread_local uint32_t			stealSeed;							// state of the random generator choosing the victim of a steal
+
+	// profiling
+	bool					profilingEnabled				= false;			// true if the threads measure their execution
+	vector<profileSlot>		profileSlots;										// [threadNo] measurements of the running execution
+	executionProfile		lastProfile;										// measurements of the last finished execution
+	static thread_local threadProfile*		currentProfile;						// measurements of the current worker thread, or nullptr if profiling is disabled
+
+	// thread count tuning
+	bool					autoTuning						= false;			// true if beginPhase() sets the number of threads chosen by the tuner
+	unsigned int			userNumThreads					= 0;				// number of threads set by the user, used outside of phases
+	threadCountTuner		tuner;												// best number of threads per phase
+	wstring					curPhase;											// name of the phase between beginPhase() and endPhase()
+	std::chrono::steady_clock::time_point	phaseStart;							// time when beginPhase() was called
 
 	// functions
 	static DWORD WINAPI		threadForLoop					(LPVOID lpParameter);
+	static DWORD WINAPI		threadForRange					(LPVOID lpParameter);
+	static bool				fetchChunk						(forLoopStruct& loop, int64_t& firstIteration, int64_t& lastIteration);
+	int64_t					getChunkSize					(unsigned int scheduleType, int64_t numIterations);
+	unsigned int			executeRangeJob					(const rangeProc& threadProc, void *pParameter, unsigned int parameterStructSize, unsigned int scheduleType, int64_t begin, int64_t end);
+	static DWORD WINAPI		workerThreadProc				(LPVOID lpParameter);
 	bool					resizeArrays					();
+	bool					changeNumThreads				(unsigned int newNumThreads);
+	bool					startWorkers					();
+	void					pinWorkers						();
+	void					stopWorkers						();
+	unsigned int			runJob							(std::function<void(unsigned int threadNo)> newJob);
+	bool					executeOneTask					();
+	void					runTask							(taskItem* task);
+	bool					isTaskThread					() const { return currentTaskManager == this; };
+	void					parkWhilePaused					();
+	static std::chrono::steady_clock::time_point startChunk	()	{ return currentProfile ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{}; };
+	static void				finishChunk						(std::chrono::steady_clock::time_point chunkStart, int64_t numIterations);
 
 public:
 
@@ -142,16 +355,90 @@ public:
 	bool					setNumThreads					(unsigned int newNumThreads);		// tries to set the number of threads. Returns false if any thread is running.
 	void					waitForOtherThreads				();									// waits for all threads to reach this point
 	void	 				waitForAllThreadsToTerminate	();									// waits for all threads to terminate
-	void					pauseExecution					();									// un-/suspend all threads
+	void					pauseExecution					();									// un-/pause all threads at their next checkpoint
+	void					pausePoint						()	{ if (executionPaused.load(std::memory_order_relaxed)) parkWhilePaused(); };	// checkpoint: waits here while the execution is paused
+	bool					isExecutionPaused				();									// tells if the execution is paused
+	unsigned int			getNumPausedThreads				();									// returns the number of threads waiting in a checkpoint
 	void					cancelExecution					();									// terminateAllThreads = true
 	bool					wasExecutionCancelled			();									// tells if the execution was cancelled
 	void					reset							();									// resets to the initial state
 	void					setCallBackFunction				(void userFunction(void* pUser), void* pUser, DWORD milliseconds);		// a user function which is called every x-milliseconds during execution between two iterations
+	bool					setRuntimeSchedule				(unsigned int scheduleType, int64_t chunkSize = 0);	// schedule used by loops with TM_SCHEDULE_RUNTIME, and chunk size of dynamic and guided loops
 	bool					anyThreadRunning				();									// returns true if any thread is running
+	size_t					getNumTaskItems					();									// returns the number of task items allocated by all workers for spawn()
+	bool					setThreadPinning				(bool enabled);						// binds each thread to one logical processor, ordered by NUMA node. Returns false if any thread is running.
+	int						getNumaNodeOfThread				(unsigned int threadNo);			// returns the NUMA node of a pinned thread, or -1
+	bool					setProfiling					(bool enabled);						// measures the execution of each thread. Returns false if any thread is running.
+	bool					isProfilingEnabled				()	{ return profilingEnabled; };
+	const executionProfile&	getLastProfile					()	{ return lastProfile; };		// measurements of the last execution, empty if profiling is disabled
+	bool					setAutoTuning					(bool enabled);						// lets beginPhase() choose the number of threads. Returns false if any thread is running.
+	bool					isAutoTuningEnabled				()	{ return autoTuning; };
+	threadCountTuner&		getTuner						()	{ return tuner; };				// e.g. to load and save the tuned thread counts
+	void					beginPhase						(const wstring& phaseName, int64_t workSize);	// call before preparing the per thread variables of a phase, since the number of threads might change
+	void					endPhase						(int64_t numStatesProcessed);		// passes the throughput of the phase to the tuner and restores the number of threads
+
+	// Writes 'value' to each element, whereby the pages are touched by the same threads as in executeParallelLoop() with TM_SCHEDULE_STATIC.
+	// Within a task the parts are spawned as tasks, so that idle workers help. Within any other job of the workers the calling 
+	// worker fills the whole array, so that the pages are placed on its own node. From a foreign thread during a job a single thread is used.
+	template <class T>
+	void					fillParallel					(T* data, size_t count, const T& value)
+	{
+		auto fillRange = [data, &value](void* pParameter, int64_t begin, int64_t end) -> DWORD {
+			std::fill(data + begin, data + end, value);
+			return TM_RETURN_VALUE_OK;
+		};
+		if (count < minFillParallelCount) {
+			std::fill(data, data + count, value);
+		} else if (isTaskThread()) {
+			taskGroup	group;
+			size_t		partSize = std::max<size_t>(minFillParallelCount, count / (numThreads * 16));
+			for (size_t begin = 0; begin < count; begin += partSize) {
+				size_t end = std::min<size_t>(begin + partSize, count);
+				spawn(group, [&fillRange, begin, end]() { fillRange(nullptr, (int64_t) begin, (int64_t) end); });
+			}
+			sync(group);
+			if (terminateAllThreads) std::fill(data, data + count, value);		// skipped tasks
+		} else if (anyThreadRunning() || executeParallelRange(fillRange, this, 0, TM_SCHEDULE_STATIC, 0, (int64_t) count) != TM_RETURN_VALUE_OK) {
+			std::fill(data, data + count, value);
+		}
+	}
+
+	static vector<long long> getBytesPerNumaNode			(const void* data, size_t sizeInBytes);	// estimates how many bytes of an array are located on each NUMA node
 	
 	// execute
 	unsigned int 			executeInParallel				(DWORD threadProc(void* pParameter			 	 ), void *pParameter, unsigned int parameterStructSize);
 	unsigned int			executeParallelLoop				(DWORD threadProc(void* pParameter, int64_t index), void *pParameter, unsigned int parameterStructSize, unsigned int scheduleType, int64_t initialValue, int64_t finalValue, int64_t increment);
+
+	// Like executeParallelLoop(), but the user function gets whole sub-ranges [begin, end) of the indices from 'begin' to 'end'.
+	// This allows the compiler to inline and vectorize cheap loop bodies. Cancellation is checked between two sub-ranges.
+	// threadProc can be a function or a lambda with the signature DWORD(void* pParameter, int64_t begin, int64_t end).
+	template <class rangeFunction>
+	unsigned int			executeParallelRange			(rangeFunction&& threadProc, void *pParameter, unsigned int parameterStructSize, unsigned int scheduleType, int64_t begin, int64_t end)
+	{
+		return executeRangeJob(rangeProc(std::forward<rangeFunction>(threadProc)), pParameter, parameterStructSize, scheduleType, begin, end);
+	}
+
+	// Fork/join tasks on the same worker threads. executeTasks() runs rootTask on the first worker, while the other workers steal spawned tasks.
+	// Within a task, spawn() passes a new task to the deque of the current worker and sync() executes or steals tasks until the group is done.
+	// Each spawned task must be synced before the task, which spawned it, returns. Outside of executeTasks() spawn() runs the task immediately.
+	// After cancelExecution() the tasks not started yet are skipped, so that sync() and executeTasks() return soon. 
+	// Within a task getThreadNumber() returns the number of the worker executing it.
+	unsigned int			executeTasks					(std::function<void()> rootTask);
+	void					spawn							(taskGroup& group, std::function<void()> task);
+	void					sync							(taskGroup& group);
+
+	// Runs all passed functions in parallel and returns when all are done. Can be called from inside and outside of a task.
+	template <class... taskFunctions>
+	unsigned int			parallel_invoke					(taskFunctions&&... tasks)
+	{
+		if (!isTaskThread()) {
+			return executeTasks([&]() { parallel_invoke(tasks...); });
+		}
+		taskGroup group;
+		(spawn(group, std::function<void()>(tasks)), ...);
+		sync(group);
+		return TM_RETURN_VALUE_OK;
+	}
 };
 
 #endif
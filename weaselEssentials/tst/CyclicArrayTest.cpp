@@ -8,6 +8,8 @@
 #include <filesystem>
 #include <vector>
 #include <algorithm>
+#include <chrono>
+#include <iostream>
 
 #include "cyclicArray.h"
 
@@ -104,3 +106,114 @@ TEST(CyclicArray, OneBlock) {
 		ASSERT_EQ(writeData, readData);											// compare the data
 	}
 }
+
+// Test adding and taking chunks of varying size, so that the background writes and prefetches overlap in many ways
+TEST_F(CyclicArrayTest, InterleavedAddAndTake) {
+	std::vector<unsigned char> expected;
+	std::vector<unsigned char> chunk;
+	size_t	numBytesTaken	= 0;
+	srand(0);
+
+	for (int round = 0; round < 2000; round++) {
+		unsigned int numBytesToAdd	= rand() % (3 * blockSizeInBytes);
+		unsigned int numBytesToTake	= rand() % (3 * blockSizeInBytes);
+		numBytesToAdd	= std::min<unsigned int>(numBytesToAdd,  (unsigned int) ca->writeableBytes());
+		chunk.resize(numBytesToAdd);
+		std::generate(chunk.begin(), chunk.end(), []() { return static_cast<unsigned char>(rand() % 256); });
+		ASSERT_TRUE(ca->addBytes(numBytesToAdd, chunk.data()));				// add a chunk
+		expected.insert(expected.end(), chunk.begin(), chunk.end());
+		numBytesToTake	= std::min<unsigned int>(numBytesToTake, (unsigned int) ca->bytesAvailable());
+		chunk.resize(numBytesToTake);
+		ASSERT_TRUE(ca->takeBytes(numBytesToTake, chunk.data()));			// take a chunk
+		ASSERT_TRUE(std::equal(chunk.begin(), chunk.end(), expected.begin() + numBytesTaken));
+		numBytesTaken += numBytesToTake;
+		ASSERT_EQ(ca->bytesAvailable(), expected.size() - numBytesTaken);	// the amount of stored bytes must match
+	}
+}
+
+// Test that the file is not used, when the reading pointer is always in the writing block
+TEST_F(CyclicArrayTest, ReaderInWritingBlock) {
+	const unsigned int numBytesPerRound = 30;
+	for (unsigned int offset = 0; offset + numBytesPerRound <= fileSize; offset += numBytesPerRound) {
+		ASSERT_TRUE(ca->addBytes (numBytesPerRound, &writeData[offset]));			// add a few bytes
+		ASSERT_TRUE(ca->takeBytes(numBytesPerRound, &readData [offset]));			// and take them immediately
+	}
+	ASSERT_TRUE(std::equal(writeData.begin(), writeData.end() - fileSize % numBytesPerRound, readData.begin()));
+	ASSERT_EQ(std::filesystem::file_size(fileName), 0);							// nothing was written to the file
+}
+
+// Test all backing stores with interleaved adding and taking, followed by saving and loading the content
+TEST(CyclicArray, BackingStores) {
+	logger log{logger::logLevel::none, logger::logType::console, L""};
+	const std::wstring	fileName			= (std::filesystem::temp_directory_path() / "temp_test_file_CyclicArrayTest.txt").c_str();
+	const std::wstring	fileName2			= (std::filesystem::temp_directory_path() / "temp_test_file_CyclicArrayTest2.txt").c_str();
+	const unsigned int	blockSizeInBytes	= 4096;									// multiple of the sector size, as required by unbufferedFile
+	const unsigned int	numberOfBlocks		= 6;
+	const std::vector<blockStorage::type> storageTypes = { blockStorage::type::memory, blockStorage::type::file, blockStorage::type::mappedFile, blockStorage::type::unbufferedFile };
+
+	for (blockStorage::type storageType : storageTypes) {
+		std::vector<unsigned char> expected;
+		std::vector<unsigned char> chunk;
+		size_t		numBytesTaken	= 0;
+		uint64_t	numBytesLoaded	= 0;
+		srand(0);
+		std::filesystem::remove(fileName);
+		std::filesystem::remove(fileName2);
+		cyclicArray ca(blockSizeInBytes, numberOfBlocks, fileName, log, storageType);
+
+		for (int round = 0; round < 200; round++) {
+			unsigned int numBytesToAdd	= std::min<unsigned int>(rand() % (2 * blockSizeInBytes), (unsigned int) ca.writeableBytes());
+			unsigned int numBytesToTake	= rand() % (2 * blockSizeInBytes);
+			chunk.resize(numBytesToAdd);
+			std::generate(chunk.begin(), chunk.end(), []() { return static_cast<unsigned char>(rand() % 256); });
+			ASSERT_TRUE(ca.addBytes(numBytesToAdd, chunk.data()));
+			expected.insert(expected.end(), chunk.begin(), chunk.end());
+			numBytesToTake	= std::min<unsigned int>(numBytesToTake, (unsigned int) ca.bytesAvailable());
+			chunk.resize(numBytesToTake);
+			ASSERT_TRUE(ca.takeBytes(numBytesToTake, chunk.data()));
+			ASSERT_TRUE(std::equal(chunk.begin(), chunk.end(), expected.begin() + numBytesTaken));
+			numBytesTaken += numBytesToTake;
+		}
+
+		// the remaining content must survive saving and loading
+		ASSERT_TRUE(ca.saveFile(fileName2));
+		ASSERT_TRUE(ca.loadFile(fileName2, numBytesLoaded));
+		ASSERT_EQ(numBytesLoaded, expected.size() - numBytesTaken);
+		chunk.resize(numBytesLoaded);
+		ASSERT_TRUE(ca.takeBytes(chunk.size(), chunk.data()));
+		ASSERT_TRUE(std::equal(chunk.begin(), chunk.end(), expected.begin() + numBytesTaken));
+		ASSERT_EQ(ca.bytesAvailable(), 0);
+	}
+	std::filesystem::remove(fileName);
+	std::filesystem::remove(fileName2);
+}
+
+// Benchmark of adding and then taking a large amount of data, with and without background I/O.
+// Disabled, so that it does not slow down the regular test run. Run it with --gtest_also_run_disabled_tests.
+TEST(CyclicArray, DISABLED_SequentialThroughput) {
+	logger log{logger::logLevel::none, logger::logType::console, L""};
+	const std::wstring	fileName			= (std::filesystem::temp_directory_path() / "temp_test_file_CyclicArrayTest.txt").c_str();
+	const unsigned int	blockSizeInBytes	= 65536;								// same as BLOCK_SIZE_IN_CYCLIC_ARRAY * sizeof(stateAdressStruct)
+	const unsigned int	numberOfBlocks		= 400;
+	const unsigned int	numBytesPerCall		= 8;									// size of a state address
+	const uint64_t		numBytes			= (uint64_t) blockSizeInBytes * numberOfBlocks;
+	std::vector<unsigned char> data(numBytesPerCall);
+
+	for (bool asyncIo : {false, true}) {
+		std::filesystem::remove(fileName);
+		cyclicArray ca(blockSizeInBytes, numberOfBlocks, fileName, log);
+		ca.setAsyncIo(asyncIo);
+		auto start = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < numBytes; i += numBytesPerCall) {
+			std::fill(data.begin(), data.end(), static_cast<unsigned char>(i));
+			ASSERT_TRUE(ca.addBytes(numBytesPerCall, data.data()));
+		}
+		for (uint64_t i = 0; i < numBytes; i += numBytesPerCall) {
+			ASSERT_TRUE(ca.takeBytes(numBytesPerCall, data.data()));
+			ASSERT_EQ(data[0], static_cast<unsigned char>(i));
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << (asyncIo ? "asynchronous" : "synchronous ") << " I/O: " << 2 * numBytes / seconds / 1e6 << " MB/s" << std::endl;
+	}
+	std::filesystem::remove(fileName);
+}
@@ -9,6 +9,8 @@
 #include <thread>
 #include <random>
 #include <mutex>
+#include <atomic>
+#include <filesystem>
 
 #include "threadManager.h"
 
@@ -204,3 +206,522 @@ TEST_F(ThreadManagerTest, waitForOthers) {
 	EXPECT_EQ(tm.anyThreadRunning(), false);
 	EXPECT_EQ(tm.wasExecutionCancelled(), false);
 }
+
+TEST_F(ThreadManagerTest, persistentThreads) {
+	std::vector<DWORD> firstIds(tm.getNumThreads(), 0);
+	std::vector<DWORD> secondIds(tm.getNumThreads(), 0);
+
+	// each thread writes its system thread id into its own element
+	auto storeThreadId = [](void* pParameter) -> DWORD {
+		*((DWORD*) pParameter) = GetCurrentThreadId();
+		return 0;
+	};
+
+	// the same threads are used for each execution
+	EXPECT_EQ(tm.executeInParallel(storeThreadId, firstIds.data(),  sizeof(DWORD)), TM_RETURN_VALUE_OK);
+	EXPECT_EQ(tm.executeInParallel(storeThreadId, secondIds.data(), sizeof(DWORD)), TM_RETURN_VALUE_OK);
+	EXPECT_EQ(firstIds, secondIds);
+	EXPECT_NE(firstIds[0], firstIds[1]);
+	EXPECT_NE(firstIds[0], GetCurrentThreadId());
+	EXPECT_EQ(tm.anyThreadRunning(), false);
+
+	// many short executions in a row
+	for (int i = 0; i < 1000; i++) {
+		ASSERT_EQ(tm.executeInParallel(storeThreadId, secondIds.data(), sizeof(DWORD)), TM_RETURN_VALUE_OK);
+	}
+	EXPECT_EQ(firstIds, secondIds);
+
+	// new threads after changing the number of threads
+	EXPECT_TRUE(tm.setNumThreads(3));
+	secondIds.resize(3);
+	EXPECT_EQ(tm.executeInParallel(storeThreadId, secondIds.data(), sizeof(DWORD)), TM_RETURN_VALUE_OK);
+	EXPECT_NE(secondIds[2], 0);
+}
+
+TEST_F(ThreadManagerTest, nestedLoop) {
+	struct nestedVars {
+		threadManagerClass*	pTm;
+		DWORD				returnValue;
+	};
+	std::vector<nestedVars> vars(tm.getNumThreads(), {&tm, TM_RETURN_VALUE_OK});
+
+	// a loop started by a worker must not take over the running job
+	auto outerLoop = [](void* pParameter, int64_t index) -> DWORD {
+		nestedVars* pVars	= (nestedVars*) pParameter;
+		pVars->returnValue	= pVars->pTm->executeParallelLoop(threadProc_3, pParameter, sizeof(nestedVars), TM_SCHEDULE_STATIC, 0, 1, 1);
+		return 0;
+	};
+	EXPECT_EQ(tm.executeParallelLoop(outerLoop, vars.data(), sizeof(nestedVars), TM_SCHEDULE_STATIC, 0, 1, 1), TM_RETURN_VALUE_OK);
+	for (auto& curVars : vars) {
+		EXPECT_EQ(curVars.returnValue, TM_RETURN_VALUE_UNEXPECTED_ERROR);
+	}
+
+	// the same within a task
+	unsigned int returnValue = TM_RETURN_VALUE_OK;
+	EXPECT_EQ(tm.executeTasks([&]() { returnValue = tm.executeParallelLoop(threadProc_3, vars.data(), sizeof(nestedVars), TM_SCHEDULE_STATIC, 0, 1, 1); }), TM_RETURN_VALUE_OK);
+	EXPECT_EQ(returnValue, TM_RETURN_VALUE_UNEXPECTED_ERROR);
+
+	// the manager is usable afterwards
+	EXPECT_EQ(tm.anyThreadRunning(), false);
+	EXPECT_EQ(tm.executeParallelLoop(threadProc_3, vars.data(), sizeof(nestedVars), TM_SCHEDULE_STATIC, 0, 1, 1), TM_RETURN_VALUE_OK);
+}
+
+TEST_F(ThreadManagerTest, dynamicSchedules) {
+	tm.setNumThreads(3);
+	std::vector<int> threadVars(tm.getNumThreads(), 0);
+	std::vector<std::atomic<int>> counts(1000);
+
+	// each visited index is counted, iterations of different duration
+	auto countIndex = [](void* pParameter, int64_t index) -> DWORD {
+		std::vector<std::atomic<int>>& counts = **((std::vector<std::atomic<int>>**) pParameter);
+		if (index % 97 == 0) Sleep(1);
+		counts[index]++;
+		return 0;
+	};
+	std::vector<std::vector<std::atomic<int>>*> pCounts(tm.getNumThreads(), &counts);
+
+	// every index must be visited exactly once, also with increments other than 1
+	for (unsigned int scheduleType : {TM_SCHEDULE_DYNAMIC, TM_SCHEDULE_GUIDED, TM_SCHEDULE_RUNTIME}) {
+		for (int64_t chunkSize : {0, 1, 7, 5000}) {
+			EXPECT_TRUE(tm.setRuntimeSchedule(scheduleType == TM_SCHEDULE_RUNTIME ? TM_SCHEDULE_GUIDED : scheduleType, chunkSize));
+			for (auto& c : counts) c = 0;
+			EXPECT_EQ(tm.executeParallelLoop(countIndex, pCounts.data(), sizeof(pCounts[0]), scheduleType, 0, 999, 1), TM_RETURN_VALUE_OK);
+			for (size_t i = 0; i < counts.size(); i++) ASSERT_EQ(counts[i], 1) << "schedule " << scheduleType << ", chunk " << chunkSize << ", index " << i;
+
+			for (auto& c : counts) c = 0;
+			EXPECT_EQ(tm.executeParallelLoop(countIndex, pCounts.data(), sizeof(pCounts[0]), scheduleType, 998, 0, -2), TM_RETURN_VALUE_OK);
+			for (size_t i = 0; i < counts.size(); i++) ASSERT_EQ(counts[i], (i % 2 == 0) ? 1 : 0);
+		}
+	}
+
+	// invalid settings
+	EXPECT_FALSE(tm.setRuntimeSchedule(TM_SCHEDULE_RUNTIME));
+	EXPECT_FALSE(tm.setRuntimeSchedule(TM_SCHEDULE_USER_DEFINED));
+	EXPECT_FALSE(tm.setRuntimeSchedule(TM_SCHEDULE_DYNAMIC, -1));
+	EXPECT_EQ(tm.anyThreadRunning(), false);
+}
+
+TEST_F(ThreadManagerTest, parallelRange) {
+	tm.setNumThreads(3);
+	std::vector<int64_t> sums(tm.getNumThreads(), 0);
+	std::vector<int> values(10007);
+	for (size_t i = 0; i < values.size(); i++) values[i] = (int) i;
+
+	// each thread sums up its sub-ranges in its own element
+	auto sumRange = [&values](void* pParameter, int64_t begin, int64_t end) -> DWORD {
+		int64_t& sum = *((int64_t*) pParameter);
+		for (int64_t i = begin; i < end; i++) sum += values[i];
+		return TM_RETURN_VALUE_OK;
+	};
+	const int64_t expectedSum = (int64_t) values.size() * (values.size() - 1) / 2 - 5000 * 4999 / 2;
+
+	for (unsigned int scheduleType : {TM_SCHEDULE_STATIC, TM_SCHEDULE_DYNAMIC, TM_SCHEDULE_GUIDED, TM_SCHEDULE_RUNTIME}) {
+		for (int64_t chunkSize : {0, 1, 64, 100000}) {
+			EXPECT_TRUE(tm.setRuntimeSchedule(TM_SCHEDULE_DYNAMIC, chunkSize));
+			std::fill(sums.begin(), sums.end(), 0);
+			EXPECT_EQ(tm.executeParallelRange(sumRange, sums.data(), sizeof(int64_t), scheduleType, 5000, (int64_t) values.size()), TM_RETURN_VALUE_OK);
+			int64_t total = 0;
+			for (auto sum : sums) total += sum;
+			EXPECT_EQ(total, expectedSum) << "schedule " << scheduleType << ", chunk " << chunkSize;
+		}
+	}
+
+	// static blocks are contiguous and ordered by thread number, like in executeParallelLoop()
+	EXPECT_TRUE(tm.setRuntimeSchedule(TM_SCHEDULE_DYNAMIC, 10));
+	std::vector<std::pair<int64_t, int64_t>> blocks(tm.getNumThreads(), {INT64_MAX, INT64_MIN});
+	auto storeBlock = [](void* pParameter, int64_t begin, int64_t end) -> DWORD {
+		auto& block = *((std::pair<int64_t, int64_t>*) pParameter);
+		EXPECT_TRUE(block.second == INT64_MIN || block.second == begin);
+		block.first		= std::min<int64_t>(block.first, begin);
+		block.second	= end;
+		return TM_RETURN_VALUE_OK;
+	};
+	EXPECT_EQ(tm.executeParallelRange(storeBlock, blocks.data(), sizeof(blocks[0]), TM_SCHEDULE_STATIC, 0, 100), TM_RETURN_VALUE_OK);
+	EXPECT_EQ(blocks[0].first, 0);		EXPECT_EQ(blocks[0].second, 34);
+	EXPECT_EQ(blocks[1].first, 34);		EXPECT_EQ(blocks[1].second, 67);
+	EXPECT_EQ(blocks[2].first, 67);		EXPECT_EQ(blocks[2].second, 100);
+
+	// termination by the user function stops at chunk granularity
+	std::atomic<int> numCalls = 0;
+	auto terminate = [&numCalls](void* pParameter, int64_t begin, int64_t end) -> DWORD {
+		numCalls++;
+		return TM_RETURN_VALUE_TERMINATE_ALL_THREADS;
+	};
+	EXPECT_EQ(tm.executeParallelRange(terminate, sums.data(), sizeof(int64_t), TM_SCHEDULE_DYNAMIC, 0, 1000), TM_RETURN_VALUE_OK);
+	EXPECT_LE(numCalls, (int) tm.getNumThreads());
+
+	// invalid parameters
+	EXPECT_EQ(tm.executeParallelRange(sumRange, sums.data(), sizeof(int64_t), TM_SCHEDULE_STATIC, 10, 5), TM_RETURN_VALUE_INVALID_PARAM);
+	EXPECT_EQ(tm.executeParallelRange(sumRange, nullptr, sizeof(int64_t), TM_SCHEDULE_STATIC, 0, 5), TM_RETURN_VALUE_INVALID_PARAM);
+	EXPECT_EQ(tm.executeParallelRange(sumRange, sums.data(), sizeof(int64_t), TM_SCHEDULE_STATIC, 5, 5), TM_RETURN_VALUE_OK);
+}
+
+// recursive fork/join: each call spawns the first half and computes the second half itself
+static int64_t parallelFibonacci(threadManagerClass& tm, int n)
+{
+	if (n < 2) return n;
+	int64_t a = 0, b = 0;
+	threadManagerClass::taskGroup group;
+	tm.spawn(group, [&]() { a = parallelFibonacci(tm, n - 1); });
+	b = parallelFibonacci(tm, n - 2);
+	tm.sync(group);
+	return a + b;
+}
+
+TEST(ThreadManager, workStealingDeque) {
+	workStealingDeque<int> deque;
+	std::vector<int> items(100);
+
+	// owner takes the newest item, thieves the oldest
+	EXPECT_EQ(deque.pop(), nullptr);
+	EXPECT_EQ(deque.steal(), nullptr);
+	for (auto& item : items) EXPECT_TRUE(deque.push(&item));
+	EXPECT_EQ(deque.pop(),   &items[99]);
+	EXPECT_EQ(deque.steal(), &items[0]);
+	EXPECT_EQ(deque.steal(), &items[1]);
+	EXPECT_EQ(deque.pop(),   &items[98]);
+
+	// full
+	while (deque.pop() != nullptr);
+	std::vector<int> many(workStealingDeque<int>::capacity + 1);
+	for (int64_t i = 0; i < workStealingDeque<int>::capacity; i++) EXPECT_TRUE(deque.push(&many[i]));
+	EXPECT_FALSE(deque.push(&many.back()));
+	while (deque.pop() != nullptr);
+
+	// concurrent thieves: every item is taken exactly once
+	std::vector<std::atomic<int>> taken(100000);
+	std::atomic<bool> ownerDone = false;
+	std::vector<int> values(taken.size());
+	auto take = [&](int* item) { taken[item - values.data()]++; };
+	auto thiefLoop = [&]() {
+		while (!ownerDone) {
+			int* item = deque.steal();
+			if (item) take(item);
+		}
+		while (int* item = deque.steal()) take(item);
+	};
+	std::thread thief1(thiefLoop), thief2(thiefLoop);
+	for (size_t i = 0; i < values.size(); i++) {
+		while (!deque.push(&values[i])) {
+			if (int* item = deque.pop()) take(item);
+		}
+		if (i % 3 == 0) {
+			if (int* item = deque.pop()) take(item);
+		}
+	}
+	while (int* item = deque.pop()) take(item);
+	ownerDone = true;
+	thief1.join();
+	thief2.join();
+	for (size_t i = 0; i < taken.size(); i++) ASSERT_EQ(taken[i], 1) << "item " << i;
+}
+
+TEST_F(ThreadManagerTest, tasks) {
+	tm.setNumThreads(4);
+
+	// nested spawn and sync
+	int64_t result = 0;
+	EXPECT_EQ(tm.executeTasks([&]() { result = parallelFibonacci(tm, 22); }), TM_RETURN_VALUE_OK);
+	EXPECT_EQ(result, 17711);
+	EXPECT_EQ(tm.anyThreadRunning(), false);
+
+	// idle workers steal tasks, so that both tasks run at the same time
+	std::atomic<int> numArrived = 0;
+	std::atomic<bool> bothRan = false;
+	auto meet = [&]() {
+		numArrived++;
+		for (int i = 0; i < 5000 && numArrived < 2; i++) Sleep(1);
+		if (numArrived >= 2) bothRan = true;
+	};
+	EXPECT_EQ(tm.parallel_invoke(meet, meet), TM_RETURN_VALUE_OK);
+	EXPECT_TRUE(bothRan);
+
+	// parallel_invoke within a task
+	std::atomic<int> sum = 0;
+	EXPECT_EQ(tm.executeTasks([&]() {
+		tm.parallel_invoke([&]() { sum += 1; }, [&]() { sum += 2; }, [&]() { tm.parallel_invoke([&]() { sum += 4; }, [&]() { sum += 8; }); });
+	}), TM_RETURN_VALUE_OK);
+	EXPECT_EQ(sum, 15);
+
+	// outside of executeTasks() spawn runs the task immediately
+	threadManagerClass::taskGroup group;
+	int value = 0;
+	tm.spawn(group, [&]() { value = 1; });
+	EXPECT_EQ(value, 1);
+	tm.sync(group);
+
+	// more tasks than the deque can hold
+	std::atomic<int> numTasks = 0;
+	EXPECT_EQ(tm.executeTasks([&]() {
+		threadManagerClass::taskGroup manyTasks;
+		for (int i = 0; i < 3 * workStealingDeque<int>::capacity; i++) tm.spawn(manyTasks, [&]() { numTasks++; });
+		tm.sync(manyTasks);
+	}), TM_RETURN_VALUE_OK);
+	EXPECT_EQ(numTasks, 3 * workStealingDeque<int>::capacity);
+
+	EXPECT_EQ(tm.executeTasks(nullptr), TM_RETURN_VALUE_INVALID_PARAM);
+
+	// each task knows its worker
+	std::atomic<int> numValidThreadNumbers = 0;
+	EXPECT_EQ(tm.executeTasks([&]() {
+		threadManagerClass::taskGroup group;
+		for (int i = 0; i < 100; i++) tm.spawn(group, [&]() { if (tm.getThreadNumber() < tm.getNumThreads()) numValidThreadNumbers++; });
+		tm.sync(group);
+	}), TM_RETURN_VALUE_OK);
+	EXPECT_EQ(numValidThreadNumbers, 100);
+
+	// tasks not started yet are skipped after a cancellation
+	numTasks = 0;
+	EXPECT_EQ(tm.executeTasks([&]() {
+		threadManagerClass::taskGroup group;
+		for (int i = 0; i < 1000; i++) tm.spawn(group, [&]() { if (numTasks++ == 10) tm.cancelExecution(); });
+		tm.sync(group);
+		tm.spawn(group, [&]() { numTasks += 1000; });
+		tm.sync(group);
+	}), TM_RETURN_VALUE_EXECUTION_CANCELLED);
+	EXPECT_LT(numTasks, 1000);
+	tm.reset();
+}
+
+TEST_F(ThreadManagerTest, taskItemsReused) {
+	tm.setNumThreads(4);
+
+	// stolen items are passed back to the spawning worker, so that repeated calls do not allocate new ones
+	const int numTasks = 32;
+	for (int call = 0; call < 50; call++) {
+		EXPECT_EQ(tm.executeTasks([&]() {
+			threadManagerClass::taskGroup group;
+			for (int i = 0; i < numTasks; i++) tm.spawn(group, [&]() { Sleep(1); });
+			tm.sync(group);
+		}), TM_RETURN_VALUE_OK);
+		EXPECT_LE(tm.getNumTaskItems(), numTasks);
+	}
+	EXPECT_GT(tm.getNumTaskItems(), 0);
+}
+
+TEST_F(ThreadManagerTest, numaPlacement) {
+	// vector elements are not initialized by the allocator, but by fillParallel()
+	std::vector<int, defaultInitAllocator<int>> values;
+	values.resize(300000);
+	tm.fillParallel(values.data(), values.size(), 7);
+	EXPECT_EQ(std::count(values.begin(), values.end(), 7), (long) values.size());
+	values.resize(values.size() + 10, 3);
+	EXPECT_EQ(values.back(), 3);
+
+	// nested in a task and in a job of the workers
+	EXPECT_EQ(tm.executeTasks([&]() { tm.fillParallel(values.data(), values.size(), 8); }), TM_RETURN_VALUE_OK);
+	EXPECT_EQ(std::count(values.begin(), values.end(), 8), (long) values.size());
+	std::vector<int> nestedValues(200000);
+	EXPECT_EQ(tm.executeParallelRange([&](void* pParameter, int64_t begin, int64_t end) -> DWORD {
+		if (begin == 0) tm.fillParallel(nestedValues.data(), nestedValues.size(), 9);
+		return TM_RETURN_VALUE_OK;
+	}, &tm, 0, TM_SCHEDULE_STATIC, 0, tm.getNumThreads()), TM_RETURN_VALUE_OK);
+	EXPECT_EQ(std::count(nestedValues.begin(), nestedValues.end(), 9), (long) nestedValues.size());
+
+	// placement info covers the touched pages
+	auto bytesPerNode = threadManagerClass::getBytesPerNumaNode(values.data(), values.size() * sizeof(int));
+	ASSERT_GE(bytesPerNode.size(), 1);
+	long long totalBytes = 0;
+	for (auto bytes : bytesPerNode) totalBytes += bytes;
+	EXPECT_LE(totalBytes, (long long) (values.size() * sizeof(int)));
+	EXPECT_GT(totalBytes, 0);
+
+	// pinned threads still execute jobs
+	EXPECT_EQ(tm.getNumaNodeOfThread(0), -1);
+	EXPECT_TRUE(tm.setThreadPinning(true));
+	std::vector<DWORD> ids(tm.getNumThreads(), 0);
+	auto storeThreadId = [](void* pParameter) -> DWORD {
+		*((DWORD*) pParameter) = GetCurrentThreadId();
+		return 0;
+	};
+	EXPECT_EQ(tm.executeInParallel(storeThreadId, ids.data(), sizeof(DWORD)), TM_RETURN_VALUE_OK);
+	EXPECT_NE(ids[0], ids[1]);
+	EXPECT_GE(tm.getNumaNodeOfThread(0), 0);
+	EXPECT_LE(tm.getNumaNodeOfThread(0), tm.getNumaNodeOfThread(1));
+	EXPECT_EQ(tm.getNumaNodeOfThread(tm.getNumThreads()), -1);
+	tm.fillParallel(values.data(), values.size(), 5);
+	EXPECT_EQ(std::count(values.begin(), values.end(), 5), (long) values.size());
+	EXPECT_TRUE(tm.setThreadPinning(false));
+	EXPECT_EQ(tm.getNumaNodeOfThread(0), -1);
+}
+
+TEST_F(ThreadManagerTest, cooperativePause) {
+	std::atomic<int64_t> numIterations = 0;
+	auto countIterations = [&numIterations](void* pParameter, int64_t begin, int64_t end) -> DWORD {
+		numIterations += end - begin;
+		Sleep(1);
+		return TM_RETURN_VALUE_OK;
+	};
+	tm.setRuntimeSchedule(TM_SCHEDULE_DYNAMIC, 10);							// many short sub-ranges
+	auto waitForParkedThreads = [this]() {
+		for (int i = 0; i < 1000 && tm.getNumPausedThreads() < tm.getNumThreads(); i++) Sleep(1);
+	};
+
+	// pause while the threads are working on the range
+	std::thread controller([&]() {
+		Sleep(20);
+		tm.pauseExecution();
+		EXPECT_TRUE(tm.isExecutionPaused());
+		waitForParkedThreads();
+		EXPECT_EQ(tm.getNumPausedThreads(), tm.getNumThreads());
+		int64_t numIterationsWhenPaused = numIterations;
+		Sleep(50);
+		EXPECT_EQ(numIterations, numIterationsWhenPaused);		// no progress while paused
+		tm.pauseExecution();
+		EXPECT_FALSE(tm.isExecutionPaused());
+	});
+	EXPECT_EQ(tm.executeParallelRange(countIterations, &tm, 0, TM_SCHEDULE_RUNTIME, 0, 10000), TM_RETURN_VALUE_OK);
+	controller.join();
+	EXPECT_EQ(numIterations, 10000);
+	EXPECT_EQ(tm.getNumPausedThreads(), 0);
+
+	// cancelling releases the parked threads
+	std::thread canceller([&]() {
+		Sleep(20);
+		tm.pauseExecution();
+		waitForParkedThreads();
+		tm.cancelExecution();
+	});
+	EXPECT_EQ(tm.executeParallelRange(countIterations, &tm, 0, TM_SCHEDULE_RUNTIME, 0, 10000000), TM_RETURN_VALUE_EXECUTION_CANCELLED);
+	canceller.join();
+	EXPECT_FALSE(tm.isExecutionPaused());
+	EXPECT_EQ(tm.getNumPausedThreads(), 0);
+}
+
+TEST_F(ThreadManagerTest, profiling) {
+	std::atomic<int64_t> sum = 0;
+	auto addRange = [&sum](void* pParameter, int64_t begin, int64_t end) -> DWORD {
+		for (int64_t i = begin; i < end; i++) sum += i;
+		return TM_RETURN_VALUE_OK;
+	};
+
+	// nothing is measured by default
+	EXPECT_FALSE(tm.isProfilingEnabled());
+	EXPECT_EQ(tm.executeParallelRange(addRange, &tm, 0, TM_SCHEDULE_DYNAMIC, 0, 1000), TM_RETURN_VALUE_OK);
+	EXPECT_TRUE(tm.getLastProfile().threads.empty());
+
+	// each thread counts its own iterations and chunks
+	EXPECT_TRUE(tm.setProfiling(true));
+	EXPECT_EQ(tm.executeParallelRange(addRange, &tm, 0, TM_SCHEDULE_DYNAMIC, 0, 100000), TM_RETURN_VALUE_OK);
+	const threadManagerClass::executionProfile& profile = tm.getLastProfile();
+	ASSERT_EQ(profile.threads.size(), tm.getNumThreads());
+	int64_t numIterations = 0, numChunks = 0, numHistogramEntries = 0;
+	for (auto& thread : profile.threads) {
+		numIterations	+= thread.numIterations;
+		numChunks		+= thread.numChunks;
+		for (auto count : thread.chunkHistogram) numHistogramEntries += count;
+		EXPECT_GE(thread.busySeconds, 0);
+		EXPECT_LE(thread.busySeconds, profile.wallSeconds);
+	}
+	EXPECT_EQ(numIterations, 100000);
+	EXPECT_EQ(numChunks, numHistogramEntries);
+	EXPECT_GE(numChunks, (int64_t) tm.getNumThreads());
+	EXPECT_GE(profile.getImbalance(), 1.0);
+
+	// time in the barrier is not counted as busy
+	std::mutex valuesMutex;
+	std::vector<int> values(tm.getNumThreads(), 0); 
+	threadManagerClass::threadVarsArray<defaultThreadVars> tva(tm.getNumThreads(), defaultThreadVars(&tm, values.data(), &valuesMutex));
+	EXPECT_EQ(tm.executeParallelLoop(threadProc_4, tva.getPointerToArray(), tva.getSizeOfArray(), TM_SCHEDULE_STATIC, 0, 19, 1), TM_RETURN_VALUE_OK);
+	ASSERT_EQ(tm.getLastProfile().threads.size(), tm.getNumThreads());
+	EXPECT_EQ(tm.getLastProfile().threads[0].numIterations + tm.getLastProfile().threads[1].numIterations, 20);
+	EXPECT_EQ(tm.getLastProfile().threads[0].numChunks, 1);
+	EXPECT_GT(tm.getLastProfile().threads[0].barrierWaitSeconds + tm.getLastProfile().threads[1].barrierWaitSeconds, 0);
+
+	// json
+	std::wstring json = tm.getLastProfile().toJson();
+	EXPECT_EQ(json.front(), L'{');
+	EXPECT_EQ(json.back(), L'}');
+	EXPECT_NE(json.find(L"\"barrierWaitSeconds\""), std::wstring::npos);
+	EXPECT_NE(json.find(L"\"thread\":1"), std::wstring::npos);
+
+	EXPECT_TRUE(tm.setProfiling(false));
+	EXPECT_TRUE(tm.getLastProfile().threads.empty());
+}
+
+TEST(ThreadManager, threadCountTuner) {
+	threadCountTuner tuner;
+	tuner.setMaxNumThreads(8);
+
+	// throughput rises up to 3 threads and falls afterwards
+	auto statesPerSecond = [](unsigned int numThreads) -> int64_t {
+		return numThreads <= 3 ? 1000 * numThreads : 3000 - 300 * (numThreads - 3);
+	};
+	EXPECT_EQ(tuner.getNumThreads(L"phase"), 8);								// first trial with all threads
+	for (int trial = 0; trial < 20 && !tuner.isTuned(L"phase"); trial++) {
+		unsigned int numThreads = tuner.getNumThreads(L"phase");
+		EXPECT_GE(numThreads, 1);
+		EXPECT_LE(numThreads, 8);
+		tuner.addMeasurement(L"phase", numThreads, statesPerSecond(numThreads), 1.0);
+	}
+	EXPECT_TRUE(tuner.isTuned(L"phase"));
+	EXPECT_EQ(tuner.getNumThreads(L"phase"), 3);
+
+	// similar amounts of work share the size class
+	EXPECT_EQ(threadCountTuner::getPhaseOfSize(L"phase", 1000), threadCountTuner::getPhaseOfSize(L"phase", 1023));
+	EXPECT_NE(threadCountTuner::getPhaseOfSize(L"phase", 1000), threadCountTuner::getPhaseOfSize(L"phase", 1024));
+	EXPECT_NE(threadCountTuner::getPhaseOfSize(L"phase", 1000), threadCountTuner::getPhaseOfSize(L"other", 1000));
+
+	// too short executions are no trials
+	EXPECT_EQ(tuner.getNumThreads(L"other"), 8);
+	tuner.addMeasurement(L"other", 8, 1000, threadCountTuner::minTrialSeconds / 2);
+	EXPECT_EQ(tuner.getNumThreads(L"other"), 8);
+	EXPECT_FALSE(tuner.isTuned(L"other"));
+
+	// only tuned phases are saved, and only loaded for the same maximum
+	std::wstring filePath = (std::filesystem::temp_directory_path() / L"threadTuning.txt").wstring();
+	ASSERT_TRUE(tuner.save(filePath));
+	threadCountTuner loaded;
+	loaded.setMaxNumThreads(8);
+	EXPECT_TRUE(loaded.load(filePath));
+	EXPECT_TRUE(loaded.isTuned(L"phase"));
+	EXPECT_EQ(loaded.getNumThreads(L"phase"), 3);
+	EXPECT_FALSE(loaded.isTuned(L"other"));
+	threadCountTuner otherMachine;
+	otherMachine.setMaxNumThreads(16);
+	EXPECT_TRUE(otherMachine.load(filePath));
+	EXPECT_FALSE(otherMachine.isTuned(L"phase"));
+	std::filesystem::remove(filePath);
+	EXPECT_FALSE(otherMachine.load(filePath));
+}
+
+TEST_F(ThreadManagerTest, autoTuning) {
+	tm.setNumThreads(4);
+	std::vector<DWORD> ids(tm.getNumThreads(), 0);
+	std::vector<DWORD> idsBefore(tm.getNumThreads(), 0);
+	std::wstring phase = threadCountTuner::getPhaseOfSize(L"phase", 1000);
+	auto storeThreadId = [](void* pParameter) -> DWORD {
+		*((DWORD*) pParameter) = GetCurrentThreadId();
+		return 0;
+	};
+
+	// without auto tuning the phases use all threads
+	tm.beginPhase(L"phase", 1000);
+	EXPECT_EQ(tm.getNumThreads(), 4);
+	tm.endPhase(1000);
+	EXPECT_EQ(tm.executeInParallel(storeThreadId, idsBefore.data(), sizeof(DWORD)), TM_RETURN_VALUE_OK);
+
+	// a tuned phase runs with fewer threads and restores the number afterwards
+	EXPECT_TRUE(tm.setAutoTuning(true));
+	tm.getTuner().addMeasurement(phase, tm.getTuner().getNumThreads(phase), 1000, 1.0);	// 4 threads measured, next trial is 2
+	tm.beginPhase(L"phase", 1000);
+	EXPECT_EQ(tm.getNumThreads(), 2);
+	EXPECT_EQ(tm.executeInParallel(storeThreadId, ids.data(), sizeof(DWORD)), TM_RETURN_VALUE_OK);
+	EXPECT_NE(ids[0], ids[1]);
+	tm.endPhase(1000);
+	EXPECT_EQ(tm.getNumThreads(), 4);
+
+	// the workers are not recreated, the surplus ones were only parked
+	EXPECT_EQ(tm.executeInParallel(storeThreadId, ids.data(), sizeof(DWORD)), TM_RETURN_VALUE_OK);
+	EXPECT_EQ(ids, idsBefore);
+
+	// another amount of work is tuned separately
+	tm.beginPhase(L"phase", 1000000);
+	EXPECT_EQ(tm.getNumThreads(), 4);
+	tm.endPhase(1000000);
+
+	EXPECT_TRUE(tm.setAutoTuning(false));
+	tm.beginPhase(L"phase", 1000);
+	EXPECT_EQ(tm.getNumThreads(), 4);
+	tm.endPhase(1000);
+}